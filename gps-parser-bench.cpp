@@ -0,0 +1,280 @@
+#include "captures.h"
+#include "drivers.h"
+#include "mock_device.h"
+#include "ubx.h"
+#include "unicore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Every heap allocation of the process is counted, so the drivers' allocations during
+// configuration and parsing can be told apart from a regression on the hot path.
+static uint64_t allocations = 0;
+
+void *operator new(size_t size)
+{
+	allocations++;
+	void *p = malloc(size > 0 ? size : 1);
+
+	if (!p) {
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	free(p);
+}
+
+struct BenchOptions {
+	size_t chunk_size{GPS_READ_BUFFER_SIZE};
+	size_t min_bytes{16 * 1024 * 1024};	///< parse at least this much data per protocol
+	unsigned seconds{60};			///< minimum duration of the synthetic captures
+	const char *save_prefix{nullptr};	///< write the synthetic captures to <prefix>.<protocol>
+	bool raw_measurements{false};		///< RXM-RAWX and RXM-SFRBX in the UBX capture, passed through to the log sink
+};
+
+struct BenchResult {
+	size_t bytes{0};
+	uint32_t frames{0};			///< messages in the parsed data, 0 if unknown
+	uint32_t updates{0};			///< receive() calls that returned data
+	uint32_t rtcm{0};			///< RTCM messages forwarded through gotRTCMMessage
+	double seconds{0.};
+	uint64_t configure_allocations{0};
+	uint64_t parse_allocations{0};
+};
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Serve the whole capture through receive() and time it
+ */
+static void runReceiveLoop(GPSHelper &driver, MockDevice &device, unsigned repeat, BenchResult &result)
+{
+	const uint64_t allocations_start = allocations;
+	device.startStream(repeat);
+	const Clock::time_point start = Clock::now();
+
+	while (!device.streamDone()) {
+		if (driver.receive(100) > 0) {
+			result.updates++;
+		}
+	}
+
+	result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	result.parse_allocations = allocations - allocations_start;
+	result.bytes = device.bytesServed();
+	result.rtcm = device.rtcmMessages();
+}
+
+static BenchResult benchDriver(HostProtocol protocol, const Capture &capture, unsigned repeat,
+			       const BenchOptions &options)
+{
+	BenchResult result;
+	sensor_gps_s gps_position{};
+	satellite_info_s satellite_info{};
+
+	const uint64_t allocations_start = allocations;
+	MockDevice device(capture.data.data(), capture.data.size(), options.chunk_size, protocolResponder(protocol));
+	GPSHelper *driver = createDriver(protocol, device, &gps_position, &satellite_info);
+
+	if (!driver) {
+		return result;
+	}
+
+	if (options.raw_measurements && protocol == HostProtocol::UBX) {
+		static_cast<GPSDriverUBX *>(driver)->setRawMessageClass(UBX_CLASS_RXM, true);
+	}
+
+	// forward RTCM as well, to include its framing in the measurement
+	if (configureDriver(protocol, *driver, GPSHelper::OutputMode::GPSAndRTCM) != 0) {
+		fprintf(stderr, "%s: configure failed\n", protocolName(protocol));
+	}
+
+	result.configure_allocations = allocations - allocations_start;
+	runReceiveLoop(*driver, device, repeat, result);
+	result.frames = capture.frames * repeat;
+
+	delete driver;
+	return result;
+}
+
+static BenchResult benchUnicore(const Capture &capture, unsigned repeat)
+{
+	BenchResult result;
+	const uint64_t allocations_start = allocations;
+	UnicoreParser parser;
+	result.configure_allocations = allocations - allocations_start;
+
+	const Clock::time_point start = Clock::now();
+
+	for (unsigned r = 0; r < repeat; r++) {
+		for (const uint8_t c : capture.data) {
+			const UnicoreParser::Result ret = parser.parseChar((char)c);
+
+			if (ret == UnicoreParser::Result::GotHeading || ret == UnicoreParser::Result::GotAgrica) {
+				result.updates++;
+			}
+		}
+	}
+
+	result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	result.parse_allocations = allocations - allocations_start - result.configure_allocations;
+	result.bytes = capture.data.size() * repeat;
+	result.frames = capture.frames * repeat;
+	return result;
+}
+
+static Capture generateCapture(HostProtocol protocol, unsigned seconds, const BenchOptions &options)
+{
+	switch (protocol) {
+	case HostProtocol::UBX: return generateUBXCapture(seconds, options.raw_measurements);
+
+	case HostProtocol::SBF: return generateSBFCapture(seconds);
+
+	case HostProtocol::NMEA: return generateNMEACapture(seconds);
+
+	case HostProtocol::Ashtech: return generateAshtechCapture(seconds);
+
+	case HostProtocol::Femto: return generateFemtoCapture(seconds);
+
+	default: return generateUnicoreCapture(seconds);
+	}
+}
+
+static void printResult(const char *name, const BenchResult &result)
+{
+	const double ns_per_byte = result.bytes > 0 ? result.seconds * 1e9 / (double)result.bytes : 0.;
+	const double messages = result.frames > 0 ? result.frames : result.updates;
+	const double messages_per_s = result.seconds > 0. ? messages / result.seconds : 0.;
+	char frames[16] = "-";
+
+	if (result.frames > 0) {
+		snprintf(frames, sizeof(frames), "%u", result.frames);
+	}
+
+	printf("%-8s %11zu %9s %9u %7u %9.2f %12.0f %9llu %9llu\n", name, result.bytes, frames, result.updates,
+	       result.rtcm, ns_per_byte, messages_per_s, (unsigned long long)result.configure_allocations,
+	       (unsigned long long)result.parse_allocations);
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-c chunk-size] [-m min-MiB] [-s seconds] [-w prefix] [-r] [<protocol> <capture-file>]...\n", name);
+	printf("  protocol: ubx, sbf, nmea, ashtech, femto or unicore\n");
+	printf("  without capture files, synthetic captures of every protocol are used\n");
+	printf("  recorded captures are repeated until min-MiB (default 16) have been parsed\n");
+	printf("  -w writes the synthetic captures to <prefix>.<protocol>\n");
+	printf("  -r adds raw measurements (RXM-RAWX, RXM-SFRBX) to the UBX capture and logs them\n");
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions options;
+	const char *capture_files[(int)HostProtocol::Count] {};
+	bool have_files = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+			options.chunk_size = strtoul(argv[++i], nullptr, 10);
+
+		} else if (i + 1 < argc && strcmp(argv[i], "-m") == 0) {
+			options.min_bytes = strtoul(argv[++i], nullptr, 10) * 1024 * 1024;
+
+		} else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+			options.seconds = (unsigned)strtoul(argv[++i], nullptr, 10);
+
+		} else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+			options.save_prefix = argv[++i];
+
+		} else if (strcmp(argv[i], "-r") == 0) {
+			options.raw_measurements = true;
+
+		} else {
+			HostProtocol protocol;
+
+			if (!parseProtocolName(argv[i], protocol) || i + 1 >= argc) {
+				usage(argv[0]);
+				return 1;
+			}
+
+			capture_files[(int)protocol] = argv[++i];
+			have_files = true;
+		}
+	}
+
+	printf("%-8s %11s %9s %9s %7s %9s %12s %9s %9s\n", "protocol", "bytes", "messages", "updates", "rtcm",
+	       "ns/byte", "messages/s", "cfg-alloc", "run-alloc");
+
+	for (int p = 0; p < (int)HostProtocol::Count; p++) {
+		const HostProtocol protocol = (HostProtocol)p;
+		Capture capture;
+
+		if (have_files) {
+			if (!capture_files[p]) {
+				continue;
+			}
+
+			if (!loadCapture(capture_files[p], capture)) {
+				fprintf(stderr, "failed to load %s\n", capture_files[p]);
+				return 1;
+			}
+
+		} else {
+			// generate a long enough capture rather than repeating it: the drivers drop
+			// solutions whose time doesn't advance
+			capture = generateCapture(protocol, options.seconds, options);
+
+			if (!capture.data.empty() && capture.data.size() < options.min_bytes) {
+				capture = generateCapture(protocol, (unsigned)(options.seconds * options.min_bytes / capture.data.size() + 1),
+						  options);
+			}
+
+			if (options.save_prefix) {
+				char path[256];
+				snprintf(path, sizeof(path), "%s.%s", options.save_prefix, protocolName(protocol));
+
+				if (!saveCapture(path, capture)) {
+					fprintf(stderr, "failed to write %s\n", path);
+					return 1;
+				}
+			}
+		}
+
+		if (capture.data.empty()) {
+			continue;
+		}
+
+		const unsigned repeat = (unsigned)((options.min_bytes + capture.data.size() - 1) / capture.data.size());
+		const BenchResult result = protocol == HostProtocol::Unicore ? benchUnicore(capture, repeat) :
+					   benchDriver(protocol, capture, repeat, options);
+		printResult(protocolName(protocol), result);
+	}
+
+	return 0;
+}
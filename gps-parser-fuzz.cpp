@@ -0,0 +1,40 @@
+#include "fuzz_decoders.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// libFuzzer target of one decoder, selected when building with -DGPS_FUZZ_DECODER="<name>"
+static FuzzDecoder fuzz_decoder{FuzzDecoder::Count};
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	(void)argc;
+	(void)argv;
+
+	if (!parseFuzzDecoderName(GPS_FUZZ_DECODER, fuzz_decoder)) {
+		fprintf(stderr, "unknown decoder %s\n", GPS_FUZZ_DECODER);
+		abort();
+	}
+
+	return 0;
+}
+
+/**
+ * The first byte of the input is the read size, 1 to 256 bytes, so both the per byte and the bulk
+ * decoding paths of the drivers see the rest of it, and it is cut at any position.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	if (size < 2) {
+		return 0;
+	}
+
+	const size_t chunk_size = (size_t)data[0] + 1;
+	FuzzHarness harness(fuzz_decoder);
+
+	for (size_t i = 1; i < size; i += chunk_size) {
+		harness.feed(data + i, size - i < chunk_size ? size - i : chunk_size);
+	}
+
+	return 0;
+}
@@ -0,0 +1,356 @@
+#include "captures.h"
+#include "fuzz_decoders.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+#define STRESS_TIME_UNIT "cycles"
+
+/** TSC, which counts at the nominal clock rate */
+static inline uint64_t timeCount()
+{
+	return __rdtsc();
+}
+
+#else
+
+#define STRESS_TIME_UNIT "ns"
+
+static inline uint64_t timeCount()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>
+	       (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
+
+#define STRESS_BLOCK_SIZE	(64 * 1024)	///< input generated at once, between the timed reads
+
+enum class StressInput {
+	Noise,		///< uniformly random bytes
+	Tokens,		///< random bytes, interspersed with the decoder's sync words, headers and length fields
+	Corrupted,	///< a synthetic capture with bit flips, replaced, dropped and inserted bytes
+	Count
+};
+
+static const char *const input_names[] = {"noise", "tokens", "corrupted"};
+
+static_assert(sizeof(input_names) / sizeof(input_names[0]) == (size_t)StressInput::Count,
+	      "input_names must match StressInput");
+
+struct StressOptions {
+	double seconds{1.};			///< run time per decoder and input
+	size_t chunk_size{GPS_READ_BUFFER_SIZE};
+	double error_rate{1e-3};		///< probability of an error per byte of the corrupted captures
+	uint32_t seed{1};
+	const char *dictionary_prefix{nullptr};	///< write the libFuzzer dictionaries to <prefix>.<decoder>.dict
+};
+
+struct StressResult {
+	size_t bytes{0};
+	uint32_t updates{0};			///< feed() calls that returned data
+	double seconds{0.};
+	std::vector<float> read_cost;		///< time per byte of each read
+};
+
+using Clock = std::chrono::steady_clock;
+
+class StressInputGenerator
+{
+public:
+	StressInputGenerator(FuzzDecoder decoder, StressInput input, const StressOptions &options) :
+		_input(input),
+		_error_rate((uint32_t)(options.error_rate * 4294967295.)),
+		_state(options.seed ? options.seed : 1)
+	{
+		_tokens = fuzzTokens(decoder, _token_count);
+
+		if (input == StressInput::Corrupted) {
+			_capture = capture(decoder);
+		}
+	}
+
+	/**
+	 * @return false if there is no input of the kind for the decoder
+	 */
+	bool valid() const { return _input != StressInput::Corrupted || !_capture.data.empty(); }
+
+	void fill(std::vector<uint8_t> &block)
+	{
+		block.clear();
+
+		while (block.size() < STRESS_BLOCK_SIZE) {
+			switch (_input) {
+			case StressInput::Noise:
+				block.push_back((uint8_t)random());
+				break;
+
+			case StressInput::Tokens:
+				if (random() % 8 == 0) {
+					const FuzzToken &token = _tokens[random() % _token_count];
+					block.insert(block.end(), token.data, token.data + token.length);
+
+				} else {
+					block.push_back((uint8_t)random());
+				}
+
+				break;
+
+			default:
+				addCorrupted(block);
+				break;
+			}
+		}
+	}
+
+private:
+	static Capture capture(FuzzDecoder decoder)
+	{
+		switch (decoder) {
+		case FuzzDecoder::UBX: return generateUBXCapture(60, true);
+
+		case FuzzDecoder::SBF: return generateSBFCapture(60);
+
+		case FuzzDecoder::NMEA: return generateNMEACapture(60);
+
+		case FuzzDecoder::Ashtech: return generateAshtechCapture(60);
+
+		case FuzzDecoder::Femto: return generateFemtoCapture(60);
+
+		case FuzzDecoder::Unicore: return generateUnicoreCapture(60);
+
+		default: return Capture();
+		}
+	}
+
+	void addCorrupted(std::vector<uint8_t> &block)
+	{
+		const uint8_t b = _capture.data[_capture_pos];
+		_capture_pos = (_capture_pos + 1) % _capture.data.size();
+
+		if (random() >= _error_rate) {
+			block.push_back(b);
+			return;
+		}
+
+		switch (random() % 4) {
+		case 0:
+			block.push_back((uint8_t)(b ^ (1u << (random() % 8))));
+			break;
+
+		case 1:
+			block.push_back((uint8_t)random());
+			break;
+
+		case 2:
+			break;	// dropped
+
+		default:
+			block.push_back((uint8_t)random());
+			block.push_back(b);
+			break;
+		}
+	}
+
+	uint32_t random()
+	{
+		// xorshift32
+		_state ^= _state << 13;
+		_state ^= _state >> 17;
+		_state ^= _state << 5;
+		return _state;
+	}
+
+	const StressInput _input;
+	const uint32_t _error_rate;
+	uint32_t _state;
+	const FuzzToken *_tokens{nullptr};
+	size_t _token_count{0};
+	Capture _capture;
+	size_t _capture_pos{0};
+};
+
+static StressResult stressDecoder(FuzzDecoder decoder, StressInputGenerator &generator, const StressOptions &options)
+{
+	StressResult result;
+	FuzzHarness harness(decoder);
+	std::vector<uint8_t> block;
+	result.read_cost.reserve(1024 * 1024);
+
+	const Clock::time_point start = Clock::now();
+	const Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>
+				      (std::chrono::duration<double>(options.seconds));
+	double parse_seconds = 0.;
+
+	do {
+		generator.fill(block);
+		const Clock::time_point block_start = Clock::now();
+
+		for (size_t i = 0; i < block.size(); i += options.chunk_size) {
+			const size_t length = std::min(options.chunk_size, block.size() - i);
+			const uint64_t t0 = timeCount();
+			const int ret = harness.feed(block.data() + i, length);
+			const uint64_t t1 = timeCount();
+
+			result.read_cost.push_back((float)(t1 - t0) / (float)length);
+
+			if (ret > 0) {
+				result.updates++;
+			}
+		}
+
+		parse_seconds += std::chrono::duration<double>(Clock::now() - block_start).count();
+		result.bytes += block.size();
+	} while (Clock::now() < end);
+
+	result.seconds = parse_seconds;
+	return result;
+}
+
+/**
+ * @param fraction 0 to 1
+ */
+static float percentile(std::vector<float> &values, double fraction)
+{
+	if (values.empty()) {
+		return 0.f;
+	}
+
+	const size_t n = std::min(values.size() - 1, (size_t)(fraction * (double)values.size()));
+	std::nth_element(values.begin(), values.begin() + (long)n, values.end());
+	return values[n];
+}
+
+static void printResult(FuzzDecoder decoder, StressInput input, StressResult &result)
+{
+	double sum = 0.;
+
+	for (const float cost : result.read_cost) {
+		sum += cost;
+	}
+
+	const double mean = result.read_cost.empty() ? 0. : sum / (double)result.read_cost.size();
+	const double ns_per_byte = result.bytes > 0 ? result.seconds * 1e9 / (double)result.bytes : 0.;
+	const float worst = result.read_cost.empty() ? 0.f : *std::max_element(result.read_cost.begin(), result.read_cost.end());
+	const float p9999 = percentile(result.read_cost, 0.9999);
+	const float p999 = percentile(result.read_cost, 0.999);
+
+	printf("%-8s %-10s %11zu %8u %8.2f %9.1f %9.1f %9.1f %9.1f\n", fuzzDecoderName(decoder),
+	       input_names[(int)input], result.bytes, result.updates, ns_per_byte, mean, p999, p9999, worst);
+}
+
+static bool writeDictionary(const char *prefix, FuzzDecoder decoder)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s.%s.dict", prefix, fuzzDecoderName(decoder));
+	FILE *file = fopen(path, "w");
+
+	if (!file) {
+		return false;
+	}
+
+	size_t count;
+	const FuzzToken *tokens = fuzzTokens(decoder, count);
+
+	for (size_t i = 0; i < count; i++) {
+		fputc('"', file);
+
+		for (size_t j = 0; j < tokens[i].length; j++) {
+			const uint8_t c = (uint8_t)tokens[i].data[j];
+
+			if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+				fputc(c, file);
+
+			} else {
+				fprintf(file, "\\x%02x", c);
+			}
+		}
+
+		fputs("\"\n", file);
+	}
+
+	return fclose(file) == 0;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s [-s seconds] [-c chunk-size] [-e error-rate] [-r seed] [-d prefix] [<decoder>]...\n", name);
+	printf("  decoder: ubx, sbf, nmea, ashtech, femto, erb, mtk or unicore, all by default\n");
+	printf("  every decoder is fed each kind of input for the given time (default 1 s), in reads of\n");
+	printf("  chunk-size bytes. The cost of the reads is in " STRESS_TIME_UNIT " per byte.\n");
+	printf("  -e probability of an error per byte of the corrupted captures (default 0.001)\n");
+	printf("  -d writes the libFuzzer dictionaries to <prefix>.<decoder>.dict\n");
+}
+
+int main(int argc, char **argv)
+{
+	StressOptions options;
+	bool selected[(int)FuzzDecoder::Count] {};
+	bool have_selection = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+			options.seconds = strtod(argv[++i], nullptr);
+
+		} else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+			options.chunk_size = std::max<size_t>(1, strtoul(argv[++i], nullptr, 10));
+
+		} else if (i + 1 < argc && strcmp(argv[i], "-e") == 0) {
+			options.error_rate = strtod(argv[++i], nullptr);
+
+		} else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+			options.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+
+		} else if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+			options.dictionary_prefix = argv[++i];
+
+		} else {
+			FuzzDecoder decoder;
+
+			if (!parseFuzzDecoderName(argv[i], decoder)) {
+				usage(argv[0]);
+				return 1;
+			}
+
+			selected[(int)decoder] = true;
+			have_selection = true;
+		}
+	}
+
+	printf("%-8s %-10s %11s %8s %8s %9s %9s %9s %9s\n", "decoder", "input", "bytes", "updates", "ns/byte",
+	       "mean", "p99.9", "p99.99", "worst");
+
+	for (int d = 0; d < (int)FuzzDecoder::Count; d++) {
+		const FuzzDecoder decoder = (FuzzDecoder)d;
+
+		if (have_selection && !selected[d]) {
+			continue;
+		}
+
+		if (options.dictionary_prefix && !writeDictionary(options.dictionary_prefix, decoder)) {
+			fprintf(stderr, "failed to write the %s dictionary\n", fuzzDecoderName(decoder));
+			return 1;
+		}
+
+		for (int k = 0; k < (int)StressInput::Count; k++) {
+			const StressInput input = (StressInput)k;
+			StressInputGenerator generator(decoder, input, options);
+
+			if (!generator.valid()) {
+				continue;
+			}
+
+			StressResult result = stressDecoder(decoder, generator, options);
+			printResult(decoder, input, result);
+		}
+	}
+
+	return 0;
+}
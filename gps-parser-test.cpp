@@ -1,6 +1,27 @@
+#include "captures.h"
+#include "crc.h"
+#include "drivers.h"
+#include "gps_epoch.h"
+#include "gps_heading.h"
+#include "gps_manager.h"
+#include "gps_memory_pool.h"
+#include "gps_rate_plan.h"
+#include "protocol_demux.h"
+#include "rtcm.h"
+#include "text_scan.h"
 #include "unicore.h"
+
+// the UBX payload definitions use anonymous structs
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#include "ubx.h"
+#pragma GCC diagnostic pop
+
 #include <cassert>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <thread>
 
 void test_empty()
 {
@@ -84,6 +105,8 @@ void test_uniheadinga()
 		if (result == UnicoreParser::Result::GotHeading) {
 			assert(unicore_parser.heading().heading_deg == 67.0255f);
 			assert(unicore_parser.heading().baseline_m == 0.3718f);
+			assert(unicore_parser.heading().time_of_week_ms == 168052600);
+			assert(unicore_parser.heading().leap_seconds == 18);
 			return;
 		}
 	}
@@ -136,6 +159,38 @@ void test_agrica()
 	assert(false);
 }
 
+void test_agrica_payload()
+{
+	const char str[] =
+		"#AGRICA,68,GPS,FINE,2063,454587000,0,0,18,38;GNSS,236,19,7,26,6,16,9,4,4,12,10,"
+		"9,306.7191,10724.0176,-"
+		"16.4796,0.0089,0.0070,0.0181,67.9651,29.3584,0.0000,0.003,0.003,0.001,-"
+		"0.002,0.021,0.039,0.025,40.07896719907,116.23652055432,67.3108,-"
+		"2160482.7849,4383625.2350,4084735.7632,0.0140,0.0125,0.0296,0.0107,0.0198,0.012"
+		"8,40.07627310896,116.11079363322,65.3740,0.00000000000,0.00000000000,0.0000,4"
+		"54587000,38.000,16.723207,-9.406086,0.000000,0.000000,8,0,0,0*e9402e02";
+
+	UnicoreParser unicore_parser;
+	assert(unicore_parser.idle());
+	assert(unicore_parser.parsePayload(str, 10) == 0);
+	assert(unicore_parser.parseChar(str[0]) == UnicoreParser::Result::None);
+	assert(!unicore_parser.idle());
+
+	// the payload at once, the rest by byte
+	const size_t payload = (size_t)(strchr(str, '*') - str) - 1;
+	assert(unicore_parser.parsePayload(str + 1, payload) == payload);
+
+	for (unsigned i = (unsigned)payload + 1; i < sizeof(str); ++i) {
+		if (unicore_parser.parseChar(str[i]) == UnicoreParser::Result::GotAgrica) {
+			assert(unicore_parser.agricaValid());
+			assert(unicore_parser.idle());
+			return;
+		}
+	}
+
+	assert(false);
+}
+
 void test_unicore()
 {
 	test_empty();
@@ -145,11 +200,1316 @@ void test_unicore()
 	test_uniheadinga();
 	test_uniheadinga_twice();
 	test_agrica();
+	test_agrica_payload();
+}
+
+void test_text_scan()
+{
+	const char sentence[] = "$GNGGA,172814.0,3723.46587704,N,12202.26957864,W,2,6,1.2,18.893,M,-25.669,M,2.0,0031*51\r\n";
+	const uint8_t *buf = (const uint8_t *)sentence;
+
+	// against a byte by byte scan, from every offset and for every length
+	for (size_t offset = 0; offset < sizeof(sentence); ++offset) {
+		for (size_t len = 0; offset + len < sizeof(sentence); ++len) {
+			size_t run = 0;
+
+			while (run < len && buf[offset + run] != '$' && buf[offset + run] != '*' && buf[offset + run] != ',') {
+				++run;
+			}
+
+			assert(textRunLength(buf + offset, len, '$', '*', ',', ',') == run);
+
+			uint8_t checksum = 0;
+
+			for (size_t i = 0; i < len; ++i) {
+				checksum ^= buf[offset + i];
+			}
+
+			assert(textChecksum(buf + offset, len) == checksum);
+		}
+	}
+
+	// all byte values, the delimiter in every position of a word
+	uint8_t bytes[256];
+
+	for (unsigned i = 0; i < sizeof(bytes); ++i) {
+		bytes[i] = (uint8_t)(255 - i);
+	}
+
+	for (unsigned d = 0; d < 256; ++d) {
+		assert(textRunLength(bytes, sizeof(bytes), (uint8_t)d, (uint8_t)d, (uint8_t)d, (uint8_t)d) == 255 - d);
+	}
+
+	assert(textRunLength(bytes, sizeof(bytes), 0x01, 0x80, 0x7f, 0xfe) == 1);
+	assert(textChecksum(buf + 1, (size_t)(strchr(sentence, '*') - sentence) - 1) == 0x51);
+}
+
+static uint32_t crc32_bitwise(uint32_t length, const uint8_t *buffer, uint32_t crc)
+{
+	while (length-- != 0) {
+		crc ^= *buffer++;
+
+		for (int i = 0; i < 8; i++) {
+			crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+		}
+	}
+
+	return crc;
+}
+
+void test_crc32_check_value()
+{
+	uint8_t str[] = "123456789";
+	assert(calculateCRC32(9, str, 0) == 0x2dfd2d88);
+	assert(calculateCRC32(0, str, 0x12345678) == 0x12345678);
+}
+
+void test_crc32_chained()
+{
+	uint8_t data[64];
+
+	for (unsigned i = 0; i < sizeof(data); ++i) {
+		data[i] = (uint8_t)(i * 37 + 11);
+	}
+
+	const uint32_t whole = calculateCRC32(sizeof(data), data, 0);
+
+	for (uint32_t split = 0; split <= sizeof(data); ++split) {
+		const uint32_t crc = calculateCRC32(split, data, 0);
+		assert(calculateCRC32(sizeof(data) - split, data + split, crc) == whole);
+	}
+}
+
+void test_crc32_unaligned()
+{
+	uint8_t data[80];
+
+	for (unsigned i = 0; i < sizeof(data); ++i) {
+		data[i] = (uint8_t)(i * 101 + 7);
+	}
+
+	for (uint32_t offset = 0; offset < 8; ++offset) {
+		for (uint32_t length = 0; length + offset <= sizeof(data); ++length) {
+			assert(calculateCRC32(length, data + offset, 0xa5a5a5a5) == crc32_bitwise(length, data + offset, 0xa5a5a5a5));
+		}
+	}
+}
+
+void test_crc16_crc24q_check_value()
+{
+	const uint8_t str[] = "123456789";
+	assert(calculateCRC16CCITT(9, str, 0) == 0x31c3);
+	assert(calculateCRC24Q(9, str, 0) == 0xcde703);
+}
+
+void test_crc_known_answers()
+{
+	// computed bit by bit: lengths around the 8 byte blocks of slice-by-8, with all tails
+	static const struct {
+		uint32_t length;
+		uint32_t crc32;
+		uint16_t crc16;
+		uint32_t crc24q;
+	} vectors[] = {
+		{  1, 0x97d2d988, 0xb16b, 0xad18cf},
+		{  7, 0x7203e44f, 0x9a87, 0x044d67},
+		{  8, 0x01a972e2, 0x443d, 0x663334},
+		{  9, 0xf1d54b30, 0x3370, 0xfa7341},
+		{ 15, 0x84b35d04, 0x4e76, 0xf334af},
+		{ 16, 0xc853e2dd, 0x899f, 0x0be16c},
+		{ 17, 0x041375f7, 0x743f, 0x3d815b},
+		{ 63, 0x524cd33d, 0x9f5e, 0x1eb457},
+		{ 64, 0x8a37853f, 0x68f2, 0xdc4959},
+		{255, 0x92a3cff1, 0x15f0, 0x69a904},
+		{256, 0x83412608, 0x2f7c, 0xa4bd8a},
+	};
+	uint8_t data[256];
+
+	for (unsigned i = 0; i < sizeof(data); ++i) {
+		data[i] = (uint8_t)(i * 37 + 11);
+	}
+
+	for (const auto &vector : vectors) {
+		assert(calculateCRC32(vector.length, data, 0) == vector.crc32);
+		assert(calculateCRC16CCITT(vector.length, data, 0) == vector.crc16);
+		assert(calculateCRC24Q(vector.length, data, 0) == vector.crc24q);
+	}
+
+	// not 8 byte aligned
+	assert(calculateCRC32(61, data + 3, 0) == 0x42a592a5);
+	assert(calculateCRC16CCITT(61, data + 3, 0) == 0xb505);
+	assert(calculateCRC24Q(61, data + 3, 0) == 0xba94f4);
+
+	// an RTCM 1005 frame of a reference station, followed by its CRC-24Q 36 0b 98
+	const uint8_t rtcm_1005[] = {0xd3, 0x00, 0x13, 0x3e, 0xd7, 0xd3, 0x02, 0x02, 0x98, 0x0e, 0xde, 0xef, 0x34, 0xb4, 0xbd,
+				     0x62, 0xac, 0x09, 0x41, 0x98, 0x6f, 0x33
+				    };
+	assert(calculateCRC24Q(sizeof(rtcm_1005), rtcm_1005, 0) == 0x360b98);
+
+	// a UM982 sentence, the CRC-32 after the '*' is over the text between '#' and '*'
+	char unicore[] = "UNIHEADINGA,89,GPS,FINE,2251,168052600,0,0,18,11;SOL_COMPUTED,NARROW_INT,0.3718,67.0255,-0.7974,"
+			 "0.0000,0.8065,3.3818,\"999\",31,21,21,18,3,01,3,f3";
+	assert(calculateCRC32((uint32_t)strlen(unicore), (uint8_t *)unicore, 0) == 0xece5bb07);
+}
+
+void test_crc32()
+{
+	test_crc32_check_value();
+	test_crc32_chained();
+	test_crc32_unaligned();
+	test_crc16_crc24q_check_value();
+	test_crc_known_answers();
+}
+
+static bool rtcm_feed(RTCMParsing &rtcm_parsing, uint16_t payload_length, uint16_t message_id)
+{
+	bool complete = false;
+	const unsigned frame_length = payload_length + 6u;
+
+	for (unsigned i = 0; i < frame_length; ++i) {
+		uint8_t b = 0;
+
+		switch (i) {
+		case 0: b = RTCM3_PREAMBLE; break;
+
+		case 1: b = (uint8_t)(payload_length >> 8); break;
+
+		case 2: b = (uint8_t)(payload_length & 0xff); break;
+
+		case 3: b = (uint8_t)(message_id >> 4); break;
+
+		case 4: b = (uint8_t)((message_id & 0xf) << 4); break;
+
+		default: b = (uint8_t)i; break;
+		}
+
+		assert(!complete);
+		complete = rtcm_parsing.addByte(b);
+	}
+
+	return complete;
+}
+
+void test_rtcm_1005()
+{
+	RTCMParsing rtcm_parsing;
+	assert(rtcm_feed(rtcm_parsing, 19, 1005));
+	assert(rtcm_parsing.messageLength() == 25);
+	assert(rtcm_parsing.messageId() == 1005);
+	assert(rtcm_parsing.message()[0] == RTCM3_PREAMBLE);
+}
+
+void test_rtcm_max_length()
+{
+	RTCMParsing rtcm_parsing;
+	assert(rtcm_feed(rtcm_parsing, RTCM3_MAX_PAYLOAD_LENGTH, 1077));
+	assert(rtcm_parsing.messageLength() == RTCM_BUFFER_LENGTH);
+	assert(rtcm_parsing.messageId() == 1077);
+
+	// a following message after a reset must parse just the same
+	rtcm_parsing.reset();
+	assert(rtcm_feed(rtcm_parsing, 19, 1005));
+	assert(rtcm_parsing.messageLength() == 25);
+	assert(rtcm_parsing.messageId() == 1005);
+}
+
+void test_rtcm_overflow()
+{
+	RTCMParsing rtcm_parsing;
+	assert(rtcm_feed(rtcm_parsing, 19, 1005));
+
+	// without a reset, bytes past the largest possible frame are refused
+	for (unsigned i = 0; i < 2 * RTCM_BUFFER_LENGTH; ++i) {
+		assert(!rtcm_parsing.addByte(0xff));
+	}
+
+	assert(rtcm_parsing.messageLength() == RTCM_BUFFER_LENGTH);
+}
+
+static int rtcm_frame(uint8_t *frame, uint16_t payload_length, uint16_t message_id, uint32_t epoch = 0)
+{
+	const int frame_length = payload_length + 6;
+	memset(frame, 0, (size_t)frame_length);
+	frame[0] = RTCM3_PREAMBLE;
+	frame[1] = (uint8_t)(payload_length >> 8);
+	frame[2] = (uint8_t)(payload_length & 0xff);
+	frame[3] = (uint8_t)(message_id >> 4);
+	frame[4] = (uint8_t)((message_id & 0xf) << 4);
+	frame[6] = (uint8_t)(epoch >> 22);
+	frame[7] = (uint8_t)(epoch >> 14);
+	frame[8] = (uint8_t)(epoch >> 6);
+	frame[9] = (uint8_t)(epoch << 2);
+	return frame_length;
+}
+
+void test_rtcm_scheduler_filter()
+{
+	RTCMScheduler scheduler;
+	uint8_t frame[RTCM_BUFFER_LENGTH];
+	int length = rtcm_frame(frame, 19, 1005);
+
+	assert(!scheduler.push(frame, length - 1, 0));
+	scheduler.setMessageEnabled(1005, false);
+	assert(!scheduler.push(frame, length, 0));
+	scheduler.setMessageEnabled(1005, true);
+	assert(scheduler.push(frame, length, 0));
+	assert(scheduler.queued() == length);
+
+	// 1230 every 5 s, with the phase kept while the messages arrive at 1 Hz
+	assert(scheduler.setMessagePeriod(1230, 5000) == 0);
+	length = rtcm_frame(frame, 10, 1230);
+	int forwarded = 0;
+
+	for (uint64_t t = 0; t < 30; t++) {
+		forwarded += scheduler.push(frame, length, t * 1000000 + (t % 2) * 1000) ? 1 : 0;
+	}
+
+	assert(forwarded == 6);
+	assert(scheduler.queued() == 25 + length); // each replaced the queued one
+	assert(scheduler.dropped() == 5);
+
+	for (uint16_t id = 1; id <= RTCM_SCHEDULER_MAX_PERIODS; id++) {
+		assert(scheduler.setMessagePeriod(id, 1000) == (id < RTCM_SCHEDULER_MAX_PERIODS ? 0 : -1));
+	}
+}
+
+void test_rtcm_scheduler_msm()
+{
+	RTCMScheduler scheduler;
+	uint8_t frame[RTCM_BUFFER_LENGTH];
+	uint8_t burst[RTCM_SCHEDULER_BUFFER_SIZE];
+
+	// a multiple message epoch is kept, a newer epoch replaces it
+	const int length = rtcm_frame(frame, 100, 1077, 1000);
+	assert(scheduler.push(frame, length, 0));
+	assert(scheduler.push(frame, length, 0));
+	rtcm_frame(frame, 100, 1087, 1000);
+	assert(scheduler.push(frame, length, 0));
+	assert(scheduler.queued() == 3 * length);
+
+	// the first frame is partially sent, it is completed
+	assert(scheduler.pop(burst, 10, 0) == 10);
+	rtcm_frame(frame, 100, 1077, 2000);
+	assert(scheduler.push(frame, length, 0));
+	assert(scheduler.dropped() == 1);
+	assert(scheduler.queued() == 3 * length - 10);
+
+	int sent = 0;
+	int popped;
+
+	while ((popped = scheduler.pop(burst + sent, 64, 0)) > 0) {
+		assert(popped <= 64);
+		sent += popped;
+	}
+
+	assert(sent == 3 * length - 10);
+	assert(burst[length - 10] == RTCM3_PREAMBLE && (burst[length - 10 + 4] >> 4) == (1087 & 0xf));
+	assert(burst[2 * length - 10] == RTCM3_PREAMBLE && burst[2 * length - 10 + 9] == (uint8_t)(2000 << 2));
+	assert(scheduler.queued() == 0);
+}
+
+void test_rtcm_scheduler_bandwidth()
+{
+	RTCMScheduler scheduler;
+	uint8_t frame[RTCM_BUFFER_LENGTH];
+	uint8_t burst[RTCM_SCHEDULER_BUFFER_SIZE];
+	scheduler.setBandwidth(1000);
+
+	// 1500 bytes per second, the oldest are dropped for the newest
+	for (uint64_t t = 0; t < 10 * 1000000; t += 100000) {
+		const int length = rtcm_frame(frame, 144, 1005);
+		assert(scheduler.push(frame, length, t));
+
+		while (scheduler.pop(burst, 200, t) > 0) {}
+
+		assert(scheduler.queued() <= RTCM_SCHEDULER_BUFFER_SIZE);
+	}
+
+	assert(scheduler.dropped() > 0);
+
+	// at most a second of unused bandwidth is saved
+	RTCMScheduler idle;
+	idle.setBandwidth(1000);
+	assert(idle.pop(burst, 200, 0) == 0);
+
+	for (int i = 0; i < 10; i++) {
+		idle.push(frame, rtcm_frame(frame, 144, 1005), 0);
+	}
+
+	int sent = 0;
+
+	for (int popped; (popped = idle.pop(burst, 200, 5000000)) > 0;) {
+		sent += popped;
+	}
+
+	assert(sent == 1000);
+	assert(idle.pop(burst, 200, 5500000) == 200);
+	assert(idle.pop(burst, 200, 5500000) == 200);
+	assert(idle.pop(burst, 200, 5500000) == 100);
+	assert(idle.pop(burst, 200, 5500000) == 0);
+}
+
+void test_rtcm()
+{
+	test_rtcm_1005();
+	test_rtcm_max_length();
+	test_rtcm_overflow();
+	test_rtcm_scheduler_filter();
+	test_rtcm_scheduler_msm();
+	test_rtcm_scheduler_bandwidth();
+}
+
+struct demux_stream_t {
+	uint8_t data[2048];
+	size_t length;
+	size_t frame_start[16];
+	size_t frame_length[16];
+	ProtocolDemux::Protocol frame_protocol[16];
+	int frames;
+};
+
+static void demux_begin_frame(demux_stream_t &stream, ProtocolDemux::Protocol protocol)
+{
+	stream.frame_start[stream.frames] = stream.length;
+	stream.frame_protocol[stream.frames] = protocol;
+}
+
+static void demux_end_frame(demux_stream_t &stream)
+{
+	stream.frame_length[stream.frames] = stream.length - stream.frame_start[stream.frames];
+	stream.frames++;
+}
+
+static void demux_add(demux_stream_t &stream, const void *data, size_t length)
+{
+	memcpy(stream.data + stream.length, data, length);
+	stream.length += length;
+}
+
+static void demux_add_byte(demux_stream_t &stream, uint8_t b)
+{
+	stream.data[stream.length++] = b;
+}
+
+static void demux_add_ubx(demux_stream_t &stream, uint16_t payload_length)
+{
+	demux_begin_frame(stream, ProtocolDemux::Protocol::UBX);
+	const uint8_t header[] = {0xb5, 0x62, 0x01, 0x07, (uint8_t)(payload_length & 0xff), (uint8_t)(payload_length >> 8)};
+	demux_add(stream, header, sizeof(header));
+
+	for (uint16_t i = 0; i < payload_length; ++i) {
+		demux_add_byte(stream, (uint8_t)(i * 7));
+	}
+
+	uint8_t ck_a = 0;
+	uint8_t ck_b = 0;
+
+	for (size_t i = stream.frame_start[stream.frames] + 2; i < stream.length; ++i) {
+		ck_a = (uint8_t)(ck_a + stream.data[i]);
+		ck_b = (uint8_t)(ck_b + ck_a);
+	}
+
+	demux_add_byte(stream, ck_a);
+	demux_add_byte(stream, ck_b);
+	demux_end_frame(stream);
+}
+
+static void demux_add_nmea(demux_stream_t &stream, const char *sentence)
+{
+	demux_begin_frame(stream, ProtocolDemux::Protocol::NMEA);
+	uint8_t checksum = 0;
+
+	for (const char *c = sentence + 1; *c; ++c) {
+		checksum ^= (uint8_t) * c;
+	}
+
+	char checksum_str[4];
+	snprintf(checksum_str, sizeof(checksum_str), "*%02X", checksum);
+	demux_add(stream, sentence, strlen(sentence));
+	demux_add(stream, checksum_str, 3);
+	demux_end_frame(stream);
+	demux_add(stream, "\r\n", 2);
+}
+
+static void demux_add_rtcm(demux_stream_t &stream, uint16_t payload_length)
+{
+	demux_begin_frame(stream, ProtocolDemux::Protocol::RTCM3);
+	const uint8_t header[] = {RTCM3_PREAMBLE, (uint8_t)(payload_length >> 8), (uint8_t)(payload_length & 0xff), 0x3e, 0xd0};
+	demux_add(stream, header, sizeof(header));
+
+	for (uint16_t i = 2; i < payload_length; ++i) {
+		demux_add_byte(stream, (uint8_t)(i * 13));
+	}
+
+	const uint32_t crc = calculateCRC24Q(payload_length + 3u, stream.data + stream.frame_start[stream.frames], 0);
+	demux_add_byte(stream, (uint8_t)(crc >> 16));
+	demux_add_byte(stream, (uint8_t)(crc >> 8));
+	demux_add_byte(stream, (uint8_t)crc);
+	demux_end_frame(stream);
+}
+
+static void demux_add_sbf(demux_stream_t &stream, uint16_t block_length)
+{
+	demux_begin_frame(stream, ProtocolDemux::Protocol::SBF);
+	const size_t start = stream.length;
+	const uint8_t header[] = {'$', '@', 0, 0, 0xa7, 0x0f, (uint8_t)(block_length & 0xff), (uint8_t)(block_length >> 8)};
+	demux_add(stream, header, sizeof(header));
+
+	for (uint16_t i = 8; i < block_length; ++i) {
+		demux_add_byte(stream, (uint8_t)(i * 3));
+	}
+
+	const uint16_t crc = calculateCRC16CCITT(block_length - 4u, stream.data + start + 4, 0);
+	stream.data[start + 2] = (uint8_t)(crc & 0xff);
+	stream.data[start + 3] = (uint8_t)(crc >> 8);
+	demux_end_frame(stream);
+}
+
+static void demux_add_femtomes(demux_stream_t &stream, uint16_t message_length)
+{
+	demux_begin_frame(stream, ProtocolDemux::Protocol::Femtomes);
+	const size_t start = stream.length;
+	uint8_t header[28] {0xaa, 0x44, 0x12, 28, 0x41, 0x1f};
+	header[8] = (uint8_t)(message_length & 0xff);
+	header[9] = (uint8_t)(message_length >> 8);
+	demux_add(stream, header, sizeof(header));
+
+	for (uint16_t i = 0; i < message_length; ++i) {
+		demux_add_byte(stream, (uint8_t)(i * 5));
+	}
+
+	const uint32_t crc = calculateCRC32((uint32_t)(stream.length - start), stream.data + start, 0);
+	demux_add(stream, &crc, sizeof(crc));
+	demux_end_frame(stream);
+}
+
+static void demux_add_garbage(demux_stream_t &stream, size_t length)
+{
+	// includes start bytes that must not confuse the demux
+	const uint8_t garbage[] = {0x00, 0xb5, 0x11, 0xd3, 0xff, '$', 0x01, 0xaa, 0x44, 0x7f};
+
+	for (size_t i = 0; i < length; ++i) {
+		demux_add_byte(stream, garbage[i % sizeof(garbage)]);
+	}
+}
+
+static void demux_build_stream(demux_stream_t &stream)
+{
+	memset(&stream, 0, sizeof(stream));
+	demux_add_garbage(stream, 17);
+	demux_add_ubx(stream, 92);
+	demux_add_nmea(stream, "$GNGGA,172814.0,3723.46587704,N,12202.26957864,W,2,6,1.2,18.893,M,-25.669,M,2.0,0031");
+	demux_add_rtcm(stream, 19);
+	demux_add_garbage(stream, 3);
+	demux_add_sbf(stream, 96);
+	demux_add_femtomes(stream, 120);
+	demux_add_ubx(stream, 0);
+	demux_add_rtcm(stream, 1023);
+	demux_add_garbage(stream, 25);
+}
+
+struct demux_result_t {
+	const demux_stream_t *stream;
+	int frames;
+};
+
+static void demux_check_frame(ProtocolDemux::Protocol protocol, const uint8_t *frame, size_t length, void *user)
+{
+	demux_result_t *result = (demux_result_t *)user;
+	const demux_stream_t *stream = result->stream;
+	assert(result->frames < stream->frames);
+	assert(protocol == stream->frame_protocol[result->frames]);
+	assert(length == stream->frame_length[result->frames]);
+	assert(memcmp(frame, stream->data + stream->frame_start[result->frames], length) == 0);
+	result->frames++;
+}
+
+void test_demux_chunked()
+{
+	static demux_stream_t stream;
+	demux_build_stream(stream);
+	assert(stream.frames == 7);
+
+	const size_t chunk_sizes[] = {1, 2, 3, 7, 64, 150, sizeof(stream.data)};
+
+	for (size_t chunk_size : chunk_sizes) {
+		demux_result_t result{&stream, 0};
+		ProtocolDemux demux(demux_check_frame, &result);
+		int frames = 0;
+
+		for (size_t i = 0; i < stream.length; i += chunk_size) {
+			frames += demux.addBytes(stream.data + i, (chunk_size < stream.length - i) ? chunk_size : stream.length - i);
+		}
+
+		assert(frames == stream.frames);
+		assert(result.frames == stream.frames);
+		assert(demux.frameCount(ProtocolDemux::Protocol::UBX) == 2);
+		assert(demux.frameCount(ProtocolDemux::Protocol::RTCM3) == 2);
+		assert(demux.detectedProtocols() == ProtocolDemux::ALL_PROTOCOLS);
+		assert(demux.bytesDiscarded() == 17 + 2 + 3 + 25);
+	}
+}
+
+void test_demux_corrupted()
+{
+	static demux_stream_t stream;
+	demux_build_stream(stream);
+
+	// flip a bit in the SBF block, the other frames must still come through
+	stream.data[stream.frame_start[3] + 20] ^= 1;
+	demux_result_t result{nullptr, 0};
+	ProtocolDemux demux([](ProtocolDemux::Protocol, const uint8_t *, size_t, void *user) { ((demux_result_t *)user)->frames++; }, &result);
+	demux.addBytes(stream.data, stream.length);
+	assert(result.frames == stream.frames - 1);
+	assert(demux.frameCount(ProtocolDemux::Protocol::SBF) == 0);
+	assert(demux.frameCount(ProtocolDemux::Protocol::Femtomes) == 1);
+}
+
+void test_demux_protocol_mask()
+{
+	static demux_stream_t stream;
+	demux_build_stream(stream);
+	demux_result_t result{nullptr, 0};
+	ProtocolDemux demux([](ProtocolDemux::Protocol protocol, const uint8_t *, size_t, void *user) {
+		assert(protocol == ProtocolDemux::Protocol::RTCM3);
+		((demux_result_t *)user)->frames++;
+	}, &result, ProtocolDemux::protocolMask(ProtocolDemux::Protocol::RTCM3));
+	demux.addBytes(stream.data, stream.length);
+	assert(result.frames == 2);
+}
+
+void test_demux()
+{
+	test_demux_chunked();
+	test_demux_corrupted();
+	test_demux_protocol_mask();
+}
+
+void test_epoch_assembler()
+{
+	GPSEpochAssembler epoch(GPSEpochAssembler::Position | GPSEpochAssembler::Velocity);
+
+	// without markers, complete with the required parts
+	assert(!epoch.add(1000, GPSEpochAssembler::Position));
+	assert(epoch.pending());
+	assert(epoch.add(1000, GPSEpochAssembler::Velocity));
+	assert(epoch.complete() && !epoch.pending());
+	epoch.reset();
+	assert(!epoch.add(1000, GPSEpochAssembler::DOP));	// after the update of its epoch
+	assert(!epoch.pending());
+
+	// a new epoch abandons an incomplete one instead of pairing their parts
+	assert(!epoch.add(1100, GPSEpochAssembler::Velocity));
+	assert(!epoch.add(1200, GPSEpochAssembler::Position));
+	assert(epoch.abandoned() == 1);
+	assert(epoch.add(1200, GPSEpochAssembler::Velocity));
+	epoch.reset();
+
+	// the first marker comes after the update, then the marker completes an epoch
+	assert(!epoch.end(1200));
+	assert(epoch.endMarkers());
+	assert(!epoch.add(1300, GPSEpochAssembler::Position | GPSEpochAssembler::Velocity));
+	assert(!epoch.add(1300, GPSEpochAssembler::DOP));
+	assert(epoch.end(1300));
+	epoch.reset();
+
+	// a marker of an epoch without the required parts
+	assert(!epoch.add(1400, GPSEpochAssembler::DOP));
+	assert(!epoch.end(1400));
+	assert(epoch.abandoned() == 2 && !epoch.pending());
+
+	// a missed marker: without markers until the next one
+	assert(!epoch.add(1500, GPSEpochAssembler::Position | GPSEpochAssembler::Velocity));
+	assert(epoch.add(1600, GPSEpochAssembler::Position | GPSEpochAssembler::Velocity));
+	assert(!epoch.endMarkers() && epoch.abandoned() == 3);
+	epoch.reset();
+	assert(!epoch.end(1600));
+	assert(!epoch.add(1700, GPSEpochAssembler::Position | GPSEpochAssembler::Velocity));
+	assert(epoch.end(1700));
+
+	// several epochs parsed before the update is returned: it has the latest data
+	assert(epoch.add(1800, GPSEpochAssembler::Position));
+	assert(epoch.complete() && epoch.abandoned() == 3);
+
+	// the epoch that started before the update was returned keeps its parts, and its marker completes it
+	epoch.reset();
+	assert(epoch.pending() && epoch.completedEpoch() == 1700);
+	assert(!epoch.add(1800, GPSEpochAssembler::Velocity));
+	assert(epoch.end(1800));
+	assert(epoch.completedEpoch() == 1800 && epoch.abandoned() == 3);
+	epoch.reset();
+	assert(!epoch.pending());
+}
+
+/**
+ * @return offset after the UBX frame of the message at or after pos, 0 if none
+ */
+static size_t ubx_frame_end(const Capture &capture, size_t pos, uint8_t msg_class, uint8_t msg_id)
+{
+	const std::vector<uint8_t> &data = capture.data;
+
+	for (; pos + 8 <= data.size(); pos++) {
+		if (data[pos] == 0xb5 && data[pos + 1] == 0x62 && data[pos + 2] == msg_class && data[pos + 3] == msg_id) {
+			return pos + 8 + (size_t)(data[pos + 4] | data[pos + 5] << 8);
+		}
+	}
+
+	return 0;
+}
+
+void test_ubx_epoch_in_one_read()
+{
+	// epoch 0 with NAV-SAT and RTCM, then epochs 1 and 2. The marker of epoch 0 completes epoch 1.
+	const Capture capture = generateUBXCapture(1);
+	const size_t eoe1_end = ubx_frame_end(capture, ubx_frame_end(capture, 0, 0x01, 0x61), 0x01, 0x61);
+	const size_t pvt2_end = ubx_frame_end(capture, eoe1_end, 0x01, 0x07);
+	const size_t eoe2_end = ubx_frame_end(capture, pvt2_end, 0x01, 0x61);
+	assert(eoe1_end > 0 && pvt2_end > eoe1_end && eoe2_end > pvt2_end);
+
+	sensor_gps_s gps{};
+	satellite_info_s satellite_info{};
+	MockDevice device(capture.data.data(), capture.data.size(), capture.data.size(), MockDevice::Responder::UBX);
+	GPSHelper *driver = createDriver(HostProtocol::UBX, device, &gps, &satellite_info);
+	assert(configureDriver(HostProtocol::UBX, *driver, GPSHelper::OutputMode::GPSAndRTCM) == 0);
+
+	// the end of epoch 1 and the NAV-PVT of epoch 2 in one read: epoch 1 is returned, then the rest of epoch 2
+	const uint8_t *data = capture.data.data();
+	driver->feed(data, eoe1_end - 12);
+	assert(driver->feed(data + eoe1_end - 12, pvt2_end - (eoe1_end - 12)) & 1);
+	assert(gps.time_utc_usec % 1000000 == 100000 && gps.lat == 473977000 + 1 * 5);
+	assert(driver->feed(data + pvt2_end, eoe2_end - pvt2_end) & 1);
+	assert(gps.time_utc_usec % 1000000 == 200000 && gps.lat == 473977000 + 2 * 5);
+
+	delete driver;
+}
+
+struct parse_report_t {
+	uint64_t time_utc_usec;
+	int32_t lat;
+	int32_t lon;
+	uint8_t fix_type;
+
+	bool operator==(const parse_report_t &other) const
+	{
+		return time_utc_usec == other.time_utc_usec && lat == other.lat && lon == other.lon && fix_type == other.fix_type;
+	}
+};
+
+/**
+ * Feed a capture to a new driver in chunks of a fixed size
+ * @return the position updates returned
+ */
+static std::vector<parse_report_t> parse_capture(HostProtocol protocol, const Capture &capture, size_t chunk_size)
+{
+	sensor_gps_s gps{};
+	satellite_info_s satellite_info{};
+	MockDevice device(capture.data.data(), capture.data.size(), capture.data.size(), protocolResponder(protocol));
+	GPSHelper *driver = createDriver(protocol, device, &gps, &satellite_info);
+	assert(configureDriver(protocol, *driver) == 0);
+
+	std::vector<parse_report_t> reports;
+
+	for (size_t pos = 0; pos < capture.data.size(); pos += chunk_size) {
+		const size_t length = capture.data.size() - pos < chunk_size ? capture.data.size() - pos : chunk_size;
+
+		if (driver->feed(capture.data.data() + pos, length) & 1) {
+			reports.push_back({gps.time_utc_usec, gps.lat, gps.lon, gps.fix_type});
+		}
+	}
+
+	delete driver;
+	return reports;
+}
+
+/**
+ * The bulk parse paths (sync search, payload runs, sentence runs) return the same updates as a
+ * byte by byte feed, wherever the reads split the frames
+ * @param max_chunk largest read, shorter than two epochs: a read with two of them returns one update
+ */
+static std::vector<parse_report_t> check_parse_paths(HostProtocol protocol, const Capture &capture, size_t max_chunk)
+{
+	const std::vector<parse_report_t> reference = parse_capture(protocol, capture, 1);
+
+	for (size_t chunk_size = 2; chunk_size <= max_chunk; chunk_size++) {
+		assert(parse_capture(protocol, capture, chunk_size) == reference);
+	}
+
+	return reference;
+}
+
+void test_parse_paths()
+{
+	// 20 epochs, the first of each second with the satellite info (and RTCM for UBX)
+	const Capture ubx = generateUBXCapture(2);
+	const size_t ubx_eoe1_end = ubx_frame_end(ubx, ubx_frame_end(ubx, 0, 0x01, 0x61), 0x01, 0x61);
+	const size_t ubx_epoch = ubx_frame_end(ubx, ubx_eoe1_end, 0x01, 0x61) - ubx_eoe1_end;
+	const std::vector<parse_report_t> ubx_reports = check_parse_paths(HostProtocol::UBX, ubx, ubx_epoch);
+	assert(ubx_reports.size() == 20);
+
+	for (int32_t epoch = 0; epoch < 20; epoch++) {
+		const parse_report_t &report = ubx_reports[(size_t)epoch];
+		assert(report.time_utc_usec == 1710417600000000ULL + (uint64_t)epoch * 100000ULL);
+		assert(report.lat == 473977000 + epoch * 5 && report.lon == 85455000 + epoch * 10 && report.fix_type == 6);
+	}
+
+	const std::vector<parse_report_t> sbf_reports = check_parse_paths(HostProtocol::SBF, generateSBFCapture(2), GPS_READ_BUFFER_SIZE);
+	assert(sbf_reports.size() == 20);
+
+	for (size_t epoch = 0; epoch < 20; epoch++) {
+		const parse_report_t &report = sbf_reports[epoch];
+		assert(report.time_utc_usec == 1707307200000000ULL + epoch * 100000ULL);
+		assert(report.lat == (int32_t)round((0.8272454 + (double)epoch * 1e-9) * 180.0 / M_PI * 1e7));
+		assert(report.lon == (int32_t)round((0.1491485 + (double)epoch * 2e-9) * 180.0 / M_PI * 1e7));
+		assert(report.fix_type == 6);
+	}
+
+	const std::vector<parse_report_t> nmea_reports = check_parse_paths(HostProtocol::NMEA, generateNMEACapture(2), GPS_READ_BUFFER_SIZE);
+	assert(nmea_reports.size() == 20);
+}
+
+/**
+ * Configure a UBX driver on a device that keeps the configuration in the BBR layer
+ * @return number of CFG-VALSET keys the device received
+ */
+static uint32_t ubx_configure_bbr(MockDevice &device, uint32_t &fingerprint)
+{
+	sensor_gps_s gps{};
+	satellite_info_s satellite_info{};
+	GPSDriverUBX *driver = static_cast<GPSDriverUBX *>(createDriver(HostProtocol::UBX, device, &gps, &satellite_info));
+	driver->setConfigLayers(UBX_CFG_LAYER_BBR);
+	driver->setConfigFingerprint(fingerprint);
+	const uint32_t keys_set = device.cfgKeysSet();
+	assert(configureDriver(HostProtocol::UBX, *driver) == 0);
+	fingerprint = driver->configFingerprint();
+	delete driver;
+	return device.cfgKeysSet() - keys_set;
+}
+
+void test_ubx_config_fingerprint()
+{
+	MockDevice device(nullptr, 0, GPS_READ_BUFFER_SIZE, MockDevice::Responder::UBX);
+	uint32_t fingerprint = 0;
+	const uint32_t all_keys = ubx_configure_bbr(device, fingerprint);
+	const uint32_t first = fingerprint;
+	assert(first != 0);
+
+	// without the fingerprint the keys are read back, none of the batch is sent, only the port setup
+	fingerprint = 0;
+	const uint32_t port_keys = ubx_configure_bbr(device, fingerprint);
+	assert(port_keys < all_keys && fingerprint == first);
+
+	// the receiver kept it: only the measurement rate is written, to RAM
+	assert(ubx_configure_bbr(device, fingerprint) == port_keys + 1 && fingerprint == first);
+
+	// the receiver lost it (e.g. the backup battery ran out): the fingerprint doesn't skip it
+	MockDevice reset_device(nullptr, 0, GPS_READ_BUFFER_SIZE, MockDevice::Responder::UBX);
+	assert(ubx_configure_bbr(reset_device, fingerprint) == all_keys && fingerprint == first);
+}
+
+/**
+ * UBX driver with the configuration batch accessible
+ */
+class UBXBatchDriver : public GPSDriverUBX
+{
+public:
+	UBXBatchDriver(MockDevice &device, sensor_gps_s *gps_position, satellite_info_s *satellite_info) :
+		GPSDriverUBX(Interface::UART, MockDevice::callback, &device, gps_position, satellite_info) {}
+
+	using GPSDriverUBX::cfgBatchBegin;
+	using GPSDriverUBX::cfgBatchMessage;
+	using GPSDriverUBX::cfgBatchValset;
+	using GPSDriverUBX::cfgBatchCommit;
+};
+
+void test_ubx_cfg_batch()
+{
+	// keys of an unused group, U1 and U8 values
+	const uint32_t key_u1 = 0x20990000;
+	const uint32_t key_u8 = 0x50990000;
+	const uint8_t one = 1;
+	const uint8_t two = 2;
+	sensor_gps_s gps{};
+	satellite_info_s satellite_info{};
+
+	// split at UBX_CFG_MAX_KEYS keys, all sent to RAM without reading back
+	MockDevice device(nullptr, 0, GPS_READ_BUFFER_SIZE, MockDevice::Responder::UBX);
+	UBXBatchDriver driver(device, &gps, &satellite_info);
+	driver.cfgBatchBegin();
+
+	for (uint32_t i = 0; i < UBX_CFG_MAX_KEYS + 6; i++) {
+		assert(driver.cfgBatchValset<uint8_t>(key_u1 + i, one));
+	}
+
+	assert(driver.cfgBatchCommit() == 0);
+	assert(device.cfgValgets() == 0 && device.cfgValsets() == 2);
+	assert(device.cfgValsetKeys(0) == UBX_CFG_MAX_KEYS && device.cfgValsetKeys(1) == 6);
+
+	// the batch is full at UBX_CFG_BATCH_SIZE bytes (4 byte header per message), then nothing is sent
+	driver.cfgBatchBegin();
+	uint32_t keys = 0;
+
+	while (driver.cfgBatchValset<uint64_t>(key_u8 + keys, 0)) {
+		keys++;
+	}
+
+	assert(keys == (UBX_CFG_BATCH_SIZE - 4) / (sizeof(uint32_t) + sizeof(uint64_t)));
+	assert(driver.cfgBatchCommit() < 0 && device.cfgValsets() == 2);
+
+	// read back from RAM and BBR: CFG-VALGET layer 0 is RAM (VALSET bit 1), 1 is BBR (bit 2), 2 is flash (bit 4).
+	// A key is only skipped if it has the value in both.
+	MockDevice stored(nullptr, 0, GPS_READ_BUFFER_SIZE, MockDevice::Responder::UBX);
+	stored.setCfgValue(key_u1 + 0, UBX_CFG_LAYER_RAM | UBX_CFG_LAYER_BBR, &one);
+	stored.setCfgValue(key_u1 + 1, UBX_CFG_LAYER_RAM, &one);
+	stored.setCfgValue(key_u1 + 2, UBX_CFG_LAYER_RAM | UBX_CFG_LAYER_FLASH, &one);
+	stored.setCfgValue(key_u1 + 3, UBX_CFG_LAYER_RAM, &one);
+	stored.setCfgValue(key_u1 + 3, UBX_CFG_LAYER_BBR, &two);
+	UBXBatchDriver stored_driver(stored, &gps, &satellite_info);
+	stored_driver.setConfigLayers(UBX_CFG_LAYER_BBR);
+	stored_driver.cfgBatchBegin();
+
+	for (uint32_t i = 0; i < 4; i++) {
+		assert(stored_driver.cfgBatchValset<uint8_t>(key_u1 + i, one));
+	}
+
+	assert(stored_driver.cfgBatchCommit() == 0);
+	assert(stored.cfgValgets() == 2 && stored.cfgValsets() == 1 && stored.cfgValsetKeys(0) == 3);
+
+	// now all are set. A key in several messages is only skipped if every occurrence has the value.
+	stored_driver.cfgBatchBegin();
+	assert(stored_driver.cfgBatchValset<uint8_t>(key_u1 + 0, one));
+	stored_driver.cfgBatchMessage(true);
+	assert(stored_driver.cfgBatchValset<uint8_t>(key_u1 + 1, one));
+	assert(stored_driver.cfgBatchValset<uint8_t>(key_u1 + 0, two));
+	assert(stored_driver.cfgBatchCommit() == 0);
+	assert(stored.cfgValsets() == 3 && stored.cfgValsetKeys(1) == 1 && stored.cfgValsetKeys(2) == 1);
+
+	stored_driver.cfgBatchBegin();
+	assert(stored_driver.cfgBatchValset<uint8_t>(key_u1 + 3, one));
+	stored_driver.cfgBatchMessage(true);
+	assert(stored_driver.cfgBatchValset<uint8_t>(key_u1 + 3, one));
+	assert(stored_driver.cfgBatchCommit() == 0 && stored.cfgValsets() == 3);
+
+	// the n-th ACK belongs to the n-th message: a NAK only fails the commit for a required message
+	device.setCfgNakKey(key_u1 + 100);
+	driver.cfgBatchBegin();
+	assert(driver.cfgBatchValset<uint8_t>(key_u1, two));
+	driver.cfgBatchMessage(false);
+	assert(driver.cfgBatchValset<uint8_t>(key_u1 + 100, two));
+	driver.cfgBatchMessage(true);
+	assert(driver.cfgBatchValset<uint8_t>(key_u1 + 1, two));
+	assert(driver.cfgBatchCommit() == 0 && device.cfgValsets() == 5);
+
+	driver.cfgBatchBegin();
+	assert(driver.cfgBatchValset<uint8_t>(key_u1, two));
+	driver.cfgBatchMessage(true);
+	assert(driver.cfgBatchValset<uint8_t>(key_u1 + 100, two));
+	driver.cfgBatchMessage(false);
+	assert(driver.cfgBatchValset<uint8_t>(key_u1 + 1, two));
+	assert(driver.cfgBatchCommit() < 0 && device.cfgValsets() == 8);
+}
+
+void test_heading_aligner()
+{
+	const uint32_t week = 7 * 24 * 3600 * 1000;
+	GPSHeadingAligner aligner(week);
+	float heading = 0.f;
+	float accuracy = 0.f;
+
+	assert(!aligner.valid() && !aligner.headingAt(1000, heading, accuracy));
+
+	// the heading of the epoch
+	aligner.add(1000, 0.5f, 0.01f);
+	assert(aligner.valid() && aligner.headingAt(1000, heading, accuracy));
+	assert(heading == 0.5f && accuracy == 0.01f);
+
+	// interpolated between two headings, and extrapolated by up to one interval
+	aligner.add(1125, 1.f, 0.02f);
+	assert(aligner.headingAt(1100, heading, accuracy));
+	assert(fabsf(heading - 0.9f) < 1e-5f && accuracy == 0.02f);
+	assert(aligner.headingAt(1200, heading, accuracy));
+	assert(fabsf(heading - 1.3f) < 1e-5f);
+	assert(aligner.headingAt(1300, heading, accuracy) && heading == 1.f);	// further: held
+	assert(!aligner.headingAt(1125 + GPS_HEADING_MAX_AGE + 1, heading, accuracy));
+
+	// across +-pi
+	aligner.add(2000, 3.1f, 0.01f);
+	aligner.add(2100, -3.1f, 0.01f);
+	assert(aligner.headingAt(2050, heading, accuracy));
+	assert(fabsf(fabsf(heading) - 3.14159265f) < 1e-4f);
+	assert(aligner.headingAt(2150, heading, accuracy));
+	assert(fabsf(heading - (-3.1f + 0.0415927f)) < 1e-4f);
+
+	// across the week rollover
+	aligner.add(week - 50, 0.f, 0.01f);
+	aligner.add(50, 0.1f, 0.01f);
+	assert(aligner.headingAt(0, heading, accuracy));
+	assert(fabsf(heading - 0.05f) < 1e-5f);
+	assert(aligner.headingAt(100, heading, accuracy));
+	assert(fabsf(heading - 0.15f) < 1e-5f);
+
+	// a repeated epoch replaces its heading
+	aligner.add(50, 0.2f, 0.01f);
+	assert(aligner.headingAt(0, heading, accuracy));
+	assert(fabsf(heading - 0.1f) < 1e-5f);
+}
+
+/**
+ * Position updates at an interval until the planner changes the period, for up to max_us
+ * @return the new period, 0 if none
+ */
+static unsigned rateUpdates(GPSRatePlanner &planner, uint64_t &now, uint64_t interval_us, uint64_t max_us,
+			    uint64_t &elapsed)
+{
+	for (elapsed = interval_us; elapsed <= max_us; elapsed += interval_us) {
+		now += interval_us;
+		const unsigned period = planner.update(now);
+
+		if (period != 0) {
+			return period;
+		}
+	}
+
+	return 0;
+}
+
+void test_rate_planner()
+{
+	// 300 bytes per epoch at 115200: 10 Hz fits (30000 bits/s), 2300 bytes only at 2 Hz
+	assert(GPSRatePlanner::fits(300, 0, 100, 115200));
+	assert(GPSRatePlanner::planPeriod(300, 0, 115200, 100) == 100);
+	assert(GPSRatePlanner::planPeriod(300, 0, 115200, 125) == 125);
+	assert(GPSRatePlanner::planPeriod(2300, 600, 115200, 100) == 500);
+	assert(GPSRatePlanner::planPeriod(2300, 600, 0, 100) == 100);
+	assert(GPSRatePlanner::planPeriod(100000, 0, 9600, 100) == 1000);	// doesn't fit at all
+
+	const unsigned baudrates[] = {115200, 230400, 460800, 921600};
+	assert(GPSRatePlanner::planBaudrate(300, 0, 100, baudrates, 4) == 115200);
+	assert(GPSRatePlanner::planBaudrate(2300, 600, 100, baudrates, 4) == 460800);
+	assert(GPSRatePlanner::planBaudrate(100000, 0, 100, baudrates, 4) == 921600);
+
+	// planned rate achieved: kept
+	GPSRatePlanner planner;
+	uint64_t now = 1000000;
+	planner.start(100);
+
+	for (int i = 0; i <= 3 * GPS_RATE_PLAN_WINDOW / 100000; i++, now += 100000) {
+		assert(planner.update(now) == 0);
+	}
+
+	// at half of the rate: the next longer period, once per window
+	unsigned period = 0;
+	int updates = 0;
+
+	for (; period == 0; now += 200000, updates++) {
+		period = planner.update(now);
+	}
+
+	assert(period == 125 && planner.currentPeriod() == 125);
+	assert(updates >= GPS_RATE_PLAN_WINDOW / 200000 && updates <= 2 * GPS_RATE_PLAN_WINDOW / 200000 + 1);
+
+	// keeping up again: stepped back to the planned period after GPS_RATE_PLAN_RECOVER_WINDOWS windows
+	uint64_t elapsed = 0;
+	assert(rateUpdates(planner, now, 125000, 100 * GPS_RATE_PLAN_WINDOW, elapsed) == 100);
+	assert(elapsed > (GPS_RATE_PLAN_RECOVER_WINDOWS - 1) * GPS_RATE_PLAN_WINDOW);
+	assert(elapsed <= (GPS_RATE_PLAN_RECOVER_WINDOWS + 2) * GPS_RATE_PLAN_WINDOW);
+
+	// behind again right after the step back: the next try waits twice as long
+	assert(rateUpdates(planner, now, 200000, 100 * GPS_RATE_PLAN_WINDOW, elapsed) == 125);
+	assert(rateUpdates(planner, now, 125000, 100 * GPS_RATE_PLAN_WINDOW, elapsed) == 100);
+	assert(elapsed > (2 * GPS_RATE_PLAN_RECOVER_WINDOWS - 1) * GPS_RATE_PLAN_WINDOW);
+	assert(elapsed <= (2 * GPS_RATE_PLAN_RECOVER_WINDOWS + 2) * GPS_RATE_PLAN_WINDOW);
+
+	// a step back that held: kept, and the wait is back to GPS_RATE_PLAN_RECOVER_WINDOWS windows
+	assert(rateUpdates(planner, now, 100000, 100 * GPS_RATE_PLAN_WINDOW, elapsed) == 0);
+	assert(rateUpdates(planner, now, 200000, 100 * GPS_RATE_PLAN_WINDOW, elapsed) == 125);
+	assert(rateUpdates(planner, now, 125000, 100 * GPS_RATE_PLAN_WINDOW, elapsed) == 100);
+	assert(elapsed <= (GPS_RATE_PLAN_RECOVER_WINDOWS + 2) * GPS_RATE_PLAN_WINDOW);
+
+	// a gap in the data isn't a rate problem
+	planner.start(125);
+	assert(planner.update(now) == 0);
+	assert(planner.update(now + 3 * GPS_RATE_PLAN_WINDOW) == 0);
+
+	// never slower than 1 Hz, not adapted after start(0)
+	planner.start(1000);
+	now += 10 * GPS_RATE_PLAN_WINDOW;
+
+	for (int i = 0; i < 10; i++, now += GPS_RATE_PLAN_WINDOW / 2) {
+		assert(planner.update(now) == 0);
+	}
+
+	planner.start(0);
+	assert(planner.update(now) == 0 && planner.update(now + GPS_RATE_PLAN_WINDOW) == 0);
+}
+
+static void lla2ecef(double latitude, double longitude, double altitude, double &x, double &y, double &z)
+{
+	const double a = 6378137.;
+	const double esq = 6.69437999014e-3;
+	const double lat = latitude * M_PI / 180.;
+	const double lon = longitude * M_PI / 180.;
+	const double N = a / sqrt(1. - esq * sin(lat) * sin(lat));
+	x = (N + altitude) * cos(lat) * cos(lon);
+	y = (N + altitude) * cos(lat) * sin(lon);
+	z = (N * (1. - esq) + altitude) * sin(lat);
+}
+
+void test_ecef2lla()
+{
+	struct Point {
+		double latitude;
+		double longitude;
+		double altitude;
+	};
+
+	const Point points[] {
+		{0., 0., 0.},
+		{47.3977419, 8.5455939, 488.1},
+		{-33.8688, 151.2093, 58.},
+		{89.9999, -120., 3000.},
+		{-90., 0., -20.},
+		{12.5, -75., 100000.},
+		{55., 37.6, 20200000.},	// GNSS orbit
+	};
+	const size_t n = sizeof(points) / sizeof(points[0]);
+	double x[n], y[n], z[n];
+
+	for (size_t i = 0; i < n; i++) {
+		lla2ecef(points[i].latitude, points[i].longitude, points[i].altitude, x[i], y[i], z[i]);
+	}
+
+	const GPSHelper::ECEFAccuracy accuracies[] {GPSHelper::ECEFAccuracy::Fast, GPSHelper::ECEFAccuracy::High};
+
+	for (const GPSHelper::ECEFAccuracy accuracy : accuracies) {
+		double latitude[n], longitude[n];
+		float altitude[n];
+		GPSHelper::ECEF2lla(x, y, z, n, latitude, longitude, altitude, accuracy);
+
+		for (size_t i = 0; i < n; i++) {
+			// 1e-8 deg is about 1 mm on the ground, Fast is less accurate in orbit
+			const bool orbit = points[i].altitude > 1e6;
+			const double tolerance = orbit && accuracy == GPSHelper::ECEFAccuracy::Fast ? 1e-6 : 1e-8;
+			assert(fabs(latitude[i] - points[i].latitude) < tolerance);
+
+			if (fabs(points[i].latitude) < 90.) {
+				assert(fabs(longitude[i] - points[i].longitude) < tolerance);
+			}
+
+			// float altitude, whose resolution is 2 m in orbit
+			assert(fabs(altitude[i] - points[i].altitude) < (orbit ? 4. : 1e-2));
+
+			// the same as one at a time
+			double lat, lon;
+			float alt;
+			GPSHelper::ECEF2lla(x[i], y[i], z[i], lat, lon, alt, accuracy);
+			assert(lat == latitude[i] && lon == longitude[i] && alt == altitude[i]);
+		}
+
+		// at and near the center of the earth: finite
+		const double center[][3] {{0., 0., 0.}, {1e-3, 0., 0.}, {0., 0., 1e-3}};
+
+		for (const auto &c : center) {
+			double lat, lon;
+			float alt;
+			GPSHelper::ECEF2lla(c[0], c[1], c[2], lat, lon, alt, accuracy);
+			assert(std::isfinite(lat) && std::isfinite(lon) && std::isfinite(alt));
+		}
+	}
+}
+
+void test_block_pool()
+{
+	static GPSBlockPool<5, 64>::Block blocks[5];
+	static GPSBlockPool<5, 64> pool{blocks};
+
+	void *a = pool.allocate(64);
+	void *b = pool.allocate(65);
+	void *c = pool.allocate(1);
+	assert(a && b && c && pool.used() == 4);
+	assert((uintptr_t)a % alignof(std::max_align_t) == 0 && (uint8_t *)b == (uint8_t *)a + 64);
+	assert(!pool.allocate(128));
+	assert(!pool.allocate(5 * 64 + 1));
+
+	// the buffer of two blocks is returned completely, adjacent free blocks can be taken together
+	pool.release(b);
+	assert(pool.used() == 2);
+	void *d = pool.allocate(128);
+	assert(d == b);
+	pool.release(a);
+	pool.release(c);
+	pool.release(d);
+	int not_from_pool;
+	pool.release(&not_from_pool);
+	assert(pool.used() == 0);
+	assert(pool.allocate(5 * 64) == a);
+	pool.release(a);
+
+	// every thread takes and returns buffers, never one taken by another thread
+	std::thread threads[4];
+
+	for (std::thread &thread : threads) {
+		thread = std::thread([]() {
+			for (uint32_t n = 0; n < 20000; n++) {
+				const size_t size = (n % 2) ? 100 : 10;
+				uint8_t *buffer = static_cast<uint8_t *>(pool.allocate(size));
+
+				if (buffer) {
+					memset(buffer, (int)(n & 0xff), size);
+
+					for (size_t i = 0; i < size; i++) {
+						assert(buffer[i] == (uint8_t)n);
+					}
+
+					pool.release(buffer);
+				}
+			}
+		});
+	}
+
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	assert(pool.used() == 0);
+}
+
+void test_snapshot_threads()
+{
+	// every word of a published value is its number, a torn read would mix two of them
+	struct snapshot_value_t {
+		uint32_t words[64];
+	};
+
+	static GPSSnapshot<snapshot_value_t> snapshot;
+	const uint32_t values = 100000;
+	std::atomic<bool> done{false};
+
+	std::thread writer([&]() {
+		snapshot_value_t value;
+
+		for (uint32_t n = 1; n <= values; n++) {
+			for (uint32_t &word : value.words) {
+				word = n;
+			}
+
+			snapshot.publish(value);
+		}
+
+		done = true;
+	});
+
+	uint32_t last = 0;
+
+	while (!done) {
+		snapshot_value_t value;
+
+		if (snapshot.read(value)) {
+			for (const uint32_t word : value.words) {
+				assert(word == value.words[0]);
+			}
+
+			assert(value.words[0] >= last);
+			last = value.words[0];
+		}
+	}
+
+	writer.join();
+	snapshot_value_t value;
+	assert(snapshot.read(value));
+	assert(value.words[0] == values);
+	assert(snapshot.updates() == values);
+}
+
+static void manager_set_fix(sensor_gps_s &gps, int32_t lat, int32_t alt, float eph, float vel_n)
+{
+	gps.timestamp = 1000000;
+	gps.fix_type = 3;
+	gps.lat = lat;
+	gps.lon = 85455940;
+	gps.alt = alt;
+	gps.eph = eph;
+	gps.epv = 2.f;
+	gps.vel_n_m_s = vel_n;
+	gps.s_variance_m_s = 0.5f;
+	gps.vel_ned_valid = true;
+	gps.satellites_used = 10;
+}
+
+void test_manager_blend()
+{
+	GPSManager manager;
+	const int first = manager.addReceiver();
+	const int second = manager.addReceiver();
+	sensor_gps_s gps{};
+	assert(first == 0 && second == 1);
+	assert(manager.readBlended(gps) == 0);
+	assert(!manager.readGpsPosition(first, gps));
+	assert(manager.receive(first, 0) == -1);	// no driver
+
+	sensor_gps_s &fix_first = *manager.gpsPositionBuffer(first);
+	manager_set_fix(fix_first, 473977420, 500000, 1.f, 1.f);
+	fix_first.device_id = 1;
+	manager.publish(first, 1);
+	assert(manager.readBlended(gps) == 1);
+	assert(gps.lat == fix_first.lat && gps.device_id == 1);
+
+	// a quarter of the weight: 1/5 of the offsets to the first receiver
+	sensor_gps_s &fix_second = *manager.gpsPositionBuffer(second);
+	manager_set_fix(fix_second, fix_first.lat + 100, fix_first.alt + 1000, 2.f, 3.f);
+	fix_second.device_id = 2;
+	manager.publish(second, 2);	// satellite info only
+	assert(manager.readBlended(gps) == 1);
+	manager.publish(second, 1);
+	assert(manager.readBlended(gps) == 2);
+	assert(gps.lat == fix_first.lat + 20);
+	assert(gps.lon == fix_first.lon);
+	assert(gps.alt == fix_first.alt + 500);	// same epv
+	assert(fabsf(gps.vel_n_m_s - 2.f) < 1e-5f);	// same speed accuracy
+	assert(gps.eph == 1.f && gps.device_id == 0);
+
+	// the second solution is 100 ms older, at 3 m/s north it is 30 cm further north by now
+	fix_second.timestamp -= 100000;
+	manager.publish(second, 1);
+	assert(manager.readBlended(gps) == 2);
+	assert(gps.lat == fix_first.lat + 25);
+
+	// too old to be blended
+	fix_first.timestamp += GPS_MANAGER_BLEND_MAX_AGE;
+	manager.publish(first, 1);
+	assert(manager.readBlended(gps) == 1);
+	assert(gps.lat == fix_first.lat);
+	assert(manager.gpsPositionUpdates(first) == 2 && manager.gpsPositionUpdates(second) == 2);
+
+	for (int i = manager.receivers(); i < GPS_MANAGER_MAX_RECEIVERS; i++) {
+		assert(manager.addReceiver() == i);
+	}
+
+	assert(manager.addReceiver() == -1);
+}
+
+void test_manager()
+{
+	test_snapshot_threads();
+	test_manager_blend();
 }
 
 int main(int, char **)
 {
+	test_crc32();
+	test_rtcm();
+	test_demux();
 	test_unicore();
+	test_text_scan();
+	test_epoch_assembler();
+	test_ubx_epoch_in_one_read();
+	test_parse_paths();
+	test_ubx_config_fingerprint();
+	test_ubx_cfg_batch();
+	test_heading_aligner();
+	test_rate_planner();
+	test_ecef2lla();
+	test_block_pool();
+	test_manager();
 
 	return 0;
 }
@@ -0,0 +1,288 @@
+#include "capture_file.h"
+#include "drivers.h"
+#include "mock_device.h"
+#include "ubx.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// receive() timeout, as used by PX4 for 5 Hz receivers. Timeouts cost no time on the
+// virtual clock, so it only affects how often receive() returns without data.
+#define REPLAY_RECEIVE_TIMEOUT	500
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplayOptions {
+	HostProtocol protocol{HostProtocol::Count};
+	size_t chunk_size{GPS_READ_BUFFER_SIZE};
+	unsigned baudrate{115200};		///< recorded line rate, 0 to not model the wire time
+	double speed{0.};			///< replay speed relative to the wire, 0 for as fast as possible
+	bool quiet{false};
+	bool feed{false};			///< pass the data with GPSHelper::feed() instead of receive()
+	bool satellite_info{true};		///< decode the satellite info
+	GPSHelper::TimestampMode timestamp_mode{GPSHelper::TimestampMode::Parsed};
+	unsigned reply_delay{0};		///< configuration reply delay of the simulated receiver, in ms
+	unsigned line_baudrate{0};		///< baudrate the simulated receiver is sending at before configuration
+	unsigned spi_clock{0};			///< SPI clock of the simulated receiver, 0 for a UART
+	const char *raw_path{nullptr};		///< file the raw measurements (UBX RXM) are written to
+	const char *path{nullptr};
+};
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s -p <protocol> [-b baudrate] [-c chunk-size] [-x speed] [-t timestamps] [-d delay] [-r baudrate] [-s spi-clock] [-w raw-file] [-f] [-n] [-q] <capture-file>\n",
+		name);
+	fprintf(stderr, "  protocol: ubx, sbf, nmea, ashtech or femto (use nmea for Unicore receivers)\n");
+	fprintf(stderr, "  -b  line rate the capture was recorded at, drives the virtual clock (default 115200, 0: off)\n");
+	fprintf(stderr, "  -c  bytes returned per read (default %d)\n", GPS_READ_BUFFER_SIZE);
+	fprintf(stderr, "  -x  replay in real time at this multiple of the wire speed (default: as fast as possible)\n");
+	fprintf(stderr, "  -t  position timestamps: parsed (default), first (first byte, estimated) or device (first byte,\n");
+	fprintf(stderr, "      from the device's receive timestamps)\n");
+	fprintf(stderr, "  -d  milliseconds the simulated receiver takes to answer a configuration command (default 0)\n");
+	fprintf(stderr, "  -r  the receiver is already sending the capture at this baudrate (default: it answers at any\n");
+	fprintf(stderr, "      baudrate and is quiet until configured)\n");
+	fprintf(stderr, "  -s  connect the UBX receiver by SPI at this clock in Hz, it queues the capture at the line rate\n");
+	fprintf(stderr, "  -w  write the raw measurement messages (UBX RXM-RAWX and RXM-SFRBX) to this file\n");
+	fprintf(stderr, "  -f  pass the data to the driver with feed(), as an event driven I/O loop would\n");
+	fprintf(stderr, "  -n  don't decode the satellite info, as without a consumer\n");
+	fprintf(stderr, "  -q  don't print the solutions\n");
+}
+
+static bool parseTimestampMode(const char *name, GPSHelper::TimestampMode &mode)
+{
+	if (strcmp(name, "parsed") == 0) {
+		mode = GPSHelper::TimestampMode::Parsed;
+
+	} else if (strcmp(name, "first") == 0) {
+		mode = GPSHelper::TimestampMode::FirstByte;
+
+	} else if (strcmp(name, "device") == 0) {
+		mode = GPSHelper::TimestampMode::FirstByteDevice;
+
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool parseOptions(int argc, char **argv, ReplayOptions &options)
+{
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+
+		if (has_value && strcmp(argv[i], "-p") == 0) {
+			if (!parseProtocolName(argv[++i], options.protocol)) {
+				return false;
+			}
+
+		} else if (has_value && strcmp(argv[i], "-b") == 0) {
+			options.baudrate = (unsigned)strtoul(argv[++i], nullptr, 10);
+
+		} else if (has_value && strcmp(argv[i], "-c") == 0) {
+			options.chunk_size = strtoul(argv[++i], nullptr, 10);
+
+		} else if (has_value && strcmp(argv[i], "-x") == 0) {
+			options.speed = strtod(argv[++i], nullptr);
+
+		} else if (has_value && strcmp(argv[i], "-t") == 0) {
+			if (!parseTimestampMode(argv[++i], options.timestamp_mode)) {
+				return false;
+			}
+
+		} else if (has_value && strcmp(argv[i], "-d") == 0) {
+			options.reply_delay = (unsigned)strtoul(argv[++i], nullptr, 10);
+
+		} else if (has_value && strcmp(argv[i], "-r") == 0) {
+			options.line_baudrate = (unsigned)strtoul(argv[++i], nullptr, 10);
+
+		} else if (has_value && strcmp(argv[i], "-s") == 0) {
+			options.spi_clock = (unsigned)strtoul(argv[++i], nullptr, 10);
+
+		} else if (has_value && strcmp(argv[i], "-w") == 0) {
+			options.raw_path = argv[++i];
+
+		} else if (strcmp(argv[i], "-f") == 0) {
+			options.feed = true;
+
+		} else if (strcmp(argv[i], "-n") == 0) {
+			options.satellite_info = false;
+
+		} else if (strcmp(argv[i], "-q") == 0) {
+			options.quiet = true;
+
+		} else if (argv[i][0] != '-' && !options.path) {
+			options.path = argv[i];
+
+		} else {
+			return false;
+		}
+	}
+
+	return options.path && options.protocol < HostProtocol::Unicore && (options.speed == 0. || options.baudrate > 0)
+	       && (options.spi_clock == 0 || (options.protocol == HostProtocol::UBX && !options.feed && options.line_baudrate == 0));
+}
+
+static void printSolution(gps_abstime time, const sensor_gps_s &gps)
+{
+	// age: publish time - timestamp of the solution
+	printf("%.6f,%.3f,%llu,%u,%u,%.7f,%.7f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f\n", (double)time * 1e-6,
+	       (double)((int64_t)gps_absolute_time() - (int64_t)gps.timestamp) * 1e-3,
+	       (unsigned long long)gps.time_utc_usec, gps.fix_type, gps.satellites_used, gps.lat * 1e-7, gps.lon * 1e-7,
+	       gps.alt * 1e-3, (double)gps.eph, (double)gps.epv, (double)gps.vel_n_m_s, (double)gps.vel_e_m_s,
+	       (double)gps.vel_d_m_s, (double)gps.heading);
+}
+
+int main(int argc, char **argv)
+{
+	ReplayOptions options;
+
+	if (!parseOptions(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	CaptureFile capture;
+
+	if (!capture.open(options.path)) {
+		fprintf(stderr, "failed to open %s\n", options.path);
+		return 1;
+	}
+
+	sensor_gps_s gps_position{};
+	satellite_info_s satellite_info{};
+	MockDevice device(capture.data(), capture.size(), options.chunk_size, protocolResponder(options.protocol));
+	GPSHelper *driver = createDriver(options.protocol, device, &gps_position, &satellite_info,
+					 options.spi_clock > 0 ? GPSHelper::Interface::SPI : GPSHelper::Interface::UART);
+	device.setSPIClock(options.spi_clock);
+	device.setReplyDelay((gps_abstime)options.reply_delay * 1000);
+	device.setLineBaudrate(options.line_baudrate, options.line_baudrate > 0);
+	FILE *raw_file = nullptr;
+
+	if (options.raw_path) {
+		raw_file = fopen(options.raw_path, "wb");
+
+		if (!raw_file || options.protocol != HostProtocol::UBX
+		    || static_cast<GPSDriverUBX *>(driver)->setRawMessageClass(UBX_CLASS_RXM, true) != 0) {
+			fprintf(stderr, "failed to write raw measurements to %s\n", options.raw_path);
+
+			if (raw_file) {
+				fclose(raw_file);
+			}
+
+			delete driver;
+			return 1;
+		}
+
+		device.setRawSink(raw_file);
+	}
+
+	const gps_abstime configure_start = gps_absolute_time();
+
+	// a receiver that is already sending is found with the baudrate detection
+	if (configureDriver(options.protocol, *driver, GPSHelper::OutputMode::GPSAndRTCM,
+			    options.line_baudrate > 0 ? 0 : 115200) != 0) {
+		fprintf(stderr, "configure failed\n");
+		delete driver;
+		return 1;
+	}
+
+	const gps_abstime configure_time = gps_absolute_time() - configure_start;
+
+	if (!options.quiet) {
+		printf("time,age_ms,time_utc_usec,fix_type,satellites_used,lat,lon,alt,eph,epv,vel_n,vel_e,vel_d,heading\n");
+	}
+
+	uint32_t solutions = 0;
+	uint32_t satellite_updates = 0;
+	device.setWireBaudrate(options.baudrate);
+	device.startStream();
+	driver->setTimestampMode(options.timestamp_mode);
+	driver->setSatelliteInfoEnabled(options.satellite_info);
+	const gps_abstime virtual_start = gps_absolute_time();
+	const Clock::time_point start = Clock::now();
+
+	while (!device.streamDone()) {
+		int ret;
+
+		if (options.feed) {
+			const uint8_t *chunk;
+			const size_t length = device.nextChunk(chunk);
+
+			if (options.timestamp_mode == GPSHelper::TimestampMode::FirstByteDevice) {
+				driver->setReceiveTimestamp(device.chunkTimestamp());
+			}
+
+			ret = driver->feed(chunk, length);
+
+			if (ret < 0) {
+				fprintf(stderr, "%s: feed() is not supported\n", protocolName(options.protocol));
+				break;
+			}
+
+		} else {
+			ret = driver->receive(REPLAY_RECEIVE_TIMEOUT);
+		}
+
+		if (ret > 0 && (ret & 1)) {
+			solutions++;
+
+			if (!options.quiet) {
+				printSolution(gps_absolute_time() - virtual_start, gps_position);
+			}
+		}
+
+		if (ret > 0 && (ret & 2)) {
+			satellite_updates++;
+		}
+
+		if (options.speed > 0.) {
+			const std::chrono::duration<double> due((double)(gps_absolute_time() - virtual_start) * 1e-6 / options.speed);
+			std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(due));
+		}
+	}
+
+	const double wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	const double wire_seconds = options.baudrate > 0 ? (double)device.bytesServed() * 10. / options.baudrate : 0.;
+
+	fprintf(stderr, "%s: %zu bytes, %u solutions, %u satellite updates, %u RTCM messages\n",
+		protocolName(options.protocol), device.bytesServed(), solutions, satellite_updates, device.rtcmMessages());
+
+	if (raw_file) {
+		fprintf(stderr, "%u raw measurement messages, %zu bytes written to %s\n", device.rawMessages(), device.rawBytes(),
+			options.raw_path);
+		fclose(raw_file);
+	}
+
+	if (options.spi_clock > 0) {
+		fprintf(stderr, "%u SPI transfers, %zu fill bytes\n", device.spiTransfers(), device.spiFillBytes());
+	}
+
+	fprintf(stderr, "configured in %.3f s (virtual clock)\n", (double)configure_time * 1e-6);
+	fprintf(stderr, "replayed in %.3f s (%.1f MB/s)", wall_seconds,
+		wall_seconds > 0. ? (double)device.bytesServed() / wall_seconds * 1e-6 : 0.);
+
+	if (wire_seconds > 0. && wall_seconds > 0.) {
+		fprintf(stderr, ", %.1f s on the wire, %.0fx real time", wire_seconds, wire_seconds / wall_seconds);
+	}
+
+	fprintf(stderr, "\n");
+
+#ifdef GPS_LATENCY_STATS
+	// on the virtual clock the parsing takes no time, the latency is the wire time of the update's messages
+	const GPSLatencyStats &stats = driver->latencyStats();
+	const uint32_t updates = stats.updates > 0 ? stats.updates : 1;
+	fprintf(stderr, "frames %u, checksum errors %u, resyncs %u, bytes discarded %u\n", stats.frames,
+		stats.checksum_errors, stats.resyncs, stats.bytesDiscarded());
+	fprintf(stderr, "latency mean %.3f ms, max %.3f ms, parse mean %.3f ms, max %.3f ms\n",
+		(double)stats.latency_sum_us / updates * 1e-3, stats.latency_max_us * 1e-3,
+		(double)stats.parse_sum_us / updates * 1e-3, stats.parse_max_us * 1e-3);
+#endif
+
+	delete driver;
+	return 0;
+}
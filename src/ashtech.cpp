@@ -38,7 +38,9 @@
 #include <ctime>
 
 #include "ashtech.h"
+#include "protocol_demux.h"
 #include "rtcm.h"
+#include "text_scan.h"
 
 #define MIN(X,Y)	((X) < (Y) ? (X) : (Y))
 #define ASH_UNUSED(x) (void)x;
@@ -46,6 +48,10 @@
 //#define ASH_DEBUG(...)		{GPS_WARN(__VA_ARGS__);}
 #define ASH_DEBUG(...)		{/*GPS_WARN(__VA_ARGS__);*/}
 
+// the RTCM parser and the baudrate detection are held at once
+static_assert(GPSHelper::staticPoolBlocks(sizeof(RTCMParsing)) + GPSHelper::staticPoolBlocks(sizeof(ProtocolDemux))
+	      <= GPS_STATIC_POOL_BLOCKS, "the static memory pool is too small for the Ashtech driver");
+
 GPSDriverAshtech::GPSDriverAshtech(GPSCallbackPtr callback, void *callback_user,
 				   sensor_gps_s *gps_position, satellite_info_s *satellite_info,
 				   float heading_offset) :
@@ -59,7 +65,7 @@ GPSDriverAshtech::GPSDriverAshtech(GPSCallbackPtr callback, void *callback_user,
 
 GPSDriverAshtech::~GPSDriverAshtech()
 {
-	delete _rtcm_parsing;
+	destroyBuffer(_rtcm_parsing);
 }
 
 /*
@@ -75,11 +81,8 @@ int GPSDriverAshtech::handleMessage(int len)
 		return 0;
 	}
 
-	int uiCalcComma = 0;
-
-	for (int i = 0 ; i < len; i++) {
-		if (_rx_buffer[i] == ',') { uiCalcComma++; }
-	}
+	// counted by parseChar() and parseRun()
+	const int uiCalcComma = _rx_comma_count;
 
 	char *bufptr = (char *)(_rx_buffer + 6);
 	int ret = 0;
@@ -272,6 +275,8 @@ int GPSDriverAshtech::handleMessage(int len)
 			0;                                  /**< Course over ground (NOT heading, but direction of movement) in rad, -PI..PI */
 		_gps_position->vel_ned_valid = true;                         /**< Flag to indicate if NED speed is valid */
 		_gps_position->c_variance_rad = 0.1f;
+		statsPositionFrame();
+		statsUpdate();
 		ret = 1;
 
 	} else if (memcmp(_rx_buffer, "$GPHDT,", 7) == 0 && uiCalcComma == 2) {
@@ -461,6 +466,8 @@ int GPSDriverAshtech::handleMessage(int len)
 		_gps_position->vel_ned_valid = true;				/** Flag to indicate if NED speed is valid */
 		_gps_position->c_variance_rad = 0.1f;
 		_rate_count_vel++;
+		statsPositionFrame();
+		statsUpdate();
 		ret = 1;
 
 	} else if ((memcmp(_rx_buffer + 3, "GST,", 3) == 0) && (uiCalcComma == 8)) {
@@ -574,13 +581,16 @@ int GPSDriverAshtech::handleMessage(int len)
 			return 0;
 		}
 
-		if (this_msg_num == 0 && bGPS && _satellite_info) {
-			memset(_satellite_info->svid,      0, sizeof(_satellite_info->svid));
-			memset(_satellite_info->used,      0, sizeof(_satellite_info->used));
-			memset(_satellite_info->elevation, 0, sizeof(_satellite_info->elevation));
-			memset(_satellite_info->azimuth,   0, sizeof(_satellite_info->azimuth));
-			memset(_satellite_info->snr,       0, sizeof(_satellite_info->snr));
-			memset(_satellite_info->prn,       0, sizeof(_satellite_info->prn));
+		// the satellites are only decoded while somebody consumes them
+		satellite_info_s *satellite_info = satelliteInfoEnabled() ? _satellite_info : nullptr;
+
+		if (this_msg_num == 0 && bGPS && satellite_info) {
+			memset(satellite_info->svid,      0, sizeof(satellite_info->svid));
+			memset(satellite_info->used,      0, sizeof(satellite_info->used));
+			memset(satellite_info->elevation, 0, sizeof(satellite_info->elevation));
+			memset(satellite_info->azimuth,   0, sizeof(satellite_info->azimuth));
+			memset(satellite_info->snr,       0, sizeof(satellite_info->snr));
+			memset(satellite_info->prn,       0, sizeof(satellite_info->prn));
 		}
 
 		int end = 4;
@@ -589,15 +599,22 @@ int GPSDriverAshtech::handleMessage(int len)
 			end =  tot_sv_visible - (this_msg_num - 1) * 4;
 			_gps_position->satellites_used = tot_sv_visible;
 
-			if (_satellite_info) {
-				_satellite_info->count = MIN(tot_sv_visible, satellite_info_s::SAT_INFO_MAX_SATELLITES);
-				_satellite_info->timestamp = gps_absolute_time();
+			if (satellite_info) {
+				satellite_info->count = MIN(tot_sv_visible, satellite_info_s::SAT_INFO_MAX_SATELLITES);
+				satellite_info->timestamp = gps_absolute_time();
 				ret = 2;
 			}
 		}
 
-		if (_satellite_info) {
-			for (int y = 0 ; y < end ; y++) {
+		if (satellite_info) {
+			// 4 satellites per message, don't trust the counts to stay within the arrays
+			for (int y = 0 ; y < end && y < 4; y++) {
+				const int sat_index = y + (this_msg_num - 1) * 4;
+
+				if (sat_index >= satellite_info_s::SAT_INFO_MAX_SATELLITES) {
+					break;
+				}
+
 				if (bufptr && *(++bufptr) != ',') { sat[y].svid = strtol(bufptr, &endp, 10); bufptr = endp; }
 
 				if (bufptr && *(++bufptr) != ',') { sat[y].elevation = strtol(bufptr, &endp, 10); bufptr = endp; }
@@ -606,12 +623,12 @@ int GPSDriverAshtech::handleMessage(int len)
 
 				if (bufptr && *(++bufptr) != ',') { sat[y].snr = strtol(bufptr, &endp, 10); bufptr = endp; }
 
-				_satellite_info->svid[y + (this_msg_num - 1) * 4]      = sat[y].svid;
-				_satellite_info->used[y + (this_msg_num - 1) * 4]      = (sat[y].snr > 0);
-				_satellite_info->elevation[y + (this_msg_num - 1) * 4] = sat[y].elevation;
-				_satellite_info->azimuth[y + (this_msg_num - 1) * 4]   = sat[y].azimuth;
-				_satellite_info->snr[y + (this_msg_num - 1) * 4]       = sat[y].snr;
-				_satellite_info->prn[y + (this_msg_num - 1) * 4]       = sat[y].prn;
+				satellite_info->svid[sat_index]      = sat[y].svid;
+				satellite_info->used[sat_index]      = (sat[y].snr > 0);
+				satellite_info->elevation[sat_index] = sat[y].elevation;
+				satellite_info->azimuth[sat_index]   = sat[y].azimuth;
+				satellite_info->snr[sat_index]       = sat[y].snr;
+				satellite_info->prn[sat_index]       = sat[y].prn;
 			}
 		}
 
@@ -771,39 +788,38 @@ void GPSDriverAshtech::receiveWait(unsigned timeout_min)
 int GPSDriverAshtech::receive(unsigned timeout)
 {
 	{
-
-		uint8_t buf[GPS_READ_BUFFER_SIZE];
-
 		/* timeout additional to poll */
 		uint64_t time_started = gps_absolute_time();
 
-		int j = 0;
-		int bytes_count = 0;
-
 		while (true) {
 
-			/* pass received bytes to the packet decoder */
-			while (j < bytes_count) {
-				int l = 0;
+			/* pass received bytes to the packet decoder, starting with what the last call left over */
+			while (_read_buffer_pos < _read_buffer_bytes) {
+				_read_buffer_pos = (uint16_t)(_read_buffer_pos + parseRun(_read_buffer + _read_buffer_pos,
+							      _read_buffer_bytes - _read_buffer_pos));
+
+				if (_read_buffer_pos >= _read_buffer_bytes) {
+					break;
+				}
 
-				if ((l = parseChar(buf[j])) > 0) {
+				int l = parseChar(_read_buffer[_read_buffer_pos++]);
+
+				if (l > 0) {
 					/* return to configure during configuration or to the gps driver during normal work
-					 * if a packet has arrived */
+					 * if a packet has arrived. The rest of the buffer is handled by the next call. */
 					int ret = handleMessage(l);
 
 					if (ret > 0) {
 						return ret;
 					}
 				}
-
-				j++;
 			}
 
 			/* everything is read */
-			j = bytes_count = 0;
+			_read_buffer_pos = _read_buffer_bytes = 0;
 
 			/* then poll or read for new data */
-			int ret = read(buf, sizeof(buf), timeout * 2);
+			int ret = read(_read_buffer, sizeof(_read_buffer), timeout * 2);
 
 			if (ret < 0) {
 				/* something went wrong when polling */
@@ -815,7 +831,8 @@ int GPSDriverAshtech::receive(unsigned timeout)
 
 			} else if (ret > 0) {
 				/* if we have new data from GPS, go handle it */
-				bytes_count = ret;
+				_read_buffer_bytes = ret;
+				statsBytesReceived(ret);
 			}
 
 			/* in case we get crap from GPS or time out */
@@ -826,6 +843,65 @@ int GPSDriverAshtech::receive(unsigned timeout)
 	}
 
 }
+
+int GPSDriverAshtech::feed(const uint8_t *buf, size_t buf_length)
+{
+	int handled = 0;
+	statsBytesReceived(buf_length);
+	_report_hold.resume(*_gps_position);
+
+	for (size_t i = 0; i < buf_length; i++) {
+		i += parseRun(buf + i, buf_length - i);
+
+		if (i >= buf_length) {
+			break;
+		}
+
+		int l = parseChar(buf[i]);
+
+		if (l > 0) {
+			const int ret = handleMessage(l);
+
+			// the rest of the read can start the next epoch
+			if ((ret & 1) && i + 1 < buf_length) {
+				_report_hold.hold(*_gps_position);
+			}
+
+			handled |= ret;
+		}
+	}
+
+	_report_hold.release(*_gps_position);
+	return handled;
+}
+
+size_t GPSDriverAshtech::parseRun(const uint8_t *buf, size_t len)
+{
+	if (_decode_state != NMEADecodeState::got_sync1) {
+		return 0;
+	}
+
+	// the bytes that fit, parseChar() handles a full buffer
+	const size_t space = sizeof(_rx_buffer) - 5 - _rx_buffer_bytes;
+	len = len < space ? len : space;
+	size_t i = 0;
+
+	while (true) {
+		const size_t run = textRunLength(buf + i, len - i, '$', '*', ',', ',');
+		memcpy(_rx_buffer + _rx_buffer_bytes, buf + i, run);
+		_rx_buffer_bytes = (uint16_t)(_rx_buffer_bytes + run);
+		i += run;
+
+		if (i >= len || buf[i] != ',') {
+			return i;
+		}
+
+		_rx_comma_count++;
+		_rx_buffer[_rx_buffer_bytes++] = ',';
+		i++;
+	}
+}
+
 #define HEXDIGIT_CHAR(d) ((char)((d) + (((d) < 0xA) ? '0' : 'A'-0xA)))
 
 int GPSDriverAshtech::parseChar(uint8_t b)
@@ -838,7 +914,9 @@ int GPSDriverAshtech::parseChar(uint8_t b)
 		if (b == '$') {
 			_decode_state = NMEADecodeState::got_sync1;
 			_rx_buffer_bytes = 0;
+			_rx_comma_count = 0;
 			_rx_buffer[_rx_buffer_bytes++] = b;
+			statsFrameStart();
 
 		} else if (b == RTCM3_PREAMBLE && _rtcm_parsing) {
 			_decode_state = NMEADecodeState::decode_rtcm3;
@@ -852,6 +930,9 @@ int GPSDriverAshtech::parseChar(uint8_t b)
 		if (b == '$') {
 			_decode_state = NMEADecodeState::got_sync1;
 			_rx_buffer_bytes = 0;
+			_rx_comma_count = 0;
+			statsResync();
+			statsFrameStart();
 
 		} else if (b == '*') {
 			_decode_state = NMEADecodeState::got_asteriks;
@@ -861,8 +942,13 @@ int GPSDriverAshtech::parseChar(uint8_t b)
 			ASH_DEBUG("buffer overflow");
 			_decode_state = NMEADecodeState::uninit;
 			_rx_buffer_bytes = 0;
+			statsResync();
 
 		} else {
+			if (b == ',') {
+				_rx_comma_count++;
+			}
+
 			_rx_buffer[_rx_buffer_bytes++] = b;
 		}
 
@@ -875,15 +961,15 @@ int GPSDriverAshtech::parseChar(uint8_t b)
 
 	case NMEADecodeState::got_first_cs_byte: {
 			_rx_buffer[_rx_buffer_bytes++] = b;
-			uint8_t checksum = 0;
-			uint8_t *buffer = _rx_buffer + 1;
-			uint8_t *bufend = _rx_buffer + _rx_buffer_bytes - 3;
-
-			for (; buffer < bufend; buffer++) { checksum ^= *buffer; }
+			const uint8_t checksum = textChecksum(_rx_buffer + 1, _rx_buffer_bytes - 4u);
 
 			if ((HEXDIGIT_CHAR(checksum >> 4) == *(_rx_buffer + _rx_buffer_bytes - 2)) &&
 			    (HEXDIGIT_CHAR(checksum & 0x0F) == *(_rx_buffer + _rx_buffer_bytes - 1))) {
 				iRet = _rx_buffer_bytes;
+				statsFrameDone(_rx_buffer_bytes + 2); // and the CR LF that follows
+
+			} else {
+				statsChecksumError();
 			}
 
 			decodeInit();
@@ -910,7 +996,7 @@ void GPSDriverAshtech::decodeInit()
 
 	if (_output_mode == OutputMode::GPSAndRTCM || _output_mode == OutputMode::RTCM) {
 		if (!_rtcm_parsing) {
-			_rtcm_parsing = new RTCMParsing();
+			_rtcm_parsing = createBuffer<RTCMParsing>();
 		}
 
 		if (_rtcm_parsing) {
@@ -950,6 +1036,14 @@ int GPSDriverAshtech::configure(unsigned &baudrate, const GPSConfig &config)
 	_correction_output_activated = false;
 	_configure_done = false;
 
+	// the RTCM output is parsed in a buffer of the memory pool, without it there is no RTCM
+	decodeInit();
+
+	if (!_rtcm_parsing && (_output_mode == OutputMode::GPSAndRTCM || _output_mode == OutputMode::RTCM)) {
+		ASH_DEBUG("no memory for the RTCM parser");
+		return -1;
+	}
+
 	/* Try different baudrates (115200 is the default for Trimble) and request the baudrate that we want.
 	 *
 	 * These are Ashtech proprietary commands, we can use them for auto-detection:
@@ -958,12 +1052,34 @@ int GPSDriverAshtech::configure(unsigned &baudrate, const GPSConfig &config)
 	 * $PASHR for a response
 	 */
 	const unsigned baudrates_to_try[] = {9600, 38400, 19200, 57600, 115200};
+	const unsigned num_baudrates = sizeof(baudrates_to_try) / sizeof(baudrates_to_try[0]);
 	bool success = false;
 
 	unsigned test_baudrate;
 
-	for (unsigned int baud_i = 0; !success && baud_i < sizeof(baudrates_to_try) / sizeof(baudrates_to_try[0]); baud_i++) {
-		test_baudrate = baudrates_to_try[baud_i];
+	// A receiver that is already sending NMEA is found by listening, without waiting for replies at the
+	// wrong baudrates. Its baudrate is probed first.
+	unsigned probe_baudrates[num_baudrates];
+	unsigned num_probe = 0;
+
+	if (baudrate == 0) {
+		const unsigned detected_baudrate = detectBaudrate(baudrates_to_try, num_baudrates,
+						   ProtocolDemux::protocolMask(ProtocolDemux::Protocol::NMEA), ASH_BAUDRATE_DETECT_TIME);
+
+		if (detected_baudrate != 0) {
+			ASH_DEBUG("detected baudrate %u", detected_baudrate);
+			probe_baudrates[num_probe++] = detected_baudrate;
+		}
+	}
+
+	for (unsigned i = 0; i < num_baudrates; i++) {
+		if (num_probe == 0 || baudrates_to_try[i] != probe_baudrates[0]) {
+			probe_baudrates[num_probe++] = baudrates_to_try[i];
+		}
+	}
+
+	for (unsigned int baud_i = 0; !success && baud_i < num_baudrates; baud_i++) {
+		test_baudrate = probe_baudrates[baud_i];
 
 		if (baudrate > 0 && baudrate != test_baudrate) {
 			continue; // skip to next baudrate
@@ -37,6 +37,7 @@
 
 #pragma once
 
+#include "gps_epoch.h"
 #include "gps_helper.h"
 #include "base_station.h"
 #include "../../definitions.h"
@@ -47,6 +48,7 @@ class RTCMParsing;
 
 #define ASHTECH_RECV_BUFFER_SIZE 512
 #define ASH_RESPONSE_TIMEOUT     200    // ms, timeout for waiting for a response
+#define ASH_BAUDRATE_DETECT_TIME 120    // ms, listening time per baudrate of the baudrate detection
 
 class GPSDriverAshtech : public GPSBaseStationSupport
 {
@@ -62,6 +64,7 @@ public:
 	int configure(unsigned &baudrate, const GPSConfig &config) override;
 
 	int receive(unsigned timeout) override;
+	int feed(const uint8_t *buf, size_t buf_length) override;
 
 private:
 	enum class AshtechBoard {
@@ -104,6 +107,13 @@ private:
 
 	int parseChar(uint8_t b);
 
+	/**
+	 * Parse the bytes at the start of buf which only have to be stored, i.e. the payload of a
+	 * sentence, faster than parseChar() does: it copies them up to the next delimiter at once.
+	 * @return number of bytes parsed, the next one is passed to parseChar()
+	 */
+	size_t parseRun(const uint8_t *buf, size_t len);
+
 	/**
 	 * receive data for at least the specified amount of time
 	 */
@@ -128,6 +138,10 @@ private:
 
 	uint8_t _rx_buffer[ASHTECH_RECV_BUFFER_SIZE];
 	uint16_t _rx_buffer_bytes{};
+	uint16_t _rx_comma_count{0}; ///< commas of the sentence in _rx_buffer
+	uint8_t _read_buffer[GPS_READ_BUFFER_SIZE] {}; ///< last read, kept across receive() calls
+	uint16_t _read_buffer_pos{0}; ///< next byte to parse in _read_buffer
+	uint16_t _read_buffer_bytes{0};
 	uint64_t _last_timestamp_time{0};
 
 	float _heading_offset;
@@ -135,6 +149,7 @@ private:
 	gps_abstime _survey_in_start{0};
 
 	sensor_gps_s *_gps_position {nullptr};
+	GPSReportHold<sensor_gps_s> _report_hold; ///< the update while the rest of its feed() is decoded
 
 	satellite_info_s *_satellite_info {nullptr};
 
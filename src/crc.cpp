@@ -33,6 +33,13 @@
 
 #include "crc.h"
 
+#include <string.h>
+
+#if defined(__ARM_FEATURE_CRC32) && !defined(CRC32_NO_HARDWARE)
+#include <arm_acle.h>
+#define CRC32_HARDWARE
+#endif
+
 // According to https://en.wikipedia.org/wiki/Cyclic_redundancy_check
 //
 // the CRC is based on the CRC-32 ISO 3309 / ANSI X3.66
@@ -40,10 +47,56 @@
 //
 // The CRC algorithm was extracted from the Femtomes driver.
 //
+// Backends, selected at build time:
+// - ARMv8 CRC32 instructions if the target has them (define CRC32_NO_HARDWARE to disable).
+//   They use the same polynomial and no implicit inversion, so the result is identical.
+// - slice-by-8 with 8 KB of tables if CRC32_SLICE_BY_8 is defined (little endian only).
+// - otherwise a single 1 KB table, one lookup per byte.
+//
+
+#if defined(CRC32_HARDWARE)
+
+uint32_t
+calculateCRC32(uint32_t length, uint8_t *buffer, uint32_t crc)
+{
+	while (length != 0 && ((uintptr_t)buffer & 7) != 0) {
+		crc = __crc32b(crc, *buffer++);
+		length--;
+	}
+
+	while (length >= 8) {
+		uint64_t data;
+		memcpy(&data, buffer, sizeof(data));
+		crc = __crc32d(crc, data);
+		buffer += 8;
+		length -= 8;
+	}
+
+	while (length-- != 0) {
+		crc = __crc32b(crc, *buffer++);
+	}
+
+	return crc;
+}
+
+#else // CRC32_HARDWARE
+
+#if defined(CRC32_SLICE_BY_8)
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "CRC32_SLICE_BY_8 requires a little endian target"
+#endif
+static constexpr int CRC32_TABLE_SLICES = 8;
+#else
+static constexpr int CRC32_TABLE_SLICES = 1;
+#endif
 
 static constexpr uint32_t CRC32_POLYNOMIAL = 0xEDB88320;
 
-static uint32_t crc32Value(uint32_t crc)
+struct crc32_table_t {
+	uint32_t value[CRC32_TABLE_SLICES][256];
+};
+
+static constexpr uint32_t crc32Value(uint32_t crc)
 {
 	for (int i = 8 ; i > 0; i--) {
 		if (crc & 1) {
@@ -57,11 +110,120 @@ static uint32_t crc32Value(uint32_t crc)
 	return crc;
 }
 
+static constexpr crc32_table_t generateCRC32Table()
+{
+	crc32_table_t table{};
+
+	for (uint32_t i = 0; i < 256; i++) {
+		table.value[0][i] = crc32Value(i);
+	}
+
+	// slice n is the CRC of a byte followed by n zero bytes
+	for (int slice = 1; slice < CRC32_TABLE_SLICES; slice++) {
+		for (uint32_t i = 0; i < 256; i++) {
+			const uint32_t prev = table.value[slice - 1][i];
+			table.value[slice][i] = (prev >> 8) ^ table.value[0][prev & 0xff];
+		}
+	}
+
+	return table;
+}
+
+static constexpr crc32_table_t crc32_table = generateCRC32Table();
+
 uint32_t
 calculateCRC32(uint32_t length, uint8_t *buffer, uint32_t crc)
+{
+	const uint32_t(&t)[CRC32_TABLE_SLICES][256] = crc32_table.value;
+
+#if defined(CRC32_SLICE_BY_8)
+
+	while (length >= 8) {
+		uint32_t one;
+		uint32_t two;
+		memcpy(&one, buffer, sizeof(one));
+		memcpy(&two, buffer + 4, sizeof(two));
+		one ^= crc;
+		crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^ t[5][(one >> 16) & 0xff] ^ t[4][one >> 24]
+		      ^ t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+		buffer += 8;
+		length -= 8;
+	}
+
+#endif
+
+	while (length-- != 0) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *buffer++) & 0xff];
+	}
+
+	return crc;
+}
+
+#endif // CRC32_HARDWARE
+
+static constexpr crc16_table_t generateCRC16CCITTTable()
+{
+	crc16_table_t table{};
+
+	for (uint32_t i = 0; i < 256; i++) {
+		uint16_t crc = static_cast<uint16_t>(i << 8);
+
+		for (int bit = 0; bit < 8; bit++) {
+			crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+		}
+
+		table.value[i] = crc;
+	}
+
+	return table;
+}
+
+const crc16_table_t crc16_ccitt_table = generateCRC16CCITTTable();
+
+uint16_t
+calculateCRC16CCITT(uint32_t length, const uint8_t *buffer, uint16_t crc)
+{
+	while (length-- != 0) {
+		crc = crc16CCITTUpdate(crc, *buffer++);
+	}
+
+	return crc;
+}
+
+static constexpr uint32_t CRC24Q_POLYNOMIAL = 0x1864CFB;
+
+struct crc24q_table_t {
+	uint32_t value[256];
+};
+
+static constexpr crc24q_table_t generateCRC24QTable()
+{
+	crc24q_table_t table{};
+
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i << 16;
+
+		for (int bit = 0; bit < 8; bit++) {
+			crc <<= 1;
+
+			if (crc & 0x1000000) {
+				crc ^= CRC24Q_POLYNOMIAL;
+			}
+		}
+
+		table.value[i] = crc;
+	}
+
+	return table;
+}
+
+static constexpr crc24q_table_t crc24q_table = generateCRC24QTable();
+
+uint32_t
+calculateCRC24Q(uint32_t length, const uint8_t *buffer, uint32_t crc)
 {
 	while (length-- != 0) {
-		crc = ((crc >> 8) & 0x00FFFFFFL) ^ (crc32Value(((uint32_t) crc ^ *buffer++) & 0xff));
+		crc = ((crc << 8) & 0xFFFFFF) ^ crc24q_table.value[((crc >> 16) ^ *buffer++) & 0xff];
 	}
 
 	return crc;
@@ -35,4 +35,50 @@
 
 #include <cstdint>
 
+/**
+ * Update a CRC-32 (reversed polynomial 0xEDB88320, no final XOR) over a buffer.
+ * The backend (hardware, slice-by-8 or single table) is selected at build time, see crc.cpp.
+ * @param length number of bytes in buffer
+ * @param buffer data
+ * @param crc initial value, or the result of a previous call to continue a running CRC
+ * @return updated CRC
+ */
 uint32_t calculateCRC32(uint32_t length, uint8_t *buffer, uint32_t crc);
+
+/**
+ * CRC-16-CCITT (polynomial 0x1021, not reflected, no final XOR), as used by Septentrio SBF.
+ */
+struct crc16_table_t {
+	uint16_t value[256];
+};
+
+extern const crc16_table_t crc16_ccitt_table;
+
+/**
+ * Update a CRC-16-CCITT with a single byte, for CRCs computed while bytes arrive.
+ * @param crc running CRC (start with 0)
+ * @param b next data byte
+ * @return updated CRC
+ */
+static inline uint16_t crc16CCITTUpdate(const uint16_t crc, const uint8_t b)
+{
+	return static_cast<uint16_t>((crc << 8) ^ crc16_ccitt_table.value[(crc >> 8) ^ b]);
+}
+
+/**
+ * Update a CRC-16-CCITT over a buffer.
+ * @param length number of bytes in buffer
+ * @param buffer data
+ * @param crc initial value (0 for SBF)
+ * @return updated CRC
+ */
+uint16_t calculateCRC16CCITT(uint32_t length, const uint8_t *buffer, uint16_t crc);
+
+/**
+ * Update a CRC-24Q (polynomial 0x1864CFB, not reflected, no final XOR) over a buffer, as used by RTCM3.
+ * @param length number of bytes in buffer
+ * @param buffer data
+ * @param crc initial value (0 for RTCM3)
+ * @return updated CRC (lower 24 bits)
+ */
+uint32_t calculateCRC24Q(uint32_t length, const uint8_t *buffer, uint32_t crc);
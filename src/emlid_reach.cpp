@@ -128,33 +128,17 @@ int
 GPSDriverEmlidReach::receive(unsigned timeout)
 {
 	uint8_t read_buff[GPS_READ_BUFFER_SIZE];
-	unsigned read_buff_len = 0;
-	uint8_t read_ind = 0;
 	int return_status = 0;
 
 	gps_abstime time_started = gps_absolute_time();
 
 	while (true) {
 		// read from serial, timeout may be truncated further in read()
-		read_buff_len = read(read_buff, sizeof(read_buff), timeout);
-
-		if (read_buff_len > 0) {
-			read_ind = 0;
-		}
+		int read_buff_len = read(read_buff, sizeof(read_buff), timeout);
 
 		// process data in buffer return by read()
-		while (read_ind < read_buff_len) {
-			int ret = 0;
-			ret = erbParseChar(read_buff[read_ind++]);
-
-			if (ret > 0) {
-				_sentence_cnt ++;
-
-				// when testig connection, we care about syntax not semantic
-				if (! _testing_connection) {
-					return_status = handleErbSentence();
-				}
-			}
+		if (read_buff_len > 0) {
+			return_status |= feed(read_buff, read_buff_len);
 		}
 
 		if (return_status > 0) {
@@ -171,6 +155,26 @@ GPSDriverEmlidReach::receive(unsigned timeout)
 	return -1;
 }
 
+int
+GPSDriverEmlidReach::feed(const uint8_t *buf, size_t buf_length)
+{
+	int handled = 0;
+	statsBytesReceived(buf_length);
+
+	for (size_t i = 0; i < buf_length; i++) {
+		if (erbParseChar(buf[i]) > 0) {
+			_sentence_cnt ++;
+
+			// when testig connection, we care about syntax not semantic
+			if (! _testing_connection) {
+				handled |= handleErbSentence();
+			}
+		}
+	}
+
+	return handled;
+}
+
 
 //// ERB
 
@@ -186,6 +190,7 @@ GPSDriverEmlidReach::erbParseChar(uint8_t b)
 			_erb_buff_cnt = 0;
 			buff_ptr[_erb_buff_cnt ++] = b;
 			_erb_decode_state = ERB_State::got_sync_1;
+			statsFrameStart();
 		}
 
 		break;
@@ -197,6 +202,7 @@ GPSDriverEmlidReach::erbParseChar(uint8_t b)
 
 		} else {
 			_erb_decode_state = ERB_State::init;
+			statsResync();
 		}
 
 		break;
@@ -213,6 +219,7 @@ GPSDriverEmlidReach::erbParseChar(uint8_t b)
 
 		} else {
 			_erb_decode_state = ERB_State::init;
+			statsResync();
 		}
 
 		break;
@@ -232,6 +239,7 @@ GPSDriverEmlidReach::erbParseChar(uint8_t b)
 	case ERB_State::got_len_2:
 		if (_erb_buff_cnt > ERB_SENTENCE_MAX_LEN - sizeof(erb_checksum_t)) {
 			_erb_decode_state = ERB_State::init;
+			statsResync();
 
 		} else {
 			buff_ptr[_erb_buff_cnt ++] = b;
@@ -260,9 +268,11 @@ GPSDriverEmlidReach::erbParseChar(uint8_t b)
 
 		if (cka == _erb_checksum.ck_a && ckb == _erb_checksum.ck_b) {
 			ret = 1;
+			statsFrameDone(_erb_payload_len + ERB_HEADER_LEN + sizeof(erb_checksum_t));
 
 		} else {
 			ret = 0;
+			statsChecksumError();
 		}
 
 		_erb_decode_state = ERB_State::init;
@@ -302,6 +312,7 @@ GPSDriverEmlidReach::handleErbSentence()
 		_gps_position->fix_type = _fix_type;
 
 		_POS_received = true;
+		statsPositionFrame();
 
 	} else if (_erb_buff.header.id == ERB_ID_NAV_STATUS) {
 
@@ -352,6 +363,7 @@ GPSDriverEmlidReach::handleErbSentence()
 		_rate_count_vel++;
 
 		_VEL_received = true;
+		statsPositionFrame();
 
 	} else if (_erb_buff.header.id == ERB_ID_SPACE_INFO) {
 
@@ -366,6 +378,7 @@ GPSDriverEmlidReach::handleErbSentence()
 	    && _POS_received && _VEL_received
 	    && _last_POS_timeGPS == _last_VEL_timeGPS) {
 		ret = 1;
+		statsUpdate();
 		_POS_received = false;
 		_VEL_received = false;
 	}
@@ -147,6 +147,7 @@ public:
 	virtual ~GPSDriverEmlidReach() = default;
 
 	int receive(unsigned timeout) override;
+	int feed(const uint8_t *buf, size_t buf_length) override;
 	int configure(unsigned &baudrate, const GPSConfig &config) override;
 
 private:
@@ -71,6 +71,9 @@
 #define FEMTO_ERR(...)			{GPS_WARN(__VA_ARGS__);}
 #endif
 
+static_assert(GPSHelper::staticPoolBlocks(sizeof(RTCMParsing)) <= GPS_STATIC_POOL_BLOCKS,
+	      "the static memory pool is too small for the Femtomes driver");
+
 
 GPSDriverFemto::GPSDriverFemto(GPSCallbackPtr callback, void *callback_user,
 			       struct sensor_gps_s *gps_position,
@@ -86,7 +89,7 @@ GPSDriverFemto::GPSDriverFemto(GPSCallbackPtr callback, void *callback_user,
 
 GPSDriverFemto::~GPSDriverFemto()
 {
-	delete _rtcm_parsing;
+	destroyBuffer(_rtcm_parsing);
 }
 
 int GPSDriverFemto::handleMessage(int len)
@@ -136,10 +139,12 @@ int GPSDriverFemto::handleMessage(int len)
 		}
 
 		_gps_position->timestamp = gps_absolute_time();
+		statsPositionFrame();
+		statsUpdate();
 
 		ret = 1;
 
-	} else if (_satellite_info && messageid == FEMTO_MSG_ID_UAVSTATUS) {	/**< set satellite info */
+	} else if (_satellite_info && satelliteInfoEnabled() && messageid == FEMTO_MSG_ID_UAVSTATUS) {	/**< set satellite info */
 		const femto_uav_status_t *uav_status = (const femto_uav_status_t *)_femto_msg.data;
 
 		_satellite_info->count = MIN(uav_status->sat_number, satellite_info_s::SAT_INFO_MAX_SATELLITES);
@@ -246,22 +251,18 @@ void GPSDriverFemto::receiveWait(unsigned timeout_min)
 
 int GPSDriverFemto::receive(unsigned timeout)
 {
-	uint8_t buf[GPS_READ_BUFFER_SIZE];
-
 	/* timeout additional to poll */
 	uint64_t time_started = gps_absolute_time();
-	int j = 0;
-	int bytes_count = 0;
 
 	while (true) {
 
-		/* pass received bytes to the packet decoder */
-		while (j < bytes_count) {
-			int l = 0;
+		/* pass received bytes to the packet decoder, starting with what the last call left over */
+		while (_read_buffer_pos < _read_buffer_bytes) {
+			int l = parseChar(_read_buffer[_read_buffer_pos++]);
 
-			if ((l = parseChar(buf[j])) > 0) {
+			if (l > 0) {
 				/* return to configure during configuration or to the gps driver during normal work
-				 * if a packet has arrived */
+				 * if a packet has arrived. The rest of the buffer is handled by the next call. */
 				int ret = handleMessage(l);
 
 				if (ret > 0) {
@@ -269,15 +270,13 @@ int GPSDriverFemto::receive(unsigned timeout)
 					return ret;
 				}
 			}
-
-			j++;
 		}
 
 		/* everything is read */
-		j = bytes_count = 0;
+		_read_buffer_pos = _read_buffer_bytes = 0;
 
 		/* then poll or read for new data */
-		int ret = read(buf, sizeof(buf), timeout * 2);
+		int ret = read(_read_buffer, sizeof(_read_buffer), timeout * 2);
 
 		if (ret < 0) {
 			/* something went wrong when polling */
@@ -289,7 +288,8 @@ int GPSDriverFemto::receive(unsigned timeout)
 
 		} else {
 			/* if we have new data from GPS, go handle it */
-			bytes_count = ret;
+			_read_buffer_bytes = ret;
+			statsBytesReceived(ret);
 		}
 
 		/* in case we get crap from GPS or time out */
@@ -300,6 +300,27 @@ int GPSDriverFemto::receive(unsigned timeout)
 	}
 }
 
+int GPSDriverFemto::feed(const uint8_t *buf, size_t buf_length)
+{
+	int handled = 0;
+	statsBytesReceived(buf_length);
+
+	for (size_t i = 0; i < buf_length; i++) {
+		int l = parseChar(buf[i]);
+
+		if (l > 0) {
+			int ret = handleMessage(l);
+
+			if (ret > 0) {
+				_decode_state = FemtoDecodeState::pream_ble1;
+				handled |= ret;
+			}
+		}
+	}
+
+	return handled;
+}
+
 #define HEXDIGIT_CHAR(d) ((char)((d) + (((d) < 0xA) ? '0' : 'A'-0xA)))
 
 int GPSDriverFemto::parseChar(uint8_t temp)
@@ -313,6 +334,7 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 			if (temp == FEMTO_PREAMBLE1) {
 				_decode_state = FemtoDecodeState::pream_ble2;
 				_femto_msg.read = 0;
+				statsFrameStart();
 			}
 
 			break;
@@ -323,6 +345,7 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 
 			} else {
 				_decode_state = FemtoDecodeState::pream_ble1;
+				statsResync();
 			}
 
 			break;
@@ -333,6 +356,7 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 
 			} else {
 				_decode_state = FemtoDecodeState::pream_ble1;
+				statsResync();
 			}
 
 			break;
@@ -350,6 +374,7 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 		case FemtoDecodeState::head_data:
 			if (_femto_msg.read >= sizeof(_femto_msg.header.data)) {
 				_decode_state = FemtoDecodeState::pream_ble1;
+				statsResync();
 				break;
 			}
 
@@ -365,6 +390,7 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 		case FemtoDecodeState::data:
 			if (_femto_msg.read >= FEMTO_MSG_MAX_LENGTH) {
 				_decode_state = FemtoDecodeState::pream_ble1;
+				statsResync();
 				break;
 			}
 
@@ -402,9 +428,11 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 
 				if (_femto_msg.crc == crc) {
 					iRet = _femto_msg.read;
+					statsFrameDone(_femto_msg.read + 4);
 
 				} else {
 					FEMTO_DEBUG("Femto: data packet is bad");
+					statsChecksumError();
 				}
 			}
 			break;
@@ -421,6 +449,7 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 				_decode_state = FemtoDecodeState::pream_nmea_got_sync1;
 				_femto_msg.read = 0;
 				_femto_msg.data[_femto_msg.read++] = temp;
+				statsFrameStart();
 
 			} else if (temp == RTCM3_PREAMBLE && _rtcm_parsing) {
 				_decode_state = FemtoDecodeState::decode_rtcm3;
@@ -433,6 +462,8 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 			if (temp == '$') {
 				_decode_state = FemtoDecodeState::pream_nmea_got_sync1;
 				_femto_msg.read = 0;
+				statsResync();
+				statsFrameStart();
 
 			} else if (temp == '*') {
 				_decode_state = FemtoDecodeState::pream_nmea_got_asteriks;
@@ -446,6 +477,7 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 				FEMTO_DEBUG("buffer overflow")
 				_decode_state = FemtoDecodeState::pream_ble1;
 				_femto_msg.read = 0;
+				statsResync();
 
 			} else {
 				_femto_msg.data[_femto_msg.read++] = temp;
@@ -473,6 +505,10 @@ int GPSDriverFemto::parseChar(uint8_t temp)
 					iRet = _femto_msg.read;
 					_femto_msg.header.femto_header.messageid = FEMTO_MSG_ID_GPGGA;
 					FEMTO_DEBUG("Femto: got NMEA message with length %i", _femto_msg.read)
+					statsFrameDone(_femto_msg.read + 2); // and the CR LF that follows
+
+				} else {
+					statsChecksumError();
 				}
 
 				decodeInit();
@@ -505,7 +541,7 @@ void GPSDriverFemto::decodeInit()
 	/** init or reset rtcm parsing */
 	if (_output_mode == OutputMode::RTCM) {
 		if (!_rtcm_parsing) {
-			_rtcm_parsing = new RTCMParsing();
+			_rtcm_parsing = createBuffer<RTCMParsing>();
 		}
 
 		if (_rtcm_parsing) {
@@ -547,6 +583,15 @@ int GPSDriverFemto::configure(unsigned &baudrate, const GPSConfig &config)
 	_output_mode = config.output_mode;
 	_configure_done = false;
 	_correction_output_activated = false;
+
+	// the RTCM output is parsed in a buffer of the memory pool, without it there is no RTCM
+	decodeInit();
+
+	if (!_rtcm_parsing && (_output_mode == OutputMode::RTCM)) {
+		FEMTO_ERR("no memory for the RTCM parser");
+		return -1;
+	}
+
 	/** Try different baudrates (115200 is the default for Femtomes) and request the baudrate that we want.	 */
 	const unsigned baudrates_to_try[] = {115200};
 	bool success = false;
@@ -172,6 +172,7 @@ public:
 	virtual ~GPSDriverFemto();
 
 	int receive(unsigned timeout) override;
+	int feed(const uint8_t *buf, size_t buf_length) override;
 	int configure(unsigned &baudrate, const GPSConfig &config) override;
 
 private:
@@ -223,6 +224,9 @@ private:
 	FemtoDecodeState		_decode_state{FemtoDecodeState::pream_ble1};
 	femto_uav_gps_t			_femto_uav_gps;
 	femto_msg_t 			_femto_msg;
+	uint8_t					_read_buffer[GPS_READ_BUFFER_SIZE] {};	///< last read, kept across receive() calls
+	uint16_t				_read_buffer_pos{0};	///< next byte to parse in _read_buffer
+	uint16_t				_read_buffer_bytes{0};
 	satellite_info_s        *_satellite_info{nullptr};
 	float 					_heading_offset;
 
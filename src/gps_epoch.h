@@ -0,0 +1,263 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file gps_epoch.h
+ *
+ * Assembly of the messages a receiver sends for a navigation epoch into one update.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Tracks which parts of an epoch the driver has handled, keyed on the epoch's time of week.
+ *
+ * An epoch is complete at the receiver's end-of-epoch marker (e.g. UBX NAV-EOE, SBF EndOfPVT), so
+ * the update includes every message of the epoch. Until a marker has been seen, or if markers
+ * stop, an epoch is complete as soon as it has the required parts. A message of a new epoch
+ * abandons an incomplete one, so an update never pairs the parts of different epochs.
+ *
+ * If the driver parses several epochs before it returns, one update is returned for them. The
+ * parts of an epoch that started after the completed one are kept for the next update.
+ */
+class GPSEpochAssembler
+{
+public:
+	enum Part : uint8_t {
+		Position = 1 << 0,
+		Velocity = 1 << 1,
+		Accuracy = 1 << 2,	///< velocity covariance
+		DOP = 1 << 3
+	};
+
+	/**
+	 * @param required parts that complete an epoch without end-of-epoch markers
+	 */
+	explicit GPSEpochAssembler(uint8_t required) : _required(required) {}
+
+	/**
+	 * A message with parts of an epoch was handled
+	 * @param epoch time of week of the message [ms]
+	 * @return true if the epoch is complete
+	 */
+	bool add(uint32_t epoch, uint8_t parts)
+	{
+		if (epoch != _epoch) {
+			if (_parts != 0 && !epochComplete()) {
+				if (hasRequired()) {
+					// the marker of the last epoch was missed, the receiver stopped sending them
+					_end_markers = false;
+				}
+
+				_abandoned++;
+			}
+
+			_epoch = epoch;
+			_parts = 0;
+			_returned = false;
+
+		} else if (_returned) {
+			// a message after the update of its epoch, e.g. before the first marker
+			return _complete;
+		}
+
+		_parts |= parts;
+
+		if (!_end_markers && hasRequired()) {
+			setComplete();
+		}
+
+		return _complete;
+	}
+
+	/**
+	 * End-of-epoch marker
+	 * @param epoch time of week of the marker [ms]
+	 * @return true if the epoch is complete
+	 */
+	bool end(uint32_t epoch)
+	{
+		_end_markers = true;
+
+		if (epoch != _epoch || _returned) {
+			return _complete;
+		}
+
+		if (hasRequired()) {
+			setComplete();
+
+		} else if (_parts != 0 && !epochComplete()) {
+			_abandoned++;
+			_parts = 0;
+		}
+
+		return _complete;
+	}
+
+	/**
+	 * @return true if an update is ready
+	 */
+	bool complete() const { return _complete; }
+
+	/**
+	 * @return true if the parts of an epoch have been handled, but it isn't complete yet
+	 */
+	bool pending() const { return _parts != 0 && !epochComplete(); }
+
+	/**
+	 * The update has been returned, start the next epoch. An epoch that started after the
+	 * completed one keeps its parts.
+	 */
+	void reset()
+	{
+		_complete = false;
+
+		if (_epoch == _completed_epoch) {
+			_parts = 0;
+			_returned = true;
+		}
+	}
+
+	/**
+	 * @return time of week of the last epoch with parts handled [ms]
+	 */
+	uint32_t epoch() const { return _epoch; }
+
+	/**
+	 * @return time of week of the last complete epoch [ms]
+	 */
+	uint32_t completedEpoch() const { return _completed_epoch; }
+
+	/**
+	 * @return true once the receiver sent an end-of-epoch marker, until one is missed
+	 */
+	bool endMarkers() const { return _end_markers; }
+
+	/**
+	 * @return number of epochs abandoned without the required parts
+	 */
+	uint32_t abandoned() const { return _abandoned; }
+
+private:
+	bool hasRequired() const { return (_parts & _required) == _required; }
+
+	bool epochComplete() const { return _complete && _completed_epoch == _epoch; }
+
+	void setComplete()
+	{
+		_complete = true;
+		_completed_epoch = _epoch;
+	}
+
+	const uint8_t _required;
+	uint8_t _parts{0};
+	bool _complete{false};
+	bool _end_markers{false};
+	bool _returned{false};			///< the update of _epoch has been returned
+	uint32_t _epoch{0};
+	uint32_t _completed_epoch{0};		///< the epoch _complete is set for
+	uint32_t _abandoned{0};
+};
+
+/**
+ * Keeps the report of an update that completed in the middle of a read, while the driver decodes
+ * the rest of the read into the report as usual. The messages of the next epoch that follow in
+ * the same read therefore don't overwrite the update before it is returned: release() swaps the
+ * held update back in, and resume() continues with the next epoch on the next read.
+ *
+ * The first update that completes in a read is returned. Fields the caller changes in the report
+ * after it is returned are overwritten by resume() if an update was held.
+ */
+template<typename T>
+class GPSReportHold
+{
+public:
+	/**
+	 * An update is complete and more of the read follows. Only the first one of a read is held.
+	 * @param report the update
+	 * @param epoch time of the update [ms], e.g. its time of week, returned by release()
+	 */
+	void hold(const T &report, uint32_t epoch = 0)
+	{
+		if (_state == State::Idle) {
+			_report = report;
+			_epoch = epoch;
+			_state = State::Held;
+		}
+	}
+
+	/**
+	 * The update is returned: put the held one in the report, keep what was decoded after it
+	 * @param report the report the caller publishes
+	 * @param epoch set to the time of the returned update if one was held, nullptr if not needed
+	 */
+	void release(T &report, uint32_t *epoch = nullptr)
+	{
+		if (_state == State::Held) {
+			const T next = report;
+			report = _report;
+			_report = next;
+
+			if (epoch) {
+				*epoch = _epoch;
+			}
+
+			_state = State::Released;
+		}
+	}
+
+	/**
+	 * Before the next read is decoded: continue with what was decoded after the returned update
+	 */
+	void resume(T &report)
+	{
+		if (_state == State::Released) {
+			report = _report;
+		}
+
+		_state = State::Idle;
+	}
+
+private:
+	enum class State : uint8_t {
+		Idle,
+		Held,		///< the update is in _report
+		Released	///< the update is returned, _report has what was decoded after it
+	};
+
+	T _report{};
+	uint32_t _epoch{0};
+	State _state{State::Idle};
+};
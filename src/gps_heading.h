@@ -0,0 +1,182 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file gps_heading.h
+ *
+ * Alignment of a moving baseline (dual antenna) heading with the position epochs of the rover.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#ifndef GPS_HEADING_MAX_AGE
+#define GPS_HEADING_MAX_AGE	500	///< ms, no heading is published for a position epoch this far from the last one
+#endif
+
+
+/**
+ * Keeps the last two headings of a moving baseline (e.g. UBX NAV-RELPOSNED, Unicore UNIHEADINGA)
+ * with their measurement times and gives the heading at the time of a position epoch: the one of
+ * the same epoch, interpolated if the epoch is between the two, or extrapolated by up to one heading
+ * interval if the epoch's heading isn't there yet (it arrives after the position, or the rates differ).
+ * The driver writes it into the position update, so heading and position are of the same time and
+ * published together.
+ *
+ * Times are in ms and wrap at a period, e.g. a week for the GPS time of week.
+ */
+class GPSHeadingAligner
+{
+public:
+	/**
+	 * @param period the times wrap at [ms]
+	 */
+	explicit GPSHeadingAligner(uint32_t period) : _period(period) {}
+
+	/**
+	 * A heading was measured
+	 * @param time measurement time [ms], in [0, period)
+	 * @param heading [rad], in [-pi, pi]
+	 * @param accuracy [rad]
+	 */
+	void add(uint32_t time, float heading, float accuracy)
+	{
+		if (_count == 0 || time != _samples[1].time) {
+			_samples[0] = _samples[1];
+
+			if (_count < 2) {
+				_count++;
+			}
+		}
+
+		_samples[1] = Sample{time, heading, accuracy};
+	}
+
+	/**
+	 * Heading at the time of a position epoch
+	 * @param time of the epoch [ms], in the time base of add()
+	 * @param heading [rad], in [-pi, pi]
+	 * @param accuracy [rad], the larger one of the headings it's interpolated from
+	 * @return false if there is no heading within GPS_HEADING_MAX_AGE of the epoch
+	 */
+	bool headingAt(uint32_t time, float &heading, float &accuracy) const
+	{
+		if (_count == 0) {
+			return false;
+		}
+
+		const Sample &last = _samples[1];
+		const int32_t since_last = elapsed(last.time, time);
+
+		if (since_last < -GPS_HEADING_MAX_AGE || since_last > GPS_HEADING_MAX_AGE) {
+			return false;
+		}
+
+		heading = last.heading;
+		accuracy = last.accuracy;
+
+		if (since_last == 0 || _count < 2) {
+			return true;
+		}
+
+		const Sample &previous = _samples[0];
+		const int32_t interval = elapsed(previous.time, last.time);
+		const int32_t since_previous = elapsed(previous.time, time);
+
+		if (interval <= 0 || interval > GPS_HEADING_MAX_AGE || since_last > interval) {
+			// too far from the previous heading to extrapolate, hold the last one
+			return true;
+		}
+
+		if (since_previous <= 0) {
+			heading = previous.heading;
+			accuracy = previous.accuracy;
+			return true;
+		}
+
+		const float fraction = (float)since_previous / (float)interval;	// in (0, 2]
+		heading = wrapPi(previous.heading + fraction * wrapPi(last.heading - previous.heading));
+		accuracy = previous.accuracy > last.accuracy ? previous.accuracy : last.accuracy;
+		return true;
+	}
+
+	/**
+	 * @return true once a heading was measured
+	 */
+	bool valid() const { return _count > 0; }
+
+	void reset() { _count = 0; }
+
+private:
+	struct Sample {
+		uint32_t time;
+		float heading;
+		float accuracy;
+	};
+
+	/**
+	 * @return to - from [ms], in [-period / 2, period / 2)
+	 */
+	int32_t elapsed(uint32_t from, uint32_t to) const
+	{
+		int64_t diff = (int64_t)to - (int64_t)from;
+
+		if (diff >= (int64_t)(_period / 2)) {
+			diff -= _period;
+
+		} else if (diff < -(int64_t)(_period / 2)) {
+			diff += _period;
+		}
+
+		return (int32_t)diff;
+	}
+
+	static float wrapPi(float angle)
+	{
+		const float pi = 3.14159265f;
+
+		if (angle > pi) {
+			return angle - 2.f * pi;
+
+		} else if (angle < -pi) {
+			return angle + 2.f * pi;
+		}
+
+		return angle;
+	}
+
+	const uint32_t _period;
+	Sample _samples[2] {};		///< previous and last heading
+	uint8_t _count{0};
+};
@@ -32,6 +32,7 @@
  ****************************************************************************/
 
 #include "gps_helper.h"
+#include "protocol_demux.h"
 #include <math.h>
 
 #ifndef M_PI
@@ -46,6 +47,18 @@
  * @author Julian Oes <julian@oes.ch>
  */
 
+static_assert(GPSHelper::staticPoolBlocks(sizeof(ProtocolDemux)) <= GPS_STATIC_POOL_BLOCKS,
+	      "the static memory pool is too small for the baudrate detection");
+
+// zero initialized storage, in .bss
+static GPSBlockPool<GPS_STATIC_POOL_BLOCKS, GPS_STATIC_POOL_BLOCK_SIZE>::Block gps_static_pool_blocks[GPS_STATIC_POOL_BLOCKS];
+static GPSBlockPool<GPS_STATIC_POOL_BLOCKS, GPS_STATIC_POOL_BLOCK_SIZE> gps_static_pool{gps_static_pool_blocks};
+
+GPSMemoryPool &GPSHelper::staticMemoryPool()
+{
+	return gps_static_pool;
+}
+
 GPSHelper::GPSHelper(GPSCallbackPtr callback, void *callback_user) :
 	_callback(callback),
 	_callback_user(callback_user)
@@ -67,37 +80,158 @@ GPSHelper::storeUpdateRates()
 	_rate_lat_lon = _rate_count_lat_lon / (((float)(gps_absolute_time() - _interval_rate_start)) / 1000000.0f);
 }
 
-void GPSHelper::ECEF2lla(double ecef_x, double ecef_y, double ecef_z, double &latitude, double &longitude,
-			 float &altitude)
+static void ignoreFrame(ProtocolDemux::Protocol, const uint8_t *, size_t, void *)
+{
+}
+
+unsigned
+GPSHelper::detectBaudrate(const unsigned *baudrates, unsigned count, uint8_t protocols, int listen_time)
+{
+	// only needed while configuring, so it's not kept in the driver
+	ProtocolDemux *demux = createBuffer<ProtocolDemux>(ignoreFrame, nullptr, protocols);
+
+	if (!demux) {
+		return 0;
+	}
+
+	uint8_t buf[GPS_READ_BUFFER_SIZE];
+	unsigned detected = 0;
+
+	for (unsigned i = 0; i < count && detected == 0; i++) {
+		if (setBaudrate((int)baudrates[i]) != 0) {
+			continue;
+		}
+
+		demux->reset();
+		size_t bytes = 0;
+		// at low baudrates, take the time to receive a few frames
+		const gps_abstime wire_time = (gps_abstime)GPS_BAUDRATE_DETECT_BYTES / 2 * 10 * 1000000 / baudrates[i];
+		const gps_abstime end = gps_absolute_time() + (gps_abstime)listen_time * 1000 + wire_time;
+		gps_abstime now;
+
+		while (bytes < GPS_BAUDRATE_DETECT_BYTES && (now = gps_absolute_time()) < end) {
+			const int ret = read(buf, sizeof(buf), (int)((end - now + 999) / 1000));
+
+			if (ret < 0) {
+				break;
+			}
+
+			bytes += (size_t)ret;
+			demux->addBytes(buf, (size_t)ret);
+			// noise passes the 8 bit NMEA checksum more easily than the 16+ bit checksums of the binary frames
+			uint32_t frames = demux->frameCount(ProtocolDemux::Protocol::NMEA);
+
+			for (unsigned p = 0; p < (unsigned)ProtocolDemux::Protocol::Count; p++) {
+				if (p != (unsigned)ProtocolDemux::Protocol::NMEA) {
+					frames += 2 * demux->frameCount((ProtocolDemux::Protocol)p);
+				}
+			}
+
+			if (frames >= GPS_BAUDRATE_DETECT_FRAMES) {
+				detected = baudrates[i];
+				break;
+			}
+		}
+
+		if (bytes == 0) {
+			// the line is idle, the receiver has to be probed
+			break;
+		}
+	}
+
+	destroyBuffer(demux);
+	return detected;
+}
+
+#ifdef GPS_LATENCY_STATS
+void GPSHelper::statsUpdate()
+{
+	const gps_abstime now = gps_absolute_time();
+	const uint32_t parse_us = (uint32_t)(now - _stats_bytes_time);
+	_latency_stats.updates++;
+	_latency_stats.parse_us = parse_us;
+	_latency_stats.parse_max_us = parse_us > _latency_stats.parse_max_us ? parse_us : _latency_stats.parse_max_us;
+	_latency_stats.parse_sum_us += parse_us;
+
+	if (!_stats_update_open) {
+		// the driver didn't tell which frames the update came from
+		_latency_stats.update_first_byte = _stats_bytes_time;
+	}
+
+	const uint32_t latency_us = (uint32_t)(now - _latency_stats.update_first_byte);
+	_latency_stats.latency_us = latency_us;
+	_latency_stats.latency_max_us = latency_us > _latency_stats.latency_max_us ? latency_us : _latency_stats.latency_max_us;
+	_latency_stats.latency_sum_us += latency_us;
+	_stats_update_open = false;
+}
+#endif
+
+/**
+ * Bowring's closed form of the ECEF to LLA conversion, with the sines and cosines of the auxiliary
+ * angles taken from their tangents instead of trig calls. ITERATE refines the latitude with a
+ * fixed point step of tan(lat) = (z + e^2 N sin(lat)) / p.
+ */
+template<bool ITERATE>
+static inline void ecef2lla(double x, double y, double z, double &latitude, double &longitude, float &altitude)
 {
 	// WGS84 ellipsoid constants
-	constexpr double a = 6378137.; // radius
-	constexpr double e = 8.1819190842622e-2;  // eccentricity
-
-	constexpr double asq = a * a;
-	constexpr double esq = e * e;
-
-	double x = ecef_x;
-	double y = ecef_y;
-	double z = ecef_z;
-
-	double b = sqrt(asq * (1. - esq));
-	double bsq = b * b;
-	double ep = sqrt((asq - bsq) / bsq);
-	double p = sqrt(x * x + y * y);
-	double th = atan2(a * z, b * p);
-
-	longitude = atan2(y, x);
-	double sin_th = sin(th);
-	double cos_th = cos(th);
-	latitude = atan2(z + ep * ep * b * sin_th * sin_th * sin_th, p - esq * a * cos_th * cos_th * cos_th);
-	double sin_lat = sin(latitude);
-	double N = a / sqrt(1. - esq * sin_lat * sin_lat);
-	altitude = (float)(p / cos(latitude) - N);
-
-	// rad to deg
-	longitude *= 180. / M_PI;
-	latitude *= 180. / M_PI;
-
-	// correction for altitude near poles left out.
+	constexpr double a = 6378137.; // semi-major axis
+	constexpr double b = 6356752.314245179; // semi-minor axis
+	constexpr double esq = 1. - (b * b) / (a * a); // eccentricity squared
+	constexpr double epsq = (a * a) / (b * b) - 1.; // second eccentricity squared
+
+	const double p = sqrt(x * x + y * y);
+
+	// auxiliary angle th = atan2(a * z, b * p)
+	const double th_y = a * z;
+	const double th_x = b * p;
+	const double th_r = sqrt(th_y * th_y + th_x * th_x);
+	const double sin_th = th_r > 0. ? th_y / th_r : 0.;
+	const double cos_th = th_r > 0. ? th_x / th_r : 0.;
+
+	double lat_y = z + epsq * b * sin_th * sin_th * sin_th;
+	double lat_x = p - esq * a * cos_th * cos_th * cos_th;
+	double lat_r = sqrt(lat_y * lat_y + lat_x * lat_x);
+
+	if (ITERATE) {
+		const double sin_lat = lat_r > 0. ? lat_y / lat_r : 0.;
+		const double N = a / sqrt(1. - esq * sin_lat * sin_lat);
+		lat_y = z + esq * N * sin_lat;
+		lat_x = p;
+		lat_r = sqrt(lat_y * lat_y + lat_x * lat_x);
+	}
+
+	const double sin_lat = lat_r > 0. ? lat_y / lat_r : 0.;
+	const double cos_lat = lat_r > 0. ? lat_x / lat_r : 1.;
+
+	// distance to the ellipsoid along its normal, unlike p / cos(lat) - N also valid at the poles
+	altitude = (float)(p * cos_lat + z * sin_lat - a * sqrt(1. - esq * sin_lat * sin_lat));
+	latitude = atan2(lat_y, lat_x) * (180. / M_PI);
+	longitude = atan2(y, x) * (180. / M_PI);
+}
+
+void GPSHelper::ECEF2lla(double ecef_x, double ecef_y, double ecef_z, double &latitude, double &longitude,
+			 float &altitude, ECEFAccuracy accuracy)
+{
+	if (accuracy == ECEFAccuracy::High) {
+		ecef2lla<true>(ecef_x, ecef_y, ecef_z, latitude, longitude, altitude);
+
+	} else {
+		ecef2lla<false>(ecef_x, ecef_y, ecef_z, latitude, longitude, altitude);
+	}
+}
+
+void GPSHelper::ECEF2lla(const double *ecef_x, const double *ecef_y, const double *ecef_z, size_t n, double *latitude,
+			 double *longitude, float *altitude, ECEFAccuracy accuracy)
+{
+	if (accuracy == ECEFAccuracy::High) {
+		for (size_t i = 0; i < n; i++) {
+			ecef2lla<true>(ecef_x[i], ecef_y[i], ecef_z[i], latitude[i], longitude[i], altitude[i]);
+		}
+
+	} else {
+		for (size_t i = 0; i < n; i++) {
+			ecef2lla<false>(ecef_x[i], ecef_y[i], ecef_z[i], latitude[i], longitude[i], altitude[i]);
+		}
+	}
 }
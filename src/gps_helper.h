@@ -41,12 +41,25 @@
 
 #include <cstdint>
 #include <cstring>
+#include <new>
 #include "../../definitions.h"
+#include "gps_memory_pool.h"
 
 #ifndef GPS_READ_BUFFER_SIZE
 #define GPS_READ_BUFFER_SIZE 150 ///< buffer size for the read() call. Messages can be longer than that.
 #endif
 
+#ifndef GPS_STATIC_POOL_BLOCK_SIZE
+#define GPS_STATIC_POOL_BLOCK_SIZE 1056 ///< bytes per block of the default memory pool, a multiple of alignof(std::max_align_t)
+#endif
+
+#ifndef GPS_STATIC_POOL_BLOCKS
+#define GPS_STATIC_POOL_BLOCKS 10 ///< blocks of the default memory pool: two drivers, a UBX driver holds up to 5 at once
+#endif
+
+#define GPS_BAUDRATE_DETECT_FRAMES	2	///< valid NMEA frames that identify the baudrate, a binary frame counts twice
+#define GPS_BAUDRATE_DETECT_BYTES	1024	///< bytes without a valid frame after which a baudrate is given up
+
 #ifndef M_PI_F
 # define M_PI_F 3.14159265358979323846f
 #endif
@@ -80,7 +93,7 @@ enum class GPSCallbackType {
 
 	/**
 	 * Got an RTCM message from the device.
-	 * data1: pointer to the message
+	 * data1: pointer to the message (read-only, valid for the duration of the callback)
 	 * data2: message length
 	 * return: ignored
 	 */
@@ -109,6 +122,27 @@ enum class GPSCallbackType {
 	 * return: ignored
 	 */
 	setClock,
+
+	/**
+	 * Read data from device, with the time the first byte was received (e.g. a kernel or DMA
+	 * timestamp). Only used in the GPSHelper::TimestampMode::FirstByteDevice mode, otherwise the
+	 * same as readDeviceData.
+	 * data1: points to a GPSTimestampedRead struct
+	 * data2: buffer length in bytes. Less bytes than this can be read.
+	 * return: num read bytes, 0 on timeout (the method can actually also return 0 before
+	 *         the timeout happens).
+	 */
+	readDeviceDataTimestamped,
+
+	/**
+	 * Got a frame of a message the driver passes on without decoding it, e.g. raw observations to
+	 * log (see GPSDriverUBX::setRawMessageClass()).
+	 * data1: pointer to the complete frame, from the sync bytes to the checksum (read-only, valid for
+	 *        the duration of the callback)
+	 * data2: frame length
+	 * return: ignored
+	 */
+	gotRawMessage,
 };
 
 enum class GPSRestartType {
@@ -138,6 +172,15 @@ enum class GPSRestartType {
 	Cold
 };
 
+/**
+ * Argument of GPSCallbackType::readDeviceDataTimestamped
+ */
+struct GPSTimestampedRead {
+	uint8_t *buf;			///< buffer to be written to
+	int timeout;			///< [ms]
+	gps_abstime timestamp;		///< set by the callback: reception of buf[0], 0 if unknown [us]
+};
+
 /** Callback function for platform-specific stuff.
  * data1 and data2 depend on type and user is the custom user-supplied argument.
  * @return <0 on error, >=0 on success (depending on type)
@@ -157,6 +200,35 @@ struct SurveyInStatus {
 // TODO: this number seems wrong
 #define GPS_EPOCH_SECS ((time_t)1234567890ULL)
 
+/**
+ * Parser timing and error counters of a driver, see GPSHelper::latencyStats().
+ * Only collected if the drivers are built with GPS_LATENCY_STATS defined.
+ *
+ * Byte arrival times are taken when the bytes are passed to the parser (when read() returns or
+ * feed() is called), so the latency includes the time spent parsing and waiting for the other
+ * messages of an update (e.g. NAV-POSLLH and NAV-VELNED), but not the UART and driver buffering
+ * before the read.
+ */
+struct GPSLatencyStats {
+	uint32_t bytes_received;	///< bytes passed to the parser
+	uint32_t bytes_framed;		///< bytes in frames with a valid checksum, including RTCM
+	uint32_t frames;		///< frames with a valid checksum, including RTCM
+	uint32_t checksum_errors;	///< frames dropped because of a checksum mismatch
+	uint32_t resyncs;		///< frames dropped before their checksum (bad header or length, overflow)
+	uint32_t updates;		///< published position updates
+
+	gps_abstime update_first_byte;	///< arrival of the first byte of the last update's first position message [us]
+	uint32_t latency_us;		///< first byte to publish of the last update [us]
+	uint32_t latency_max_us;
+	uint64_t latency_sum_us;	///< divide by updates for the mean
+	uint32_t parse_us;		///< arrival of the last bytes to publish of the last update [us]
+	uint32_t parse_max_us;
+	uint64_t parse_sum_us;		///< divide by updates for the mean
+
+	/** bytes outside of valid frames so far, including the frame being received */
+	uint32_t bytesDiscarded() const { return bytes_received - bytes_framed; }
+};
+
 class GPSHelper
 {
 public:
@@ -194,6 +266,23 @@ public:
 		I2C_OUT_PROT_RTCM3X = 1 << 5
 	};
 
+	/**
+	 * Source of the position timestamps (sensor_gps_s::timestamp)
+	 */
+	enum class TimestampMode : uint8_t {
+		Parsed = 0,      ///< when the solution is parsed (default)
+		FirstByte,       ///< reception of the first byte of the solution, estimated from the read time and baudrate
+		FirstByteDevice  ///< reception of the first byte of the solution, using readDeviceDataTimestamped
+	};
+
+	/**
+	 * Accuracy of the ECEF to LLA conversion
+	 */
+	enum class ECEFAccuracy : uint8_t {
+		Fast = 0,        ///< closed form: error below 0.1 mm up to 100 km altitude, 5 cm at 20000 km
+		High             ///< plus one iteration of the latitude: below 0.1 mm at any altitude
+	};
+
 	struct GPSConfig {
 		OutputMode output_mode;
 		GNSSSystemsMask gnss_systems;
@@ -222,6 +311,19 @@ public:
 	 */
 	virtual int receive(unsigned timeout) = 0;
 
+	/**
+	 * handle data read from the device by the caller, as alternative to receive() for event driven
+	 * I/O where one thread serves several receivers. Never blocks and never reads from the device.
+	 * configure() still communicates through the callback. Don't mix with receive() on the same stream.
+	 * @param buf received data
+	 * @param buf_length number of bytes in buf
+	 * @return <0 if not supported by the driver, otherwise a bitset (the same as receive(), accumulated
+	 *         until a complete update is available):
+	 *         bit 0 set: got gps position update
+	 *         bit 1 set: got satellite info update
+	 */
+	virtual int feed(const uint8_t *buf, size_t buf_length) { (void)buf; (void)buf_length; return -1; }
+
 	/**
 	 * Reset GPS device
 	 * @param restart_type
@@ -241,8 +343,118 @@ public:
 	 */
 	virtual bool shouldInjectRTCM() { return true; }
 
+	/**
+	 * Select the source of the position timestamps. The first byte modes take the reception of the first
+	 * byte of the epoch's first position message (e.g. UBX NAV-PVT or NMEA GGA), which doesn't include the
+	 * serialization delay of the messages, so the timestamp doesn't depend on the baudrate and message mix.
+	 * Drivers without support keep timestamping when the solution is parsed.
+	 * The estimate of TimestampMode::FirstByte assumes the last byte of a read was received when the read
+	 * returned, so it's late by the driver's buffering time.
+	 */
+	void setTimestampMode(TimestampMode mode) { _timestamp_mode = mode; }
+	TimestampMode getTimestampMode() const { return _timestamp_mode; }
+
+	/**
+	 * Set the reception time of the first byte of the data passed to the next feed() call, e.g. from a
+	 * kernel or DMA timestamp. Without it, the time is estimated like in TimestampMode::FirstByte.
+	 * @param timestamp [us]
+	 */
+	void setReceiveTimestamp(gps_abstime timestamp) { _rx_pending_time = timestamp; }
+
+	/**
+	 * Decode the satellite info only while it is consumed, e.g. while a ground station shows it. Disabled,
+	 * the driver skips the satellite messages and doesn't report them in the result of receive(). The
+	 * receiver keeps sending them, so it can be enabled again any time. Only has an effect on drivers
+	 * created with a satellite_info_s buffer. Call from the thread that runs the driver.
+	 */
+	void setSatelliteInfoEnabled(bool enabled) { _satellite_info_enabled = enabled; }
+	bool satelliteInfoEnabled() const { return _satellite_info_enabled; }
+
+	/**
+	 * Take the driver's buffers from a pool instead of the default: a static GPSBlockPool shared by
+	 * all drivers, with GPS_STATIC_POOL_BLOCKS blocks of GPS_STATIC_POOL_BLOCK_SIZE bytes. Set it
+	 * before configure(), the pool must outlive the driver.
+	 */
+	void setMemoryPool(GPSMemoryPool *pool) { _memory_pool = pool; }
+
+	/**
+	 * @return the static pool the drivers use by default
+	 */
+	static GPSMemoryPool &staticMemoryPool();
+
+	/**
+	 * @return blocks of the static pool a buffer takes, for the drivers to check that theirs fit
+	 */
+	static constexpr unsigned staticPoolBlocks(size_t size)
+	{
+		return (unsigned)((size + GPS_STATIC_POOL_BLOCK_SIZE - 1) / GPS_STATIC_POOL_BLOCK_SIZE);
+	}
+
+	/**
+	 * Convert an ECEF (Earth Centered Earth Fixed) coordinate to LLA WGS84 (Lat, Lon, Alt).
+	 * Bowring's closed form, with the altitude valid at the poles as well.
+	 * @param ecef_x ECEF X-coordinate [m]
+	 * @param ecef_y ECEF Y-coordinate [m]
+	 * @param ecef_z ECEF Z-coordinate [m]
+	 * @param latitude [deg]
+	 * @param longitude [deg]
+	 * @param altitude [m]
+	 * @param accuracy ECEFAccuracy::High refines the latitude with one iteration
+	 */
+	static void ECEF2lla(double ecef_x, double ecef_y, double ecef_z, double &latitude, double &longitude, float &altitude,
+			     ECEFAccuracy accuracy = ECEFAccuracy::Fast);
+
+	/**
+	 * Convert n ECEF coordinates to LLA WGS84, e.g. to reprocess a log. The points are independent
+	 * and the conversion has no branches, so the loop vectorizes with a vector math library.
+	 * @param ecef_x, ecef_y, ecef_z ECEF coordinates [m]
+	 * @param latitude, longitude [deg]
+	 * @param altitude [m]
+	 */
+	static void ECEF2lla(const double *ecef_x, const double *ecef_y, const double *ecef_z, size_t n, double *latitude,
+			     double *longitude, float *altitude, ECEFAccuracy accuracy = ECEFAccuracy::Fast);
+
+#ifdef GPS_LATENCY_STATS
+	const GPSLatencyStats &latencyStats() const { return _latency_stats; }
+	void resetLatencyStats() { _latency_stats = GPSLatencyStats{}; }
+#endif
+
 protected:
 
+	/**
+	 * Construct a buffer in memory of the driver's pool
+	 * @return nullptr if the pool has no memory left
+	 */
+	template<typename T, typename... Args>
+	T *createBuffer(Args... args)
+	{
+		void *block = _memory_pool->allocate(sizeof(T));
+
+		if (!block) {
+			if (!_buffer_memory_warned) {
+				GPS_WARN("out of buffer memory");
+				_buffer_memory_warned = true;
+			}
+
+			return nullptr;
+		}
+
+		return new (block) T(args...);
+	}
+
+	/**
+	 * Destruct a buffer from createBuffer() and return its memory to the pool
+	 */
+	template<typename T>
+	void destroyBuffer(T *&buffer)
+	{
+		if (buffer) {
+			buffer->~T();
+			_memory_pool->release(buffer);
+			buffer = nullptr;
+		}
+	}
+
 	/**
 	 * read from device
 	 * @param buf: pointer to read buffer
@@ -254,6 +466,13 @@ protected:
 	 */
 	int read(uint8_t *buf, int buf_length, int timeout)
 	{
+		if (_timestamp_mode == TimestampMode::FirstByteDevice) {
+			GPSTimestampedRead request{buf, timeout, 0};
+			const int ret = _callback(GPSCallbackType::readDeviceDataTimestamped, &request, buf_length, _callback_user);
+			_rx_pending_time = ret > 0 ? request.timestamp : 0;
+			return ret;
+		}
+
 		memcpy(buf, &timeout, sizeof(timeout));
 		return _callback(GPSCallbackType::readDeviceData, buf, buf_length, _callback_user);
 	}
@@ -276,7 +495,13 @@ protected:
 	 */
 	int setBaudrate(int baudrate)
 	{
-		return _callback(GPSCallbackType::setBaudrate, nullptr, baudrate, _callback_user);
+		const int ret = _callback(GPSCallbackType::setBaudrate, nullptr, baudrate, _callback_user);
+
+		if (ret == 0) {
+			_byte_time_ns = baudrate > 0 ? (uint32_t)(10000000000ULL / (unsigned)baudrate) : 0;
+		}
+
+		return ret;
 	}
 
 	void surveyInStatus(SurveyInStatus &status)
@@ -285,9 +510,18 @@ protected:
 	}
 
 	/** got an RTCM message from the device */
-	void gotRTCMMessage(uint8_t *buf, int buf_length)
+	void gotRTCMMessage(const uint8_t *buf, int buf_length)
+	{
+		statsFrameDone(buf_length);
+		// the callback interface is not const-aware, but receivers must treat the message as read-only
+		_callback(GPSCallbackType::gotRTCMMessage, const_cast<uint8_t *>(buf), buf_length, _callback_user);
+	}
+
+	/** got a frame passed on without decoding it */
+	void gotRawMessage(const uint8_t *buf, int buf_length)
 	{
-		_callback(GPSCallbackType::gotRTCMMessage, buf, buf_length, _callback_user);
+		// the callback interface is not const-aware, but receivers must treat the frame as read-only
+		_callback(GPSCallbackType::gotRawMessage, const_cast<uint8_t *>(buf), buf_length, _callback_user);
 	}
 
 	/** got a relative position message from the device */
@@ -302,16 +536,110 @@ protected:
 	}
 
 	/**
-	 * Convert an ECEF (Earth Centered Earth Fixed) coordinate to LLA WGS84 (Lat, Lon, Alt).
-	 * Ported from: https://stackoverflow.com/a/25428344
-	 * @param ecef_x ECEF X-coordinate [m]
-	 * @param ecef_y ECEF Y-coordinate [m]
-	 * @param ecef_z ECEF Z-coordinate [m]
-	 * @param latitude [deg]
-	 * @param longitude [deg]
-	 * @param altitude [m]
+	 * Find the baudrate of a receiver that is already sending, by listening at each candidate for
+	 * frames with a valid checksum (see ProtocolDemux). Much faster than probing every baudrate with
+	 * a command and waiting for the reply to time out, but it needs traffic on the line: the detection
+	 * stops as soon as nothing at all is received at a baudrate, as a sending receiver produces
+	 * (garbage) bytes at any baudrate.
+	 * The baudrate is left at the detected one, or at the last candidate.
+	 * @param baudrates candidates, in the order to try them
+	 * @param count number of candidates
+	 * @param protocols ProtocolDemux protocol mask of the frames to look for
+	 * @param listen_time how long to listen at each baudrate [ms], plus the time half of
+	 *                    GPS_BAUDRATE_DETECT_BYTES take at the baudrate
+	 * @return detected baudrate, 0 if the line is idle or no frames were found
+	 */
+	unsigned detectBaudrate(const unsigned *baudrates, unsigned count, uint8_t protocols, int listen_time);
+
+	/**
+	 * Start of a chunk of received data, called by the drivers supporting the first byte timestamp
+	 * modes before they parse it (from feed() or after read()).
+	 * @param length number of bytes in the chunk
+	 */
+	void receivedData(size_t length)
+	{
+		if (_timestamp_mode == TimestampMode::Parsed) {
+			return;
+		}
+
+		if (_rx_pending_time != 0) {
+			_rx_chunk_time = _rx_pending_time;
+			_rx_pending_time = 0;
+
+		} else {
+			// assume the bytes arrived back-to-back, the last one just now (8N1: 10 bits per byte)
+			const gps_abstime wire_time = length > 0 ? (gps_abstime)(length - 1) * _byte_time_ns / 1000 : 0;
+			const gps_abstime now = gps_absolute_time();
+			_rx_chunk_time = now > wire_time ? now - wire_time : 0;
+		}
+	}
+
+	/**
+	 * A frame starts at the given byte of the chunk of the last receivedData() call:
+	 * remember its reception time as frameStartTime()
+	 * @param offset index of the frame's first byte in the chunk
 	 */
-	static void ECEF2lla(double ecef_x, double ecef_y, double ecef_z, double &latitude, double &longitude, float &altitude);
+	void frameStart(size_t offset)
+	{
+		if (_timestamp_mode != TimestampMode::Parsed) {
+			_rx_frame_time = _rx_chunk_time + (gps_abstime)offset * _byte_time_ns / 1000;
+		}
+	}
+
+	/**
+	 * Timestamp of a message in the current timestamp mode
+	 * @param first_byte_time reception of the message's first byte, frameStartTime() of its frame (0 if unknown)
+	 */
+	gps_abstime messageTimestamp(gps_abstime first_byte_time) const
+	{
+		return _timestamp_mode == TimestampMode::Parsed || first_byte_time == 0 ? gps_absolute_time() : first_byte_time;
+	}
+
+	gps_abstime frameStartTime() const { return _rx_frame_time; }
+
+	/*
+	 * Latency instrumentation, called by the drivers. Without GPS_LATENCY_STATS they compile to nothing.
+	 * statsBytesReceived(): bytes are passed to the parser
+	 * statsFrameStart(): a frame header or sync was found in the bytes of the last statsBytesReceived()
+	 * statsFrameDone(): a frame (or an RTCM message) passed its checksum
+	 * statsPositionFrame(): the current frame contributes to the next position update
+	 * statsChecksumError(), statsResync(): the current frame was dropped
+	 * statsUpdate(): a position update is published (bit 0 of receive() or feed())
+	 */
+#ifdef GPS_LATENCY_STATS
+	void statsBytesReceived(size_t length)
+	{
+		_latency_stats.bytes_received += (uint32_t)length;
+		_stats_bytes_time = gps_absolute_time();
+	}
+
+	void statsFrameStart() { _stats_frame_start = _stats_bytes_time; }
+	void statsFrameDone(int length) { _latency_stats.frames++; _latency_stats.bytes_framed += (uint32_t)length; }
+	void statsPositionFrame()
+	{
+		if (!_stats_update_open) {
+			_latency_stats.update_first_byte = _stats_frame_start;
+			_stats_update_open = true;
+		}
+	}
+
+	void statsChecksumError() { _latency_stats.checksum_errors++; }
+	void statsResync() { _latency_stats.resyncs++; }
+	void statsUpdate();
+
+	GPSLatencyStats _latency_stats{};
+	gps_abstime _stats_bytes_time{0};
+	gps_abstime _stats_frame_start{0};
+	bool _stats_update_open{false};
+#else
+	void statsBytesReceived(size_t) {}
+	void statsFrameStart() {}
+	void statsFrameDone(int) {}
+	void statsPositionFrame() {}
+	void statsChecksumError() {}
+	void statsResync() {}
+	void statsUpdate() {}
+#endif
 
 	GPSCallbackPtr _callback{nullptr};
 	void *_callback_user{};
@@ -323,6 +651,16 @@ protected:
 	float _rate_vel{0.0f};
 
 	uint64_t _interval_rate_start{0};
+
+	GPSMemoryPool *_memory_pool{&staticMemoryPool()};
+	bool _buffer_memory_warned{false};
+
+	TimestampMode _timestamp_mode{TimestampMode::Parsed};
+	bool _satellite_info_enabled{true};
+	uint32_t _byte_time_ns{0};		///< wire time of a byte at the current baudrate, 0 if unknown
+	gps_abstime _rx_pending_time{0};	///< reception of the next chunk's first byte, 0 if unknown
+	gps_abstime _rx_chunk_time{0};		///< reception of the current chunk's first byte
+	gps_abstime _rx_frame_time{0};		///< reception of the current frame's first byte
 };
 
 inline bool operator&(GPSHelper::GNSSSystemsMask a, GPSHelper::GNSSSystemsMask b)
@@ -0,0 +1,237 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file gps_manager.cpp
+ */
+
+#include "gps_manager.h"
+#include <math.h>
+
+#define GPS_MANAGER_EARTH_RADIUS	6378137.0	///< m, WGS84 semi-major axis
+#define GPS_MANAGER_DEG_1E7_TO_M	(GPS_MANAGER_EARTH_RADIUS * 3.14159265358979323846 / 180. * 1e-7)	///< m per 1e-7 deg of latitude
+
+GPSManager::~GPSManager()
+{
+	for (int i = 0; i < _num_receivers; i++) {
+		delete _receivers[i]->driver;
+		delete _receivers[i];
+	}
+}
+
+int GPSManager::addReceiver()
+{
+	if (_num_receivers >= GPS_MANAGER_MAX_RECEIVERS) {
+		return -1;
+	}
+
+	_receivers[_num_receivers] = new Receiver();
+	return _num_receivers++;
+}
+
+void GPSManager::setDriver(int instance, GPSHelper *driver)
+{
+	if (!validInstance(instance)) {
+		delete driver;
+		return;
+	}
+
+	delete _receivers[instance]->driver;
+	_receivers[instance]->driver = driver;
+}
+
+int GPSManager::receive(int instance, unsigned timeout)
+{
+	GPSHelper *gps_driver = driver(instance);
+
+	if (!gps_driver) {
+		return -1;
+	}
+
+	const int ret = gps_driver->receive(timeout);
+	publish(instance, ret);
+	return ret;
+}
+
+void GPSManager::publish(int instance, int updated)
+{
+	if (!validInstance(instance) || updated <= 0) {
+		return;
+	}
+
+	Receiver &receiver = *_receivers[instance];
+
+	if (updated & 1) {
+		receiver.gps_snapshot.publish(receiver.gps_position);
+	}
+
+	if (updated & 2) {
+		receiver.satellite_snapshot.publish(receiver.satellite_info);
+	}
+}
+
+bool GPSManager::readGpsPosition(int instance, sensor_gps_s &gps) const
+{
+	return validInstance(instance) && _receivers[instance]->gps_snapshot.read(gps);
+}
+
+bool GPSManager::readSatelliteInfo(int instance, satellite_info_s &satellite_info) const
+{
+	return validInstance(instance) && _receivers[instance]->satellite_snapshot.read(satellite_info);
+}
+
+uint32_t GPSManager::gpsPositionUpdates(int instance) const
+{
+	return validInstance(instance) ? _receivers[instance]->gps_snapshot.updates() : 0;
+}
+
+int GPSManager::readBlended(sensor_gps_s &gps) const
+{
+	sensor_gps_s fixes[GPS_MANAGER_MAX_RECEIVERS];
+	int num_fixes = 0;
+	gps_abstime newest = 0;
+
+	for (int i = 0; i < _num_receivers; i++) {
+		sensor_gps_s &fix = fixes[num_fixes];
+
+		if (readGpsPosition(i, fix) && fix.fix_type >= 3 && fix.eph > 0.f && fix.epv > 0.f) {
+			newest = fix.timestamp > newest ? fix.timestamp : newest;
+			num_fixes++;
+		}
+	}
+
+	// the best of the recent fixes is the reference, the others are blended as offsets to it
+	float weight_h[GPS_MANAGER_MAX_RECEIVERS];
+	float weight_v[GPS_MANAGER_MAX_RECEIVERS];
+	float weight_vel[GPS_MANAGER_MAX_RECEIVERS];
+	int num_blended = 0;
+	int best = 0;
+
+	for (int i = 0; i < num_fixes; i++) {
+		if (fixes[i].timestamp + GPS_MANAGER_BLEND_MAX_AGE < newest) {
+			continue;
+		}
+
+		fixes[num_blended] = fixes[i];
+		const sensor_gps_s &fix = fixes[num_blended];
+		weight_h[num_blended] = 1.f / (fix.eph * fix.eph);
+		weight_v[num_blended] = 1.f / (fix.epv * fix.epv);
+		weight_vel[num_blended] = fix.s_variance_m_s > 0.f ? 1.f / (fix.s_variance_m_s * fix.s_variance_m_s) :
+					  weight_h[num_blended];
+
+		if (weight_h[num_blended] > weight_h[best]) {
+			best = num_blended;
+		}
+
+		num_blended++;
+	}
+
+	if (num_blended == 0) {
+		return 0;
+	}
+
+	gps = fixes[best];
+
+	if (num_blended == 1) {
+		return 1;
+	}
+
+	const sensor_gps_s &reference = fixes[best];
+	const double lon_scale = cos((double)reference.lat * 1e-7 * M_DEG_TO_RAD_F);
+	double sum_h = 0., sum_v = 0., sum_vel = 0.;
+	double lat = 0., lon = 0., alt = 0., alt_ellipsoid = 0.;
+	double vel_n = 0., vel_e = 0., vel_d = 0.;
+
+	for (int i = 0; i < num_blended; i++) {
+		const sensor_gps_s &fix = fixes[i];
+		const double dt = ((double)reference.timestamp - (double)fix.timestamp) * 1e-6;
+		int64_t dlon = (int64_t)fix.lon - reference.lon;
+
+		if (dlon > 1800000000) {
+			dlon -= 3600000000;
+
+		} else if (dlon < -1800000000) {
+			dlon += 3600000000;
+		}
+
+		// moved to the time of the reference, in 1e-7 deg and mm
+		const double fix_lat = (double)((int64_t)fix.lat - reference.lat) + fix.vel_n_m_s * dt / GPS_MANAGER_DEG_1E7_TO_M;
+		const double fix_lon = (double)dlon + (lon_scale > 0.01 ? fix.vel_e_m_s * dt / (GPS_MANAGER_DEG_1E7_TO_M * lon_scale) : 0.);
+		const double fix_alt = (double)((int64_t)fix.alt - reference.alt) - fix.vel_d_m_s * dt * 1e3;
+		const double fix_alt_ellipsoid = (double)((int64_t)fix.alt_ellipsoid - reference.alt_ellipsoid) - fix.vel_d_m_s * dt *
+						 1e3;
+
+		lat += weight_h[i] * fix_lat;
+		lon += weight_h[i] * fix_lon;
+		sum_h += weight_h[i];
+		alt += weight_v[i] * fix_alt;
+		alt_ellipsoid += weight_v[i] * fix_alt_ellipsoid;
+		sum_v += weight_v[i];
+
+		if (fix.vel_ned_valid) {
+			vel_n += weight_vel[i] * fix.vel_n_m_s;
+			vel_e += weight_vel[i] * fix.vel_e_m_s;
+			vel_d += weight_vel[i] * fix.vel_d_m_s;
+			sum_vel += weight_vel[i];
+		}
+
+		gps.fix_type = fix.fix_type > gps.fix_type ? fix.fix_type : gps.fix_type;
+		gps.satellites_used = fix.satellites_used > gps.satellites_used ? fix.satellites_used : gps.satellites_used;
+	}
+
+	int64_t blended_lon = reference.lon + (int64_t)lround(lon / sum_h);
+
+	if (blended_lon > 1800000000) {
+		blended_lon -= 3600000000;
+
+	} else if (blended_lon < -1800000000) {
+		blended_lon += 3600000000;
+	}
+
+	gps.lat = (int32_t)(reference.lat + lround(lat / sum_h));
+	gps.lon = (int32_t)blended_lon;
+	gps.alt = (int32_t)(reference.alt + lround(alt / sum_v));
+	gps.alt_ellipsoid = (int32_t)(reference.alt_ellipsoid + lround(alt_ellipsoid / sum_v));
+
+	if (sum_vel > 0.) {
+		gps.vel_n_m_s = (float)(vel_n / sum_vel);
+		gps.vel_e_m_s = (float)(vel_e / sum_vel);
+		gps.vel_d_m_s = (float)(vel_d / sum_vel);
+		gps.vel_m_s = sqrtf(gps.vel_n_m_s * gps.vel_n_m_s + gps.vel_e_m_s * gps.vel_e_m_s);
+		gps.cog_rad = atan2f(gps.vel_e_m_s, gps.vel_n_m_s);
+		gps.vel_ned_valid = true;
+	}
+
+	gps.device_id = 0;
+	return num_blended;
+}
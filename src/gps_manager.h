@@ -0,0 +1,148 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file gps_manager.h
+ *
+ * Owner of several receivers' drivers, which publishes their solutions to readers on other threads
+ * and blends them into one.
+ */
+
+#pragma once
+
+#include "gps_helper.h"
+#include "gps_snapshot.h"
+#include "../../definitions.h"
+
+#ifndef GPS_MANAGER_MAX_RECEIVERS
+#define GPS_MANAGER_MAX_RECEIVERS	3
+#endif
+
+#ifndef GPS_MANAGER_BLEND_MAX_AGE
+#define GPS_MANAGER_BLEND_MAX_AGE	300000		///< us, solutions this much older than the newest one are not blended
+#endif
+
+
+/**
+ * The drivers write into buffers owned by the manager. After each update of a driver, the manager
+ * copies them into a GPSSnapshot, so readers get a consistent solution without locks.
+ *
+ * Setup, before any thread uses the manager:
+ *   int instance = manager.addReceiver();
+ *   manager.setDriver(instance, new GPSDriverUBX(..., manager.gpsPositionBuffer(instance),
+ *                     manager.satelliteInfoBuffer(instance)));
+ *
+ * Each driver is then configured and run by one thread with receive(instance, timeout), and any
+ * thread can read the solutions with readGpsPosition() and readBlended().
+ */
+class GPSManager
+{
+public:
+	GPSManager() = default;
+	~GPSManager();
+
+	GPSManager(const GPSManager &) = delete;
+	GPSManager &operator=(const GPSManager &) = delete;
+
+	/**
+	 * Add a receiver, its driver is created with the instance's buffers and set with setDriver()
+	 * @return instance, -1 if there are GPS_MANAGER_MAX_RECEIVERS already
+	 */
+	int addReceiver();
+
+	/**
+	 * @param driver writing into gpsPositionBuffer(instance) and satelliteInfoBuffer(instance).
+	 *               The manager deletes it.
+	 */
+	void setDriver(int instance, GPSHelper *driver);
+
+	GPSHelper *driver(int instance) const { return validInstance(instance) ? _receivers[instance]->driver : nullptr; }
+
+	/**
+	 * Outputs for the driver of an instance, only to be accessed by the thread running it
+	 */
+	sensor_gps_s *gpsPositionBuffer(int instance) { return validInstance(instance) ? &_receivers[instance]->gps_position : nullptr; }
+	satellite_info_s *satelliteInfoBuffer(int instance) { return validInstance(instance) ? &_receivers[instance]->satellite_info : nullptr; }
+
+	/**
+	 * Run the driver of an instance and publish its updates, from the thread running the driver
+	 * @return the driver's receive() result, -1 without driver
+	 */
+	int receive(int instance, unsigned timeout);
+
+	/**
+	 * Publish the updates of a driver the caller runs itself, e.g. with feed()
+	 * @param updated result of receive() or feed(): bit 0 publishes the position, bit 1 the satellite info
+	 */
+	void publish(int instance, int updated);
+
+	/**
+	 * Read the last solution of an instance, from any thread
+	 * @return false if there is none yet
+	 */
+	bool readGpsPosition(int instance, sensor_gps_s &gps) const;
+	bool readSatelliteInfo(int instance, satellite_info_s &satellite_info) const;
+
+	/**
+	 * @return number of solutions published by an instance
+	 */
+	uint32_t gpsPositionUpdates(int instance) const;
+
+	/**
+	 * Blend the last 3D fixes of all instances into one solution, from any thread. Positions are
+	 * weighted by the inverse of their variance (eph, epv), velocities by the speed accuracy.
+	 * Fixes older than GPS_MANAGER_BLEND_MAX_AGE relative to the newest are left out, the others
+	 * are moved to the time of the best one with their velocity.
+	 * The accuracies are those of the best instance, the blended errors are not independent.
+	 * @param gps blended solution, the best instance's for the fields that are not blended.
+	 *            device_id is 0 if more than one instance was blended.
+	 * @return number of instances blended, 0 if there is no 3D fix
+	 */
+	int readBlended(sensor_gps_s &gps) const;
+
+	int receivers() const { return _num_receivers; }
+
+private:
+	struct Receiver {
+		GPSHelper *driver{nullptr};
+		sensor_gps_s gps_position{};
+		satellite_info_s satellite_info{};
+		GPSSnapshot<sensor_gps_s> gps_snapshot;
+		GPSSnapshot<satellite_info_s> satellite_snapshot;
+	};
+
+	bool validInstance(int instance) const { return instance >= 0 && instance < _num_receivers; }
+
+	Receiver *_receivers[GPS_MANAGER_MAX_RECEIVERS] {};
+	int _num_receivers{0};
+};
@@ -0,0 +1,152 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file gps_memory_pool.h
+ *
+ * Memory for the buffers a driver only needs in some modes or while configuring, e.g. the RTCM
+ * parser and the baudrate detection, without using the heap.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The drivers take and return their buffers from their own thread, so an implementation shared by
+ * several drivers has to be thread-safe.
+ */
+class GPSMemoryPool
+{
+public:
+	virtual ~GPSMemoryPool() = default;
+
+	/**
+	 * @return memory of at least size bytes, aligned for any type. nullptr if there's none left.
+	 */
+	virtual void *allocate(size_t size) = 0;
+
+	/**
+	 * @param block from allocate() on the same thread
+	 */
+	virtual void release(void *block) = 0;
+};
+
+/**
+ * Fixed number of equally sized blocks in static memory. A buffer takes as many adjacent blocks as it
+ * needs, they are claimed with a compare and swap on a bitmask, so the time is bounded and the pool
+ * lock-free. Constant initialized, so it can be used by drivers in static constructors.
+ *
+ * The blocks are a separate plain array, so static storage for them is zero initialized (.bss) and
+ * takes no space in the image, unlike the pool object with its vtable pointer.
+ */
+template<unsigned BLOCKS, size_t BLOCK_SIZE>
+class GPSBlockPool : public GPSMemoryPool
+{
+public:
+	static_assert(BLOCKS > 0 && BLOCKS < 32, "the blocks are tracked in a 32 bit mask");
+	static_assert(BLOCK_SIZE % alignof(std::max_align_t) == 0, "every block must be aligned for any type");
+
+	struct alignas(alignof(std::max_align_t)) Block {
+		uint8_t data[BLOCK_SIZE];
+	};
+
+	/**
+	 * @param blocks BLOCKS blocks, e.g. a static array, must outlive the pool
+	 */
+	constexpr explicit GPSBlockPool(Block *blocks) : _blocks(blocks) {}
+
+	void *allocate(size_t size) override
+	{
+		const unsigned count = size > BLOCK_SIZE ? (unsigned)((size + BLOCK_SIZE - 1) / BLOCK_SIZE) : 1;
+
+		if (count > BLOCKS) {
+			return nullptr;
+		}
+
+		const uint32_t run = (1u << count) - 1;
+		uint32_t used = _used.load(std::memory_order_relaxed);
+		unsigned first = 0;
+
+		while (first + count <= BLOCKS) {
+			if (used & (run << first)) {
+				first++;
+
+			} else if (_used.compare_exchange_weak(used, used | (run << first), std::memory_order_acquire,
+							       std::memory_order_relaxed)) {
+				_counts[first] = (uint8_t)count;
+				return _blocks[first].data;
+
+			} else {
+				// used is reloaded, start over
+				first = 0;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void release(void *block) override
+	{
+		const uintptr_t offset = (uintptr_t)block - (uintptr_t)_blocks;
+
+		if (offset >= BLOCKS * sizeof(Block)) {
+			return;
+		}
+
+		const unsigned first = (unsigned)(offset / sizeof(Block));
+		const uint32_t run = (1u << _counts[first]) - 1;
+		_used.fetch_and(~(run << first), std::memory_order_release);
+	}
+
+	/**
+	 * @return number of blocks in use
+	 */
+	unsigned used() const
+	{
+		unsigned count = 0;
+
+		for (uint32_t used = _used.load(std::memory_order_relaxed); used; used &= used - 1) {
+			count++;
+		}
+
+		return count;
+	}
+
+private:
+	Block *const _blocks;
+	uint8_t _counts[BLOCKS] {};			///< blocks of the buffer starting at a block
+	std::atomic<uint32_t> _used{0};			///< bit per block
+};
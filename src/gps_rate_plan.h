@@ -0,0 +1,249 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file gps_rate_plan.h
+ *
+ * Planning of the navigation rate a receiver's output fits into at a baudrate.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#ifndef GPS_RATE_PLAN_MAX_LOAD
+#define GPS_RATE_PLAN_MAX_LOAD		80	///< %, of the line's bandwidth the planned output may use
+#endif
+
+#ifndef GPS_RATE_PLAN_WINDOW
+#define GPS_RATE_PLAN_WINDOW		3000000	///< us, the achieved rate is measured over this time
+#endif
+
+#ifndef GPS_RATE_PLAN_MIN_ACHIEVED
+#define GPS_RATE_PLAN_MIN_ACHIEVED	75	///< %, of the planned rate below which the rate is lowered
+#endif
+
+#ifndef GPS_RATE_PLAN_RECOVER_WINDOWS
+#define GPS_RATE_PLAN_RECOVER_WINDOWS	10	///< windows that keep up with a lowered rate before the next higher one is tried
+#endif
+
+#ifndef GPS_RATE_PLAN_MAX_BACKOFF
+#define GPS_RATE_PLAN_MAX_BACKOFF	8	///< the wait for the next try grows up to this factor when the rate falls behind again
+#endif
+
+
+/**
+ * Picks the shortest measurement period (and the baudrate) at which the messages of an epoch fit
+ * into the line with GPS_RATE_PLAN_MAX_LOAD to spare, from the sizes of the enabled messages.
+ *
+ * The estimate can't know how many satellites will be tracked, and a receiver whose output doesn't
+ * fit drops messages instead, which just reduces the update rate. The planner therefore also
+ * measures the achieved rate, and if it stays below GPS_RATE_PLAN_MIN_ACHIEVED of the planned one
+ * for the GPS_RATE_PLAN_WINDOW, it steps to the next longer period.
+ * A lowered rate that keeps up for GPS_RATE_PLAN_RECOVER_WINDOWS windows in a row is stepped back
+ * towards the planned one, e.g. after a burst of noise on the line. Every time the rate falls behind
+ * again, the wait for the next try doubles, up to GPS_RATE_PLAN_MAX_BACKOFF times.
+ */
+class GPSRatePlanner
+{
+public:
+	static constexpr unsigned NUM_PERIODS = 6;
+
+	/**
+	 * @return measurement period i [ms], from the shortest (i = 0) to the longest (1000 ms)
+	 */
+	static unsigned period(unsigned i)
+	{
+		static const uint16_t periods[NUM_PERIODS] {100, 125, 200, 250, 500, 1000};
+		return periods[i < NUM_PERIODS ? i : NUM_PERIODS - 1];
+	}
+
+	/**
+	 * @param epoch_bytes output of each epoch
+	 * @param second_bytes output per second that doesn't depend on the rate
+	 * @param period measurement period [ms]
+	 * @param baudrate 0 if the interface's bandwidth isn't limited by it (SPI, USB)
+	 * @return true if the output fits into GPS_RATE_PLAN_MAX_LOAD of the line
+	 */
+	static bool fits(uint32_t epoch_bytes, uint32_t second_bytes, unsigned period, unsigned baudrate)
+	{
+		if (baudrate == 0) {
+			return true;
+		}
+
+		// 10 bits per byte with start and stop bit
+		const uint64_t bits = ((uint64_t)epoch_bytes * 1000 / (period > 0 ? period : 1) + second_bytes) * 10;
+		return bits * 100 <= (uint64_t)baudrate * GPS_RATE_PLAN_MAX_LOAD;
+	}
+
+	/**
+	 * @param min_period the receiver's shortest period [ms]
+	 * @return shortest period not below min_period the output fits into, the longest one if none
+	 */
+	static unsigned planPeriod(uint32_t epoch_bytes, uint32_t second_bytes, unsigned baudrate, unsigned min_period)
+	{
+		for (unsigned i = 0; i < NUM_PERIODS; i++) {
+			if (period(i) >= min_period && fits(epoch_bytes, second_bytes, period(i), baudrate)) {
+				return period(i);
+			}
+		}
+
+		return period(NUM_PERIODS - 1);
+	}
+
+	/**
+	 * @param baudrates the candidates, ascending
+	 * @return lowest baudrate the output fits into at the period, the highest one if none
+	 */
+	static unsigned planBaudrate(uint32_t epoch_bytes, uint32_t second_bytes, unsigned period,
+				     const unsigned *baudrates, unsigned count)
+	{
+		for (unsigned i = 0; i < count; i++) {
+			if (fits(epoch_bytes, second_bytes, period, baudrates[i])) {
+				return baudrates[i];
+			}
+		}
+
+		return count > 0 ? baudrates[count - 1] : 0;
+	}
+
+	/**
+	 * The receiver was configured to a period, the achieved rate is measured from the next update
+	 * @param period [ms], the shortest one the rate returns to. 0 to not adapt it.
+	 */
+	void start(unsigned period)
+	{
+		_planned = period;
+		_period = period;
+		_window_start = 0;
+		_updates = 0;
+		_kept_up = 0;
+		_backoff = 1;
+		_recovered = false;
+	}
+
+	/**
+	 * A position update was received
+	 * @param now [us]
+	 * @return the period the receiver is to be configured to, 0 to keep the current one
+	 */
+	unsigned update(uint64_t now)
+	{
+		if (_planned == 0 || _planned >= period(NUM_PERIODS - 1)) {
+			return 0;
+		}
+
+		if (_window_start == 0 || now < _window_start) {
+			_window_start = now;
+			_updates = 0;
+			return 0;
+		}
+
+		_updates++;
+		const uint64_t elapsed = now - _window_start;
+
+		if (elapsed < GPS_RATE_PLAN_WINDOW) {
+			return 0;
+		}
+
+		_window_start = now;
+		const uint32_t updates = _updates;
+		_updates = 0;
+
+		// a gap in the data (e.g. a reconnect) says nothing about the rate
+		if (elapsed > 2 * GPS_RATE_PLAN_WINDOW) {
+			return 0;
+		}
+
+		// updates / elapsed at least GPS_RATE_PLAN_MIN_ACHIEVED % of 1000 / _period, with elapsed in us
+		if ((uint64_t)updates * _period * 100000 >= (uint64_t)GPS_RATE_PLAN_MIN_ACHIEVED * elapsed) {
+			_kept_up++;
+
+			if (_recovered && _kept_up >= GPS_RATE_PLAN_RECOVER_WINDOWS) {
+				// the step back held
+				_recovered = false;
+				_backoff = 1;
+			}
+
+			if (_period == _planned || _kept_up < GPS_RATE_PLAN_RECOVER_WINDOWS * _backoff) {
+				return 0;
+			}
+
+			// the next shorter period, not below the planned one
+			unsigned i = NUM_PERIODS - 1;
+
+			while (i > 0 && period(i - 1) >= _planned && period(i) >= _period) {
+				i--;
+			}
+
+			_period = period(i) > _planned ? period(i) : _planned;
+			_kept_up = 0;
+			_recovered = true;
+			return _period;
+		}
+
+		if (_period >= period(NUM_PERIODS - 1)) {
+			return 0;
+		}
+
+		if (_recovered && _backoff < GPS_RATE_PLAN_MAX_BACKOFF) {
+			// soon after a step back: the shorter period doesn't keep up after all
+			_backoff = (uint8_t)(_backoff * 2);
+		}
+
+		unsigned i = 0;
+
+		while (i < NUM_PERIODS - 1 && period(i) <= _period) {
+			i++;
+		}
+
+		_period = period(i);
+		_kept_up = 0;
+		_recovered = false;
+		return _period;
+	}
+
+	/**
+	 * @return the period the receiver is configured to [ms], 0 if it's not adapted
+	 */
+	unsigned currentPeriod() const { return _period; }
+
+private:
+	uint64_t _window_start{0};	///< first update of the measurement window [us], 0 before it
+	uint32_t _updates{0};		///< updates after the first one of the window
+	unsigned _planned{0};		///< configured period, the shortest one
+	unsigned _period{0};		///< current period
+	uint16_t _kept_up{0};		///< windows in a row that achieved the current period
+	uint8_t _backoff{1};		///< factor of GPS_RATE_PLAN_RECOVER_WINDOWS before the next step back
+	bool _recovered{false};		///< stepped back, for less than GPS_RATE_PLAN_RECOVER_WINDOWS windows
+};
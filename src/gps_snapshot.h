@@ -0,0 +1,117 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file gps_snapshot.h
+ *
+ * Lock-free hand over of a driver output from the thread running the driver to readers on
+ * other threads or cores.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Snapshot of a trivially copyable T with one writer and any number of readers.
+ *
+ * Two copies are kept (a seqlock latch): while the writer updates one of them, the sequence
+ * number directs the readers to the other. A reader therefore never waits for the writer, it
+ * only retries if the writer completed a step during its copy. With priority scheduling on a
+ * single core this matters: a reader that preempted the writer couldn't make progress with a
+ * plain seqlock.
+ */
+template<typename T>
+class GPSSnapshot
+{
+public:
+	/**
+	 * Publish a new value. Must not be called concurrently.
+	 */
+	void publish(const T &value)
+	{
+		uint32_t words[WORDS] {};
+		memcpy(words, &value, sizeof(T));
+		const uint32_t seq = _seq.load(std::memory_order_relaxed);
+
+		// odd: the readers use copy 1 while copy 0 is written, even: copy 0 while copy 1 is written
+		for (uint32_t copy = 0; copy < 2; copy++) {
+			_seq.store(seq + 1 + copy, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			for (unsigned i = 0; i < WORDS; i++) {
+				_copies[copy][i].store(words[i], std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * Read the last published value, from any thread
+	 * @return false if nothing was published yet
+	 */
+	bool read(T &value) const
+	{
+		uint32_t words[WORDS];
+		uint32_t seq;
+
+		do {
+			seq = _seq.load(std::memory_order_acquire);
+
+			if (seq < 2) {
+				return false;
+			}
+
+			for (unsigned i = 0; i < WORDS; i++) {
+				words[i] = _copies[seq & 1][i].load(std::memory_order_relaxed);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while (_seq.load(std::memory_order_relaxed) != seq);
+
+		memcpy(&value, words, sizeof(T));
+		return true;
+	}
+
+	/**
+	 * @return number of values published, a reader can tell from it whether there is a new one
+	 */
+	uint32_t updates() const { return _seq.load(std::memory_order_acquire) / 2; }
+
+private:
+	static constexpr unsigned WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+	std::atomic<uint32_t> _seq{0};
+	std::atomic<uint32_t> _copies[2][WORDS] {};
+};
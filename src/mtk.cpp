@@ -113,7 +113,6 @@ int
 GPSDriverMTK::receive(unsigned timeout)
 {
 	uint8_t buf[GPS_READ_BUFFER_SIZE];
-	gps_mtk_packet_t packet{};
 
 	/* timeout additional to poll */
 	gps_abstime time_started = gps_absolute_time();
@@ -125,12 +124,14 @@ GPSDriverMTK::receive(unsigned timeout)
 		int ret = read(buf, sizeof(buf), timeout);
 
 		if (ret > 0) {
+			statsBytesReceived(ret);
+
 			/* first read whatever is left */
 			if (j < ret) {
 				/* pass received bytes to the packet decoder */
 				while (j < ret) {
-					if (parseChar(buf[j], packet) > 0) {
-						handleMessage(packet);
+					if (parseChar(buf[j], _packet) > 0) {
+						handleMessage(_packet);
 						return 1;
 					}
 
@@ -152,6 +153,22 @@ GPSDriverMTK::receive(unsigned timeout)
 	}
 }
 
+int
+GPSDriverMTK::feed(const uint8_t *buf, size_t buf_length)
+{
+	int handled = 0;
+	statsBytesReceived(buf_length);
+
+	for (size_t i = 0; i < buf_length; i++) {
+		if (parseChar(buf[i], _packet) > 0) {
+			handleMessage(_packet);
+			handled = 1;
+		}
+	}
+
+	return handled;
+}
+
 void
 GPSDriverMTK::decodeInit()
 {
@@ -170,10 +187,12 @@ GPSDriverMTK::parseChar(uint8_t b, gps_mtk_packet_t &packet)
 		if (b == MTK_SYNC1_V16) {
 			_decode_state = MTK_DECODE_GOT_CK_A;
 			_mtk_revision = 16;
+			statsFrameStart();
 
 		} else if (b == MTK_SYNC1_V19) {
 			_decode_state = MTK_DECODE_GOT_CK_A;
 			_mtk_revision = 19;
+			statsFrameStart();
 		}
 
 	} else if (_decode_state == MTK_DECODE_GOT_CK_A) {
@@ -182,6 +201,7 @@ GPSDriverMTK::parseChar(uint8_t b, gps_mtk_packet_t &packet)
 
 		} else {
 			// Second start symbol was wrong, reset state machine
+			statsResync();
 			decodeInit();
 		}
 
@@ -200,9 +220,11 @@ GPSDriverMTK::parseChar(uint8_t b, gps_mtk_packet_t &packet)
 			/* Compare checksum */
 			if (_rx_ck_a == packet.ck_a && _rx_ck_b == packet.ck_b) {
 				ret = 1;
+				statsFrameDone(sizeof(packet) + 2);
 
 			} else {
 				ret = -1;
+				statsChecksumError();
 			}
 
 			// Reset state machine to decode next packet
@@ -217,8 +239,8 @@ void
 GPSDriverMTK::handleMessage(gps_mtk_packet_t &packet)
 {
 	if (_mtk_revision == 16) {
-		_gps_position->lat = packet.latitude * 10; // from degrees*1e6 to degrees*1e7
-		_gps_position->lon = packet.longitude * 10; // from degrees*1e6 to degrees*1e7
+		_gps_position->lat = (int32_t)((int64_t)packet.latitude * 10); // from degrees*1e6 to degrees*1e7
+		_gps_position->lon = (int32_t)((int64_t)packet.longitude * 10); // from degrees*1e6 to degrees*1e7
 
 	} else if (_mtk_revision == 19) {
 		_gps_position->lat = packet.latitude; // both degrees*1e7
@@ -251,12 +273,12 @@ GPSDriverMTK::handleMessage(gps_mtk_packet_t &packet)
 	uint32_t timeinfo_conversion_temp;
 
 	timeinfo.tm_mday = packet.date / 10000;
-	timeinfo_conversion_temp = packet.date - timeinfo.tm_mday * 10000;
+	timeinfo_conversion_temp = packet.date % 10000;
 	timeinfo.tm_mon = (timeinfo_conversion_temp / 100) - 1;
-	timeinfo.tm_year = (timeinfo_conversion_temp - (timeinfo.tm_mon + 1) * 100) + 100;
+	timeinfo.tm_year = (timeinfo_conversion_temp % 100) + 100;
 
 	timeinfo.tm_hour = (packet.utc_time / 10000000);
-	timeinfo_conversion_temp = packet.utc_time - timeinfo.tm_hour * 10000000;
+	timeinfo_conversion_temp = packet.utc_time % 10000000;
 	timeinfo.tm_min = timeinfo_conversion_temp / 100000;
 	timeinfo_conversion_temp -= timeinfo.tm_min * 100000;
 	timeinfo.tm_sec = timeinfo_conversion_temp / 1000;
@@ -296,6 +318,8 @@ GPSDriverMTK::handleMessage(gps_mtk_packet_t &packet)
 	// Position and velocity update always at the same time
 	_rate_count_vel++;
 	_rate_count_lat_lon++;
+	statsPositionFrame();
+	statsUpdate();
 }
 
 void
@@ -92,6 +92,7 @@ public:
 	virtual ~GPSDriverMTK() = default;
 
 	int receive(unsigned timeout) override;
+	int feed(const uint8_t *buf, size_t buf_length) override;
 	int configure(unsigned &baudrate, const GPSConfig &config) override;
 
 private:
@@ -116,6 +117,7 @@ private:
 	void addByteToChecksum(uint8_t);
 
 	sensor_gps_s *_gps_position {nullptr};
+	gps_mtk_packet_t _packet{}; ///< packet being decoded, it can span several reads
 	mtk_decode_state_t _decode_state{MTK_DECODE_UNINIT};
 	uint8_t _mtk_revision{0};
 	unsigned _rx_count{};
@@ -50,18 +50,23 @@
 
 #include "nmea.h"
 #include "rtcm.h"
+#include "text_scan.h"
 
 #ifndef M_PI_F
 # define M_PI_F 3.14159265358979323846f
 #endif
 
 #define MAX(X,Y)    ((X) > (Y) ? (X) : (Y))
+#define NMEA_MS_PER_DAY 86400000
 #define NMEA_UNUSED(x) (void)x;
 
 /**** Warning macros, disable to save memory */
 #define NMEA_WARN(...)         {GPS_WARN(__VA_ARGS__);}
 #define NMEA_DEBUG(...)        {/*GPS_WARN(__VA_ARGS__);*/}
 
+static_assert(GPSHelper::staticPoolBlocks(sizeof(RTCMParsing)) <= GPS_STATIC_POOL_BLOCKS,
+	      "the static memory pool is too small for the NMEA driver");
+
 GPSDriverNMEA::GPSDriverNMEA(GPSCallbackPtr callback, void *callback_user,
 			     sensor_gps_s *gps_position,
 			     satellite_info_s *satellite_info,
@@ -76,775 +81,957 @@ GPSDriverNMEA::GPSDriverNMEA(GPSCallbackPtr callback, void *callback_user,
 
 GPSDriverNMEA::~GPSDriverNMEA()
 {
-	delete _rtcm_parsing;
+	destroyBuffer(_rtcm_parsing);
 }
 
 /*
- * All NMEA descriptions are taken from
- * http://www.trimble.com/OEM_ReceiverHelp/V4.44/en/NMEA-0183messages_MessageOverview.html
+ * Field parsers used instead of strtod() and strtol(), which are slow without an FPU:
+ * the digits are accumulated as integers and converted to floating point once at the end.
+ * An empty field leaves the value untouched and returns false.
  */
 
-int GPSDriverNMEA::handleMessage(int len)
+#define NMEA_SENTENCE_ID(a, b, c) (((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(c))
+#define NMEA_TALKER_ID(a, b) (((uint32_t)(a) << 8) | (uint32_t)(b))
+#define NMEA_MAX_DIGITS 18 // significant digits that fit into an int64_t
+
+static const double nmea_pow10[NMEA_MAX_DIGITS + 1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+// powers of ten that are exact in a float
+static const float nmea_pow10f[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+static inline bool nmeaIsDigit(char c)
 {
-	char *endp;
+	return c >= '0' && c <= '9';
+}
 
-	if (len < 7) {
-		return 0;
+static inline bool nmeaFieldEmpty(const char *s)
+{
+	return !s || *s == ',' || *s == '*';
+}
+
+/**
+ * Parse a [-]ddd[.ddd] field into mantissa / 10^decimals
+ */
+static bool nmeaDecimal(const char *s, int64_t &mantissa, int &decimals)
+{
+	if (nmeaFieldEmpty(s)) {
+		return false;
 	}
 
-	int uiCalcComma = 0;
+	const bool negative = *s == '-';
 
-	for (int i = 0 ; i < len; i++) {
-		if (_rx_buffer[i] == ',') { uiCalcComma++; }
+	if (negative || *s == '+') {
+		s++;
 	}
 
-	char *bufptr = (char *)(_rx_buffer + 6);
-	int ret = 0;
+	int64_t m = 0;
+	int digits = 0;
+	decimals = 0;
 
-	if ((memcmp(_rx_buffer + 3, "ZDA,", 4) == 0) && (uiCalcComma == 6)) {
-#ifndef NO_MKTIME
-		/*
-		UTC day, month, and year, and local time zone offset
-		An example of the ZDA message string is:
-
-		$GPZDA,172809.456,12,07,1996,00,00*45
-
-		ZDA message fields
-		Field	Meaning
-		0	Message ID $GPZDA
-		1	UTC
-		2	Day, ranging between 01 and 31
-		3	Month, ranging between 01 and 12
-		4	Year
-		5	Local time zone offset from GMT, ranging from 00 through 13 hours
-		6	Local time zone offset from GMT, ranging from 00 through 59 minutes
-		7	The checksum data, always begins with *
-		Fields 5 and 6 together yield the total offset. For example, if field 5 is -5 and field 6 is +15, local time is 5 hours and 15 minutes earlier than GMT.
-		*/
-		double utc_time = 0.0;
-		int day = 0, month = 0, year = 0, local_time_off_hour = 0, local_time_off_min = 0;
-		NMEA_UNUSED(local_time_off_hour);
-		NMEA_UNUSED(local_time_off_min);
-
-		if (bufptr && *(++bufptr) != ',') { utc_time = strtod(bufptr, &endp); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { day = strtol(bufptr, &endp, 10); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { month = strtol(bufptr, &endp, 10); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { year = strtol(bufptr, &endp, 10); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { local_time_off_hour = strtol(bufptr, &endp, 10); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { local_time_off_min = strtol(bufptr, &endp, 10); bufptr = endp; }
-
-		int utc_hour = static_cast<int>(utc_time / 10000);
-		int utc_minute = static_cast<int>((utc_time - utc_hour * 10000) / 100);
-		double utc_sec = static_cast<double>(utc_time - utc_hour * 10000 - utc_minute * 100);
-
-
-		/*
-		* convert to unix timestamp
-		*/
-		struct tm timeinfo = {};
-		timeinfo.tm_year = year - 1900;
-		timeinfo.tm_mon = month - 1;
-		timeinfo.tm_mday = day;
-		timeinfo.tm_hour = utc_hour;
-		timeinfo.tm_min = utc_minute;
-		timeinfo.tm_sec = int(utc_sec);
-		timeinfo.tm_isdst = 0;
-
-
-		time_t epoch = mktime(&timeinfo);
-
-		if (epoch > GPS_EPOCH_SECS) {
-			uint64_t usecs = static_cast<uint64_t>((utc_sec - static_cast<uint64_t>(utc_sec)) * 1000000);
-
-			// FMUv2+ boards have a hardware RTC, but GPS helps us to configure it
-			// and control its drift. Since we rely on the HRT for our monotonic
-			// clock, updating it from time to time is safe.
-
-			if (!_clock_set) {
-				timespec ts{};
-				ts.tv_sec = epoch;
-				ts.tv_nsec = usecs * 1000;
-				setClock(ts);
-				_clock_set = true;
+	for (; nmeaIsDigit(*s); s++) {
+		if (digits < NMEA_MAX_DIGITS) {
+			m = m * 10 + (*s - '0');
+			digits++;
+		}
+	}
+
+	if (*s == '.') {
+		for (s++; nmeaIsDigit(*s); s++) {
+			if (digits < NMEA_MAX_DIGITS) {
+				m = m * 10 + (*s - '0');
+				digits++;
+				decimals++;
 			}
+		}
+	}
 
-			_gps_position->time_utc_usec = static_cast<uint64_t>(epoch) * 1000000ULL;
-			_gps_position->time_utc_usec += usecs;
+	mantissa = negative ? -m : m;
+	return true;
+}
 
-		} else {
-			_gps_position->time_utc_usec = 0;
-		}
+static bool nmeaInt(const char *s, int &value)
+{
+	if (nmeaFieldEmpty(s)) {
+		return false;
+	}
 
-#else
-		_gps_position->time_utc_usec = 0;
-#endif
-		_TIME_received = true;
-		_gps_position->timestamp = gps_absolute_time();
-
-	} else if ((memcmp(_rx_buffer + 3, "GGA,", 4) == 0) && (uiCalcComma >= 14)) {
-		/*
-		  Time, position, and fix related data
-		  An example of the GBS message string is:
-		  $xxGGA,time,lat,NS,long,EW,quality,numSV,HDOP,alt,M,sep,M,diffAge,diffStation*cs
-		  $GPGGA,172814.0,3723.46587704,N,12202.26957864,W,2,6,1.2,18.893,M,-25.669,M,2.0,0031*4F
-		  $GNGGA,092721.00,2926.688113,N,11127.771644,E,2,08,1.11,106.3,M,-20,M,1.0,3721*53
-
-		  Note - The data string exceeds the nmea standard length.
-		  GGA message fields
-		  Field   Meaning
-		  0   Message ID $GPGGA
-		  1   UTC of position fix
-		  2   Latitude
-		  3   Direction of latitude:
-		  N: North
-		  S: South
-		  4   Longitude
-		  5   Direction of longitude:
-		  E: East
-		  W: West
-		  6   GPS Quality indicator:
-		  0: Fix not valid
-		  1: GPS fix
-		  2: Differential GPS fix, OmniSTAR VBS
-		  4: Real-Time Kinematic, fixed integers
-		  5: Real-Time Kinematic, float integers, OmniSTAR XP/HP or Location RTK
-		  7   Number of SVs in use, range from 00 through to 24+
-		  8   HDOP
-		  9   Orthometric height (MSL reference)
-		  10  M: unit of measure for orthometric height is meters
-		  11  Geoid separation
-		  12  M: geoid separation measured in meters
-		  13  Age of differential GPS data record, Type 1 or Type 9. Null field when DGPS is not used.
-		  14  Reference station ID, range 0000-4095. A null field when any reference station ID is selected and no corrections are received1.
-		  15
-		  The checksum data, always begins with *
-		*/
-		double utc_time = 0.0, lat = 0.0, lon = 0.0;
-		float alt = 0.f, geoid_h = 0.f;
-		float hdop = 99.9f, dgps_age = NAN;
-		int  num_of_sv = 0, fix_quality = 0;
-		char ns = '?', ew = '?';
-
-		NMEA_UNUSED(dgps_age);
-
-		if (bufptr && *(++bufptr) != ',') { utc_time = strtod(bufptr, &endp); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { lat = strtod(bufptr, &endp); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { ns = *(bufptr++); }
-
-		if (bufptr && *(++bufptr) != ',') { lon = strtod(bufptr, &endp); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { ew = *(bufptr++); }
-
-		if (bufptr && *(++bufptr) != ',') { fix_quality = strtol(bufptr, &endp, 10); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { num_of_sv = strtol(bufptr, &endp, 10); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { hdop = strtof(bufptr, &endp); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { alt = strtof(bufptr, &endp); bufptr = endp; }
-
-		while (*(++bufptr) != ',') {} //skip M
-
-		if (bufptr && *(++bufptr) != ',') { geoid_h = strtof(bufptr, &endp); bufptr = endp; }
-
-		while (*(++bufptr) != ',') {} //skip M
-
-		if (bufptr && *(++bufptr) != ',') { dgps_age = strtof(bufptr, &endp); bufptr = endp; }
-
-		if (ns == 'S') {
-			lat = -lat;
-		}
+	const bool negative = *s == '-';
 
-		if (ew == 'W') {
-			lon = -lon;
-		}
+	if (negative || *s == '+') {
+		s++;
+	}
 
-		/* convert from degrees, minutes and seconds to degrees */
-		_gps_position->lon = static_cast<int>((int(lon * 0.01) + (lon * 0.01 - int(lon * 0.01)) * 100.0 / 60.0) * 10000000);
-		_gps_position->lat = static_cast<int>((int(lat * 0.01) + (lat * 0.01 - int(lat * 0.01)) * 100.0 / 60.0) * 10000000);
-		_gps_position->hdop = hdop;
-		_gps_position->alt = static_cast<int>(alt * 1000);
-		_gps_position->alt_ellipsoid = _gps_position->alt + static_cast<int>(geoid_h * 1000);
-		_sat_num_gga = static_cast<int>(num_of_sv);
+	int v = 0;
 
+	for (int digits = 0; nmeaIsDigit(*s) && digits < 9; s++, digits++) {
+		v = v * 10 + (*s - '0');
+	}
 
-		if (fix_quality <= 0) {
-			_gps_position->fix_type = 0;
+	value = negative ? -v : v;
+	return true;
+}
 
-		} else {
-			/*
-			 * in this NMEA message float integers (value 5) mode has higher value than fixed integers (value 4), whereas it provides lower quality,
-			 * and since value 3 is not being used, I "moved" value 5 to 3 to add it to _gps_position->fix_type
-			 */
-			if (fix_quality == 5) { fix_quality = 3; }
+static bool nmeaFloat(const char *s, float &value)
+{
+	int64_t mantissa;
+	int decimals;
 
-			/*
-			 * fix quality 1 means just a normal 3D fix, so I'm subtracting 1 here. This way we'll have 3 for auto, 4 for DGPS, 5 for floats, 6 for fixed.
-			 */
-			_gps_position->fix_type = 3 + fix_quality - 1;
-		}
+	if (!nmeaDecimal(s, mantissa, decimals)) {
+		return false;
+	}
 
-		if (!_POS_received && (_last_POS_timeUTC < utc_time)) {
-			_last_POS_timeUTC = utc_time;
-			_POS_received = true;
-		}
+	// exact operands, so the single division rounds like strtof()
+	if (mantissa < (1 << 24) && mantissa > -(1 << 24)
+	    && decimals < (int)(sizeof(nmea_pow10f) / sizeof(nmea_pow10f[0]))) {
+		value = (float)mantissa / nmea_pow10f[decimals];
 
-		_ALT_received = true;
-		_SVNUM_received = true;
-		_FIX_received = true;
+	} else {
+		value = (float)((double)mantissa / nmea_pow10[decimals]);
+	}
 
-		_gps_position->c_variance_rad = 0.1f;
-		_gps_position->timestamp = gps_absolute_time();
+	return true;
+}
 
-	} else if (memcmp(_rx_buffer + 3, "HDT,", 4) == 0 && uiCalcComma == 2) {
-		/*
-		Heading message
-		Example $GPHDT,121.2,T*35
+static bool nmeaDouble(const char *s, double &value)
+{
+	int64_t mantissa;
+	int decimals;
 
-		f1 Last computed heading value, in degrees (0-359.99)
-		T "T" for "True"
-		 */
+	if (!nmeaDecimal(s, mantissa, decimals)) {
+		return false;
+	}
 
-		float heading_deg = 0.f;
+	value = (double)mantissa / nmea_pow10[decimals];
+	return true;
+}
 
-		if (bufptr && *(++bufptr) != ',') {
-			heading_deg = strtof(bufptr, &endp); bufptr = endp;
-			handleHeading(heading_deg, NAN);
-		}
+static bool nmeaChar(const char *s, char &value)
+{
+	if (nmeaFieldEmpty(s)) {
+		return false;
+	}
 
-		_HEAD_received = true;
-
-	} else if ((memcmp(_rx_buffer + 3, "GNS,", 4) == 0) && (uiCalcComma >= 12)) {
-
-		/*
-		Message GNS
-		Type Output Message
-		Time and position, together with GNSS fixing related data (number of satellites in use, and
-		the resulting HDOP, age of differential data if in use, etc.).
-		Message Structure:
-		$xxGNS,time,lat,NS,long,EW,posMode,numSV,HDOP,alt,altRef,diffAge,diffStation,navStatus*cs<CR><LF>
-		Example:
-		$GPGNS,091547.00,5114.50897,N,00012.28663,W,AA,10,0.83,111.1,45.6,,,V*71
-		$GNGNS,092721.00,2926.68811,N,11127.77164,E,DNNN,08,1.11,106.3,-20,1.0,3721,V*0D
-
-		FieldNo.  Name    Unit     Format                  Example Description
-		0        xxGNS    -       string            $GPGNS GNS Message ID (xx = current Talker ID)
-		1        time     -       hhmmss.ss         091547.00 UTC time, see note on UTC representation
-		2        lat      -       ddmm.mmmmm        5114.50897 Latitude (degrees & minutes), see format description
-		3        NS       -       character         N North/South indicator
-		4        long     -       dddmm.mmmmm       00012.28663 Longitude (degrees & minutes), see format description
-		5        EW       -       character         E East/West indicator
-		6      posMode    -       character         AA Positioning mode, see position fix flags description. First character for GPS, second character forGLONASS
-		7       numSV     -       numeric         10 Number of satellites used (range: 0-99)
-		8         HDOP    -       numeric         0.83 Horizontal Dilution of Precision
-		9         alt     m       numeric         111.1 Altitude above mean sea level
-		10        sep    m        numeric         45.6 Geoid separation: difference between ellipsoid and mean sea level UBX-18010854 - R05 Advance Information Page 18 of 262 u-blox ZED-F9P Interface Description - Manual GNS continued
-		11    diffAge    s        numeric         - Age of differential corrections (blank when DGPS is not used)
-		12 diffStation   -        numeric         - ID of station providing differential corrections (blank when DGPS is not used)
-		13 navStatus    -         character         V Navigational status indicator (V = Equipment is not providing navigational status information) NMEA v4.10 and above only
-		14 cs - hexadecimal *71   Checksum
-		15 <CR><LF> - character - Carriage return and line feed
-		*/
-		double utc_time = 0.0;
-		double lat = 0.0, lon = 0.0;
-		char pos_Mode[5] = {'N', 'N', 'N', 'N', 'N'};
-		int num_of_sv = 0;
-		float alt = 0.f;
-		float hdop = 0.f;
-		char ns = '?', ew = '?';
-		int i = 0;
-		NMEA_UNUSED(pos_Mode);
-
-		if (bufptr && *(++bufptr) != ',') { utc_time = strtod(bufptr, &endp); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { lat = strtod(bufptr, &endp); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { ns = *(bufptr++); }
-
-		if (bufptr && *(++bufptr) != ',') { lon = strtod(bufptr, &endp); bufptr = endp; }
-
-		if (bufptr && *(++bufptr) != ',') { ew = *(bufptr++);}
-
-		do {
-			pos_Mode[i] =  *(bufptr);
-			i++;
+	value = *s;
+	return true;
+}
 
-		} while (*(++bufptr) != ',' && i < 5);
+/**
+ * @param utc_time hhmmss.ss as parsed from a sentence
+ * @return UTC time of day [ms]
+ */
+static uint32_t utcTimeOfDay(double utc_time)
+{
+	const int hhmm = (int)(utc_time / 100.);
+	const double seconds = utc_time - hhmm * 100.;
+	return (uint32_t)((hhmm / 100) * 3600000 + (hhmm % 100) * 60000 + lround(seconds * 1000.)) % NMEA_MS_PER_DAY;
+}
 
-		if (bufptr && *(++bufptr) != ',') { num_of_sv = strtol(bufptr, &endp, 10); bufptr = endp; }
+/**
+ * @return UTC time of day [ms] of a Unicore message header's GPS time
+ */
+static uint32_t unicoreTimeOfDay(uint32_t time_of_week_ms, int leap_seconds)
+{
+	const int64_t week = 7LL * NMEA_MS_PER_DAY;
+	return (uint32_t)(((int64_t)time_of_week_ms + week - leap_seconds * 1000LL) % NMEA_MS_PER_DAY);
+}
 
-		if (bufptr && *(++bufptr) != ',') { hdop = strtof(bufptr, &endp); bufptr = endp; }
+/**
+ * Parse a [d]ddmm.mmmmm latitude or longitude into degrees * 1e7, in integer arithmetic.
+ * The result is truncated, like the floating point conversion it replaces.
+ */
+static bool nmeaLatLon(const char *s, int32_t &value)
+{
+	if (nmeaFieldEmpty(s)) {
+		return false;
+	}
 
-		if (bufptr && *(++bufptr) != ',') { alt = strtof(bufptr, &endp); bufptr = endp; }
+	const bool negative = *s == '-';
 
-		if (ns == 'S') {
-			lat = -lat;
-		}
+	if (negative || *s == '+') {
+		s++;
+	}
 
-		if (ew == 'W') {
-			lon = -lon;
-		}
+	int32_t degrees_minutes = 0;
+
+	for (int digits = 0; nmeaIsDigit(*s) && digits < 9; s++, digits++) {
+		degrees_minutes = degrees_minutes * 10 + (*s - '0');
+	}
 
-		/* convert from degrees, minutes and seconds to degrees */
-		_gps_position->lat = static_cast<int>((int(lat * 0.01) + (lat * 0.01 - int(lat * 0.01)) * 100.0 / 60.0) * 10000000);
-		_gps_position->lon = static_cast<int>((int(lon * 0.01) + (lon * 0.01 - int(lon * 0.01)) * 100.0 / 60.0) * 10000000);
-		_gps_position->hdop = hdop;
-		_gps_position->alt = static_cast<int>(alt * 1000);
-		_sat_num_gns = static_cast<int>(num_of_sv);
+	// minutes * scale, with up to 10 decimals (1e-10 minutes are 2e-5 mm)
+	int64_t minutes = degrees_minutes % 100;
+	int64_t scale = 1;
 
-		if (!_POS_received && (_last_POS_timeUTC < utc_time)) {
-			_last_POS_timeUTC = utc_time;
-			_POS_received = true;
+	if (*s == '.') {
+		for (s++; nmeaIsDigit(*s); s++) {
+			if (scale < 10000000000LL) {
+				minutes = minutes * 10 + (*s - '0');
+				scale *= 10;
+			}
 		}
+	}
 
-		_ALT_received = true;
-		_SVNUM_received = true;
+	// 1e7 / 60 = 500000 / 3
+	const int64_t v = (int64_t)(degrees_minutes / 100) * 10000000 + minutes * 500000 / (3 * scale);
+	value = (int32_t)(negative ? -v : v);
+	return true;
+}
 
+const char *GPSDriverNMEA::field(int index) const
+{
+	if (index == 0) {
+		return (const char *)_rx_buffer;
+	}
 
-	} else if ((memcmp(_rx_buffer + 3, "RMC,", 4) == 0) && (uiCalcComma >= 11)) {
+	if (index > _rx_comma_count || index > NMEA_MAX_FIELDS) {
+		return nullptr;
+	}
 
-		/*
-		Position, velocity, and time
-		The RMC string is:
+	return (const char *)_rx_buffer + _rx_field_offsets[index - 1] + 1;
+}
+
+/*
+ * All NMEA descriptions are taken from
+ * http://www.trimble.com/OEM_ReceiverHelp/V4.44/en/NMEA-0183messages_MessageOverview.html
+ */
 
-		$xxRMC,time,status,lat,NS,long,EW,spd,cog,date,mv,mvEW,posMode,navStatus*cs<CR><LF>
-		The Talker ID ($--) will vary depending on the satellite system used for the position solution:
-		$GNRMC,092721.00,A,2926.688113,N,11127.771644,E,0.780,,200520,,,D,V*1D
+int GPSDriverNMEA::handleMessage(int len)
+{
+	// $xxYYY, address fields only: the fields were split by parseChar()
+	if (len < 7 || _rx_comma_count == 0 || _rx_field_offsets[0] != 6) {
+		return 0;
+	}
 
-		GPRMC message fields
-		Field	Meaning
-		0	Message ID $GPRMC
-		1	UTC of position fix
-		2	Status A=active or V=void
-		3	Latitude
-		4	Longitude
-		5	Speed over the ground in knots
-		6	Track angle in degrees (True)
-		7	Date
-		8	Magnetic variation in degrees
-		9	The checksum data, always begins with *
-		*/
-		double utc_time = 0.0;
-		char Status = 'V';
-		double lat = 0.0, lon = 0.0;
-		float ground_speed_K = 0.f;
-		float track_true = 0.f;
-		int nmea_date = 0;
-		float Mag_var = 0.f;
-		char ns = '?', ew = '?';
-		NMEA_UNUSED(Mag_var);
+	const int uiCalcComma = _rx_comma_count;
+	const uint32_t sentence_id = NMEA_SENTENCE_ID(_rx_buffer[3], _rx_buffer[4], _rx_buffer[5]);
+	int ret = 0;
 
-		if (bufptr && *(++bufptr) != ',') { utc_time = strtod(bufptr, &endp); bufptr = endp; }
+	switch (sentence_id) {
+	case NMEA_SENTENCE_ID('Z', 'D', 'A'): {
+			if (uiCalcComma != 6) {
+				break;
+			}
 
-		if (bufptr && *(++bufptr) != ',') { Status = *(bufptr++); }
+#ifndef NO_MKTIME
+			/*
+			UTC day, month, and year, and local time zone offset
+			An example of the ZDA message string is:
 
-		if (bufptr && *(++bufptr) != ',') { lat = strtod(bufptr, &endp); bufptr = endp; }
+			$GPZDA,172809.456,12,07,1996,00,00*45
 
-		if (bufptr && *(++bufptr) != ',') { ns = *(bufptr++); }
+			ZDA message fields
+			Field	Meaning
+			0	Message ID $GPZDA
+			1	UTC
+			2	Day, ranging between 01 and 31
+			3	Month, ranging between 01 and 12
+			4	Year
+			5	Local time zone offset from GMT, ranging from 00 through 13 hours
+			6	Local time zone offset from GMT, ranging from 00 through 59 minutes
+			7	The checksum data, always begins with *
+			Fields 5 and 6 together yield the total offset. For example, if field 5 is -5 and field 6 is +15, local time is 5 hours and 15 minutes earlier than GMT.
+			*/
+			double utc_time = 0.0;
+			int day = 0, month = 0, year = 0;
 
-		if (bufptr && *(++bufptr) != ',') { lon = strtod(bufptr, &endp); bufptr = endp; }
+			nmeaDouble(field(1), utc_time);
 
-		if (bufptr && *(++bufptr) != ',') { ew = *(bufptr++); }
+			nmeaInt(field(2), day);
 
-		if (bufptr && *(++bufptr) != ',') { ground_speed_K = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaInt(field(3), month);
 
-		if (bufptr && *(++bufptr) != ',') { track_true = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaInt(field(4), year);
 
-		if (bufptr && *(++bufptr) != ',') { nmea_date = static_cast<int>(strtol(bufptr, &endp, 10)); bufptr = endp; }
+			// fields 5 and 6, the local time zone offset, are not used
 
-		if (bufptr && *(++bufptr) != ',') { Mag_var = strtof(bufptr, &endp); bufptr = endp; }
+			int utc_hour = static_cast<int>(utc_time / 10000);
+			int utc_minute = static_cast<int>((utc_time - utc_hour * 10000) / 100);
+			double utc_sec = static_cast<double>(utc_time - utc_hour * 10000 - utc_minute * 100);
 
-		if (ns == 'S') {
-			lat = -lat;
-		}
 
-		if (ew == 'W') {
-			lon = -lon;
-		}
+			/*
+			* convert to unix timestamp
+			*/
+			struct tm timeinfo = {};
+			timeinfo.tm_year = year - 1900;
+			timeinfo.tm_mon = month - 1;
+			timeinfo.tm_mday = day;
+			timeinfo.tm_hour = utc_hour;
+			timeinfo.tm_min = utc_minute;
+			timeinfo.tm_sec = int(utc_sec);
+			timeinfo.tm_isdst = 0;
+
+
+			time_t epoch = mktime(&timeinfo);
+
+			if (epoch > GPS_EPOCH_SECS) {
+				uint64_t usecs = static_cast<uint64_t>((utc_sec - static_cast<uint64_t>(utc_sec)) * 1000000);
+
+				// FMUv2+ boards have a hardware RTC, but GPS helps us to configure it
+				// and control its drift. Since we rely on the HRT for our monotonic
+				// clock, updating it from time to time is safe.
+
+				if (!_clock_set) {
+					timespec ts{};
+					ts.tv_sec = epoch;
+					ts.tv_nsec = usecs * 1000;
+					setClock(ts);
+					_clock_set = true;
+				}
 
-		if (Status == 'V') {
-			_gps_position->fix_type = 0;
-		}
+				_gps_position->time_utc_usec = static_cast<uint64_t>(epoch) * 1000000ULL;
+				_gps_position->time_utc_usec += usecs;
 
-		float track_rad = track_true * M_PI_F / 180.0f; // rad in range [0, 2pi]
+			} else {
+				_gps_position->time_utc_usec = 0;
+			}
 
-		if (track_rad > M_PI_F) {
-			track_rad -= 2.f * M_PI_F; // rad in range [-pi, pi]
+#else
+			_gps_position->time_utc_usec = 0;
+#endif
+			_TIME_received = true;
+			_gps_position->timestamp = messageTimestamp(frameStartTime());
 		}
+		break;
 
-		float velocity_ms = ground_speed_K / 1.9438445f;
-		float velocity_north = velocity_ms * cosf(track_rad);
-		float velocity_east  = velocity_ms * sinf(track_rad);
+	case NMEA_SENTENCE_ID('G', 'G', 'A'): {
+			if (uiCalcComma < 14) {
+				break;
+			}
 
-		/* convert from degrees, minutes and seconds to degrees */
-		_gps_position->lat = static_cast<int>((int(lat * 0.01) + (lat * 0.01 - int(lat * 0.01)) * 100.0 / 60.0) * 10000000);
-		_gps_position->lon = static_cast<int>((int(lon * 0.01) + (lon * 0.01 - int(lon * 0.01)) * 100.0 / 60.0) * 10000000);
+			/*
+			  Time, position, and fix related data
+			  An example of the GBS message string is:
+			  $xxGGA,time,lat,NS,long,EW,quality,numSV,HDOP,alt,M,sep,M,diffAge,diffStation*cs
+			  $GPGGA,172814.0,3723.46587704,N,12202.26957864,W,2,6,1.2,18.893,M,-25.669,M,2.0,0031*4F
+			  $GNGGA,092721.00,2926.688113,N,11127.771644,E,2,08,1.11,106.3,M,-20,M,1.0,3721*53
+
+			  Note - The data string exceeds the nmea standard length.
+			  GGA message fields
+			  Field   Meaning
+			  0   Message ID $GPGGA
+			  1   UTC of position fix
+			  2   Latitude
+			  3   Direction of latitude:
+			  N: North
+			  S: South
+			  4   Longitude
+			  5   Direction of longitude:
+			  E: East
+			  W: West
+			  6   GPS Quality indicator:
+			  0: Fix not valid
+			  1: GPS fix
+			  2: Differential GPS fix, OmniSTAR VBS
+			  4: Real-Time Kinematic, fixed integers
+			  5: Real-Time Kinematic, float integers, OmniSTAR XP/HP or Location RTK
+			  7   Number of SVs in use, range from 00 through to 24+
+			  8   HDOP
+			  9   Orthometric height (MSL reference)
+			  10  M: unit of measure for orthometric height is meters
+			  11  Geoid separation
+			  12  M: geoid separation measured in meters
+			  13  Age of differential GPS data record, Type 1 or Type 9. Null field when DGPS is not used.
+			  14  Reference station ID, range 0000-4095. A null field when any reference station ID is selected and no corrections are received1.
+			  15
+			  The checksum data, always begins with *
+			*/
+			double utc_time = 0.0;
+			int32_t lat = 0, lon = 0; // degrees * 1e7
+			float alt = 0.f, geoid_h = 0.f;
+			float hdop = 99.9f;
+			int  num_of_sv = 0, fix_quality = 0;
+			char ns = '?', ew = '?';
+
+			nmeaDouble(field(1), utc_time);
+
+			nmeaLatLon(field(2), lat);
+
+			nmeaChar(field(3), ns);
+
+			nmeaLatLon(field(4), lon);
+
+			nmeaChar(field(5), ew);
+
+			nmeaInt(field(6), fix_quality);
+
+			nmeaInt(field(7), num_of_sv);
+
+			nmeaFloat(field(8), hdop);
+
+			nmeaFloat(field(9), alt);
+
+			nmeaFloat(field(11), geoid_h);
+
+			// field 13, the age of the differential corrections, is not used
+
+			if (ns == 'S') {
+				lat = -lat;
+			}
 
-		_gps_position->cog_rad = track_rad;
-		_gps_position->c_variance_rad = 0.1f;
+			if (ew == 'W') {
+				lon = -lon;
+			}
 
-		if (!_unicore_parser.agricaValid()) {
-			_gps_position->vel_m_s = velocity_ms;
-			_gps_position->vel_n_m_s = velocity_north;
-			_gps_position->vel_e_m_s = velocity_east;
-			_gps_position->vel_ned_valid = true; /**< Flag to indicate if NED speed is valid */
-			_gps_position->s_variance_m_s = 0;
-		}
+			_gps_position->lon = lon;
+			_gps_position->lat = lat;
+			_gps_position->hdop = hdop;
+			_gps_position->alt = static_cast<int>(alt * 1000);
+			_gps_position->alt_ellipsoid = _gps_position->alt + static_cast<int>(geoid_h * 1000);
+			_sat_num_gga = static_cast<int>(num_of_sv);
 
-		_gps_position->timestamp = gps_absolute_time();
-		_last_timestamp_time = gps_absolute_time();
 
-#ifndef NO_MKTIME
-		int utc_hour = static_cast<int>(utc_time / 10000);
-		int utc_minute = static_cast<int>((utc_time - utc_hour * 10000) / 100);
-		double utc_sec = static_cast<double>(utc_time - utc_hour * 10000 - utc_minute * 100);
-		int nmea_day = static_cast<int>(nmea_date / 10000);
-		int nmea_mth = static_cast<int>((nmea_date - nmea_day * 10000) / 100);
-		int nmea_year = static_cast<int>(nmea_date - nmea_day * 10000 - nmea_mth * 100);
-		/*
-		 * convert to unix timestamp
-		 */
-		struct tm timeinfo = {};
-		timeinfo.tm_year = nmea_year + 100;
-		timeinfo.tm_mon = nmea_mth - 1;
-		timeinfo.tm_mday = nmea_day;
-		timeinfo.tm_hour = utc_hour;
-		timeinfo.tm_min = utc_minute;
-		timeinfo.tm_sec = int(utc_sec);
-		timeinfo.tm_isdst = 0;
-
-		time_t epoch = mktime(&timeinfo);
-
-		if (epoch > GPS_EPOCH_SECS) {
-			uint64_t usecs = static_cast<uint64_t>((utc_sec - static_cast<uint64_t>(utc_sec)) * 1000000);
-
-			// FMUv2+ boards have a hardware RTC, but GPS helps us to configure it
-			// and control its drift. Since we rely on the HRT for our monotonic
-			// clock, updating it from time to time is safe.
-			if (!_clock_set) {
-				timespec ts{};
-				ts.tv_sec = epoch;
-				ts.tv_nsec = usecs * 1000;
-
-				setClock(ts);
-				_clock_set = true;
+			if (fix_quality <= 0) {
+				_gps_position->fix_type = 0;
+
+			} else {
+				/*
+				 * in this NMEA message float integers (value 5) mode has higher value than fixed integers (value 4), whereas it provides lower quality,
+				 * and since value 3 is not being used, I "moved" value 5 to 3 to add it to _gps_position->fix_type
+				 */
+				if (fix_quality == 5) { fix_quality = 3; }
+
+				/*
+				 * fix quality 1 means just a normal 3D fix, so I'm subtracting 1 here. This way we'll have 3 for auto, 4 for DGPS, 5 for floats, 6 for fixed.
+				 */
+				_gps_position->fix_type = 3 + fix_quality - 1;
 			}
 
-			_gps_position->time_utc_usec = static_cast<uint64_t>(epoch) * 1000000ULL;
-			_gps_position->time_utc_usec += usecs;
+			if (!_POS_received && (_last_POS_timeUTC < utc_time)) {
+				_last_POS_timeUTC = utc_time;
+				_POS_received = true;
+				positionSentence();
+			}
 
-		} else {
-			_gps_position->time_utc_usec = 0;
+			_ALT_received = true;
+			_SVNUM_received = true;
+			_FIX_received = true;
+
+			_gps_position->c_variance_rad = 0.1f;
+			_gps_position->timestamp = messageTimestamp(frameStartTime());
 		}
+		break;
 
-#else
-		NMEA_UNUSED(utc_time);
-		NMEA_UNUSED(nmea_date);
-		_gps_position->time_utc_usec = 0;
-#endif
+	case NMEA_SENTENCE_ID('H', 'D', 'T'): {
+			if (uiCalcComma != 2) {
+				break;
+			}
 
-		if (!_POS_received && (_last_POS_timeUTC < utc_time)) {
-			_last_POS_timeUTC = utc_time;
-			_POS_received = true;
-		}
+			/*
+			Heading message
+			Example $GPHDT,121.2,T*35
+
+			f1 Last computed heading value, in degrees (0-359.99)
+			T "T" for "True"
+			 */
+
+			float heading_deg = 0.f;
 
-		if (!_VEL_received && (_last_VEL_timeUTC < utc_time)) {
-			_last_VEL_timeUTC = utc_time;
-			_VEL_received = true;
+			if (nmeaFloat(field(1), heading_deg)) {
+				handleHeading(heading_deg, NAN);
+			}
+
+			_HEAD_received = true;
 		}
+		break;
+
+	case NMEA_SENTENCE_ID('G', 'N', 'S'): {
+			if (uiCalcComma < 12) {
+				break;
+			}
+
+			/*
+			Message GNS
+			Type Output Message
+			Time and position, together with GNSS fixing related data (number of satellites in use, and
+			the resulting HDOP, age of differential data if in use, etc.).
+			Message Structure:
+			$xxGNS,time,lat,NS,long,EW,posMode,numSV,HDOP,alt,altRef,diffAge,diffStation,navStatus*cs<CR><LF>
+			Example:
+			$GPGNS,091547.00,5114.50897,N,00012.28663,W,AA,10,0.83,111.1,45.6,,,V*71
+			$GNGNS,092721.00,2926.68811,N,11127.77164,E,DNNN,08,1.11,106.3,-20,1.0,3721,V*0D
+
+			FieldNo.  Name    Unit     Format                  Example Description
+			0        xxGNS    -       string            $GPGNS GNS Message ID (xx = current Talker ID)
+			1        time     -       hhmmss.ss         091547.00 UTC time, see note on UTC representation
+			2        lat      -       ddmm.mmmmm        5114.50897 Latitude (degrees & minutes), see format description
+			3        NS       -       character         N North/South indicator
+			4        long     -       dddmm.mmmmm       00012.28663 Longitude (degrees & minutes), see format description
+			5        EW       -       character         E East/West indicator
+			6      posMode    -       character         AA Positioning mode, see position fix flags description. First character for GPS, second character forGLONASS
+			7       numSV     -       numeric         10 Number of satellites used (range: 0-99)
+			8         HDOP    -       numeric         0.83 Horizontal Dilution of Precision
+			9         alt     m       numeric         111.1 Altitude above mean sea level
+			10        sep    m        numeric         45.6 Geoid separation: difference between ellipsoid and mean sea level UBX-18010854 - R05 Advance Information Page 18 of 262 u-blox ZED-F9P Interface Description - Manual GNS continued
+			11    diffAge    s        numeric         - Age of differential corrections (blank when DGPS is not used)
+			12 diffStation   -        numeric         - ID of station providing differential corrections (blank when DGPS is not used)
+			13 navStatus    -         character         V Navigational status indicator (V = Equipment is not providing navigational status information) NMEA v4.10 and above only
+			14 cs - hexadecimal *71   Checksum
+			15 <CR><LF> - character - Carriage return and line feed
+			*/
+			double utc_time = 0.0;
+			int32_t lat = 0, lon = 0; // degrees * 1e7
+			int num_of_sv = 0;
+			float alt = 0.f;
+			float hdop = 0.f;
+			char ns = '?', ew = '?';
+
+			nmeaDouble(field(1), utc_time);
+
+			nmeaLatLon(field(2), lat);
+
+			nmeaChar(field(3), ns);
+
+			nmeaLatLon(field(4), lon);
+
+			nmeaChar(field(5), ew);
+
+			// field 6, the positioning mode, is not used
+
+			nmeaInt(field(7), num_of_sv);
+
+			nmeaFloat(field(8), hdop);
+
+			nmeaFloat(field(9), alt);
+
+			if (ns == 'S') {
+				lat = -lat;
+			}
 
-		_TIME_received = true;
+			if (ew == 'W') {
+				lon = -lon;
+			}
 
-	}	else if ((memcmp(_rx_buffer + 3, "GST,", 4) == 0) && (uiCalcComma == 8)) {
+			_gps_position->lat = lat;
+			_gps_position->lon = lon;
+			_gps_position->hdop = hdop;
+			_gps_position->alt = static_cast<int>(alt * 1000);
+			_sat_num_gns = static_cast<int>(num_of_sv);
 
-		/*
-		Position error statistics
-		An example of the GST message string is:
+			if (!_POS_received && (_last_POS_timeUTC < utc_time)) {
+				_last_POS_timeUTC = utc_time;
+				_POS_received = true;
+				positionSentence();
+			}
 
-		$GPGST,172814.0,0.006,0.023,0.020,273.6,0.023,0.020,0.031*6A
-		$GNGST,091200.54,45,,,,1.2,0.77,2.2*70
-		$GNGST,092720.50,43,,,,2.6,2.6,5.9*49
+			_ALT_received = true;
+			_SVNUM_received = true;
+		}
+		break;
 
-		The Talker ID ($--) will vary depending on the satellite system used for the position solution:
+	case NMEA_SENTENCE_ID('R', 'M', 'C'): {
+			if (uiCalcComma < 11) {
+				break;
+			}
 
-		$GP - GPS only
-		$GL - GLONASS only
-		$GN - Combined
-		GST message fields
-		Field   Meaning
-		0   Message ID $GPGST
-		1   UTC of position fix
-		2   RMS value of the pseudorange residuals; includes carrier phase residuals during periods of RTK (float) and RTK (fixed) processing
-		3   Error ellipse semi-major axis 1 sigma error, in meters
-		4   Error ellipse semi-minor axis 1 sigma error, in meters
-		5   Error ellipse orientation, degrees from true north
-		6   Latitude 1 sigma error, in meters
-		7   Longitude 1 sigma error, in meters
-		8   Height 1 sigma error, in meters
-		9   The checksum data, always begins with *
-		*/
-		double utc_time = 0.0;
-		float lat_err = 0.f, lon_err = 0.f, alt_err = 0.f;
-		float min_err = 0.f, maj_err = 0.f, deg_from_north = 0.f, rms_err = 0.f;
+			/*
+			Position, velocity, and time
+			The RMC string is:
 
-		NMEA_UNUSED(min_err);
-		NMEA_UNUSED(maj_err);
-		NMEA_UNUSED(deg_from_north);
-		NMEA_UNUSED(rms_err);
+			$xxRMC,time,status,lat,NS,long,EW,spd,cog,date,mv,mvEW,posMode,navStatus*cs<CR><LF>
+			The Talker ID ($--) will vary depending on the satellite system used for the position solution:
+			$GNRMC,092721.00,A,2926.688113,N,11127.771644,E,0.780,,200520,,,D,V*1D
 
-		if (bufptr && *(++bufptr) != ',') { utc_time = strtod(bufptr, &endp); bufptr = endp; }
+			GPRMC message fields
+			Field	Meaning
+			0	Message ID $GPRMC
+			1	UTC of position fix
+			2	Status A=active or V=void
+			3	Latitude
+			4	Longitude
+			5	Speed over the ground in knots
+			6	Track angle in degrees (True)
+			7	Date
+			8	Magnetic variation in degrees
+			9	The checksum data, always begins with *
+			*/
+			double utc_time = 0.0;
+			char Status = 'V';
+			int32_t lat = 0, lon = 0; // degrees * 1e7
+			float ground_speed_K = 0.f;
+			float track_true = 0.f;
+			int nmea_date = 0;
+			char ns = '?', ew = '?';
 
-		if (bufptr && *(++bufptr) != ',') { rms_err = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaDouble(field(1), utc_time);
 
-		if (bufptr && *(++bufptr) != ',') { maj_err = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaChar(field(2), Status);
 
-		if (bufptr && *(++bufptr) != ',') { min_err = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaLatLon(field(3), lat);
 
-		if (bufptr && *(++bufptr) != ',') { deg_from_north = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaChar(field(4), ns);
 
-		if (bufptr && *(++bufptr) != ',') { lat_err = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaLatLon(field(5), lon);
 
-		if (bufptr && *(++bufptr) != ',') { lon_err = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaChar(field(6), ew);
 
-		if (bufptr && *(++bufptr) != ',') { alt_err = strtof(bufptr, &endp); bufptr = endp; }
+			nmeaFloat(field(7), ground_speed_K);
 
-		_gps_position->eph = sqrtf(static_cast<float>(lat_err) * static_cast<float>(lat_err)
-					   + static_cast<float>(lon_err) * static_cast<float>(lon_err));
-		_gps_position->epv = static_cast<float>(alt_err);
+			nmeaFloat(field(8), track_true);
 
-		_EPH_received = true;
-		_last_FIX_timeUTC = utc_time;
+			nmeaInt(field(9), nmea_date);
 
-	} else if ((memcmp(_rx_buffer + 3, "GSA,", 4) == 0) && (uiCalcComma >= 17)) {
+			// field 10, the magnetic variation, is not used
 
-		/*
-		GPS DOP and active satellites
-		An example of the GSA message string is:
-		$GPGSA,<1>,<2>,<3>,<3>,,,,,<3>,<3>,<3>,<4>,<5>,<6>*<7><CR><LF>
-		$GNGSA,A,3,82,67,74,68,73,80,83,,,,,,0.99,0.53,0.84,2*09
-		$GNGSA,A,3,12,19,06,17,02,09,28,05,,,,,2.38,1.10,2.11,1*05
-		$GNGSA,A,3,27,04,16,08,09,26,31,11,,,,,1.96,1.05,1.65,1*08
+			if (ns == 'S') {
+				lat = -lat;
+			}
 
-		GSA message fields
-		Field	Meaning
-		0	Message ID $GPGSA
-		1	Mode 1, M = manual, A = automatic
-		2	Mode 2, Fix type, 1 = not available, 2 = 2D, 3 = 3D
-		3	PRN number, 01 through 32 for GPS, 33 through 64 for SBAS, 64+ for GLONASS
-		4 	PDOP: 0.5 through 99.9
-		5	HDOP: 0.5 through 99.9
-		6	VDOP: 0.5 through 99.9
-		7	The checksum data, always begins with *
-		*/
-		char M_pos = ' ';
-		int fix_mode = 0;
-		int sat_id[12] {0};
-		float pdop = 99.9f, hdop = 99.9f, vdop = 99.9f;
+			if (ew == 'W') {
+				lon = -lon;
+			}
 
-		NMEA_UNUSED(M_pos);
-		NMEA_UNUSED(sat_id);
-		NMEA_UNUSED(pdop);
+			if (Status == 'V') {
+				_gps_position->fix_type = 0;
+			}
 
-		if (bufptr && *(++bufptr) != ',') { M_pos = *(bufptr++); }
+			float track_rad = track_true * M_PI_F / 180.0f; // rad in range [0, 2pi]
 
-		if (bufptr && *(++bufptr) != ',') { fix_mode = strtol(bufptr, &endp, 10); bufptr = endp; }
+			if (track_rad > M_PI_F) {
+				track_rad -= 2.f * M_PI_F; // rad in range [-pi, pi]
+			}
 
-		for (int y = 0; y < 12; y++) {
-			if (bufptr && *(++bufptr) != ',') {sat_id[y] = strtol(bufptr, &endp, 10); bufptr = endp; }
-		}
+			float velocity_ms = ground_speed_K / 1.9438445f;
+			float velocity_north = velocity_ms * cosf(track_rad);
+			float velocity_east  = velocity_ms * sinf(track_rad);
 
-		if (bufptr && *(++bufptr) != ',') { pdop = strtof(bufptr, &endp); bufptr = endp; }
+			_gps_position->lat = lat;
+			_gps_position->lon = lon;
 
-		if (bufptr && *(++bufptr) != ',') { hdop = strtof(bufptr, &endp); bufptr = endp; }
+			_gps_position->cog_rad = track_rad;
+			_gps_position->c_variance_rad = 0.1f;
 
-		if (bufptr && *(++bufptr) != ',') { vdop = strtof(bufptr, &endp); bufptr = endp; }
+			if (!_unicore_parser.agricaValid()) {
+				_gps_position->vel_m_s = velocity_ms;
+				_gps_position->vel_n_m_s = velocity_north;
+				_gps_position->vel_e_m_s = velocity_east;
+				_gps_position->vel_ned_valid = true; /**< Flag to indicate if NED speed is valid */
+				_gps_position->s_variance_m_s = 0;
+			}
 
-		if (fix_mode <= 1) {
-			_gps_position->fix_type = 0;
+			_gps_position->timestamp = messageTimestamp(frameStartTime());
+			_last_timestamp_time = messageTimestamp(frameStartTime());
 
-		} else {
-			_gps_position->hdop = static_cast<float>(hdop);
-			_gps_position->vdop = static_cast<float>(vdop);
-			_DOP_received = true;
+#ifndef NO_MKTIME
+			int utc_hour = static_cast<int>(utc_time / 10000);
+			int utc_minute = static_cast<int>((utc_time - utc_hour * 10000) / 100);
+			double utc_sec = static_cast<double>(utc_time - utc_hour * 10000 - utc_minute * 100);
+			int nmea_day = static_cast<int>(nmea_date / 10000);
+			int nmea_mth = static_cast<int>((nmea_date - nmea_day * 10000) / 100);
+			int nmea_year = static_cast<int>(nmea_date - nmea_day * 10000 - nmea_mth * 100);
+			/*
+			 * convert to unix timestamp
+			 */
+			struct tm timeinfo = {};
+			timeinfo.tm_year = nmea_year + 100;
+			timeinfo.tm_mon = nmea_mth - 1;
+			timeinfo.tm_mday = nmea_day;
+			timeinfo.tm_hour = utc_hour;
+			timeinfo.tm_min = utc_minute;
+			timeinfo.tm_sec = int(utc_sec);
+			timeinfo.tm_isdst = 0;
+
+			time_t epoch = mktime(&timeinfo);
+
+			if (epoch > GPS_EPOCH_SECS) {
+				uint64_t usecs = static_cast<uint64_t>((utc_sec - static_cast<uint64_t>(utc_sec)) * 1000000);
+
+				// FMUv2+ boards have a hardware RTC, but GPS helps us to configure it
+				// and control its drift. Since we rely on the HRT for our monotonic
+				// clock, updating it from time to time is safe.
+				if (!_clock_set) {
+					timespec ts{};
+					ts.tv_sec = epoch;
+					ts.tv_nsec = usecs * 1000;
+
+					setClock(ts);
+					_clock_set = true;
+				}
 
-		}
+				_gps_position->time_utc_usec = static_cast<uint64_t>(epoch) * 1000000ULL;
+				_gps_position->time_utc_usec += usecs;
 
+			} else {
+				_gps_position->time_utc_usec = 0;
+			}
 
-	} else if ((memcmp(_rx_buffer + 3, "GSV,", 4) == 0)) {
-		/*
-		The GSV message string identifies the number of SVs in view, the PRN numbers, elevations, azimuths, and SNR values. An example of the GSV message string is:
+#else
+			NMEA_UNUSED(utc_time);
+			NMEA_UNUSED(nmea_date);
+			_gps_position->time_utc_usec = 0;
+#endif
 
-		$GPGSV,4,1,13,02,02,213,,03,-3,000,,11,00,121,,14,13,172,05*67
+			if (!_POS_received && (_last_POS_timeUTC < utc_time)) {
+				_last_POS_timeUTC = utc_time;
+				_POS_received = true;
+				positionSentence();
+			}
 
-		GSV message fields
-		Field   Meaning
-		0   Message ID $GPGSV
-		1   Total number of messages of this type in this cycle
-		2   Message number
-		3   Total number of SVs visible
-		4   SV PRN number
-		5   Elevation, in degrees, 90 maximum
-		6   Azimuth, degrees from True North, 000 through 359
-		7   SNR, 00 through 99 dB (null when not tracking)
-		8-11    Information about second SV, same format as fields 4 through 7
-		12-15   Information about third SV, same format as fields 4 through 7
-		16-19   Information about fourth SV, same format as fields 4 through 7
-		20  The checksum data, always begins with *
-		*/
+			if (!_VEL_received && (_last_VEL_timeUTC < utc_time)) {
+				_last_VEL_timeUTC = utc_time;
+				_VEL_received = true;
+				statsPositionFrame();
+			}
 
-		int all_page_num = 0, this_page_num = 0, tot_sv_visible = 0;
-		struct gsv_sat {
-			int svid;
-			int elevation;
-			int azimuth;
-			int snr;
-		} sat[4] {};
+			_TIME_received = true;
+		}
+		break;
 
-		if (bufptr && *(++bufptr) != ',') { all_page_num = strtol(bufptr, &endp, 10); bufptr = endp; }
+	case NMEA_SENTENCE_ID('G', 'S', 'T'): {
+			if (uiCalcComma != 8) {
+				break;
+			}
 
-		if (bufptr && *(++bufptr) != ',') { this_page_num = strtol(bufptr, &endp, 10); bufptr = endp; }
+			/*
+			Position error statistics
+			An example of the GST message string is:
+
+			$GPGST,172814.0,0.006,0.023,0.020,273.6,0.023,0.020,0.031*6A
+			$GNGST,091200.54,45,,,,1.2,0.77,2.2*70
+			$GNGST,092720.50,43,,,,2.6,2.6,5.9*49
+
+			The Talker ID ($--) will vary depending on the satellite system used for the position solution:
+
+			$GP - GPS only
+			$GL - GLONASS only
+			$GN - Combined
+			GST message fields
+			Field   Meaning
+			0   Message ID $GPGST
+			1   UTC of position fix
+			2   RMS value of the pseudorange residuals; includes carrier phase residuals during periods of RTK (float) and RTK (fixed) processing
+			3   Error ellipse semi-major axis 1 sigma error, in meters
+			4   Error ellipse semi-minor axis 1 sigma error, in meters
+			5   Error ellipse orientation, degrees from true north
+			6   Latitude 1 sigma error, in meters
+			7   Longitude 1 sigma error, in meters
+			8   Height 1 sigma error, in meters
+			9   The checksum data, always begins with *
+			*/
+			double utc_time = 0.0;
+			float lat_err = 0.f, lon_err = 0.f, alt_err = 0.f;
+
+			nmeaDouble(field(1), utc_time);
+
+			// fields 2 to 5, the residuals and the error ellipse, are not used
+
+			nmeaFloat(field(6), lat_err);
+
+			nmeaFloat(field(7), lon_err);
+
+			nmeaFloat(field(8), alt_err);
+
+			_gps_position->eph = sqrtf(static_cast<float>(lat_err) * static_cast<float>(lat_err)
+						   + static_cast<float>(lon_err) * static_cast<float>(lon_err));
+			_gps_position->epv = static_cast<float>(alt_err);
+
+			_EPH_received = true;
+			_last_FIX_timeUTC = utc_time;
+		}
+		break;
 
-		if (bufptr && *(++bufptr) != ',') { tot_sv_visible = strtol(bufptr, &endp, 10); bufptr = endp; }
+	case NMEA_SENTENCE_ID('G', 'S', 'A'): {
+			if (uiCalcComma < 17) {
+				break;
+			}
 
-		if ((this_page_num < 1) || (this_page_num > all_page_num)) {
-			return 0;
+			/*
+			GPS DOP and active satellites
+			An example of the GSA message string is:
+			$GPGSA,<1>,<2>,<3>,<3>,,,,,<3>,<3>,<3>,<4>,<5>,<6>*<7><CR><LF>
+			$GNGSA,A,3,82,67,74,68,73,80,83,,,,,,0.99,0.53,0.84,2*09
+			$GNGSA,A,3,12,19,06,17,02,09,28,05,,,,,2.38,1.10,2.11,1*05
+			$GNGSA,A,3,27,04,16,08,09,26,31,11,,,,,1.96,1.05,1.65,1*08
+
+			GSA message fields
+			Field	Meaning
+			0	Message ID $GPGSA
+			1	Mode 1, M = manual, A = automatic
+			2	Mode 2, Fix type, 1 = not available, 2 = 2D, 3 = 3D
+			3	PRN number, 01 through 32 for GPS, 33 through 64 for SBAS, 64+ for GLONASS
+			4 	PDOP: 0.5 through 99.9
+			5	HDOP: 0.5 through 99.9
+			6	VDOP: 0.5 through 99.9
+			7	The checksum data, always begins with *
+			*/
+			int fix_mode = 0;
+			float hdop = 99.9f, vdop = 99.9f;
+
+			nmeaInt(field(2), fix_mode);
+
+			// the mode, the 12 satellite IDs and the PDOP (fields 1 and 3 to 15) are not used
+
+			nmeaFloat(field(16), hdop);
+
+			nmeaFloat(field(17), vdop);
+
+			if (fix_mode <= 1) {
+				_gps_position->fix_type = 0;
+
+			} else {
+				_gps_position->hdop = static_cast<float>(hdop);
+				_gps_position->vdop = static_cast<float>(vdop);
+				_DOP_received = true;
+
+			}
 		}
+		break;
 
-		if (memcmp(_rx_buffer, "$GP", 3) == 0) {
-			_sat_num_gpgsv = tot_sv_visible;
+	case NMEA_SENTENCE_ID('G', 'S', 'V'): {
+			/*
+			The GSV message string identifies the number of SVs in view, the PRN numbers, elevations, azimuths, and SNR values. An example of the GSV message string is:
 
-		} else if (memcmp(_rx_buffer, "$GL", 3) == 0) {
-			_sat_num_glgsv = tot_sv_visible;
+			$GPGSV,4,1,13,02,02,213,,03,-3,000,,11,00,121,,14,13,172,05*67
 
-		} else if (memcmp(_rx_buffer, "$GA", 3) == 0) {
-			_sat_num_gagsv = tot_sv_visible;
+			GSV message fields
+			Field   Meaning
+			0   Message ID $GPGSV
+			1   Total number of messages of this type in this cycle
+			2   Message number
+			3   Total number of SVs visible
+			4   SV PRN number
+			5   Elevation, in degrees, 90 maximum
+			6   Azimuth, degrees from True North, 000 through 359
+			7   SNR, 00 through 99 dB (null when not tracking)
+			8-11    Information about second SV, same format as fields 4 through 7
+			12-15   Information about third SV, same format as fields 4 through 7
+			16-19   Information about fourth SV, same format as fields 4 through 7
+			20  The checksum data, always begins with *
+			*/
 
-		} else if (memcmp(_rx_buffer, "$GB", 3) == 0) {
-			_sat_num_gbgsv = tot_sv_visible;
+			int all_page_num = 0, this_page_num = 0, tot_sv_visible = 0;
 
-		} else if (memcmp(_rx_buffer, "$BD", 3) == 0) {
-			_sat_num_bdgsv = tot_sv_visible;
+			nmeaInt(field(1), all_page_num);
 
-		}
+			nmeaInt(field(2), this_page_num);
 
-		if (this_page_num == 0 && _satellite_info) {
-			memset(_satellite_info->svid,     0, sizeof(_satellite_info->svid));
-			memset(_satellite_info->used,     0, sizeof(_satellite_info->used));
-			memset(_satellite_info->snr,      0, sizeof(_satellite_info->snr));
-			memset(_satellite_info->elevation, 0, sizeof(_satellite_info->elevation));
-			memset(_satellite_info->azimuth,  0, sizeof(_satellite_info->azimuth));
-		}
+			nmeaInt(field(3), tot_sv_visible);
+
+			if ((this_page_num < 1) || (this_page_num > all_page_num)) {
+				return 0;
+			}
 
-		int end = 4;
+			switch (NMEA_TALKER_ID(_rx_buffer[1], _rx_buffer[2])) {
+			case NMEA_TALKER_ID('G', 'P'): _sat_num_gpgsv = tot_sv_visible; break;
 
-		if (this_page_num == all_page_num) {
-			end =  tot_sv_visible - (this_page_num - 1) * 4;
+			case NMEA_TALKER_ID('G', 'L'): _sat_num_glgsv = tot_sv_visible; break;
 
-			_SVNUM_received = true;
-			_SVINFO_received = true;
+			case NMEA_TALKER_ID('G', 'A'): _sat_num_gagsv = tot_sv_visible; break;
 
-			if (_satellite_info) {
-				_satellite_info->count = satellite_info_s::SAT_INFO_MAX_SATELLITES;
-				_satellite_info->timestamp = gps_absolute_time();
+			case NMEA_TALKER_ID('G', 'B'): _sat_num_gbgsv = tot_sv_visible; break;
+
+			case NMEA_TALKER_ID('B', 'D'): _sat_num_bdgsv = tot_sv_visible; break;
 			}
-		}
 
-		if (_satellite_info) {
-			for (int y = 0 ; y < end ; y++) {
-				if (bufptr && *(++bufptr) != ',') { sat[y].svid = strtol(bufptr, &endp, 10); bufptr = endp; }
+			// the satellites are only decoded while somebody consumes them
+			satellite_info_s *satellite_info = satelliteInfoEnabled() ? _satellite_info : nullptr;
+
+			if (this_page_num == 0 && satellite_info) {
+				memset(satellite_info->svid,     0, sizeof(satellite_info->svid));
+				memset(satellite_info->used,     0, sizeof(satellite_info->used));
+				memset(satellite_info->snr,      0, sizeof(satellite_info->snr));
+				memset(satellite_info->elevation, 0, sizeof(satellite_info->elevation));
+				memset(satellite_info->azimuth,  0, sizeof(satellite_info->azimuth));
+			}
 
-				if (bufptr && *(++bufptr) != ',') { sat[y].elevation = strtol(bufptr, &endp, 10); bufptr = endp; }
+			int end = 4;
 
-				if (bufptr && *(++bufptr) != ',') { sat[y].azimuth = strtol(bufptr, &endp, 10); bufptr = endp; }
+			if (this_page_num == all_page_num) {
+				end =  tot_sv_visible - (this_page_num - 1) * 4;
 
-				if (bufptr && *(++bufptr) != ',') { sat[y].snr = strtol(bufptr, &endp, 10); bufptr = endp; }
+				_SVNUM_received = true;
+				_SVINFO_received = true;
 
-				_satellite_info->svid[y + (this_page_num - 1) * 4]      = sat[y].svid;
-				_satellite_info->used[y + (this_page_num - 1) * 4]      = (sat[y].snr > 0);
-				_satellite_info->snr[y + (this_page_num - 1) * 4]       = sat[y].snr;
-				_satellite_info->elevation[y + (this_page_num - 1) * 4] = sat[y].elevation;
-				_satellite_info->azimuth[y + (this_page_num - 1) * 4]   = sat[y].azimuth;
+				if (satellite_info) {
+					satellite_info->count = satellite_info_s::SAT_INFO_MAX_SATELLITES;
+					satellite_info->timestamp = gps_absolute_time();
+				}
 			}
-		}
 
+			if (satellite_info) {
+				// 4 satellites per page, don't trust the counts to stay within the arrays
+				for (int y = 0 ; y < end && y < 4; y++) {
+					const int sat_index = y + (this_page_num - 1) * 4;
+
+					if (sat_index >= satellite_info_s::SAT_INFO_MAX_SATELLITES) {
+						break;
+					}
+
+					int svid = 0, elevation = 0, azimuth = 0, snr = 0;
 
-	} else if ((memcmp(_rx_buffer + 3, "VTG,", 4) == 0) && (uiCalcComma >= 8)) {
+					nmeaInt(field(4 + y * 4), svid);
 
-		/*$GNVTG,,T,,M,0.683,N,1.265,K*30
-		  $GNVTG,,T,,M,0.780,N,1.445,K*33
+					nmeaInt(field(5 + y * 4), elevation);
 
-		Field	Meaning
-		0	Message ID $GPVTG
-		1	Track made good (degrees true)
-		2	T: track made good is relative to true north
-		3	Track made good (degrees magnetic)
-		4	M: track made good is relative to magnetic north
-		5	Speed, in knots
-		6	N: speed is measured in knots
-		7	Speed over ground in kilometers/hour (kph)
-		8	K: speed over ground is measured in kph
-		9	The checksum data, always begins with *
-		*/
+					nmeaInt(field(6 + y * 4), azimuth);
 
-		float track_true = 0.f;
-		char T;
-		float track_mag = 0.f;
-		char M;
-		float ground_speed = 0.f;
-		char N;
-		float ground_speed_K = 0.f;
-		char K;
-		NMEA_UNUSED(T);
-		NMEA_UNUSED(track_mag);
-		NMEA_UNUSED(M);
-		NMEA_UNUSED(N);
-		NMEA_UNUSED(ground_speed_K);
-		NMEA_UNUSED(K);
+					nmeaInt(field(7 + y * 4), snr);
 
-		if (bufptr && *(++bufptr) != ',') {track_true = strtof(bufptr, &endp); bufptr = endp; }
+					satellite_info->svid[sat_index]      = svid;
+					satellite_info->used[sat_index]      = (snr > 0);
+					satellite_info->snr[sat_index]       = snr;
+					satellite_info->elevation[sat_index] = elevation;
+					satellite_info->azimuth[sat_index]   = azimuth;
+				}
+			}
+		}
+		break;
 
-		if (bufptr && *(++bufptr) != ',') { T = *(bufptr++); }
+	case NMEA_SENTENCE_ID('V', 'T', 'G'): {
+			if (uiCalcComma < 8) {
+				break;
+			}
 
-		if (bufptr && *(++bufptr) != ',') {track_mag = strtof(bufptr, &endp); bufptr = endp; }
+			/*$GNVTG,,T,,M,0.683,N,1.265,K*30
+			  $GNVTG,,T,,M,0.780,N,1.445,K*33
 
-		if (bufptr && *(++bufptr) != ',') { M = *(bufptr++); }
+			Field	Meaning
+			0	Message ID $GPVTG
+			1	Track made good (degrees true)
+			2	T: track made good is relative to true north
+			3	Track made good (degrees magnetic)
+			4	M: track made good is relative to magnetic north
+			5	Speed, in knots
+			6	N: speed is measured in knots
+			7	Speed over ground in kilometers/hour (kph)
+			8	K: speed over ground is measured in kph
+			9	The checksum data, always begins with *
+			*/
 
-		if (bufptr && *(++bufptr) != ',') { ground_speed = strtof(bufptr, &endp); bufptr = endp; }
+			float track_true = 0.f;
+			float ground_speed = 0.f;
 
-		if (bufptr && *(++bufptr) != ',') { N = *(bufptr++); }
+			nmeaFloat(field(1), track_true);
 
-		if (bufptr && *(++bufptr) != ',') { ground_speed_K = strtof(bufptr, &endp); bufptr = endp; }
+			// the magnetic track and the speed in km/h (fields 3 and 7) are not used
 
-		if (bufptr && *(++bufptr) != ',') { K = *(bufptr++); }
+			nmeaFloat(field(5), ground_speed);
 
-		float track_rad = track_true * M_PI_F / 180.0f; // rad in range [0, 2pi]
+			float track_rad = track_true * M_PI_F / 180.0f; // rad in range [0, 2pi]
 
-		if (track_rad > M_PI_F) {
-			track_rad -= 2.f * M_PI_F; // rad in range [-pi, pi]
-		}
+			if (track_rad > M_PI_F) {
+				track_rad -= 2.f * M_PI_F; // rad in range [-pi, pi]
+			}
 
-		float velocity_ms = ground_speed / 1.9438445f;
-		float velocity_north = velocity_ms * cosf(track_rad);
-		float velocity_east  = velocity_ms * sinf(track_rad);
+			float velocity_ms = ground_speed / 1.9438445f;
+			float velocity_north = velocity_ms * cosf(track_rad);
+			float velocity_east  = velocity_ms * sinf(track_rad);
 
-		_gps_position->vel_m_s = velocity_ms;
-		_gps_position->vel_n_m_s = velocity_north;
-		_gps_position->vel_e_m_s = velocity_east;
-		_gps_position->cog_rad = track_rad;
-		_gps_position->vel_ned_valid = true; /** Flag to indicate if NED speed is valid */
-		_gps_position->c_variance_rad = 0.1f;
-		_gps_position->s_variance_m_s = 0;
+			_gps_position->vel_m_s = velocity_ms;
+			_gps_position->vel_n_m_s = velocity_north;
+			_gps_position->vel_e_m_s = velocity_east;
+			_gps_position->cog_rad = track_rad;
+			_gps_position->vel_ned_valid = true; /** Flag to indicate if NED speed is valid */
+			_gps_position->c_variance_rad = 0.1f;
+			_gps_position->s_variance_m_s = 0;
 
-		if (!_VEL_received) {
-			_VEL_received = true;
+			if (!_VEL_received) {
+				_VEL_received = true;
+				statsPositionFrame();
+			}
 		}
+		break;
 	}
 
 	if (_sat_num_gga > 0) {
@@ -859,6 +1046,15 @@ int GPSDriverNMEA::handleMessage(int len)
 
 	if (_VEL_received && _POS_received) {
 		ret = 1;
+		statsUpdate();
+
+		alignHeading(utcTimeOfDay(_last_POS_timeUTC));
+
+		if (getTimestampMode() != TimestampMode::Parsed) {
+			_gps_position->timestamp = messageTimestamp(_epoch_rx_time);
+		}
+
+		_epoch_rx_time = 0;
 		_gps_position->timestamp_time_relative = (int32_t)(_last_timestamp_time - _gps_position->timestamp);
 		_clock_set = false;
 		_VEL_received = false;
@@ -890,76 +1086,116 @@ int GPSDriverNMEA::receive(unsigned timeout)
 		} else if (ret != 0) {
 
 			/* pass received bytes to the packet decoder */
-			for (int i = 0; i < ret; i++) {
-				int l = parseChar(buf[i]);
+			handled |= feed(buf, ret);
 
-				if (l > 0) {
-					handled |= handleMessage(l);
-				}
+			if (handled > 0) {
+				return handled;
+			}
+		}
 
-				UnicoreParser::Result result = _unicore_parser.parseChar(buf[i]);
-
-				if (result == UnicoreParser::Result::GotHeading) {
-					handled+=2;//kcx064
-					_unicore_heading_received_last = gps_absolute_time();
-
-					// Unicore seems to publish heading and standard deviation of 0
-					// to signal that it has not initialized the heading yet.
-					if (_unicore_parser.heading().heading_stddev_deg > 0.0f) {
-						// Unicore publishes the heading between True North and
-						// the baseline vector from master antenna to slave
-						// antenna.
-						// Assuming that the master is in front and the slave
-						// in the back, this means that we need to flip the
-						// heading 180 degrees.
-
-						handleHeading(
-							_unicore_parser.heading().heading_deg + 180.0f,
-							_unicore_parser.heading().heading_stddev_deg);
-					}
+		/* abort after timeout if no useful packets received */
+		if (time_started + timeout * 1000 < gps_absolute_time()) {
+			return -1;
+		}
+	}
+}
 
-					NMEA_DEBUG("Got heading: %.1f deg, stddev: %.1f deg, baseline: %.2f m\n",
-						   (double)_unicore_parser.heading().heading_deg,
-						   (double)_unicore_parser.heading().heading_stddev_deg,
-						   (double)_unicore_parser.heading().baseline_m);
+int GPSDriverNMEA::feed(const uint8_t *buf, size_t buf_length)
+{
+	int handled = 0;
+	statsBytesReceived(buf_length);
+	receivedData(buf_length);
+	_report_hold.resume(*_gps_position);
 
-				} else if (result == UnicoreParser::Result::GotAgrica) {
-					++handled;
+	/* pass received bytes to the packet decoder */
+	for (size_t i = 0; i < buf_length; i++) {
+		i += parseRun(buf + i, buf_length - i);
 
-					// Receiving this message tells us that we are talking to a UM982. If
-					// UNIHEADINGA is not configured by default, we request it now.
+		if (i >= buf_length) {
+			break;
+		}
 
-					if (gps_absolute_time() - _unicore_heading_received_last > 1000000) {
-						request_unicore_heading_message();
-					}
+		if (buf[i] == '$' && (_decode_state == NMEADecodeState::uninit || _decode_state == NMEADecodeState::got_sync1)) {
+			frameStart(i);
+		}
 
-					_gps_position->vel_m_s = _unicore_parser.agrica().velocity_m_s;
-					_gps_position->vel_n_m_s = _unicore_parser.agrica().velocity_north_m_s;
-					_gps_position->vel_e_m_s = _unicore_parser.agrica().velocity_east_m_s;
-					_gps_position->vel_d_m_s = -_unicore_parser.agrica().velocity_up_m_s;
-					_gps_position->s_variance_m_s =
-						(_unicore_parser.agrica().stddev_velocity_north_m_s * _unicore_parser.agrica().stddev_velocity_north_m_s +
-						 _unicore_parser.agrica().stddev_velocity_east_m_s * _unicore_parser.agrica().stddev_velocity_east_m_s +
-						 _unicore_parser.agrica().stddev_velocity_up_m_s * _unicore_parser.agrica().stddev_velocity_up_m_s)
-						/ 3.0f;
-
-					_gps_position->vel_ned_valid = true;
-				}
-			}
+		int l = parseChar(buf[i]);
 
-			if (handled > 0) {
-				return handled;
+		if (l > 0) {
+			const int ret = handleMessage(l);
+
+			// the rest of the read can start the next epoch
+			if ((ret & 1) && i + 1 < buf_length) {
+				_report_hold.hold(*_gps_position);
 			}
+
+			handled |= ret;
 		}
 
-		/* abort after timeout if no useful packets received */
-		if (time_started + timeout * 1000 < gps_absolute_time()) {
-			return -1;
+		UnicoreParser::Result result = _unicore_parser.parseChar(buf[i]);
+
+		if (result == UnicoreParser::Result::GotHeading) {
+			_unicore_heading_received_last = gps_absolute_time();
+			const UnicoreParser::Heading heading = _unicore_parser.heading();
+
+			// Unicore seems to publish heading and standard deviation of 0
+			// to signal that it has not initialized the heading yet.
+			if (heading.heading_stddev_deg > 0.0f) {
+				// Unicore publishes the heading between True North and
+				// the baseline vector from master antenna to slave
+				// antenna.
+				// Assuming that the master is in front and the slave
+				// in the back, this means that we need to flip the
+				// heading 180 degrees.
+
+				// written into the update of the same time
+				_heading_aligner.add(unicoreTimeOfDay(heading.time_of_week_ms, heading.leap_seconds),
+						     headingRad(heading.heading_deg + 180.0f), heading.heading_stddev_deg * M_PI_F / 180.0f);
+			}
+
+			NMEA_DEBUG("Got heading: %.1f deg, stddev: %.1f deg, baseline: %.2f m\n",
+				   (double)_unicore_parser.heading().heading_deg,
+				   (double)_unicore_parser.heading().heading_stddev_deg,
+				   (double)_unicore_parser.heading().baseline_m);
+
+		} else if (result == UnicoreParser::Result::GotAgrica) {
+			++handled;
+
+			// Receiving this message tells us that we are talking to a UM982. If
+			// UNIHEADINGA is not configured by default, we request it now.
+
+			if (gps_absolute_time() - _unicore_heading_received_last > 1000000) {
+				request_unicore_heading_message();
+			}
+
+			_gps_position->vel_m_s = _unicore_parser.agrica().velocity_m_s;
+			_gps_position->vel_n_m_s = _unicore_parser.agrica().velocity_north_m_s;
+			_gps_position->vel_e_m_s = _unicore_parser.agrica().velocity_east_m_s;
+			_gps_position->vel_d_m_s = -_unicore_parser.agrica().velocity_up_m_s;
+			_gps_position->s_variance_m_s =
+				(_unicore_parser.agrica().stddev_velocity_north_m_s * _unicore_parser.agrica().stddev_velocity_north_m_s +
+				 _unicore_parser.agrica().stddev_velocity_east_m_s * _unicore_parser.agrica().stddev_velocity_east_m_s +
+				 _unicore_parser.agrica().stddev_velocity_up_m_s * _unicore_parser.agrica().stddev_velocity_up_m_s)
+				/ 3.0f;
+
+			_gps_position->vel_ned_valid = true;
+			alignHeading(unicoreTimeOfDay(_unicore_parser.agrica().time_of_week_ms, _unicore_parser.agrica().leap_seconds));
 		}
 	}
+
+	_report_hold.release(*_gps_position);
+	return handled;
 }
 
-void GPSDriverNMEA::handleHeading(float heading_deg, float heading_stddev_deg)
+void GPSDriverNMEA::alignHeading(uint32_t time_of_day)
+{
+	if (_heading_aligner.valid()
+	    && !_heading_aligner.headingAt(time_of_day, _gps_position->heading, _gps_position->heading_accuracy)) {
+		_gps_position->heading = NAN;
+	}
+}
+
+float GPSDriverNMEA::headingRad(float heading_deg) const
 {
 	float heading_rad = heading_deg * M_PI_F / 180.0f; // rad in range [0, 2pi]
 	heading_rad -= _heading_offset; // rad in range [-pi, 3pi]
@@ -968,11 +1204,16 @@ void GPSDriverNMEA::handleHeading(float heading_deg, float heading_stddev_deg)
 		heading_rad -= 2.f * M_PI_F; // rad in range [-pi, pi]
 	}
 
+	return heading_rad;
+}
+
+void GPSDriverNMEA::handleHeading(float heading_deg, float heading_stddev_deg)
+{
 	// We are not publishing heading_offset because it wasn't done in the past,
 	// and the UBX driver doesn't do it either. I'm assuming it would cause the
 	// offset to be applied twice.
 
-	_gps_position->heading = heading_rad;
+	_gps_position->heading = headingRad(heading_deg);
 
 	const float heading_stddev_rad = heading_stddev_deg * M_PI_F / 180.0f;
 	_gps_position->heading_accuracy = heading_stddev_rad;
@@ -985,6 +1226,43 @@ void GPSDriverNMEA::request_unicore_heading_message()
 	write(buf, sizeof(buf) - 1);
 }
 
+size_t GPSDriverNMEA::parseRun(const uint8_t *buf, size_t len)
+{
+	if (_decode_state == NMEADecodeState::got_sync1 && _unicore_parser.idle()) {
+		// the bytes that fit, parseChar() handles a full buffer
+		const size_t space = sizeof(_rx_buffer) - 5 - _rx_buffer_bytes;
+		len = len < space ? len : space;
+		size_t i = 0;
+
+		while (true) {
+			const size_t run = textRunLength(buf + i, len - i, '$', '*', ',', '#');
+			memcpy(_rx_buffer + _rx_buffer_bytes, buf + i, run);
+			_rx_buffer_bytes = (uint16_t)(_rx_buffer_bytes + run);
+			i += run;
+
+			if (i >= len || buf[i] != ',') {
+				return i;
+			}
+
+			if (_rx_comma_count < NMEA_MAX_FIELDS) {
+				_rx_field_offsets[_rx_comma_count] = _rx_buffer_bytes;
+			}
+
+			_rx_comma_count++;
+			_rx_buffer[_rx_buffer_bytes++] = ',';
+			i++;
+		}
+	}
+
+	if (_decode_state == NMEADecodeState::uninit && !_unicore_parser.idle()) {
+		// up to a byte that would start an NMEA or RTCM message
+		const size_t run = textRunLength(buf, len, '$', '*', '#', RTCM3_PREAMBLE);
+		return _unicore_parser.parsePayload((const char *)buf, run);
+	}
+
+	return 0;
+}
+
 #define HEXDIGIT_CHAR(d) ((char)((d) + (((d) < 0xA) ? '0' : 'A'-0xA)))
 
 int GPSDriverNMEA::parseChar(uint8_t b)
@@ -997,7 +1275,9 @@ int GPSDriverNMEA::parseChar(uint8_t b)
 		if (b == '$') {
 			_decode_state = NMEADecodeState::got_sync1;
 			_rx_buffer_bytes = 0;
+			_rx_comma_count = 0;
 			_rx_buffer[_rx_buffer_bytes++] = b;
+			statsFrameStart();
 
 		}  else if (b == RTCM3_PREAMBLE && _rtcm_parsing) {
 			_decode_state = NMEADecodeState::decode_rtcm3;
@@ -1011,6 +1291,9 @@ int GPSDriverNMEA::parseChar(uint8_t b)
 		if (b == '$') {
 			_decode_state = NMEADecodeState::got_sync1;
 			_rx_buffer_bytes = 0;
+			_rx_comma_count = 0;
+			statsResync();
+			statsFrameStart();
 
 		} else if (b == '*') {
 			_decode_state = NMEADecodeState::got_asteriks;
@@ -1019,8 +1302,18 @@ int GPSDriverNMEA::parseChar(uint8_t b)
 		if (_rx_buffer_bytes >= (sizeof(_rx_buffer) - 5)) {
 			_decode_state = NMEADecodeState::uninit;
 			_rx_buffer_bytes = 0;
+			statsResync();
 
 		} else {
+			// split the fields while receiving, so handleMessage() doesn't scan the sentence again
+			if (b == ',') {
+				if (_rx_comma_count < NMEA_MAX_FIELDS) {
+					_rx_field_offsets[_rx_comma_count] = _rx_buffer_bytes;
+				}
+
+				_rx_comma_count++;
+			}
+
 			_rx_buffer[_rx_buffer_bytes++] = b;
 		}
 
@@ -1033,15 +1326,15 @@ int GPSDriverNMEA::parseChar(uint8_t b)
 
 	case NMEADecodeState::got_first_cs_byte: {
 			_rx_buffer[_rx_buffer_bytes++] = b;
-			uint8_t checksum = 0;
-			uint8_t *buffer = _rx_buffer + 1;
-			uint8_t *bufend = _rx_buffer + _rx_buffer_bytes - 3;
-
-			for (; buffer < bufend; buffer++) { checksum ^= *buffer; }
+			const uint8_t checksum = textChecksum(_rx_buffer + 1, _rx_buffer_bytes - 4u);
 
 			if ((HEXDIGIT_CHAR(checksum >> 4) == *(_rx_buffer + _rx_buffer_bytes - 2)) &&
 			    (HEXDIGIT_CHAR(checksum & 0x0F) == *(_rx_buffer + _rx_buffer_bytes - 1))) {
 				iRet = _rx_buffer_bytes;
+				statsFrameDone(_rx_buffer_bytes + 2); // and the CR LF that follows
+
+			} else {
+				statsChecksumError();
 			}
 
 			decodeInit();
@@ -1068,7 +1361,7 @@ void GPSDriverNMEA::decodeInit()
 
 	if (_output_mode == OutputMode::GPSAndRTCM || _output_mode == OutputMode::RTCM) {
 		if (!_rtcm_parsing) {
-			_rtcm_parsing = new RTCMParsing();
+			_rtcm_parsing = createBuffer<RTCMParsing>();
 		}
 
 		if (_rtcm_parsing) {
@@ -1085,6 +1378,14 @@ int GPSDriverNMEA::configure(unsigned &baudrate, const GPSConfig &config)
 		NMEA_WARN("RTCM output have to be configured manually");
 	}
 
+	// the RTCM output is parsed in a buffer of the memory pool, without it there is no RTCM
+	decodeInit();
+
+	if (!_rtcm_parsing && (_output_mode == OutputMode::GPSAndRTCM || _output_mode == OutputMode::RTCM)) {
+		NMEA_WARN("no memory for the RTCM parser");
+		return -1;
+	}
+
 	// If a baudrate is defined, we test this first
 	if (baudrate > 0) {
 		setBaudrate(baudrate);
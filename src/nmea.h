@@ -44,12 +44,15 @@
 
 #pragma once
 
+#include "gps_epoch.h"
+#include "gps_heading.h"
 #include "gps_helper.h"
 #include "unicore.h"
 
 class RTCMParsing;
 
 #define NMEA_RECV_BUFFER_SIZE 1024
+#define NMEA_MAX_FIELDS 40	///< comma offsets kept per sentence, GSV has the most with 20
 #define NMEA_DEFAULT_BAUDRATE 115200
 
 class GPSDriverNMEA : public GPSHelper
@@ -66,14 +69,29 @@ public:
 	virtual ~GPSDriverNMEA();
 
 	int receive(unsigned timeout) override;
+	int feed(const uint8_t *buf, size_t buf_length) override;
 	int configure(unsigned &baudrate, const GPSConfig &config) override;
 
 private:
 	void handleHeading(float heading_deg, float heading_stddev_deg);
+
+	/**
+	 * Write the dual antenna heading at the time of an update into it, so both are published together
+	 * @param time_of_day UTC [ms]
+	 */
+	void alignHeading(uint32_t time_of_day);
+
+	/**
+	 * @return heading of the vehicle [rad], in [-pi, pi]
+	 */
+	float headingRad(float heading_deg) const;
+
 	void request_unicore_heading_message();
 
 	UnicoreParser _unicore_parser;
 	gps_abstime _unicore_heading_received_last;
+	GPSHeadingAligner _heading_aligner{24 * 3600 * 1000};	///< Unicore headings, by UTC time of day
+	GPSReportHold<sensor_gps_s> _report_hold;	///< the update while the rest of its read is decoded
 
 	enum class NMEADecodeState {
 		uninit,
@@ -87,9 +105,34 @@ private:
 	int handleMessage(int len);
 	int parseChar(uint8_t b);
 
-	int32_t read_int();
-	double read_float();
-	char read_char();
+	/**
+	 * Parse the bytes at the start of buf which only have to be stored, i.e. the payload of a
+	 * sentence, faster than parseChar() does: it copies them up to the next delimiter and records
+	 * the commas at once.
+	 * @return number of bytes parsed, the next one is passed to parseChar()
+	 */
+	size_t parseRun(const uint8_t *buf, size_t len);
+
+	/**
+	 * Start of a field of the sentence in _rx_buffer, as split by parseChar()
+	 * @param index field index, 0 is the address field ($xxGGA)
+	 * @return nullptr if the sentence has no such field
+	 */
+	const char *field(int index) const;
+
+	/**
+	 * The current sentence has the position of the next update. Its first byte is the update's
+	 * timestamp in the first byte timestamp modes (velocity-only sentences like VTG can be from the
+	 * previous epoch).
+	 */
+	void positionSentence()
+	{
+		statsPositionFrame();
+
+		if (_epoch_rx_time == 0) {
+			_epoch_rx_time = frameStartTime();
+		}
+	}
 
 	sensor_gps_s *_gps_position {nullptr};
 	satellite_info_s *_satellite_info {nullptr};
@@ -97,6 +140,7 @@ private:
 	double _last_VEL_timeUTC{0};
 	double _last_FIX_timeUTC{0};
 	uint64_t _last_timestamp_time{0};
+	gps_abstime _epoch_rx_time{0};	///< reception of the first byte of the update's first position sentence
 
 	uint8_t _sat_num_gga{0};
 	uint8_t _sat_num_gns{0};
@@ -124,6 +168,8 @@ private:
 	NMEADecodeState _decode_state{NMEADecodeState::uninit};
 	uint8_t _rx_buffer[NMEA_RECV_BUFFER_SIZE] {};
 	uint16_t _rx_buffer_bytes{0};
+	uint16_t _rx_field_offsets[NMEA_MAX_FIELDS] {};	///< offsets of the commas in _rx_buffer
+	uint16_t _rx_comma_count{0};
 
 	OutputMode _output_mode{OutputMode::GPS};
 
@@ -0,0 +1,307 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "protocol_demux.h"
+#include "crc.h"
+#include "rtcm.h"
+
+#include <string.h>
+
+#define MIN(X,Y)	((X) < (Y) ? (X) : (Y))
+
+using Protocol = ProtocolDemux::Protocol;
+
+struct start_table_t {
+	uint8_t value[256];
+};
+
+// protocols that can start with a given byte
+static constexpr start_table_t generateStartTable()
+{
+	start_table_t table{};
+	table.value[0xB5] = ProtocolDemux::protocolMask(Protocol::UBX);
+	table.value['$'] = ProtocolDemux::protocolMask(Protocol::NMEA) | ProtocolDemux::protocolMask(Protocol::SBF);
+	table.value[RTCM3_PREAMBLE] = ProtocolDemux::protocolMask(Protocol::RTCM3);
+	table.value[0xAA] = ProtocolDemux::protocolMask(Protocol::Femtomes);
+	return table;
+}
+
+static constexpr start_table_t start_table = generateStartTable();
+
+static int hexValue(uint8_t c)
+{
+	if (c >= '0' && c <= '9') { return c - '0'; }
+
+	if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+
+	if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+
+	return -1;
+}
+
+ProtocolDemux::ProtocolDemux(FrameHandler handler, void *user, uint8_t protocols) :
+	_handler(handler),
+	_user(user),
+	_protocols(protocols)
+{
+}
+
+void ProtocolDemux::reset()
+{
+	_pos = 0;
+	_bytes_discarded = 0;
+
+	for (unsigned i = 0; i < (unsigned)Protocol::Count; i++) {
+		_frame_count[i] = 0;
+	}
+}
+
+uint8_t ProtocolDemux::detectedProtocols() const
+{
+	uint8_t mask = 0;
+
+	for (unsigned i = 0; i < (unsigned)Protocol::Count; i++) {
+		if (_frame_count[i] > 0) {
+			mask |= protocolMask((Protocol)i);
+		}
+	}
+
+	return mask;
+}
+
+int ProtocolDemux::addBytes(const uint8_t *buf, size_t len)
+{
+	_frames_handled = 0;
+	size_t i = 0;
+
+	// first complete a frame carried over from the previous chunk, copying no more than it needs
+	while (_pos > 0 && i < len) {
+		Protocol protocol;
+		const int32_t length = frameLength(_buffer, _pos, protocol);
+		size_t take = (length > (int32_t)_pos) ? (size_t)length - _pos : PROTOCOL_DEMUX_HEADER_LENGTH;
+		take = MIN(take, len - i);
+		take = MIN(take, sizeof(_buffer) - _pos);
+
+		memcpy(_buffer + _pos, buf + i, take);
+		_pos += take;
+		i += take;
+
+		const size_t used = scan(_buffer, _pos);
+
+		if (used == 0 && _pos == sizeof(_buffer)) {
+			// cannot happen with consistent limits, but never stall
+			_bytes_discarded += (uint32_t)_pos;
+			_pos = 0;
+
+		} else if (used > 0) {
+			memmove(_buffer, _buffer + used, _pos - used);
+			_pos -= used;
+		}
+	}
+
+	// then split the rest of the chunk in place
+	if (i < len) {
+		const size_t used = scan(buf + i, len - i);
+		const size_t rest = len - i - used;
+
+		memcpy(_buffer, buf + i + used, rest);
+		_pos = rest;
+	}
+
+	return _frames_handled;
+}
+
+size_t ProtocolDemux::scan(const uint8_t *p, size_t n)
+{
+	size_t i = 0;
+
+	while (i < n) {
+		const size_t start = i;
+
+		while (i < n && (start_table.value[p[i]] & _protocols) == 0) {
+			i++;
+		}
+
+		_bytes_discarded += (uint32_t)(i - start);
+
+		if (i == n) {
+			break;
+		}
+
+		Protocol protocol;
+		const int32_t length = frameLength(p + i, n - i, protocol);
+
+		if (length == 0 || (length > 0 && (size_t)length > n - i && (size_t)length <= sizeof(_buffer))) {
+			// incomplete, but can still be completed from the next chunk
+			break;
+		}
+
+		if (length > 0 && (size_t)length <= n - i && frameValid(protocol, p + i, (size_t)length)) {
+			_frame_count[(unsigned)protocol]++;
+			_frames_handled++;
+			_handler(protocol, p + i, (size_t)length, _user);
+			i += (size_t)length;
+
+		} else {
+			// false start, resync on the next byte
+			_bytes_discarded++;
+			i++;
+		}
+	}
+
+	return i;
+}
+
+int32_t ProtocolDemux::frameLength(const uint8_t *p, size_t n, Protocol &protocol) const
+{
+	switch (p[0]) {
+	case 0xB5:
+		protocol = Protocol::UBX;
+
+		if (n < 2) { return 0; }
+
+		if (p[1] != 0x62) { return -1; }
+
+		if (n < 6) { return 0; }
+
+		return 8 + (p[4] | (p[5] << 8)); // sync, class, id, length, payload, checksum
+
+	case '$':
+		if (n < 2) { return 0; }
+
+		if (p[1] == '@') {
+			protocol = Protocol::SBF;
+
+			if (!(_protocols & protocolMask(Protocol::SBF))) { return -1; }
+
+			if (n < 8) { return 0; }
+
+			const int32_t length = p[6] | (p[7] << 8); // the block length includes the header
+
+			return (length < 8 || length % 4 != 0) ? -1 : length;
+		}
+
+		protocol = Protocol::NMEA;
+
+		if (!(_protocols & protocolMask(Protocol::NMEA))) { return -1; }
+
+		for (size_t k = 1; k < n; k++) {
+			if (p[k] == '*') {
+				return (int32_t)k + 3; // two checksum digits follow
+			}
+
+			if (p[k] < 0x20 || p[k] > 0x7e || p[k] == '$' || k >= PROTOCOL_DEMUX_MAX_TEXT_LENGTH) {
+				return -1;
+			}
+		}
+
+		return 0;
+
+	case RTCM3_PREAMBLE:
+		protocol = Protocol::RTCM3;
+
+		if (n < 2) { return 0; }
+
+		if (p[1] & 0xFC) { return -1; } // reserved bits
+
+		if (n < 3) { return 0; }
+
+		return RTCM3_HEADER_CRC_LENGTH + (((p[1] & 3) << 8) | p[2]);
+
+	case 0xAA:
+		protocol = Protocol::Femtomes;
+
+		if (n < 2) { return 0; }
+
+		if (p[1] != 0x44 || (n > 2 && p[2] != 0x12)) { return -1; }
+
+		if (n < 3) { return 0; }
+
+		if (n < PROTOCOL_DEMUX_HEADER_LENGTH) { return 0; }
+
+		if (p[3] < PROTOCOL_DEMUX_HEADER_LENGTH) { return -1; }
+
+		return p[3] + (p[8] | (p[9] << 8)) + 4; // header, message, CRC-32
+
+	default:
+		return -1;
+	}
+}
+
+bool ProtocolDemux::frameValid(Protocol protocol, const uint8_t *p, size_t length) const
+{
+	switch (protocol) {
+	case Protocol::UBX: {
+			uint8_t ck_a = 0;
+			uint8_t ck_b = 0;
+
+			for (size_t i = 2; i < length - 2; i++) {
+				ck_a = ck_a + p[i];
+				ck_b = ck_b + ck_a;
+			}
+
+			return ck_a == p[length - 2] && ck_b == p[length - 1];
+		}
+
+	case Protocol::NMEA: {
+			uint8_t checksum = 0;
+
+			for (size_t i = 1; i < length - 3; i++) {
+				checksum ^= p[i];
+			}
+
+			const int high = hexValue(p[length - 2]);
+			const int low = hexValue(p[length - 1]);
+			return high >= 0 && low >= 0 && checksum == ((high << 4) | low);
+		}
+
+	case Protocol::RTCM3: {
+			const uint32_t crc = ((uint32_t)p[length - 3] << 16) | ((uint32_t)p[length - 2] << 8) | p[length - 1];
+			return calculateCRC24Q((uint32_t)length - 3, p, 0) == crc;
+		}
+
+	case Protocol::SBF: {
+			const uint16_t crc = (uint16_t)(p[2] | (p[3] << 8));
+			return calculateCRC16CCITT((uint32_t)length - 4, p + 4, 0) == crc;
+		}
+
+	case Protocol::Femtomes: {
+			uint32_t crc;
+			memcpy(&crc, p + length - 4, sizeof(crc));
+			return calculateCRC32((uint32_t)length - 4, const_cast<uint8_t *>(p), 0) == crc;
+		}
+
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,152 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file protocol_demux.h
+ *
+ * Single pass frame splitter for receivers that interleave several protocols on one port.
+ * Frames are recognised by their start sequence, checked end to end and handed to a handler:
+ * - UBX: 0xB5 0x62, Fletcher checksum
+ * - NMEA: '$', XOR checksum
+ * - RTCM3: 0xD3, CRC-24Q
+ * - SBF: '$' '@', CRC-16-CCITT
+ * - Femtomes: 0xAA 0x44 0x12, CRC-32
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef PROTOCOL_DEMUX_BUFFER_SIZE
+#define PROTOCOL_DEMUX_BUFFER_SIZE		2048		/**< longest frame that can be reassembled across input chunks */
+#endif
+
+#define PROTOCOL_DEMUX_MAX_TEXT_LENGTH		1024		/**< longest NMEA sentence accepted */
+#define PROTOCOL_DEMUX_HEADER_LENGTH		10		/**< bytes needed to know the length of any binary frame */
+
+static_assert(PROTOCOL_DEMUX_MAX_TEXT_LENGTH < PROTOCOL_DEMUX_BUFFER_SIZE, "text frames must fit into the buffer");
+
+
+class ProtocolDemux
+{
+public:
+	enum class Protocol : uint8_t {
+		UBX = 0,
+		NMEA,
+		RTCM3,
+		SBF,
+		Femtomes,
+		Count
+	};
+
+	static constexpr uint8_t protocolMask(Protocol protocol) { return (uint8_t)(1u << (unsigned)protocol); }
+
+	static constexpr uint8_t ALL_PROTOCOLS = (1u << (unsigned)Protocol::Count) - 1;
+
+	/**
+	 * Called for every complete frame with a valid checksum.
+	 * @param protocol protocol of the frame
+	 * @param frame the whole frame, including sync and checksum. Only valid during the call.
+	 * @param length frame length in bytes
+	 * @param user user pointer passed to the constructor
+	 */
+	typedef void (*FrameHandler)(Protocol protocol, const uint8_t *frame, size_t length, void *user);
+
+	/**
+	 * @param handler frame handler
+	 * @param user passed to the handler
+	 * @param protocols mask of protocols to look for (see protocolMask())
+	 */
+	ProtocolDemux(FrameHandler handler, void *user, uint8_t protocols = ALL_PROTOCOLS);
+	~ProtocolDemux() = default;
+
+	/**
+	 * Drop any partially received frame and clear the statistics.
+	 */
+	void reset();
+
+	/**
+	 * Add a chunk of the byte stream. Frames contained entirely in the chunk are handed out in place,
+	 * only frames split across chunks are copied into the internal buffer.
+	 * @return number of frames handed to the handler
+	 */
+	int addBytes(const uint8_t *buf, size_t len);
+
+	/**
+	 * @return number of valid frames seen for a protocol since the last reset
+	 */
+	uint32_t frameCount(Protocol protocol) const { return _frame_count[(unsigned)protocol]; }
+
+	/**
+	 * @return mask of the protocols that produced at least one valid frame since the last reset
+	 */
+	uint8_t detectedProtocols() const;
+
+	/**
+	 * @return number of bytes that did not belong to a valid frame since the last reset
+	 */
+	uint32_t bytesDiscarded() const { return _bytes_discarded; }
+
+private:
+	/**
+	 * Get the total length of a frame from its first bytes.
+	 * @param p candidate frame start
+	 * @param n number of bytes available at p
+	 * @param protocol set to the protocol of the frame
+	 * @return -1 not a frame start, 0 more bytes needed, > 0 total frame length (may be larger than n)
+	 */
+	int32_t frameLength(const uint8_t *p, size_t n, Protocol &protocol) const;
+
+	/**
+	 * @return true if the checksum of a complete frame is correct
+	 */
+	bool frameValid(Protocol protocol, const uint8_t *p, size_t length) const;
+
+	/**
+	 * Split a contiguous region into frames.
+	 * @return number of bytes consumed. The rest is the start of an incomplete frame.
+	 */
+	size_t scan(const uint8_t *p, size_t n);
+
+	FrameHandler		_handler;
+	void			*_user;
+	const uint8_t		_protocols;
+
+	uint8_t			_buffer[PROTOCOL_DEMUX_BUFFER_SIZE] {};	///< incomplete frame carried over between chunks
+	size_t			_pos{0};					///< bytes in _buffer
+
+	int			_frames_handled{0};				///< frames handed out during the current addBytes() call
+	uint32_t		_frame_count[(unsigned)Protocol::Count] {};
+	uint32_t		_bytes_discarded{0};
+};
@@ -32,32 +32,23 @@
  ****************************************************************************/
 
 #include "rtcm.h"
-#include <cstring>
+
+#include <string.h>
 
 RTCMParsing::RTCMParsing()
 {
 	reset();
 }
 
-RTCMParsing::~RTCMParsing()
-{
-	delete[] _buffer;
-}
-
 void RTCMParsing::reset()
 {
-	if (!_buffer) {
-		_buffer = new uint8_t[RTCM_INITIAL_BUFFER_LENGTH];
-		_buffer_len = RTCM_INITIAL_BUFFER_LENGTH;
-	}
-
 	_pos = 0;
-	_message_length = _buffer_len;
+	_message_length = RTCM3_MAX_PAYLOAD_LENGTH;
 }
 
 bool RTCMParsing::addByte(uint8_t b)
 {
-	if (!_buffer) {
+	if (_pos >= RTCM_BUFFER_LENGTH) {
 		return false;
 	}
 
@@ -65,23 +56,188 @@ bool RTCMParsing::addByte(uint8_t b)
 
 	if (_pos == 3) {
 		_message_length = (((uint16_t)_buffer[1] & 3) << 8) | (_buffer[2]);
+	}
+
+	return _message_length + RTCM3_HEADER_CRC_LENGTH == _pos;
+}
+
+void RTCMScheduler::setMessageEnabled(uint16_t id, bool enabled)
+{
+	if (id >= RTCM_MESSAGE_ID_COUNT) {
+		return;
+	}
+
+	if (enabled) {
+		_disabled[id / 32] &= ~(1u << (id % 32));
+
+	} else {
+		_disabled[id / 32] |= 1u << (id % 32);
+	}
+}
+
+int RTCMScheduler::setMessagePeriod(uint16_t id, uint32_t period_ms)
+{
+	for (int i = 0; i < _num_periods; i++) {
+		if (_periods[i].id == id) {
+			_periods[i].period_us = period_ms * 1000;
+			_periods[i].next_us = 0;
+			return 0;
+		}
+	}
+
+	if (period_ms == 0) {
+		return 0;
+	}
+
+	if (_num_periods >= RTCM_SCHEDULER_MAX_PERIODS) {
+		return -1;
+	}
+
+	_periods[_num_periods++] = Period{id, period_ms * 1000, 0};
+	return 0;
+}
+
+void RTCMScheduler::setBandwidth(uint32_t bytes_per_second)
+{
+	_bandwidth = bytes_per_second;
+	_budget = bytes_per_second;
+	_budget_time_us = 0;
+}
+
+bool RTCMScheduler::isMsm(uint16_t id)
+{
+	// MSM1 to MSM7 of GPS (107x), GLONASS, Galileo, SBAS, QZSS, BeiDou and NavIC (113x)
+	return id >= 1071 && id <= 1137 && id % 10 >= 1 && id % 10 <= 7;
+}
+
+bool RTCMScheduler::push(const uint8_t *frame, int length, uint64_t now_us)
+{
+	if (length < RTCM3_HEADER_CRC_LENGTH + 2 || length > RTCM_BUFFER_LENGTH || frame[0] != RTCM3_PREAMBLE
+	    || length != ((((int)frame[1] & 3) << 8) | frame[2]) + RTCM3_HEADER_CRC_LENGTH) {
+		return false;
+	}
+
+	const uint16_t id = (uint16_t)((frame[3] << 4) | (frame[4] >> 4));
+
+	if (_disabled[id / 32] & (1u << (id % 32))) {
+		return false;
+	}
+
+	bool replaces = false;
 
-		if (_message_length + 6 > _buffer_len) {
-			uint16_t new_buffer_len = _message_length + 6;
-			uint8_t *new_buffer = new uint8_t[new_buffer_len];
+	for (int i = 0; i < _num_periods; i++) {
+		Period &period = _periods[i];
 
-			if (!new_buffer) {
-				delete[](_buffer);
-				_buffer = nullptr;
+		if (period.id == id && period.period_us > 0) {
+			if (now_us < period.next_us) {
 				return false;
 			}
 
-			memcpy(new_buffer, _buffer, 3);
-			delete[](_buffer);
-			_buffer = new_buffer;
-			_buffer_len = new_buffer_len;
+			// keep the phase, unless one was missed
+			period.next_us = (period.next_us != 0 && now_us < period.next_us + period.period_us) ?
+					 period.next_us + period.period_us : now_us + period.period_us;
+			replaces = true;
+		}
+	}
+
+	// DF004 (30 bits), after the message and station numbers, is the epoch time of all MSM
+	const bool msm = isMsm(id) && length >= 10 + 3;
+	const uint32_t epoch = msm ? ((uint32_t)frame[6] << 22 | (uint32_t)frame[7] << 14 | (uint32_t)frame[8] << 6 |
+				      (uint32_t)frame[9] >> 2) & 0x3fffffff : 0;
+
+	// frames which are stale now, the one partially sent is completed
+	for (int i = _num_frames - 1; i >= (_sent > 0 ? 1 : 0); i--) {
+		if (_frames[i].id == id && (replaces || (msm && _frames[i].epoch != epoch))) {
+			remove(i);
+			_dropped++;
 		}
 	}
 
-	return _message_length + 6 == _pos;
+	// make room, dropping the oldest
+	while (_num_frames >= RTCM_SCHEDULER_MAX_FRAMES || _buffer_bytes + length > RTCM_SCHEDULER_BUFFER_SIZE) {
+		if (_num_frames <= (_sent > 0 ? 1 : 0)) {
+			// only the frame partially sent is left
+			return false;
+		}
+
+		remove(_sent > 0 ? 1 : 0);
+		_dropped++;
+	}
+
+	memcpy(_buffer + _buffer_bytes, frame, length);
+	_buffer_bytes += length;
+	_frames[_num_frames++] = Frame{(uint16_t)length, id, epoch, msm};
+	return true;
+}
+
+void RTCMScheduler::remove(int index)
+{
+	int offset = 0;
+
+	for (int i = 0; i < index; i++) {
+		offset += _frames[i].length;
+	}
+
+	const int length = _frames[index].length;
+	memmove(_buffer + offset, _buffer + offset + length, _buffer_bytes - offset - length);
+	_buffer_bytes -= length;
+	memmove(&_frames[index], &_frames[index + 1], (_num_frames - index - 1) * sizeof(Frame));
+	_num_frames--;
+}
+
+int RTCMScheduler::pop(uint8_t *burst, int max_length, uint64_t now_us)
+{
+	if (_num_frames == 0 || max_length <= 0) {
+		return 0;
+	}
+
+	int length = _buffer_bytes - _sent;
+
+	if (_bandwidth > 0) {
+		if (_budget_time_us == 0) {
+			_budget_time_us = now_us;
+
+		} else if (now_us > _budget_time_us) {
+			const uint64_t earned = (now_us - _budget_time_us) * _bandwidth / 1000000;
+
+			if (_budget + earned >= _bandwidth) {
+				_budget = _bandwidth;
+				_budget_time_us = now_us;
+
+			} else {
+				// the remainder counts for the next burst
+				_budget += (uint32_t)earned;
+				_budget_time_us += earned * 1000000 / _bandwidth;
+			}
+		}
+
+		length = length < (int)_budget ? length : (int)_budget;
+	}
+
+	length = length < max_length ? length : max_length;
+
+	if (_bandwidth > 0) {
+		_budget -= (uint32_t)length;
+	}
+
+	memcpy(burst, _buffer + _sent, length);
+	_sent += length;
+
+	// remove the frames that are sent completely
+	int sent_frames = 0;
+	int sent_bytes = 0;
+
+	while (sent_frames < _num_frames && _sent - sent_bytes >= _frames[sent_frames].length) {
+		sent_bytes += _frames[sent_frames++].length;
+	}
+
+	if (sent_frames > 0) {
+		memmove(_buffer, _buffer + sent_bytes, _buffer_bytes - sent_bytes);
+		_buffer_bytes -= sent_bytes;
+		_sent -= sent_bytes;
+		memmove(&_frames[0], &_frames[sent_frames], (_num_frames - sent_frames) * sizeof(Frame));
+		_num_frames -= sent_frames;
+	}
+
+	return length;
 }
@@ -37,14 +37,33 @@
 
 /* RTCM3 */
 #define RTCM3_PREAMBLE					0xD3
-#define RTCM_INITIAL_BUFFER_LENGTH			300		/**< initial maximum message length of an RTCM message */
+#define RTCM3_MAX_PAYLOAD_LENGTH			1023		/**< the length field is 10 bits */
+#define RTCM3_HEADER_CRC_LENGTH				6		/**< 3 bytes header & 3 bytes CRC */
+#define RTCM_BUFFER_LENGTH				(RTCM3_MAX_PAYLOAD_LENGTH + RTCM3_HEADER_CRC_LENGTH)	/**< largest possible RTCM3 frame */
+
+#ifndef RTCM_SCHEDULER_BUFFER_SIZE
+#define RTCM_SCHEDULER_BUFFER_SIZE			4096		/**< bytes of frames queued for the link */
+#endif
+
+#ifndef RTCM_SCHEDULER_MAX_FRAMES
+#define RTCM_SCHEDULER_MAX_FRAMES			32
+#endif
+
+static_assert(RTCM_SCHEDULER_BUFFER_SIZE >= 2 * RTCM_BUFFER_LENGTH && RTCM_SCHEDULER_MAX_FRAMES >= 2,
+	      "a frame must fit next to the one partially sent");
+
+#ifndef RTCM_SCHEDULER_MAX_PERIODS
+#define RTCM_SCHEDULER_MAX_PERIODS			8		/**< message IDs with a period */
+#endif
+
+#define RTCM_MESSAGE_ID_COUNT				4096		/**< the message number field is 12 bits */
 
 
 class RTCMParsing
 {
 public:
 	RTCMParsing();
-	~RTCMParsing();
+	~RTCMParsing() = default;
 
 	/**
 	 * reset the parsing state
@@ -58,13 +77,119 @@ public:
 	 */
 	bool addByte(uint8_t b);
 
-	uint8_t *message() const { return _buffer; }
+	/**
+	 * The complete frame (header, payload & CRC). It stays valid until the next call to reset() or addByte().
+	 */
+	const uint8_t *message() const { return _buffer; }
 	uint16_t messageLength() const { return _pos; }
 	uint16_t messageId() const { return (_buffer[3] << 4) | (_buffer[4] >> 4); }
 
 private:
-	uint8_t			*_buffer{nullptr};
-	uint16_t		_buffer_len{};
+	uint8_t			_buffer[RTCM_BUFFER_LENGTH] {};				///< statically sized, no allocations while parsing
 	uint16_t		_pos{};						///< next position in buffer
 	uint16_t		_message_length{};					///< message length without header & CRC (both 3 bytes)
 };
+
+
+/**
+ * Queue of RTCM frames between the receiver and a correction link with a limited bandwidth, e.g. a
+ * telemetry radio to the rover. It forwards the frames from gotRTCMMessage:
+ * - filtered by message ID,
+ * - at most once per period for messages that rarely change, e.g. the station position (1005, 1006)
+ *   and the GLONASS biases (1230). A newer one replaces a queued one.
+ * - MSM observations only for the latest epoch: a queued MSM frame is dropped when the same message of
+ *   a newer epoch arrives, as it's stale then.
+ * - in bursts of whole or split frames up to the link's MTU, at the link's bandwidth.
+ * If the queue is full, the oldest frames are dropped, so the link never sends stale data.
+ *
+ * Usage, from one thread:
+ *   push(rtcm_frame, length, gps_absolute_time()) for each gotRTCMMessage callback,
+ *   while ((length = pop(burst, mtu, gps_absolute_time())) > 0) { send(burst, length); }
+ */
+class RTCMScheduler
+{
+public:
+	RTCMScheduler() = default;
+	~RTCMScheduler() = default;
+
+	/**
+	 * Forward the messages with an ID or not, all are forwarded by default
+	 */
+	void setMessageEnabled(uint16_t id, bool enabled);
+
+	/**
+	 * Forward a message at most once per period
+	 * @param period_ms 0 to forward all of them
+	 * @return 0 on success, -1 if RTCM_SCHEDULER_MAX_PERIODS messages have a period already
+	 */
+	int setMessagePeriod(uint16_t id, uint32_t period_ms);
+
+	/**
+	 * @param bytes_per_second bandwidth of the link, 0 (default) for no limit.
+	 *                         Up to a second of unused bandwidth is saved for later bursts.
+	 */
+	void setBandwidth(uint32_t bytes_per_second);
+
+	/**
+	 * Queue a frame
+	 * @param frame complete frame, as from RTCMParsing::message()
+	 * @param now_us time, e.g. gps_absolute_time()
+	 * @return true if queued, false if it's filtered, decimated or not an RTCM3 frame
+	 */
+	bool push(const uint8_t *frame, int length, uint64_t now_us);
+
+	/**
+	 * Take the next burst to send. Frames are sent in the order they were queued, a frame that
+	 * doesn't fit continues in the next burst.
+	 * @param max_length MTU of the link
+	 * @return burst length, 0 if nothing is queued or the bandwidth is used up
+	 */
+	int pop(uint8_t *burst, int max_length, uint64_t now_us);
+
+	/**
+	 * @return bytes queued
+	 */
+	int queued() const { return _buffer_bytes - _sent; }
+
+	/**
+	 * @return number of frames queued but not sent: stale or for lack of bandwidth
+	 */
+	uint32_t dropped() const { return _dropped; }
+
+private:
+	struct Frame {
+		uint16_t length;
+		uint16_t id;
+		uint32_t epoch;			///< MSM epoch time field
+		bool msm;
+	};
+
+	struct Period {
+		uint16_t id;
+		uint32_t period_us;
+		uint64_t next_us;		///< earliest time for the next one, 0: the next one is forwarded
+	};
+
+	static bool isMsm(uint16_t id);
+
+	/**
+	 * Remove a queued frame, which must not be partially sent
+	 */
+	void remove(int index);
+
+	uint8_t _buffer[RTCM_SCHEDULER_BUFFER_SIZE] {};		///< queued frames, in order
+	int _buffer_bytes{0};
+	Frame _frames[RTCM_SCHEDULER_MAX_FRAMES] {};
+	int _num_frames{0};
+	int _sent{0};						///< bytes of the first frame already sent
+
+	uint32_t _disabled[RTCM_MESSAGE_ID_COUNT / 32] {};	///< bit per message ID
+	Period _periods[RTCM_SCHEDULER_MAX_PERIODS] {};
+	int _num_periods{0};
+
+	uint32_t _bandwidth{0};					///< bytes/s, 0: unlimited
+	uint32_t _budget{0};					///< bytes that can be sent now
+	uint64_t _budget_time_us{0};
+
+	uint32_t _dropped{0};
+};
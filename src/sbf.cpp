@@ -43,6 +43,7 @@
 
 #include "sbf.h"
 #include "rtcm.h"
+#include "crc.h"
 
 #include <string.h>
 #include <ctime>
@@ -63,6 +64,9 @@
 #define SBF_WARN(...)        {GPS_WARN(__VA_ARGS__);}
 #define SBF_DEBUG(...)       {/*GPS_WARN(__VA_ARGS__);*/}
 
+static_assert(GPSHelper::staticPoolBlocks(sizeof(RTCMParsing)) <= GPS_STATIC_POOL_BLOCKS,
+	      "the static memory pool is too small for the SBF driver");
+
 GPSDriverSBF::GPSDriverSBF(GPSCallbackPtr callback, void *callback_user, struct sensor_gps_s *gps_position,
 			   satellite_info_s *satellite_info, float heading_offset, float pitch_offset)
 	: GPSBaseStationSupport(callback, callback_user), _gps_position(gps_position), _satellite_info(satellite_info),
@@ -73,7 +77,7 @@ GPSDriverSBF::GPSDriverSBF(GPSCallbackPtr callback, void *callback_user, struct
 
 GPSDriverSBF::~GPSDriverSBF()
 {
-	delete _rtcm_parsing;
+	destroyBuffer(_rtcm_parsing);
 }
 
 int GPSDriverSBF::configure(unsigned &baudrate, const GPSConfig &config)
@@ -84,6 +88,14 @@ int GPSDriverSBF::configure(unsigned &baudrate, const GPSConfig &config)
 	baudrate = SBF_TX_CFG_PRT_BAUDRATE;
 	_output_mode = config.output_mode;
 
+	// the RTCM output is parsed in a buffer of the memory pool, without it there is no RTCM
+	decodeInit();
+
+	if (!_rtcm_parsing && (_output_mode == OutputMode::GPSAndRTCM || _output_mode == OutputMode::RTCM)) {
+		SBF_WARN("no memory for the RTCM parser");
+		return -1;
+	}
+
 	if (_output_mode != OutputMode::RTCM) {
 		sendMessage(SBF_CONFIG_FORCE_INPUT);
 	}
@@ -326,10 +338,7 @@ int GPSDriverSBF::receive(unsigned timeout)
 			SBF_DEBUG("Read %d bytes (receive)", ret);
 
 			// pass received bytes to the packet decoder
-			for (int i = 0; i < ret; i++) {
-				handled |= parseChar(buf[i]);
-				SBF_DEBUG("parsed %d: 0x%x", i, buf[i]);
-			}
+			handled |= feed(buf, ret);
 		}
 
 		if (handled > 0) {
@@ -344,6 +353,34 @@ int GPSDriverSBF::receive(unsigned timeout)
 	}
 }
 
+// 0 = no message handled, 1 = message handled, 2 = sat info message handled
+int GPSDriverSBF::feed(const uint8_t *buf, size_t buf_length)
+{
+	// Do not receive messages until we're configured
+	if (!_configured) {
+		return 0;
+	}
+
+	int handled = 0;
+	statsBytesReceived(buf_length);
+	_report_hold.resume(*_gps_position);
+
+	for (size_t i = 0; i < buf_length; i++) {
+		const int ret = parseChar(buf[i]);
+		SBF_DEBUG("parsed %d: 0x%x", (int)i, buf[i]);
+
+		// the rest of the read can start the next epoch
+		if ((ret & 1) && i + 1 < buf_length) {
+			_report_hold.hold(*_gps_position);
+		}
+
+		handled |= ret;
+	}
+
+	_report_hold.release(*_gps_position);
+	return handled;
+}
+
 // 0 = decoding, 1 = message handled, 2 = sat info message handled
 int GPSDriverSBF::parseChar(const uint8_t b)
 {
@@ -357,6 +394,7 @@ int GPSDriverSBF::parseChar(const uint8_t b)
 			SBF_TRACE_PARSER("A");
 			payloadRxAdd(b); // add a payload byte
 			_decode_state = SBF_DECODE_SYNC2;
+			statsFrameStart();
 
 		} else if (b == RTCM3_PREAMBLE && _rtcm_parsing) {
 			SBF_TRACE_PARSER("RTCM");
@@ -374,6 +412,7 @@ int GPSDriverSBF::parseChar(const uint8_t b)
 			_decode_state = SBF_DECODE_PAYLOAD;
 
 		} else { // Sync1 not followed by Sync2: reset parser
+			statsResync();
 			decodeInit();
 		}
 
@@ -426,6 +465,11 @@ int GPSDriverSBF::payloadRxAdd(const uint8_t b)
 	int ret = 0;
 	uint8_t *p_buf = reinterpret_cast<uint8_t *>(&_buf);
 
+	// the CRC covers everything after the sync and CRC fields, up to the block length
+	if (_rx_payload_index >= 4 && (_rx_payload_index < 8 || _rx_payload_index < _buf.length)) {
+		_rx_crc = crc16CCITTUpdate(_rx_crc, b);
+	}
+
 	p_buf[_rx_payload_index++] = b;
 
 	if ((_rx_payload_index > 7 && _rx_payload_index >= _buf.length) || _rx_payload_index >= sizeof(_buf)) {
@@ -440,16 +484,7 @@ int GPSDriverSBF::payloadRxAdd(const uint8_t b)
  */
 uint16_t crc16(const uint8_t *data_p, uint32_t length)
 {
-	uint8_t x;
-	uint16_t crc = 0;
-
-	while (length--) {
-		x = crc >> 8 ^ *data_p++;
-		x ^= x >> 4;
-		crc = static_cast<uint16_t>((crc << 8) ^ (x << 12) ^ (x << 5) ^ x);
-	}
-
-	return crc;
+	return calculateCRC16CCITT(length, data_p, 0);
 }
 
 /**
@@ -464,16 +499,23 @@ int GPSDriverSBF::payloadRxDone()
 	time_t epoch;
 #endif
 
-	if (_buf.length <= 4 ||
-	    _buf.length > _rx_payload_index ||
-	    _buf.crc16 != crc16(reinterpret_cast<uint8_t *>(&_buf) + 4, _buf.length - 4)) {
+	// the CRC was accumulated in payloadRxAdd(), a block is at least as long as its 8 byte header
+	if (_buf.length < 8 || _buf.length > _rx_payload_index) {
+		statsResync();
 		return 0;
 	}
 
+	if (_buf.crc16 != _rx_crc) {
+		statsChecksumError();
+		return 0;
+	}
+
+	statsFrameDone(_buf.length);
+
 	// handle message
 	switch (_buf.msg_id) {
 	case SBF_ID_PVTGeodetic: SBF_TRACE_RXMSG("Rx PVTGeodetic");
-		_msg_status |= 1;
+		statsPositionFrame();
 
 		if (_buf.payload_pvt_geodetic.mode_type < 1) {
 			_gps_position->fix_type = 1;
@@ -513,7 +555,7 @@ int GPSDriverSBF::payloadRxDone()
 		if (_buf.payload_pvt_geodetic.nr_sv < 255) {  // 255 = do not use value
 			_gps_position->satellites_used = _buf.payload_pvt_geodetic.nr_sv;
 
-			if (_satellite_info) {
+			if (_satellite_info && satelliteInfoEnabled()) {
 				// Only fill in the satellite count for now (we could use the ChannelStatus message for the
 				// other data, but it's really large: >800B)
 				_satellite_info->timestamp = gps_absolute_time();
@@ -584,12 +626,13 @@ int GPSDriverSBF::payloadRxDone()
 		_last_timestamp_time = _gps_position->timestamp;
 		_rate_count_vel++;
 		_rate_count_lat_lon++;
-		ret |= (_msg_status == 7) ? 1 : 0;
+		_epoch.add(_buf.TOW, GPSEpochAssembler::Position | GPSEpochAssembler::Velocity);
 		//SBF_DEBUG("PVTGeodetic handled");
 		break;
 
 	case SBF_ID_VelCovGeodetic: SBF_TRACE_RXMSG("Rx VelCovGeodetic");
-		_msg_status |= 2;
+		_epoch.add(_buf.TOW, GPSEpochAssembler::Accuracy);
+		statsPositionFrame();
 		_gps_position->s_variance_m_s = _buf.payload_vel_col_geodetic.cov_ve_ve;
 
 		if (_gps_position->s_variance_m_s < _buf.payload_vel_col_geodetic.cov_vn_vn) {
@@ -604,12 +647,17 @@ int GPSDriverSBF::payloadRxDone()
 		break;
 
 	case SBF_ID_DOP: SBF_TRACE_RXMSG("Rx DOP");
-		_msg_status |= 4;
+		_epoch.add(_buf.TOW, GPSEpochAssembler::DOP);
+		statsPositionFrame();
 		_gps_position->hdop = _buf.payload_dop.hDOP * 0.01f;
 		_gps_position->vdop = _buf.payload_dop.vDOP * 0.01f;
 		//SBF_DEBUG("DOP handled");
 		break;
 
+	case SBF_ID_EndOfPVT: SBF_TRACE_RXMSG("Rx EndOfPVT");
+		_epoch.end(_buf.TOW);
+		break;
+
 	case SBF_ID_AttEuler: SBF_TRACE_RXMSG("Rx AttEuler");
 
 		if (!_buf.payload_att_euler.error_not_requested) {
@@ -671,12 +719,22 @@ int GPSDriverSBF::payloadRxDone()
 		break;
 	}
 
+	// the satellite info is returned with the position of its epoch
+	_handled_pending |= ret;
+	ret = 0;
+
+	if (_epoch.complete()) {
+		_epoch.reset();
+		ret = _handled_pending | 1;
+		_handled_pending = 0;
+	}
+
 	if (ret > 0) {
 		_gps_position->timestamp_time_relative = static_cast<int32_t>(_last_timestamp_time - _gps_position->timestamp);
 	}
 
-	if (ret == 1) {
-		_msg_status &= ~1;
+	if (ret & 1) {
+		statsUpdate();
 	}
 
 	return ret;
@@ -686,10 +744,11 @@ void GPSDriverSBF::decodeInit()
 {
 	_decode_state = SBF_DECODE_SYNC1;
 	_rx_payload_index = 0;
+	_rx_crc = 0;
 
 	if (_output_mode == OutputMode::GPSAndRTCM || _output_mode == OutputMode::RTCM) {
 		if (!_rtcm_parsing) {
-			_rtcm_parsing = new RTCMParsing();
+			_rtcm_parsing = createBuffer<RTCMParsing>();
 		}
 
 		if (_rtcm_parsing) {
@@ -43,6 +43,7 @@
 
 #pragma once
 
+#include "gps_epoch.h"
 #include "gps_helper.h"
 #include "base_station.h"
 #include "rtcm.h"
@@ -63,7 +64,7 @@
 
 #define SBF_DATA_IO "setDataInOut, %s, Auto, SBF\n"
 
-#define SBF_CONFIG "setSBFOutput, Stream1, %s, PVTGeodetic+VelCovGeodetic+DOP+AttEuler+AttCovEuler, msec100\n"
+#define SBF_CONFIG "setSBFOutput, Stream1, %s, PVTGeodetic+VelCovGeodetic+DOP+AttEuler+AttCovEuler+EndOfPVT, msec100\n"
 
 
 #define SBF_CONFIG_RTCM "" \
@@ -108,6 +109,7 @@
 #define SBF_ID_PVTGeodetic    4007
 #define SBF_ID_ChannelStatus  4013
 #define SBF_ID_VelCovGeodetic 5908
+#define SBF_ID_EndOfPVT       5921
 #define SBF_ID_AttEuler       5938
 #define SBF_ID_AttCovEuler    5939
 
@@ -376,6 +378,7 @@ public:
 	virtual ~GPSDriverSBF();
 
 	int receive(unsigned timeout) override;
+	int feed(const uint8_t *buf, size_t buf_length) override;
 
 	int configure(unsigned &baudrate, const GPSConfig &config) override;
 
@@ -389,7 +392,7 @@ private:
 	int parseChar(const uint8_t b);
 
 	/**
-	 * @brief Add payload rx byte
+	 * @brief Add payload rx byte and update the running block CRC
 	 */
 	int payloadRxAdd(const uint8_t b);
 
@@ -426,9 +429,12 @@ private:
 	uint8_t _dynamic_model{7};
 	uint64_t _last_timestamp_time{0};
 	bool _configured{false};
-	uint8_t _msg_status{0};
+	int _handled_pending{0};	///< parse results of the update in progress, returned once it is complete
+	GPSEpochAssembler _epoch{GPSEpochAssembler::Position | GPSEpochAssembler::Velocity};	///< PVT blocks of the update
+	GPSReportHold<sensor_gps_s> _report_hold;	///< the update while the rest of its read is decoded
 	sbf_decode_state_t _decode_state{SBF_DECODE_SYNC1};
 	uint16_t _rx_payload_index{0};
+	uint16_t _rx_crc{0};
 	sbf_buf_t _buf;
 	OutputMode _output_mode{OutputMode::GPS};
 	RTCMParsing *_rtcm_parsing{nullptr};
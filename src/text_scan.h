@@ -0,0 +1,115 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file text_scan.h
+ *
+ * Scanning of text (NMEA style) sentences several bytes at a time, for the parts of the text
+ * parsers that only copy the bytes of a sentence.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Length of the run of bytes at the start of buf that are none of the delimiters.
+ * On little endian targets 8 bytes are tested at once (SWAR): a delimiter becomes a zero byte when
+ * XORed with the repeated delimiter, and the lowest detected zero byte of the word is the first
+ * delimiter (the detection only has false positives above a zero byte).
+ * @param d0 .. d3 delimiters, repeat one for less
+ */
+static inline size_t textRunLength(const uint8_t *buf, size_t len, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
+{
+	size_t i = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	const uint64_t ones = 0x0101010101010101ULL;
+	const uint64_t high_bits = 0x8080808080808080ULL;
+	const uint64_t delimiters[4] = {ones * d0, ones * d1, ones * d2, ones * d3};
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t word;
+		memcpy(&word, buf + i, sizeof(word));
+		uint64_t zero_bytes = 0;
+
+		for (int d = 0; d < 4; d++) {
+			const uint64_t x = word ^ delimiters[d];
+			zero_bytes |= (x - ones) & ~x & high_bits;
+		}
+
+		if (zero_bytes) {
+			return i + (size_t)(__builtin_ctzll(zero_bytes) / 8);
+		}
+	}
+
+#endif
+
+	for (; i < len; i++) {
+		const uint8_t b = buf[i];
+
+		if (b == d0 || b == d1 || b == d2 || b == d3) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+/**
+ * NMEA checksum (XOR of the bytes), 8 bytes at a time
+ */
+static inline uint8_t textChecksum(const uint8_t *buf, size_t len)
+{
+	uint64_t checksum = 0;
+	size_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t word;
+		memcpy(&word, buf + i, sizeof(word));
+		checksum ^= word;
+	}
+
+	checksum ^= checksum >> 32;
+	checksum ^= checksum >> 16;
+	checksum ^= checksum >> 8;
+	uint8_t ret = (uint8_t)checksum;
+
+	for (; i < len; i++) {
+		ret ^= buf[i];
+	}
+
+	return ret;
+}
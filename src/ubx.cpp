@@ -52,7 +52,9 @@
 
 #include <string.h>
 
+#include "protocol_demux.h"
 #include "rtcm.h"
+#include "text_scan.h"
 #include "ubx.h"
 
 #define MIN(X,Y)              ((X) < (Y) ? (X) : (Y))
@@ -67,6 +69,16 @@
 #define UBX_WARN(...)         {GPS_WARN(__VA_ARGS__);}
 #define UBX_DEBUG(...)        {/*GPS_WARN(__VA_ARGS__);*/}
 
+// the buffers the driver holds at once: RTCM parsing and raw frames, with the baudrate detection or
+// with the SPI buffer and the CFG batch
+static constexpr unsigned ubx_pool_rx_blocks = GPSHelper::staticPoolBlocks(sizeof(RTCMParsing)) +
+		GPSHelper::staticPoolBlocks(sizeof(ubx_raw_frame_t));
+static constexpr unsigned ubx_pool_cfg_blocks = GPSHelper::staticPoolBlocks(sizeof(ubx_spi_buffer_t)) +
+		GPSHelper::staticPoolBlocks(sizeof(ubx_cfg_batch_t));
+static constexpr unsigned ubx_pool_detect_blocks = GPSHelper::staticPoolBlocks(sizeof(ProtocolDemux));
+static_assert(ubx_pool_rx_blocks + (ubx_pool_cfg_blocks > ubx_pool_detect_blocks ? ubx_pool_cfg_blocks : ubx_pool_detect_blocks)
+	      <= GPS_STATIC_POOL_BLOCKS, "the static memory pool is too small for the UBX driver");
+
 GPSDriverUBX::GPSDriverUBX(Interface gpsInterface, GPSCallbackPtr callback, void *callback_user,
 			   sensor_gps_s *gps_position, satellite_info_s *satellite_info, uint8_t dynamic_model,
 			   float heading_offset, int32_t uart2_baudrate, UBXMode mode) :
@@ -84,7 +96,41 @@ GPSDriverUBX::GPSDriverUBX(Interface gpsInterface, GPSCallbackPtr callback, void
 
 GPSDriverUBX::~GPSDriverUBX()
 {
-	delete _rtcm_parsing;
+	destroyBuffer(_rtcm_parsing);
+	destroyBuffer(_raw_frame);
+	destroyBuffer(_spi_buffer);
+	destroyBuffer(_cfg_batch);
+}
+
+int
+GPSDriverUBX::setRawMessageClass(uint8_t msg_class, bool enabled)
+{
+	switch (msg_class) {
+	case UBX_CLASS_NAV:
+	case UBX_CLASS_INF:
+	case UBX_CLASS_ACK:
+	case UBX_CLASS_CFG:
+	case UBX_CLASS_MON:
+	case UBX_CLASS_SEC:
+		return -1;
+	}
+
+	if (enabled) {
+		if (!_raw_frame) {
+			_raw_frame = createBuffer<ubx_raw_frame_t>();
+
+			if (!_raw_frame) {
+				return -1;
+			}
+		}
+
+		_raw_classes[msg_class / 32] |= 1u << (msg_class % 32);
+
+	} else {
+		_raw_classes[msg_class / 32] &= ~(1u << (msg_class % 32));
+	}
+
+	return 0;
 }
 
 int
@@ -93,6 +139,35 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 	_configured = false;
 	_output_mode = config.output_mode;
 
+	// without the buffer, SPI transfers are received like UART reads
+	if (_interface == Interface::SPI && !_spi_buffer) {
+		_spi_buffer = createBuffer<ubx_spi_buffer_t>();
+	}
+
+	_spi_pos = 0;
+	_spi_data_length = 0;
+	_spi_transfer_length = 0;
+	_uart_baudrate = 0;
+	_rate_planner.start(0);
+
+#if !UBX_SUPPORT_RTK
+
+	if (_output_mode != OutputMode::GPS || _mode != UBXMode::Normal) {
+		UBX_WARN("built without RTK support");
+		return -1;
+	}
+
+#endif
+
+	// the RTCM output is parsed in a buffer of the memory pool, without it there is no RTCM
+	decodeInit();
+
+	if (!_rtcm_parsing && (_output_mode == OutputMode::GPSAndRTCM || _output_mode == OutputMode::RTCM || _mode == UBXMode::MovingBaseUART1)) {
+		UBX_WARN("no memory for the RTCM parser");
+		return -1;
+	}
+
+#if UBX_SUPPORT_PRE_V27
 	ubx_payload_tx_cfg_prt_t cfg_prt[2];
 
 	uint16_t out_proto_mask = _output_mode == OutputMode::GPS ?
@@ -102,6 +177,7 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 	uint16_t in_proto_mask = (_output_mode == OutputMode::GPS || _output_mode == OutputMode::GPSAndRTCM) ?
 				 (UBX_TX_CFG_PRT_PROTO_UBX | UBX_TX_CFG_PRT_PROTO_RTCM) :
 				 UBX_TX_CFG_PRT_PROTO_UBX;
+#endif
 
 	const bool auto_baudrate = baudrate == 0;
 
@@ -109,16 +185,48 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 
 		/* try different baudrates */
 		const unsigned baudrates[] = {38400, 57600, 9600, 115200, 230400, 460800, 921600};
+		const unsigned num_baudrates = sizeof(baudrates) / sizeof(baudrates[0]);
 
 		unsigned baud_i;
 		unsigned desired_baudrate = auto_baudrate ? UBX_BAUDRATE_M8_AND_NEWER : baudrate;
 
 		if ((_mode == UBXMode::RoverWithMovingBaseUART1) || (_mode == UBXMode::MovingBaseUART1)) {
 			desired_baudrate = UART1_BAUDRATE_HEADING;
+
+		} else if (auto_baudrate) {
+			// the lowest baudrate the enabled messages fit into at the shortest period of any receiver
+			const unsigned plan_baudrates[] = {UBX_BAUDRATE_M8_AND_NEWER, 230400, 460800, 921600};
+			uint32_t epoch_bytes, second_bytes;
+			ratePlanBytes(epoch_bytes, second_bytes);
+			desired_baudrate = GPSRatePlanner::planBaudrate(epoch_bytes, second_bytes, _mode == UBXMode::Normal ? 100 : 125,
+					   plan_baudrates, sizeof(plan_baudrates) / sizeof(plan_baudrates[0]));
+		}
+
+		/* A receiver that is already sending is found by listening, which takes a fraction of the ACK
+		 * timeouts of probing the wrong baudrates. Its baudrate is probed first. */
+		unsigned probe_baudrates[num_baudrates];
+		unsigned num_probe = 0;
+
+		if (auto_baudrate) {
+			const uint8_t protocols = ProtocolDemux::protocolMask(ProtocolDemux::Protocol::UBX)
+						  | ProtocolDemux::protocolMask(ProtocolDemux::Protocol::NMEA)
+						  | ProtocolDemux::protocolMask(ProtocolDemux::Protocol::RTCM3);
+			const unsigned detected_baudrate = detectBaudrate(baudrates, num_baudrates, protocols, UBX_BAUDRATE_DETECT_TIME);
+
+			if (detected_baudrate != 0) {
+				UBX_DEBUG("detected baudrate %u", detected_baudrate);
+				probe_baudrates[num_probe++] = detected_baudrate;
+			}
+		}
+
+		for (unsigned i = 0; i < num_baudrates; i++) {
+			if (num_probe == 0 || baudrates[i] != probe_baudrates[0]) {
+				probe_baudrates[num_probe++] = baudrates[i];
+			}
 		}
 
-		for (baud_i = 0; baud_i < sizeof(baudrates) / sizeof(baudrates[0]); baud_i++) {
-			unsigned test_baudrate = baudrates[baud_i];
+		for (baud_i = 0; baud_i < num_baudrates; baud_i++) {
+			unsigned test_baudrate = probe_baudrates[baud_i];
 
 			if (!auto_baudrate && baudrate != test_baudrate) {
 				continue; // skip to next baudrate
@@ -175,6 +283,7 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 				waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, false);
 
 			} else {
+#if UBX_SUPPORT_PRE_V27
 				_proto_ver_27_or_higher = false;
 
 				UBX_DEBUG("trying old protocol");
@@ -216,6 +325,10 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 
 				/* no ACK is expected here, but read the buffer anyway in case we actually get an ACK */
 				waitForAck(UBX_MSG_CFG_PRT, UBX_CONFIG_TIMEOUT, false);
+#else
+				/* try next baudrate */
+				continue;
+#endif
 			}
 
 			if (desired_baudrate != test_baudrate) {
@@ -228,10 +341,11 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 
 			/* at this point we have correct baudrate on both ends */
 			baudrate = desired_baudrate;
+			_uart_baudrate = desired_baudrate;
 			break;
 		}
 
-		if (baud_i >= sizeof(baudrates) / sizeof(baudrates[0])) {
+		if (baud_i >= num_baudrates) {
 			return -1;	// connection and/or baudrate detection failed
 		}
 
@@ -261,6 +375,7 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 			_proto_ver_27_or_higher = true;
 
 		} else {
+#if UBX_SUPPORT_PRE_V27
 			_proto_ver_27_or_higher = false;
 			memset(cfg_prt, 0, sizeof(ubx_payload_tx_cfg_prt_t));
 			cfg_prt[0].portID		= UBX_TX_CFG_PRT_PORTID_SPI;
@@ -273,6 +388,9 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 			}
 
 			waitForAck(UBX_MSG_CFG_PRT, UBX_CONFIG_TIMEOUT, false);
+#else
+			return -1;
+#endif
 		}
 
 	} else {
@@ -281,6 +399,14 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 
 	UBX_DEBUG("Protocol version 27+: %i", static_cast<int>(_proto_ver_27_or_higher));
 
+	/* The chip ID identifies the receiver for the configuration fingerprint. The response arrives before
+	 * the one to MON-VER, older receivers answer with a NAK. */
+	_unique_id = 0;
+
+	if (_proto_ver_27_or_higher && !sendMessage(UBX_MSG_SEC_UNIQID, nullptr, 0)) {
+		return -1;
+	}
+
 	/* Request module version information by sending an empty MON-VER message */
 	if (!sendMessage(UBX_MSG_MON_VER, nullptr, 0)) {
 		return -1;
@@ -293,6 +419,7 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 		return -1;
 	}
 
+#if UBX_SUPPORT_PRE_V27
 
 	/* Now that we know the board, update the baudrate on M8 boards (on F9+ we already used the
 	 * higher baudrate with CFG-VALSET) */
@@ -307,9 +434,11 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 
 			setBaudrate(UBX_BAUDRATE_M8_AND_NEWER);
 			baudrate = UBX_BAUDRATE_M8_AND_NEWER;
+			_uart_baudrate = UBX_BAUDRATE_M8_AND_NEWER;
 		}
 	}
 
+#endif
 
 	if (_output_mode == OutputMode::RTCM) {
 		// RTCM mode force stationary dynamic model
@@ -318,6 +447,8 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 
 	int ret;
 
+#if UBX_SUPPORT_PRE_V27
+
 	if (_proto_ver_27_or_higher) {
 		ret = configureDevice(config, _uart2_baudrate);
 
@@ -325,10 +456,16 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 		ret = configureDevicePreV27(config.gnss_systems);
 	}
 
+#else
+	ret = configureDevice(config, _uart2_baudrate);
+#endif
+
 	if (ret != 0) {
 		return ret;
 	}
 
+#if UBX_SUPPORT_RTK
+
 	if (_output_mode == OutputMode::RTCM) {
 		if (restartSurveyIn() < 0) {
 			return -1;
@@ -340,11 +477,13 @@ GPSDriverUBX::configure(unsigned &baudrate, const GPSConfig &config)
 		}
 	}
 
+#endif
+
 	_configured = true;
 	return 0;
 }
 
-
+#if UBX_SUPPORT_PRE_V27
 int GPSDriverUBX::configureDevicePreV27(const GNSSSystemsMask &gnssSystems)
 {
 	/* Send a CFG-RATE message to define update rate */
@@ -493,6 +632,9 @@ int GPSDriverUBX::configureDevicePreV27(const GNSSSystemsMask &gnssSystems)
 		return -1;
 	}
 
+	// since u-blox 8, without it the updates are complete with the position and velocity
+	configureMessageRateAndAck(UBX_MSG_NAV_EOE, 1, true);
+
 	if (!configureMessageRateAndAck(UBX_MSG_NAV_SVINFO, (_satellite_info != nullptr) ? 5 : 0, true)) {
 		return -1;
 	}
@@ -501,94 +643,141 @@ int GPSDriverUBX::configureDevicePreV27(const GNSSSystemsMask &gnssSystems)
 		return -1;
 	}
 
+	if (rawMessageClass(UBX_CLASS_RXM)) {
+		// only supported by some receivers (e.g. M8T), so not fatal
+		if (!configureMessageRateAndAck(UBX_MSG_RXM_RAWX, 1, true)
+		    || !configureMessageRateAndAck(UBX_MSG_RXM_SFRBX, 1, true)) {
+			UBX_WARN("no raw measurements");
+		}
+	}
+
 	return 0;
 }
+#endif
+
+void GPSDriverUBX::ratePlanBytes(uint32_t &epoch_bytes, uint32_t &second_bytes) const
+{
+	const uint32_t frame = 8;	// sync, class, id, length and checksum
+
+	epoch_bytes = sizeof(ubx_payload_rx_nav_pvt_t) + sizeof(ubx_payload_rx_nav_dop_t) + sizeof(ubx_payload_rx_nav_eoe_t)
+		      + sizeof(ubx_payload_rx_nav_status_t) + 5 * frame;
+	// MON-RF of a dual band receiver, with 2 blocks
+	epoch_bytes += sizeof(ubx_payload_rx_mon_rf_t) + sizeof(ubx_payload_rx_mon_rf_t::block[0]) + frame;
+	second_bytes = 0;
+
+	if (_satellite_info != nullptr) {
+		// NAV-SAT, every 10th epoch
+		epoch_bytes += (sizeof(ubx_payload_rx_nav_sat_part1_t) + UBX_RATE_PLAN_SATELLITES * sizeof(ubx_payload_rx_nav_sat_part2_t)
+				+ frame) / 10;
+	}
+
+	if (rawMessageClass(UBX_CLASS_RXM)) {
+		// RXM-RAWX: 16 bytes and 32 per measurement
+		epoch_bytes += 16 + UBX_RATE_PLAN_SIGNALS * 32 + frame;
+		second_bytes += UBX_RATE_PLAN_SFRBX;
+	}
+
+#if UBX_SUPPORT_RTK
+
+	if (_mode == UBXMode::RoverWithStaticBaseUart2 || _mode == UBXMode::RoverWithMovingBase
+	    || _mode == UBXMode::RoverWithMovingBaseUART1) {
+		epoch_bytes += sizeof(ubx_payload_rx_nav_relposned_t) + frame;
+
+	} else if (_mode == UBXMode::MovingBaseUART1) {
+		// 4 MSM4 frames, 1230 and 4072
+		epoch_bytes += 6 * UBX_RATE_PLAN_RTCM_FRAME + UBX_RATE_PLAN_SIGNALS * UBX_RATE_PLAN_MSM4_SIGNAL;
+	}
+
+	if (_output_mode == OutputMode::GPSAndRTCM) {
+		// 4 MSM7 frames and 1230, 1005 is negligible
+		epoch_bytes += 5 * UBX_RATE_PLAN_RTCM_FRAME + UBX_RATE_PLAN_SIGNALS * UBX_RATE_PLAN_MSM7_SIGNAL;
+	}
+
+#endif
+}
 
 int GPSDriverUBX::configureDevice(const GPSConfig &config, const int32_t uart2_baudrate)
 {
+	// All messages are sent before waiting for the ACKs. The messages are only split where the keys
+	// are optional or must be applied separately.
+	cfgBatchBegin();
+
 	// There is no RTCM or USB interface on M10
 	if (_board != Board::u_blox10) {
-
-		int cfg_valset_msg_size = initCfgValset();
-
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_RTCM3X, _output_mode == OutputMode::RTCM ? 0 : 1,
-				   cfg_valset_msg_size);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_RTCM3X, _output_mode == OutputMode::RTCM ? 0 : 1);
 
 		if (_output_mode != OutputMode::GPS) {
-			cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_RTCM3X, 1, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_RTCM3X, 1);
 		}
 
 		// USB
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_USBINPROT_UBX, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_USBINPROT_RTCM3X, _output_mode == OutputMode::RTCM ? 0 : 1,
-				   cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_USBINPROT_NMEA, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_USBOUTPROT_UBX, 1, cfg_valset_msg_size);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_USBINPROT_UBX, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_USBINPROT_RTCM3X, _output_mode == OutputMode::RTCM ? 0 : 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_USBINPROT_NMEA, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_USBOUTPROT_UBX, 1);
 
 		if (_output_mode != OutputMode::GPS) {
-			cfgValset<uint8_t>(UBX_CFG_KEY_CFG_USBOUTPROT_RTCM3X, 1, cfg_valset_msg_size);
-		}
-
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_USBOUTPROT_NMEA, 0, cfg_valset_msg_size);
-
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			return -1;
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_USBOUTPROT_RTCM3X, 1);
 		}
 
-		if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
-		}
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_USBOUTPROT_NMEA, 0);
 	}
 
 	/* set configuration parameters */
-	int cfg_valset_msg_size = initCfgValset();
-	cfgValset<uint8_t>(UBX_CFG_KEY_NAVSPG_FIXMODE, 3 /* Auto 2d/3d */, cfg_valset_msg_size);
-	cfgValset<uint8_t>(UBX_CFG_KEY_NAVSPG_UTCSTANDARD, 3 /* USNO (U.S. Naval Observatory derived from GPS) */,
-			   cfg_valset_msg_size);
-	cfgValset<uint8_t>(UBX_CFG_KEY_NAVSPG_DYNMODEL, _dyn_model, cfg_valset_msg_size);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_NAVSPG_FIXMODE, 3 /* Auto 2d/3d */);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_NAVSPG_UTCSTANDARD, 3 /* USNO (U.S. Naval Observatory derived from GPS) */);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_NAVSPG_DYNMODEL, _dyn_model);
 
 	// disable odometer & filtering
-	cfgValset<uint8_t>(UBX_CFG_KEY_ODO_USE_ODO, 0, cfg_valset_msg_size);
-	cfgValset<uint8_t>(UBX_CFG_KEY_ODO_USE_COG, 0, cfg_valset_msg_size);
-	cfgValset<uint8_t>(UBX_CFG_KEY_ODO_OUTLPVEL, 0, cfg_valset_msg_size);
-	cfgValset<uint8_t>(UBX_CFG_KEY_ODO_OUTLPCOG, 0, cfg_valset_msg_size);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_ODO_USE_ODO, 0);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_ODO_USE_COG, 0);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_ODO_OUTLPVEL, 0);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_ODO_OUTLPCOG, 0);
 
 	// enable jamming monitor
-	cfgValset<uint8_t>(UBX_CFG_KEY_ITFM_ENABLE, 1, cfg_valset_msg_size);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_ITFM_ENABLE, 1);
 
 	// measurement rate
-	// In case of F9P not in moving base mode we use 10Hz, otherwise 8Hz (receivers such as M9N can go higher as well, but
-	// the number of used satellites will be restricted to 16. Not mentioned in datasheet)
-	int rate_meas;
+	// In case of F9P not in moving base mode we use up to 10Hz, otherwise 8Hz (receivers such as M9N can go higher as
+	// well, but the number of used satellites will be restricted to 16. Not mentioned in datasheet).
+	// The rate is lowered to what the enabled messages fit into at the baudrate.
+	const unsigned min_rate_meas = (_mode == UBXMode::Normal && _board == Board::u_blox9_F9P) ? 100 : 125;
+	uint32_t epoch_bytes, second_bytes;
+	ratePlanBytes(epoch_bytes, second_bytes);
+	unsigned rate_meas = GPSRatePlanner::planPeriod(epoch_bytes, second_bytes, _uart_baudrate, min_rate_meas);
 
-	if (_mode != UBXMode::Normal) {
-		rate_meas = 125; //8Hz for heading.
+#if UBX_SUPPORT_RTK
 
-	} else {
-		rate_meas = (_board == Board::u_blox9_F9P) ? 100 : 125;
+	if (_mode == UBXMode::MovingBase && uart2_baudrate > 0) {
+		// the RTCM output to the rover on UART2: 4 MSM4 frames, 1230 and 4072
+		const uint32_t rtcm_bytes = 6 * UBX_RATE_PLAN_RTCM_FRAME + UBX_RATE_PLAN_SIGNALS * UBX_RATE_PLAN_MSM4_SIGNAL;
+		const unsigned uart2_rate_meas = GPSRatePlanner::planPeriod(rtcm_bytes, 0, (unsigned)uart2_baudrate, min_rate_meas);
+		rate_meas = uart2_rate_meas > rate_meas ? uart2_rate_meas : rate_meas;
 	}
 
-	cfgValset<uint16_t>(UBX_CFG_KEY_RATE_MEAS, rate_meas, cfg_valset_msg_size);
-	cfgValset<uint16_t>(UBX_CFG_KEY_RATE_NAV, 1, cfg_valset_msg_size);
-	cfgValset<uint8_t>(UBX_CFG_KEY_RATE_TIMEREF, 0, cfg_valset_msg_size);
-
-	if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-		return -1;
-	}
+#endif
 
-	if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-		return -1;
-	}
+	if (_mode != UBXMode::Normal) {
+		// the heading modes' receivers run at the same rate as their partner
+		if (rate_meas != min_rate_meas) {
+			UBX_WARN("output doesn't fit the baudrate at %u ms", min_rate_meas);
+		}
 
-	// RTK (optional, as only RTK devices like F9P support it)
-	cfg_valset_msg_size = initCfgValset();
-	cfgValset<uint8_t>(UBX_CFG_KEY_NAVHPG_DGNSSMODE, 3 /* RTK Fixed */, cfg_valset_msg_size);
+		rate_meas = min_rate_meas;
 
-	if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-		return -1;
+	} else if (rate_meas != min_rate_meas) {
+		UBX_WARN("output doesn't fit the baudrate, measurement period %u ms", rate_meas);
 	}
 
-	waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, false);
+	// not adapted at runtime in the heading modes, it would desync the receivers
+	_rate_planner.start(_mode == UBXMode::Normal ? rate_meas : 0);
+	cfgBatchValset<uint16_t>(UBX_CFG_KEY_RATE_MEAS, (uint16_t)rate_meas);
+	cfgBatchValset<uint16_t>(UBX_CFG_KEY_RATE_NAV, 1);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_RATE_TIMEREF, 0);
+
+	// RTK (optional, as only RTK devices like F9P support it)
+	cfgBatchMessage(false);
+	cfgBatchValset<uint8_t>(UBX_CFG_KEY_NAVHPG_DGNSSMODE, 3 /* RTK Fixed */);
 
 	// configure active GNSS systems (leave signal bands as is)
 	// Note: For M10 configuration if changing from default. As per the
@@ -596,231 +785,182 @@ int GPSDriverUBX::configureDevice(const GPSConfig &config, const int32_t uart2_b
 	//       2.1.1.3 GNSS signal configuration for details on some restrictions.
 	//       Implementing these restrictions are a TODO item for M10.
 	if (static_cast<int32_t>(config.gnss_systems) != 0) {
-		cfg_valset_msg_size = initCfgValset();
+		cfgBatchMessage(true);
 
 		// GPS and QZSS should always be enabled and disabled together, according to uBlox
 		if (config.gnss_systems & GNSSSystemsMask::ENABLE_GPS) {
 			UBX_DEBUG("GNSS Systems: Use GPS + QZSS");
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GPS_ENA, 1, cfg_valset_msg_size);
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_QZSS_ENA, 1, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GPS_ENA, 1);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_QZSS_ENA, 1);
 
 		} else {
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GPS_ENA, 0, cfg_valset_msg_size);
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_QZSS_ENA, 0, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GPS_ENA, 0);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_QZSS_ENA, 0);
 		}
 
 		if (config.gnss_systems & GNSSSystemsMask::ENABLE_GALILEO) {
 			UBX_DEBUG("GNSS Systems: Use Galileo");
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GAL_ENA, 1, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GAL_ENA, 1);
 
 		} else {
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GAL_ENA, 0, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GAL_ENA, 0);
 		}
 
 		if (config.gnss_systems & GNSSSystemsMask::ENABLE_BEIDOU) {
 			UBX_DEBUG("GNSS Systems: Use BeiDou");
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_BDS_ENA, 1, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_BDS_ENA, 1);
 
 		} else {
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_BDS_ENA, 0, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_BDS_ENA, 0);
 		}
 
 		if (config.gnss_systems & GNSSSystemsMask::ENABLE_GLONASS) {
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GLO_ENA, 1, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GLO_ENA, 1);
 
 		} else {
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GLO_ENA, 0, cfg_valset_msg_size);
-		}
-
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			UBX_DEBUG("UBX GNSS config send failed");
-			return -1;
-		}
-
-		if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_GLO_ENA, 0);
 		}
 
 		// send SBAS config separately, because it seems to be buggy (with u-center, too)
-		cfg_valset_msg_size = initCfgValset();
+		cfgBatchMessage(false);
 
 		if (config.gnss_systems & GNSSSystemsMask::ENABLE_SBAS) {
 			UBX_DEBUG("GNSS Systems: Use SBAS");
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_SBAS_ENA, 1, cfg_valset_msg_size);
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_SBAS_L1CA_ENA, 1, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_SBAS_ENA, 1);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_SBAS_L1CA_ENA, 1);
 
 		} else {
-			cfgValset<uint8_t>(UBX_CFG_KEY_SIGNAL_SBAS_ENA, 0, cfg_valset_msg_size);
-		}
-
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			return -1;
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_SIGNAL_SBAS_ENA, 0);
 		}
-
-		waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true);
 	}
 
 	// Configure message rates
-	// Send a new CFG-VALSET message to make sure it does not get too large
-	cfg_valset_msg_size = initCfgValset();
-	cfgValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_PVT_I2C, 1, cfg_valset_msg_size);
+	cfgBatchMessage(true);
+	cfgBatchValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_PVT_I2C, 1);
 	_use_nav_pvt = true;
-	cfgValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_DOP_I2C, 1, cfg_valset_msg_size);
-	cfgValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_SAT_I2C, (_satellite_info != nullptr) ? 10 : 0, cfg_valset_msg_size);
-	cfgValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_STATUS_I2C, 1, cfg_valset_msg_size);
-	cfgValsetPort(UBX_CFG_KEY_MSGOUT_UBX_MON_RF_I2C, 1, cfg_valset_msg_size);
-
-	if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-		return -1;
-	}
+	cfgBatchValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_DOP_I2C, 1);
+	cfgBatchValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_EOE_I2C, 1);
+	cfgBatchValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_SAT_I2C, (_satellite_info != nullptr) ? 10 : 0);
+	cfgBatchValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_STATUS_I2C, 1);
+	cfgBatchValsetPort(UBX_CFG_KEY_MSGOUT_UBX_MON_RF_I2C, 1);
 
-	if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-		return -1;
+	if (rawMessageClass(UBX_CLASS_RXM)) {
+		cfgBatchValsetPort(UBX_CFG_KEY_MSGOUT_UBX_RXM_RAWX_I2C, 1);
+		cfgBatchValsetPort(UBX_CFG_KEY_MSGOUT_UBX_RXM_SFRBX_I2C, 1);
 	}
 
 	if (_interface == Interface::UART || _interface == Interface::SPI) {
 
 		// Enable/Disable GPS protocols at I2C interface
-		cfg_valset_msg_size = initCfgValset();
-
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_I2CINPROT_UBX,
-				   config.interface_protocols & InterfaceProtocolsMask::I2C_IN_PROT_UBX, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_I2CINPROT_NMEA,
-				   config.interface_protocols & InterfaceProtocolsMask::I2C_IN_PROT_NMEA, cfg_valset_msg_size);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_I2CINPROT_UBX,
+					config.interface_protocols & InterfaceProtocolsMask::I2C_IN_PROT_UBX);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_I2CINPROT_NMEA,
+					config.interface_protocols & InterfaceProtocolsMask::I2C_IN_PROT_NMEA);
 
 		// There is no RTCM on M10
 		if (_board != Board::u_blox10) {
-			cfgValset<uint8_t>(UBX_CFG_KEY_CFG_I2CINPROT_RTCM3X,
-					   config.interface_protocols & InterfaceProtocolsMask::I2C_IN_PROT_RTCM3X, cfg_valset_msg_size);
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_I2CINPROT_RTCM3X,
+						config.interface_protocols & InterfaceProtocolsMask::I2C_IN_PROT_RTCM3X);
 		}
 
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_I2COUTPROT_UBX,
-				   config.interface_protocols & InterfaceProtocolsMask::I2C_OUT_PROT_UBX, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_I2COUTPROT_NMEA,
-				   config.interface_protocols & InterfaceProtocolsMask::I2C_OUT_PROT_NMEA, cfg_valset_msg_size);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_I2COUTPROT_UBX,
+					config.interface_protocols & InterfaceProtocolsMask::I2C_OUT_PROT_UBX);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_I2COUTPROT_NMEA,
+					config.interface_protocols & InterfaceProtocolsMask::I2C_OUT_PROT_NMEA);
 
 		if (_board == Board::u_blox9_F9P) {
-			cfgValset<uint8_t>(UBX_CFG_KEY_CFG_I2COUTPROT_RTCM3X,
-					   config.interface_protocols & InterfaceProtocolsMask::I2C_OUT_PROT_RTCM3X, cfg_valset_msg_size);
-		}
-
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			return -1;
-		}
-
-		if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
+			cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_I2COUTPROT_RTCM3X,
+						config.interface_protocols & InterfaceProtocolsMask::I2C_OUT_PROT_RTCM3X);
 		}
 	}
 
+#if UBX_SUPPORT_RTK
+	// the port setup of the heading modes overrides keys of the first message
+	cfgBatchMessage(true);
+
 	if (_mode == UBXMode::RoverWithStaticBaseUart2 || _mode == UBXMode::RoverWithMovingBase) {
 		UBX_DEBUG("Configuring UART2 for rover");
-		cfg_valset_msg_size = initCfgValset();
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_UBX, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_RTCM3X, 0, cfg_valset_msg_size);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_UBX, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_RTCM3X, 0);
 		// heading output period 1 second
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_UART1, 1, cfg_valset_msg_size);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_UART1, 1);
 		// enable RTCM input on uart2 + set baudrate
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_STOPBITS, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_DATABITS, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_PARITY, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_UBX, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_RTCM3X, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_NMEA, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2OUTPROT_UBX, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2OUTPROT_RTCM3X, 0, cfg_valset_msg_size);
-		cfgValset<uint32_t>(UBX_CFG_KEY_CFG_UART2_BAUDRATE, uart2_baudrate, cfg_valset_msg_size);
-
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			return -1;
-		}
-
-		if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
-		}
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_STOPBITS, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_DATABITS, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_PARITY, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_UBX, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_RTCM3X, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_NMEA, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2OUTPROT_UBX, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2OUTPROT_RTCM3X, 0);
+		cfgBatchValset<uint32_t>(UBX_CFG_KEY_CFG_UART2_BAUDRATE, uart2_baudrate);
 
 	} else if (_mode == UBXMode::MovingBase) {
 		UBX_DEBUG("Configuring UART2 for moving base");
 		// enable RTCM output on uart2 + set baudrate
-		cfg_valset_msg_size = initCfgValset();
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_STOPBITS, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_DATABITS, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_PARITY, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_UBX, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_RTCM3X, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_NMEA, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2OUTPROT_UBX, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART2OUTPROT_RTCM3X, 1, cfg_valset_msg_size);
-		cfgValset<uint32_t>(UBX_CFG_KEY_CFG_UART2_BAUDRATE, uart2_baudrate, cfg_valset_msg_size);
-
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE4072_0_UART2, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1230_UART2, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1074_UART2, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1084_UART2, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1094_UART2, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1124_UART2, 1, cfg_valset_msg_size);
-
-
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			return -1;
-		}
-
-		if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
-		}
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_STOPBITS, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_DATABITS, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2_PARITY, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_UBX, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_RTCM3X, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2INPROT_NMEA, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2OUTPROT_UBX, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART2OUTPROT_RTCM3X, 1);
+		cfgBatchValset<uint32_t>(UBX_CFG_KEY_CFG_UART2_BAUDRATE, uart2_baudrate);
+
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE4072_0_UART2, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1230_UART2, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1074_UART2, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1084_UART2, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1094_UART2, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1124_UART2, 1);
 
 	} else if (_mode == UBXMode::RoverWithMovingBaseUART1) {
 		UBX_DEBUG("Configuring UART1 for rover");
 		// heading output period 1 second
-		cfg_valset_msg_size = initCfgValset();
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_UBX, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_RTCM3X, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_NMEA, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_UBX, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_RTCM3X, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_UART1, 1, cfg_valset_msg_size);
-
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			return -1;
-		}
-
-		if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
-		}
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_UBX, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_RTCM3X, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_NMEA, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_UBX, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_RTCM3X, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_UART1, 1);
 
 	} else if (_mode == UBXMode::MovingBaseUART1) {
 		UBX_DEBUG("Configuring UART1 for moving base");
 		// enable RTCM output on uart1
-		cfg_valset_msg_size = initCfgValset();
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_UBX, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_RTCM3X, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_NMEA, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_UBX, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_RTCM3X, 1, cfg_valset_msg_size);
-
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_UART1, 0, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_UART2, 0, cfg_valset_msg_size);
-
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE4072_0_UART1, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1230_UART1, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1074_UART1, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1084_UART1, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1094_UART1, 1, cfg_valset_msg_size);
-		cfgValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1124_UART1, 1, cfg_valset_msg_size);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_UBX, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_RTCM3X, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1INPROT_NMEA, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_UBX, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_CFG_UART1OUTPROT_RTCM3X, 1);
 
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			return -1;
-		}
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_UART1, 0);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_UART2, 0);
 
-		if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
-		}
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE4072_0_UART1, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1230_UART1, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1074_UART1, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1084_UART1, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1094_UART1, 1);
+		cfgBatchValset<uint8_t>(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1124_UART1, 1);
+	}
+
+#else
+	(void)uart2_baudrate;
+#endif
 
+	int ret = cfgBatchCommit();
+
+	if (ret == 1) {
+		// The configuration in BBR or flash is kept, but a receiver that stayed powered can still have
+		// a rate adapted at runtime in RAM
+		ret = setMeasurementRate(rate_meas, true);
 	}
 
-	return 0;
+	return ret;
 }
 
+
 int GPSDriverUBX::initCfgValset()
 {
 	memset(&_buf.payload_tx_cfg_valset, 0, sizeof(_buf.payload_tx_cfg_valset));
@@ -869,84 +1009,520 @@ bool GPSDriverUBX::cfgValsetPort(uint32_t key_id, uint8_t value, int &msg_size)
 	return true;
 }
 
-int GPSDriverUBX::restartSurveyInPreV27()
+// CFG-VALSET and CFG-VALGET payload header (version, layers, reserved or position)
+#define UBX_CFG_HEADER_SIZE	(sizeof(ubx_payload_tx_cfg_valset_t) - sizeof(ubx_payload_tx_cfg_valset_t::cfgData))
+
+// Bits 24-27 of a key ID are reserved (always 0). The batch uses them to mark the key as already
+// set in a layer by the read back.
+#define UBX_CFG_KEY_SET_IN_LAYER(layer)	(1u << (24 + (layer)))
+#define UBX_CFG_KEY_RESERVED_MASK	0x0f000000u
+
+/**
+ * Size of a configuration value in bytes, from the size field of the key ID
+ * @return 0 for an invalid size
+ */
+static size_t cfgValueSize(uint32_t key_id)
 {
-	//disable RTCM output
-	configureMessageRate(UBX_MSG_RTCM3_1005, 0);
-	configureMessageRate(UBX_MSG_RTCM3_1077, 0);
-	configureMessageRate(UBX_MSG_RTCM3_1087, 0);
-	configureMessageRate(UBX_MSG_RTCM3_1230, 0);
-	configureMessageRate(UBX_MSG_RTCM3_1097, 0);
-	configureMessageRate(UBX_MSG_RTCM3_1127, 0);
+	switch ((key_id >> 28) & 0x7) {
+	case 1: // one bit, stored in a byte
+	case 2: return 1;
 
-	//stop it first
-	//FIXME: stopping the survey-in process does not seem to work
-	memset(&_buf.payload_tx_cfg_tmode3, 0, sizeof(_buf.payload_tx_cfg_tmode3));
-	_buf.payload_tx_cfg_tmode3.flags        = 0; /* disable time mode */
+	case 3: return 2;
 
-	if (!sendMessage(UBX_MSG_CFG_TMODE3, (uint8_t *)&_buf, sizeof(_buf.payload_tx_cfg_tmode3))) {
-		UBX_WARN("TMODE3 failed. Device w/o base station support?");
-		return -1;
-	}
+	case 4: return 4;
 
-	if (waitForAck(UBX_MSG_CFG_TMODE3, UBX_CONFIG_TIMEOUT, true) < 0) {
-		return -1;
-	}
+	case 5: return 8;
 
-	if (_base_settings.type == BaseSettingsType::survey_in) {
-		UBX_DEBUG("Starting Survey-in");
+	default: return 0;
+	}
+}
 
-		memset(&_buf.payload_tx_cfg_tmode3, 0, sizeof(_buf.payload_tx_cfg_tmode3));
-		_buf.payload_tx_cfg_tmode3.flags        = 1; /* start survey-in */
-		_buf.payload_tx_cfg_tmode3.svinMinDur   = _base_settings.settings.survey_in.min_dur;
-		_buf.payload_tx_cfg_tmode3.svinAccLimit = _base_settings.settings.survey_in.acc_limit;
+void GPSDriverUBX::cfgBatchBegin()
+{
+	if (!_cfg_batch) {
+		_cfg_batch = createBuffer<ubx_cfg_batch_t>();
 
-		if (!sendMessage(UBX_MSG_CFG_TMODE3, (uint8_t *)&_buf, sizeof(_buf.payload_tx_cfg_tmode3))) {
-			return -1;
+		if (!_cfg_batch) {
+			return;
 		}
+	}
 
-		if (waitForAck(UBX_MSG_CFG_TMODE3, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
-		}
+	_cfg_batch->length = 0;
+	_cfg_batch->msg_count = 0;
+	_cfg_batch->error = false;
+	cfgBatchMessage(true);
+}
 
-		/* enable status output of survey-in */
-		if (!configureMessageRateAndAck(UBX_MSG_NAV_SVIN, 5, true)) {
-			return -1;
-		}
+void GPSDriverUBX::cfgBatchMessage(bool required)
+{
+	if (!_cfg_batch) {
+		return;
+	}
 
-	} else {
-		UBX_DEBUG("Setting fixed base position");
+	if (_cfg_batch->msg_count > 0 && _cfg_batch->msgs[_cfg_batch->msg_count - 1].keys == 0) {
+		// reuse the empty message
+		_cfg_batch->msgs[_cfg_batch->msg_count - 1].required = required;
+		return;
+	}
 
-		const FixedPositionSettings &settings = _base_settings.settings.fixed_position;
+	if (_cfg_batch->msg_count >= UBX_CFG_BATCH_MSGS || _cfg_batch->length + UBX_CFG_HEADER_SIZE > sizeof(_cfg_batch->data)) {
+		UBX_WARN("CFG batch too large");
+		_cfg_batch->error = true;
+		return;
+	}
 
-		memset(&_buf.payload_tx_cfg_tmode3, 0, sizeof(_buf.payload_tx_cfg_tmode3));
-		_buf.payload_tx_cfg_tmode3.flags = 2 /* fixed mode */ | (1 << 8) /* lat/lon mode */;
-		int64_t lat64 = (int64_t)(settings.latitude * 1e9);
-		_buf.payload_tx_cfg_tmode3.ecefXOrLat = (int32_t)(lat64 / 100);
-		_buf.payload_tx_cfg_tmode3.ecefXOrLatHP = lat64 % 100; // range [-99, 99]
-		int64_t lon64 = (int64_t)(settings.longitude * 1e9);
-		_buf.payload_tx_cfg_tmode3.ecefYOrLon = (int32_t)(lon64 / 100);
-		_buf.payload_tx_cfg_tmode3.ecefYOrLonHP = lon64 % 100;
-		int64_t alt64 = (int64_t)((double)settings.altitude * 1e4);
-		_buf.payload_tx_cfg_tmode3.ecefZOrAlt = (int32_t)(alt64 / 100); // cm
-		_buf.payload_tx_cfg_tmode3.ecefZOrAltHP = alt64 % 100; // 0.1mm
+	ubx_cfg_batch_t::Message &msg = _cfg_batch->msgs[_cfg_batch->msg_count++];
+	msg.offset = _cfg_batch->length;
+	msg.length = UBX_CFG_HEADER_SIZE;
+	msg.keys = 0;
+	msg.required = required;
 
-		_buf.payload_tx_cfg_tmode3.fixedPosAcc = (uint32_t)(settings.position_accuracy * 10.f);
+	uint8_t *header = _cfg_batch->data + msg.offset;
+	memset(header, 0, UBX_CFG_HEADER_SIZE);
+	header[1] = _cfg_layers;
+	_cfg_batch->length += UBX_CFG_HEADER_SIZE;
+}
 
-		if (!sendMessage(UBX_MSG_CFG_TMODE3, (uint8_t *)&_buf, sizeof(_buf.payload_tx_cfg_tmode3))) {
-			return -1;
-		}
+bool GPSDriverUBX::cfgBatchAdd(uint32_t key_id, const void *value, size_t size)
+{
+	if (cfgValueSize(key_id) != size || (key_id & UBX_CFG_KEY_RESERVED_MASK) != 0) {
+		UBX_WARN("CFG key 0x%08x: invalid size", (unsigned)key_id);
 
-		if (waitForAck(UBX_MSG_CFG_TMODE3, UBX_CONFIG_TIMEOUT, true) < 0) {
-			return -1;
+		if (_cfg_batch) {
+			_cfg_batch->error = true;
 		}
 
-		// directly enable RTCM3 output
-		return activateRTCMOutput(true);
+		return false;
 	}
 
-	return 0;
-}
+	if (!_cfg_batch) {
+		return false;
+	}
+
+	if (_cfg_batch->msg_count == 0 || _cfg_batch->error) {
+		_cfg_batch->error = true;
+		return false;
+	}
+
+	if (_cfg_batch->msgs[_cfg_batch->msg_count - 1].keys >= UBX_CFG_MAX_KEYS) {
+		cfgBatchMessage(_cfg_batch->msgs[_cfg_batch->msg_count - 1].required);
+
+		if (_cfg_batch->error) {
+			return false;
+		}
+	}
+
+	if (_cfg_batch->length + sizeof(key_id) + size > sizeof(_cfg_batch->data)) {
+		UBX_WARN("CFG batch too large");
+		_cfg_batch->error = true;
+		return false;
+	}
+
+	ubx_cfg_batch_t::Message &msg = _cfg_batch->msgs[_cfg_batch->msg_count - 1];
+	memcpy(_cfg_batch->data + _cfg_batch->length, &key_id, sizeof(key_id));
+	memcpy(_cfg_batch->data + _cfg_batch->length + sizeof(key_id), value, size);
+	_cfg_batch->length += (uint16_t)(sizeof(key_id) + size);
+	msg.length += (uint16_t)(sizeof(key_id) + size);
+	msg.keys++;
+	return true;
+}
+
+bool GPSDriverUBX::cfgBatchValsetPort(uint32_t key_id, uint8_t value)
+{
+	if (_interface == Interface::SPI) {
+		return cfgBatchValset<uint8_t>(key_id + 4, value);
+	}
+
+	// enable on UART1 & USB, M10 has no USB
+	return cfgBatchValset<uint8_t>(key_id + 1, value)
+	       && (_board == Board::u_blox10 || cfgBatchValset<uint8_t>(key_id + 3, value));
+}
+
+void GPSDriverUBX::cfgBatchPoll(const uint8_t *poll, size_t keys)
+{
+	if (sendMessage(UBX_MSG_CFG_VALGET, poll, (uint16_t)(UBX_CFG_HEADER_SIZE + keys * sizeof(uint32_t)))) {
+		_cfg_valget_pending++;
+	}
+}
+
+void GPSDriverUBX::cfgBatchReadBack(uint8_t layers, const uint32_t *only_keys, size_t only_count)
+{
+	// the polls are built in _buf: as many keys as fit, the responses have no size limit
+	const size_t max_keys = MIN((sizeof(_buf) - UBX_CFG_HEADER_SIZE) / sizeof(uint32_t), (size_t)UBX_CFG_MAX_KEYS);
+	uint8_t *poll = (uint8_t *)&_buf;
+	_cfg_valget_pending = 0;
+
+	for (uint8_t layer = 0; layer < 3; layer++) {
+		if (!(layers & (1 << layer))) {
+			continue;
+		}
+
+		size_t keys = 0;
+
+		for (uint8_t m = 0; m < _cfg_batch->msg_count; m++) {
+			const ubx_cfg_batch_t::Message &msg = _cfg_batch->msgs[m];
+			size_t pos = msg.offset + UBX_CFG_HEADER_SIZE;
+
+			while (pos < (size_t)(msg.offset + msg.length)) {
+				uint32_t key_id;
+				memcpy(&key_id, _cfg_batch->data + pos, sizeof(key_id));
+				key_id &= ~UBX_CFG_KEY_RESERVED_MASK;
+				pos += sizeof(key_id) + cfgValueSize(key_id);
+
+				if (only_keys && !cfgKeyListed(key_id, only_keys, only_count)) {
+					continue;
+				}
+
+				if (keys == 0) {
+					memset(poll, 0, UBX_CFG_HEADER_SIZE);
+					poll[1] = layer;
+				}
+
+				memcpy(poll + UBX_CFG_HEADER_SIZE + keys * sizeof(key_id), &key_id, sizeof(key_id));
+
+				if (++keys == max_keys) {
+					cfgBatchPoll(poll, keys);
+					keys = 0;
+				}
+			}
+		}
+
+		if (keys > 0) {
+			cfgBatchPoll(poll, keys);
+		}
+	}
+
+	// the polls are answered in order, wait as long as responses keep coming
+	gps_abstime last_response = gps_absolute_time();
+	uint8_t pending = _cfg_valget_pending;
+
+	while (_cfg_valget_pending > 0 && gps_absolute_time() < last_response + UBX_CONFIG_TIMEOUT * 1000) {
+		receive(UBX_CONFIG_TIMEOUT);
+
+		if (_cfg_valget_pending != pending) {
+			pending = _cfg_valget_pending;
+			last_response = gps_absolute_time();
+		}
+	}
+
+	if (_cfg_valget_pending > 0) {
+		UBX_DEBUG("CFG-VALGET: %u responses missing", (unsigned)_cfg_valget_pending);
+	}
+
+	_cfg_valget_pending = 0;
+}
+
+bool GPSDriverUBX::cfgKeyListed(uint32_t key_id, const uint32_t *keys, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (keys[i] == key_id) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool GPSDriverUBX::cfgBatchConfirm()
+{
+	// the NAV-PVT output and the protocols of the port, and the rate
+	const bool spi = _interface == Interface::SPI;
+	const uint32_t keys[] = {
+		UBX_CFG_KEY_MSGOUT_UBX_NAV_PVT_I2C + (spi ? 4u : 1u),
+		UBX_CFG_KEY_RATE_MEAS,
+		spi ? (uint32_t)UBX_CFG_KEY_CFG_SPIOUTPROT_UBX : (uint32_t)UBX_CFG_KEY_CFG_UART1OUTPROT_UBX,
+		UBX_CFG_KEY_CFG_UART1INPROT_RTCM3X,
+	};
+	const size_t count = sizeof(keys) / sizeof(keys[0]);
+
+	// RAM can hold a runtime change, e.g. of the rate, only the layers loaded on startup are checked
+	const uint8_t layers = _cfg_layers & (UBX_CFG_LAYER_BBR | UBX_CFG_LAYER_FLASH);
+	uint32_t set_in_layers = 0;
+
+	for (uint8_t layer = 1; layer < 3; layer++) {
+		if (layers & (1 << layer)) {
+			set_in_layers |= UBX_CFG_KEY_SET_IN_LAYER(layer);
+		}
+	}
+
+	cfgBatchReadBack(layers, keys, count);
+
+	unsigned confirmed = 0;
+
+	for (uint8_t m = 0; m < _cfg_batch->msg_count; m++) {
+		const ubx_cfg_batch_t::Message &msg = _cfg_batch->msgs[m];
+		size_t pos = msg.offset + UBX_CFG_HEADER_SIZE;
+
+		while (pos < (size_t)(msg.offset + msg.length)) {
+			uint32_t key_id;
+			memcpy(&key_id, _cfg_batch->data + pos, sizeof(key_id));
+			pos += sizeof(key_id) + cfgValueSize(key_id);
+
+			if (!cfgKeyListed(key_id & ~UBX_CFG_KEY_RESERVED_MASK, keys, count)) {
+				continue;
+			}
+
+			if ((key_id & set_in_layers) != set_in_layers) {
+				return false;
+			}
+
+			confirmed++;
+		}
+	}
+
+	return confirmed > 0;
+}
+
+void GPSDriverUBX::cfgBatchMatch(uint8_t layer, uint32_t key_id, const uint8_t *value, size_t size)
+{
+	if (!_cfg_batch || layer > 2 || size != cfgValueSize(key_id)) {
+		return;
+	}
+
+	// A key can be in several messages of the batch, with the last one applied last. It can only be
+	// skipped if every occurrence has the value that is already set.
+	for (int mark = 0; mark < 2; mark++) {
+		for (uint8_t m = 0; m < _cfg_batch->msg_count; m++) {
+			const ubx_cfg_batch_t::Message &msg = _cfg_batch->msgs[m];
+			size_t pos = msg.offset + UBX_CFG_HEADER_SIZE;
+
+			while (pos < (size_t)(msg.offset + msg.length)) {
+				uint32_t batch_key_id;
+				memcpy(&batch_key_id, _cfg_batch->data + pos, sizeof(batch_key_id));
+
+				if ((batch_key_id & ~UBX_CFG_KEY_RESERVED_MASK) == key_id) {
+					if (memcmp(_cfg_batch->data + pos + sizeof(batch_key_id), value, size) != 0) {
+						return;
+					}
+
+					if (mark) {
+						batch_key_id |= UBX_CFG_KEY_SET_IN_LAYER(layer);
+						memcpy(_cfg_batch->data + pos, &batch_key_id, sizeof(batch_key_id));
+					}
+				}
+
+				pos += sizeof(batch_key_id) + cfgValueSize(batch_key_id);
+			}
+		}
+	}
+}
+
+int GPSDriverUBX::cfgBatchCommit()
+{
+	const int ret = _cfg_batch && !_cfg_batch->error ? cfgBatchSend() : -1;
+	destroyBuffer(_cfg_batch);
+	return ret;
+}
+
+int GPSDriverUBX::cfgBatchSend()
+{
+	const bool read_back = _cfg_layers & (UBX_CFG_LAYER_BBR | UBX_CFG_LAYER_FLASH);
+	uint32_t set_in_all_layers = 0;
+
+	// A configuration in BBR or flash is loaded by the receiver on startup. If it's the one of the last
+	// start (same receiver, firmware, layers and keys), there is nothing to send. The fingerprint is
+	// kept by the host, so a few keys confirm that the receiver still has the configuration: it's lost
+	// with the backup battery, by a factory reset, or changed by another tool.
+	uint32_t fingerprint = fnv1_32_buf(&_unique_id, sizeof(_unique_id), FNV1_32_INIT);
+	fingerprint = fnv1_32_buf(&_ubx_version, sizeof(_ubx_version), fingerprint);
+	fingerprint = fnv1_32_buf(_cfg_batch->data, _cfg_batch->length, fingerprint);
+
+	if (read_back && _unique_id != 0 && fingerprint == _config_fingerprint) {
+		if (cfgBatchConfirm()) {
+			UBX_DEBUG("CFG batch: fingerprint 0x%08x matches, configuration kept", (unsigned)fingerprint);
+			return 1;
+		}
+
+		UBX_WARN("CFG batch: fingerprint matches, but the receiver lost the configuration");
+	}
+
+	_config_fingerprint = 0;
+
+	if (read_back) {
+		cfgBatchReadBack(_cfg_layers);
+
+		for (uint8_t layer = 0; layer < 3; layer++) {
+			if (_cfg_layers & (1 << layer)) {
+				set_in_all_layers |= UBX_CFG_KEY_SET_IN_LAYER(layer);
+			}
+		}
+	}
+
+	// Send all messages before waiting for any ACK: the receiver handles them in order, so the n-th
+	// CFG-VALSET ACK (or NAK) belongs to the n-th message sent.
+	bool sent[UBX_CFG_BATCH_MSGS] {};
+	unsigned keys_skipped = 0;
+	_cfg_acks_received = 0;
+	_cfg_nak_mask = 0;
+	_cfg_acks_expected = 0;
+
+	for (uint8_t m = 0; m < _cfg_batch->msg_count; m++) {
+		ubx_cfg_batch_t::Message &msg = _cfg_batch->msgs[m];
+
+		if (read_back) {
+			// drop the keys that are already set, clear the marks of the others
+			const size_t end = msg.offset + msg.length;
+			size_t pos = msg.offset + UBX_CFG_HEADER_SIZE;
+			size_t out = pos;
+
+			while (pos < end) {
+				uint32_t key_id;
+				memcpy(&key_id, _cfg_batch->data + pos, sizeof(key_id));
+				const size_t pair_size = sizeof(key_id) + cfgValueSize(key_id);
+
+				if ((key_id & set_in_all_layers) == set_in_all_layers) {
+					msg.keys--;
+					keys_skipped++;
+
+				} else {
+					key_id &= ~UBX_CFG_KEY_RESERVED_MASK;
+					memmove(_cfg_batch->data + out, _cfg_batch->data + pos, pair_size);
+					memcpy(_cfg_batch->data + out, &key_id, sizeof(key_id));
+					out += pair_size;
+				}
+
+				pos += pair_size;
+			}
+
+			msg.length = (uint16_t)(out - msg.offset);
+		}
+
+		if (msg.keys == 0) {
+			continue;
+		}
+
+		if (!sendMessage(UBX_MSG_CFG_VALSET, _cfg_batch->data + msg.offset, msg.length)) {
+			_cfg_acks_expected = 0;
+			return -1;
+		}
+
+		sent[m] = true;
+		_cfg_acks_expected++;
+	}
+
+	if (read_back) {
+		UBX_DEBUG("CFG batch: %u keys already set", keys_skipped);
+	}
+
+	gps_abstime last_ack = gps_absolute_time();
+	uint8_t acks = 0;
+
+	while (_cfg_acks_received < _cfg_acks_expected && gps_absolute_time() < last_ack + UBX_CONFIG_TIMEOUT * 1000) {
+		receive(UBX_CONFIG_TIMEOUT);
+
+		if (_cfg_acks_received != acks) {
+			acks = _cfg_acks_received;
+			last_ack = gps_absolute_time();
+		}
+	}
+
+	int ret = 0;
+	unsigned ack_index = 0;
+
+	for (uint8_t m = 0; m < _cfg_batch->msg_count; m++) {
+		if (!sent[m]) {
+			continue;
+		}
+
+		const bool acked = ack_index < _cfg_acks_received && !(_cfg_nak_mask & (1u << ack_index));
+
+		if (!acked && _cfg_batch->msgs[m].required) {
+			UBX_DEBUG("CFG-VALSET %u of the batch %s", (unsigned)m, ack_index < _cfg_acks_received ? "NAK" : "ACK timeout");
+			ret = -1;
+		}
+
+		ack_index++;
+	}
+
+	if (ret == 0 && read_back && _unique_id != 0) {
+		_config_fingerprint = fingerprint;
+	}
+
+	_cfg_acks_expected = 0;
+	return ret;
+}
+
+#if UBX_SUPPORT_RTK
+#if UBX_SUPPORT_PRE_V27
+int GPSDriverUBX::restartSurveyInPreV27()
+{
+	//disable RTCM output
+	configureMessageRate(UBX_MSG_RTCM3_1005, 0);
+	configureMessageRate(UBX_MSG_RTCM3_1077, 0);
+	configureMessageRate(UBX_MSG_RTCM3_1087, 0);
+	configureMessageRate(UBX_MSG_RTCM3_1230, 0);
+	configureMessageRate(UBX_MSG_RTCM3_1097, 0);
+	configureMessageRate(UBX_MSG_RTCM3_1127, 0);
+
+	//stop it first
+	//FIXME: stopping the survey-in process does not seem to work
+	memset(&_buf.payload_tx_cfg_tmode3, 0, sizeof(_buf.payload_tx_cfg_tmode3));
+	_buf.payload_tx_cfg_tmode3.flags        = 0; /* disable time mode */
+
+	if (!sendMessage(UBX_MSG_CFG_TMODE3, (uint8_t *)&_buf, sizeof(_buf.payload_tx_cfg_tmode3))) {
+		UBX_WARN("TMODE3 failed. Device w/o base station support?");
+		return -1;
+	}
+
+	if (waitForAck(UBX_MSG_CFG_TMODE3, UBX_CONFIG_TIMEOUT, true) < 0) {
+		return -1;
+	}
+
+	if (_base_settings.type == BaseSettingsType::survey_in) {
+		UBX_DEBUG("Starting Survey-in");
+
+		memset(&_buf.payload_tx_cfg_tmode3, 0, sizeof(_buf.payload_tx_cfg_tmode3));
+		_buf.payload_tx_cfg_tmode3.flags        = 1; /* start survey-in */
+		_buf.payload_tx_cfg_tmode3.svinMinDur   = _base_settings.settings.survey_in.min_dur;
+		_buf.payload_tx_cfg_tmode3.svinAccLimit = _base_settings.settings.survey_in.acc_limit;
+
+		if (!sendMessage(UBX_MSG_CFG_TMODE3, (uint8_t *)&_buf, sizeof(_buf.payload_tx_cfg_tmode3))) {
+			return -1;
+		}
+
+		if (waitForAck(UBX_MSG_CFG_TMODE3, UBX_CONFIG_TIMEOUT, true) < 0) {
+			return -1;
+		}
+
+		/* enable status output of survey-in */
+		if (!configureMessageRateAndAck(UBX_MSG_NAV_SVIN, 5, true)) {
+			return -1;
+		}
+
+	} else {
+		UBX_DEBUG("Setting fixed base position");
+
+		const FixedPositionSettings &settings = _base_settings.settings.fixed_position;
+
+		memset(&_buf.payload_tx_cfg_tmode3, 0, sizeof(_buf.payload_tx_cfg_tmode3));
+		_buf.payload_tx_cfg_tmode3.flags = 2 /* fixed mode */ | (1 << 8) /* lat/lon mode */;
+		int64_t lat64 = (int64_t)(settings.latitude * 1e9);
+		_buf.payload_tx_cfg_tmode3.ecefXOrLat = (int32_t)(lat64 / 100);
+		_buf.payload_tx_cfg_tmode3.ecefXOrLatHP = lat64 % 100; // range [-99, 99]
+		int64_t lon64 = (int64_t)(settings.longitude * 1e9);
+		_buf.payload_tx_cfg_tmode3.ecefYOrLon = (int32_t)(lon64 / 100);
+		_buf.payload_tx_cfg_tmode3.ecefYOrLonHP = lon64 % 100;
+		int64_t alt64 = (int64_t)((double)settings.altitude * 1e4);
+		_buf.payload_tx_cfg_tmode3.ecefZOrAlt = (int32_t)(alt64 / 100); // cm
+		_buf.payload_tx_cfg_tmode3.ecefZOrAltHP = alt64 % 100; // 0.1mm
+
+		_buf.payload_tx_cfg_tmode3.fixedPosAcc = (uint32_t)(settings.position_accuracy * 10.f);
+
+		if (!sendMessage(UBX_MSG_CFG_TMODE3, (uint8_t *)&_buf, sizeof(_buf.payload_tx_cfg_tmode3))) {
+			return -1;
+		}
+
+		if (waitForAck(UBX_MSG_CFG_TMODE3, UBX_CONFIG_TIMEOUT, true) < 0) {
+			return -1;
+		}
+
+		// directly enable RTCM3 output
+		return activateRTCMOutput(true);
+	}
+
+	return 0;
+}
+#endif
 
 int GPSDriverUBX::restartSurveyIn()
 {
@@ -954,10 +1530,14 @@ int GPSDriverUBX::restartSurveyIn()
 		return -1;
 	}
 
+#if UBX_SUPPORT_PRE_V27
+
 	if (!_proto_ver_27_or_higher) {
 		return restartSurveyInPreV27();
 	}
 
+#endif
+
 	//disable RTCM output
 	int cfg_valset_msg_size = initCfgValset();
 	cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1005_I2C, 0, cfg_valset_msg_size);
@@ -1020,6 +1600,7 @@ int GPSDriverUBX::restartSurveyIn()
 
 	return 0;
 }
+#endif
 
 int	// -1 = NAK, error or timeout, 0 = ACK
 GPSDriverUBX::waitForAck(const uint16_t msg, const unsigned timeout, const bool report)
@@ -1054,59 +1635,365 @@ GPSDriverUBX::waitForAck(const uint16_t msg, const unsigned timeout, const bool
 int	// -1 = error, 0 = no message handled, 1 = message handled, 2 = sat info message handled
 GPSDriverUBX::receive(unsigned timeout)
 {
+	if (_spi_buffer) {
+		return receiveSPI(timeout);
+	}
+
 	uint8_t buf[GPS_READ_BUFFER_SIZE];
 
 	/* timeout additional to poll */
 	gps_abstime time_started = gps_absolute_time();
 
-	int handled = 0;
-
 	while (true) {
-		bool ready_to_return = _configured ? (_got_posllh && _got_velned) : handled;
-
-		/* return success if ready */
-		if (ready_to_return) {
-			_got_posllh = false;
-			_got_velned = false;
-			return handled;
-		}
-
 		/* Wait for only UBX_PACKET_TIMEOUT if something already received. */
-		int ret = read(buf, sizeof(buf), (_got_posllh || _got_velned) ? UBX_PACKET_TIMEOUT : timeout);
+		int ret = read(buf, sizeof(buf), _epoch.pending() ? UBX_PACKET_TIMEOUT : timeout);
 
 		if (ret < 0) {
 			/* something went wrong when polling or reading */
 			UBX_WARN("ubx poll_or_read err");
+			_handled_pending = 0;
 			return -1;
 
 		} else if (ret > 0) {
 			//UBX_DEBUG("read %d bytes", ret);
 
-			/* pass received bytes to the packet decoder */
-			for (int i = 0; i < ret; i++) {
-				handled |= parseChar(buf[i]);
-				//UBX_DEBUG("parsed %d: 0x%x", i, buf[i]);
+			/* pass received bytes to the packet decoder, return success if ready */
+			int handled = feed(buf, ret);
+
+			if (handled > 0) {
+				return handled;
 			}
+		}
 
-			if (_interface == Interface::SPI) {
-				if (buf[ret - 1] == 0xff) {
-					if (ready_to_return) {
-						_got_posllh = false;
-						_got_velned = false;
-						return handled;
-					}
+		/* abort after timeout if no useful packets received */
+		if (time_started + timeout * 1000 < gps_absolute_time()) {
+			UBX_DEBUG("timed out, returning");
+			_handled_pending = 0;
+			return -1;
+		}
+	}
+}
+
+int
+GPSDriverUBX::receiveSPI(unsigned timeout)
+{
+	uint8_t *const buf = _spi_buffer->data;
+
+	/* timeout additional to poll */
+	gps_abstime time_started = gps_absolute_time();
+
+	while (true) {
+		if (_spi_pos == _spi_data_length && _spi_data_length < _spi_transfer_length) {
+			if (_decode_state != UBX_DECODE_SYNC1) {
+				/* a frame in progress ends with 0xFF bytes (e.g. its checksum), they are not all fill */
+				_spi_data_length = _spi_transfer_length;
+
+			} else {
+				/* skip the fill. A transfer of only fill: the receiver has nothing queued, don't poll it back
+				 * to back. After data the next frame may follow soon, it's polled right away. */
+				if (_spi_data_length == 0) {
+					gps_usleep(UBX_SPI_IDLE_SLEEP);
+				}
+
+				_spi_transfer_length = _spi_data_length;
+			}
+		}
+
+		if (_spi_pos == _spi_transfer_length) {
+			/* Wait for only UBX_PACKET_TIMEOUT if something already received. */
+			int ret = read(buf, spiTransferLength(), _epoch.pending() ? UBX_PACKET_TIMEOUT : timeout);
+
+			if (ret < 0) {
+				UBX_WARN("ubx spi read err");
+				_handled_pending = 0;
+				return -1;
+			}
+
+			_spi_pos = 0;
+			_spi_transfer_length = (uint16_t)ret;
+			_spi_data_length = (uint16_t)(ret - spiFillLength(buf, ret));
+		}
+
+		/* Parse in parts of a UART read: an update completed by one leaves the rest for the next call */
+		const uint16_t length = MIN((uint16_t)GPS_READ_BUFFER_SIZE, (uint16_t)(_spi_data_length - _spi_pos));
+
+		if (length > 0) {
+			int handled = feed(buf + _spi_pos, length);
+			_spi_pos = (uint16_t)(_spi_pos + length);
+			_spi_update_bytes = (uint16_t)MIN(_spi_update_bytes + length, UINT16_MAX);
+
+			if (handled > 0) {
+				if (handled & 1) {
+					// the next update is expected to be as large, it shrinks slowly after a larger one
+					const unsigned decayed = _spi_update_size - _spi_update_size / 8u;
+					_spi_update_size = (uint16_t)(_spi_update_bytes > decayed ? _spi_update_bytes : decayed);
+					_spi_update_bytes = 0;
 				}
+
+				return handled;
 			}
 		}
 
 		/* abort after timeout if no useful packets received */
 		if (time_started + timeout * 1000 < gps_absolute_time()) {
 			UBX_DEBUG("timed out, returning");
+			_handled_pending = 0;
 			return -1;
 		}
 	}
 }
 
+int
+GPSDriverUBX::spiTransferLength() const
+{
+	const unsigned expected = _spi_update_size > _spi_update_bytes ? _spi_update_size - _spi_update_bytes : 0;
+
+	if (expected < GPS_READ_BUFFER_SIZE) {
+		return GPS_READ_BUFFER_SIZE;
+	}
+
+	return expected < sizeof(_spi_buffer->data) ? (int)expected : (int)sizeof(_spi_buffer->data);
+}
+
+size_t
+GPSDriverUBX::spiFillLength(const uint8_t *buf, size_t len)
+{
+	// the fill is at the end, scanned backwards a word at a time
+	size_t data = len;
+
+	while (data >= sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, buf + data - sizeof(word), sizeof(word));
+
+		if (word != UINT64_MAX) {
+			break;
+		}
+
+		data -= sizeof(word);
+	}
+
+	while (data > 0 && buf[data - 1] == 0xff) {
+		data--;
+	}
+
+	return len - data;
+}
+
+int	// 0 = no update yet, otherwise the OR of the handled messages: 1 = message handled, 2 = sat info message handled
+GPSDriverUBX::feed(const uint8_t *buf, size_t buf_length)
+{
+	_report_hold.resume(*_gps_position);
+	statsBytesReceived(buf_length);
+	receivedData(buf_length);
+	_handled_pending |= parseBuffer(buf, buf_length);
+
+	bool ready_to_return = _configured ? _epoch.complete() : _handled_pending;
+
+	if (!ready_to_return) {
+		return 0;
+	}
+
+	_epoch.reset();
+
+	// a complete epoch is a position update, even if its NAV-PVT came in the read that returned the last one
+	int handled = _configured ? _handled_pending | 1 : _handled_pending;
+	_handled_pending = 0;
+
+	// an epoch that completed in the middle of the read is returned, not the next one after it
+	uint32_t epoch = _configured ? _epoch.completedEpoch() : _epoch.epoch();
+	_report_hold.release(*_gps_position, &epoch);
+
+	if (handled & 1) {
+#if UBX_SUPPORT_RTK
+
+		// the moving baseline heading at the time of the position, published with it
+		if (_heading_aligner.valid()
+		    && !_heading_aligner.headingAt(epoch, _gps_position->heading, _gps_position->heading_accuracy)) {
+			_gps_position->heading = NAN;
+		}
+
+#endif
+		statsUpdate();
+
+		if (_configured) {
+			adaptRate();
+		}
+	}
+
+	return handled;
+}
+
+void
+GPSDriverUBX::adaptRate()
+{
+	const unsigned rate_meas = _rate_planner.update(gps_absolute_time());
+
+	if (rate_meas == 0) {
+		return;
+	}
+
+	UBX_WARN("achieved rate changed, measurement period %u ms", rate_meas);
+	setMeasurementRate(rate_meas, false);
+}
+
+int
+GPSDriverUBX::setMeasurementRate(unsigned rate_meas, bool wait_ack)
+{
+	// not in _buf, which holds the message being received
+	const size_t header_size = sizeof(ubx_payload_tx_cfg_valset_t) - sizeof(ubx_payload_tx_cfg_valset_t::cfgData);
+	ubx_payload_tx_cfg_valset_t header{};
+	header.layers = UBX_CFG_LAYER_RAM;
+	const uint32_t key_id = UBX_CFG_KEY_RATE_MEAS;
+	const uint16_t value = (uint16_t)rate_meas;
+	uint8_t cfg_valset[header_size + sizeof(key_id) + sizeof(value)];
+	memcpy(cfg_valset, &header, header_size);
+	memcpy(cfg_valset + header_size, &key_id, sizeof(key_id));
+	memcpy(cfg_valset + header_size + sizeof(key_id), &value, sizeof(value));
+
+	if (!sendMessage(UBX_MSG_CFG_VALSET, cfg_valset, sizeof(cfg_valset))) {
+		return -1;
+	}
+
+	return wait_ack ? waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, true) : 0;
+}
+
+int	// 0 = decoding, 1 = message handled, 2 = sat info message handled
+GPSDriverUBX::parseBuffer(const uint8_t *buf, const size_t len)
+{
+	int ret = 0;
+	size_t i = 0;
+
+	while (i < len) {
+		// the update is complete, the rest of the read can start the next epoch
+		if (_configured && _epoch.complete()) {
+			_report_hold.hold(*_gps_position, _epoch.completedEpoch());
+		}
+
+		switch (_decode_state) {
+
+		/* Skip everything that cannot start a UBX or RTCM frame */
+		case UBX_DECODE_SYNC1:
+			if (_rtcm_parsing) {
+				i += textRunLength(buf + i, len - i, UBX_SYNC1, RTCM3_PREAMBLE, UBX_SYNC1, UBX_SYNC1);
+
+			} else {
+				const uint8_t *sync = (const uint8_t *)memchr(buf + i, UBX_SYNC1, len - i);
+				i = sync ? (size_t)(sync - buf) : len;
+			}
+
+			if (i < len) {
+				if (buf[i] == UBX_SYNC1) {
+					frameStart(i);
+
+					// a raw frame that is complete in the input is passed on from there
+					const size_t raw = _raw_frame ? parseRawFrame(buf + i, len - i) : 0;
+
+					if (raw > 0) {
+						i += raw;
+						break;
+					}
+				}
+
+				ret |= parseChar(buf[i++]);
+			}
+
+			break;
+
+		/* Copy the available part of a plain payload in one go, only checksum an ignored one */
+		case UBX_DECODE_PAYLOAD:
+			if (_rx_state == UBX_RXMSG_IGNORE || _rx_state == UBX_RXMSG_RAW ||
+			    (_rx_payload == UBX_RXPAYLOAD_PLAIN && _rx_payload_length <= sizeof(_buf))) {
+				const size_t run = MIN((size_t)(_rx_payload_length - _rx_payload_index), len - i);
+				const uint8_t *src = buf + i;
+				uint8_t ck_a = _rx_ck_a;
+				uint8_t ck_b = _rx_ck_b;
+
+				if (_rx_state == UBX_RXMSG_RAW) {
+					memcpy(_raw_frame->data + 6 + _rx_payload_index, src, run);
+
+				} else if (_rx_state != UBX_RXMSG_IGNORE) {
+					memcpy((uint8_t *)&_buf + _rx_payload_index, src, run);
+				}
+
+				for (size_t j = 0; j < run; j++) {
+					ck_a = ck_a + src[j];
+					ck_b = ck_b + ck_a;
+				}
+
+				_rx_ck_a = ck_a;
+				_rx_ck_b = ck_b;
+				_rx_payload_index += (uint16_t)run;
+				i += run;
+
+				if (_rx_payload_index >= _rx_payload_length) {
+					// payload complete, expecting checksum
+					_decode_state = UBX_DECODE_CHKSUM1;
+				}
+
+			} else if ((_rx_payload == UBX_RXPAYLOAD_NAV_SAT || _rx_payload == UBX_RXPAYLOAD_NAV_SVINFO) && _rx_sat_record_pos == 0
+				   && _rx_payload_index > sizeof(ubx_payload_rx_nav_sat_part1_t)) {
+				// decode whole satellite records straight from the input
+				const size_t run = payloadRxAddSatRecords(buf + i, len - i);
+
+				if (run > 0) {
+					i += run;
+
+					if (_rx_payload_index >= _rx_payload_length) {
+						// payload complete, expecting checksum
+						_decode_state = UBX_DECODE_CHKSUM1;
+					}
+
+				} else {
+					ret |= parseChar(buf[i++]);
+				}
+
+			} else {
+				ret |= parseChar(buf[i++]);
+			}
+
+			break;
+
+		default:
+			ret |= parseChar(buf[i++]);
+			break;
+		}
+	}
+
+	return ret;
+}
+
+size_t
+GPSDriverUBX::parseRawFrame(const uint8_t *buf, size_t len)
+{
+	if (len < 8 || buf[1] != UBX_SYNC2 || !rawMessageClass(buf[2])) {
+		return 0;
+	}
+
+	const size_t length = (size_t)(buf[4] | buf[5] << 8) + 8;
+
+	if (length > len) {
+		return 0;
+	}
+
+	uint8_t ck_a = 0;
+	uint8_t ck_b = 0;
+
+	for (size_t i = 2; i < length - 2; i++) {
+		ck_a = ck_a + buf[i];
+		ck_b = ck_b + ck_a;
+	}
+
+	if (ck_a != buf[length - 2] || ck_b != buf[length - 1]) {
+		// parseChar() drops it
+		return 0;
+	}
+
+	statsFrameStart();
+	statsFrameDone((int)length);
+	gotRawMessage(buf, (int)length);
+	return length;
+}
+
 int	// 0 = decoding, 1 = message handled, 2 = sat info message handled
 GPSDriverUBX::parseChar(const uint8_t b)
 {
@@ -1119,6 +2006,7 @@ GPSDriverUBX::parseChar(const uint8_t b)
 		if (b == UBX_SYNC1) {	// Sync1 found --> expecting Sync2
 			UBX_TRACE_PARSER("A");
 			_decode_state = UBX_DECODE_SYNC2;
+			statsFrameStart();
 
 		} else if (b == RTCM3_PREAMBLE && _rtcm_parsing) {
 			UBX_TRACE_PARSER("RTCM");
@@ -1135,6 +2023,7 @@ GPSDriverUBX::parseChar(const uint8_t b)
 			_decode_state = UBX_DECODE_CLASS;
 
 		} else {		// Sync1 not followed by Sync2: reset parser
+			statsResync();
 			decodeInit();
 		}
 
@@ -1185,22 +2074,39 @@ GPSDriverUBX::parseChar(const uint8_t b)
 		UBX_TRACE_PARSER(".");
 		addByteToChecksum(b);
 
-		switch (_rx_msg) {
-		case UBX_MSG_NAV_SAT:
-			ret = payloadRxAddNavSat(b);	// add a NAV-SAT payload byte
-			break;
+		if (_rx_state == UBX_RXMSG_IGNORE) {
+			ret = (++_rx_payload_index >= _rx_payload_length) ? 1 : 0;	// only the checksum is needed
 
-		case UBX_MSG_NAV_SVINFO:
-			ret = payloadRxAddNavSvinfo(b);	// add a NAV-SVINFO payload byte
-			break;
+		} else if (_rx_state == UBX_RXMSG_RAW) {
+			_raw_frame->data[6 + _rx_payload_index] = b;
+			ret = (++_rx_payload_index >= _rx_payload_length) ? 1 : 0;
 
-		case UBX_MSG_MON_VER:
-			ret = payloadRxAddMonVer(b);	// add a MON-VER payload byte
-			break;
+		} else {
+			switch (_rx_payload) {
+			case UBX_RXPAYLOAD_NAV_SAT:
+				ret = payloadRxAddNavSat(b);	// add a NAV-SAT payload byte
+				break;
 
-		default:
-			ret = payloadRxAdd(b);		// add a payload byte
-			break;
+#if UBX_SUPPORT_PRE_V27
+
+			case UBX_RXPAYLOAD_NAV_SVINFO:
+				ret = payloadRxAddNavSvinfo(b);	// add a NAV-SVINFO payload byte
+				break;
+
+#endif
+
+			case UBX_RXPAYLOAD_MON_VER:
+				ret = payloadRxAddMonVer(b);	// add a MON-VER payload byte
+				break;
+
+			case UBX_RXPAYLOAD_CFG_VALGET:
+				ret = payloadRxAddCfgValget(b);	// add a CFG-VALGET payload byte
+				break;
+
+			default:
+				ret = payloadRxAdd(b);		// add a payload byte
+				break;
+			}
 		}
 
 		if (ret < 0) {
@@ -1222,6 +2128,7 @@ GPSDriverUBX::parseChar(const uint8_t b)
 	case UBX_DECODE_CHKSUM1:
 		if (_rx_ck_a != b) {
 			UBX_DEBUG("ubx checksum err");
+			statsChecksumError();
 			decodeInit();
 
 		} else {
@@ -1234,8 +2141,10 @@ GPSDriverUBX::parseChar(const uint8_t b)
 	case UBX_DECODE_CHKSUM2:
 		if (_rx_ck_b != b) {
 			UBX_DEBUG("ubx checksum err");
+			statsChecksumError();
 
 		} else {
+			statsFrameDone(_rx_payload_length + 8);
 			ret = payloadRxDone();	// finish payload processing
 		}
 
@@ -1258,200 +2167,249 @@ GPSDriverUBX::parseChar(const uint8_t b)
 	return ret;
 }
 
-/**
- * Start payload rx
- */
-int	// -1 = abort, 0 = continue
-GPSDriverUBX::payloadRxInit()
-{
-	int ret = 0;
-
-	_rx_state = UBX_RXMSG_HANDLE;	// handle by default
-
-	switch (_rx_msg) {
-	case UBX_MSG_NAV_PVT:
-		if ((_rx_payload_length != UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX7)		/* u-blox 7 msg format */
-		    && (_rx_payload_length != UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX8)) {	/* u-blox 8+ msg format */
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
-
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-
-		} else if (!_use_nav_pvt) {
-			_rx_state = UBX_RXMSG_DISABLE;        // disable if not using NAV-PVT
-		}
-
-		break;
-
-	case UBX_MSG_INF_DEBUG:
-	case UBX_MSG_INF_ERROR:
-	case UBX_MSG_INF_NOTICE:
-	case UBX_MSG_INF_WARNING:
-		if (_rx_payload_length >= sizeof(ubx_buf_t)) {
-			_rx_payload_length = sizeof(ubx_buf_t) - 1; //avoid buffer overflow
-		}
-
-		break;
-
-	case UBX_MSG_NAV_POSLLH:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_nav_posllh_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
-
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-
-		} else if (_use_nav_pvt) {
-			_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
-		}
-
-		break;
-
-	case UBX_MSG_NAV_SOL:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_nav_sol_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
-
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-
-		} else if (_use_nav_pvt) {
-			_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
-		}
-
-		break;
+namespace
+{
 
-	case UBX_MSG_NAV_STATUS:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_nav_status_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+/** When a message with a valid length is handled, see GPSDriverUBX::payloadRxInit() */
+enum class UBXAccept : uint8_t {
+	Always,		///< handled unconditionally
+	Text,		///< handled unconditionally, truncated to fit _buf
+	Configured,	///< ignored until configured
+	NavPvt,		///< ignored until configured, disabled without NAV-PVT
+	NavLegacy,	///< ignored until configured, disabled with NAV-PVT
+	SatInfo,	///< disabled without satellite info buffer, ignored until configured or while not consumed
+	Ack,		///< ignored once configured
+	CfgValget	///< ignored unless polled
+};
+
+/** A received message the driver handles */
+struct UBXMessage {
+	uint16_t msg;
+	uint16_t min_length;	///< valid payload lengths: min_length + n * length_step up to max_length
+	uint16_t max_length;
+	uint16_t length_step;
+	UBXAccept accept;
+	ubx_rxpayload_t payload;
+};
+
+constexpr UBXMessage ubxMessage(uint16_t msg, size_t length, UBXAccept accept)
+{
+	return UBXMessage{msg, (uint16_t)length, (uint16_t)length, 1, accept, UBX_RXPAYLOAD_PLAIN};
+}
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
+constexpr UBXMessage ubxMessage(uint16_t msg, size_t min_length, size_t max_length, size_t length_step, UBXAccept accept,
+				ubx_rxpayload_t payload = UBX_RXPAYLOAD_PLAIN)
+{
+	return UBXMessage{msg, (uint16_t)min_length, (uint16_t)max_length, (uint16_t)length_step, accept, payload};
+}
 
+constexpr UBXMessage ubx_messages[] = {
+	ubxMessage(UBX_MSG_NAV_PVT, UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX7, UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX8,
+		   UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX8 - UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX7, UBXAccept::NavPvt),	// u-blox 7 or 8+ format
+	ubxMessage(UBX_MSG_NAV_DOP, sizeof(ubx_payload_rx_nav_dop_t), UBXAccept::Configured),
+	ubxMessage(UBX_MSG_NAV_EOE, sizeof(ubx_payload_rx_nav_eoe_t), UBXAccept::Configured),
+	ubxMessage(UBX_MSG_NAV_STATUS, sizeof(ubx_payload_rx_nav_status_t), UBXAccept::Configured),
+	ubxMessage(UBX_MSG_NAV_SAT, 0, UINT16_MAX, 1, UBXAccept::SatInfo, UBX_RXPAYLOAD_NAV_SAT),
+#if UBX_SUPPORT_PRE_V27
+	ubxMessage(UBX_MSG_NAV_POSLLH, sizeof(ubx_payload_rx_nav_posllh_t), UBXAccept::NavLegacy),
+	ubxMessage(UBX_MSG_NAV_SOL, sizeof(ubx_payload_rx_nav_sol_t), UBXAccept::NavLegacy),
+	ubxMessage(UBX_MSG_NAV_VELNED, sizeof(ubx_payload_rx_nav_velned_t), UBXAccept::NavLegacy),
+	ubxMessage(UBX_MSG_NAV_TIMEUTC, sizeof(ubx_payload_rx_nav_timeutc_t), UBXAccept::NavLegacy),
+	ubxMessage(UBX_MSG_NAV_SVINFO, 0, UINT16_MAX, 1, UBXAccept::SatInfo, UBX_RXPAYLOAD_NAV_SVINFO),
+	ubxMessage(UBX_MSG_MON_HW, sizeof(ubx_payload_rx_mon_hw_ubx7_t), sizeof(ubx_payload_rx_mon_hw_ubx6_t),
+		   sizeof(ubx_payload_rx_mon_hw_ubx6_t) - sizeof(ubx_payload_rx_mon_hw_ubx7_t), UBXAccept::Configured),
+#endif
+#if UBX_SUPPORT_RTK
+	ubxMessage(UBX_MSG_NAV_RELPOSNED, sizeof(ubx_payload_rx_nav_relposned_t), UBXAccept::Configured),
+	ubxMessage(UBX_MSG_NAV_SVIN, sizeof(ubx_payload_rx_nav_svin_t), UBXAccept::Configured),
+#endif
+	ubxMessage(UBX_MSG_MON_RF, sizeof(ubx_payload_rx_mon_rf_t), sizeof(ubx_buf_t),
+		   sizeof(ubx_payload_rx_mon_rf_t::ubx_payload_rx_mon_rf_block_t), UBXAccept::Configured),
+	ubxMessage(UBX_MSG_MON_VER, 0, UINT16_MAX, 1, UBXAccept::Always, UBX_RXPAYLOAD_MON_VER),
+	ubxMessage(UBX_MSG_SEC_UNIQID, 9, sizeof(ubx_payload_rx_sec_uniqid_t), 1, UBXAccept::Always),
+	ubxMessage(UBX_MSG_CFG_VALGET, UBX_CFG_HEADER_SIZE, UINT16_MAX, 1, UBXAccept::CfgValget, UBX_RXPAYLOAD_CFG_VALGET),
+	ubxMessage(UBX_MSG_ACK_ACK, sizeof(ubx_payload_rx_ack_ack_t), UBXAccept::Ack),
+	ubxMessage(UBX_MSG_ACK_NAK, sizeof(ubx_payload_rx_ack_nak_t), UBXAccept::Ack),
+	ubxMessage(UBX_MSG_INF_DEBUG, 0, UINT16_MAX, 1, UBXAccept::Text),
+	ubxMessage(UBX_MSG_INF_ERROR, 0, UINT16_MAX, 1, UBXAccept::Text),
+	ubxMessage(UBX_MSG_INF_NOTICE, 0, UINT16_MAX, 1, UBXAccept::Text),
+	ubxMessage(UBX_MSG_INF_WARNING, 0, UINT16_MAX, 1, UBXAccept::Text),
+};
+
+constexpr bool ubxMessagesFitBuffer()
+{
+	for (const UBXMessage &message : ubx_messages) {
+		if (message.payload == UBX_RXPAYLOAD_PLAIN && message.accept != UBXAccept::Text && message.max_length > sizeof(ubx_buf_t)) {
+			return false;
 		}
+	}
 
-		break;
+	return true;
+}
 
-	case UBX_MSG_NAV_DOP:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_nav_dop_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+static_assert(ubxMessagesFitBuffer(), "a plain payload must fit into _buf");
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
+constexpr unsigned UBX_MESSAGE_COUNT = sizeof(ubx_messages) / sizeof(ubx_messages[0]);
+constexpr unsigned UBX_MESSAGE_SLOTS = 64;	///< power of 2, more than UBX_MESSAGE_COUNT
+constexpr uint8_t UBX_MESSAGE_NONE = 0xff;
 
+constexpr unsigned ubxMessageSlot(uint16_t msg, uint32_t multiplier)
+{
+	return ((msg * multiplier) >> 16) & (UBX_MESSAGE_SLOTS - 1);
+}
+
+/** Multiplicative hash of the message class and ID, searched at compile time for a multiplier without collisions */
+struct UBXMessageTable {
+	uint32_t multiplier{0};
+	uint8_t index[UBX_MESSAGE_SLOTS] {};
+
+	constexpr UBXMessageTable()
+	{
+		for (uint32_t candidate = 0x9e37; candidate < 0x9e37 + 0x10000; candidate += 2) {
+			if (fill(candidate)) {
+				multiplier = candidate;
+				return;
+			}
 		}
+	}
 
-		break;
+	constexpr bool fill(uint32_t candidate)
+	{
+		for (unsigned slot = 0; slot < UBX_MESSAGE_SLOTS; slot++) {
+			index[slot] = UBX_MESSAGE_NONE;
+		}
 
-	case UBX_MSG_NAV_RELPOSNED:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_nav_relposned_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+		for (unsigned i = 0; i < UBX_MESSAGE_COUNT; i++) {
+			const unsigned slot = ubxMessageSlot(ubx_messages[i].msg, candidate);
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
+			if (index[slot] != UBX_MESSAGE_NONE) {
+				return false;
+			}
 
+			index[slot] = (uint8_t)i;
 		}
 
-		break;
+		return true;
+	}
 
-	case UBX_MSG_NAV_TIMEUTC:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_nav_timeutc_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+	constexpr const UBXMessage *find(uint16_t msg) const
+	{
+		const uint8_t i = index[ubxMessageSlot(msg, multiplier)];
+		return (i != UBX_MESSAGE_NONE && ubx_messages[i].msg == msg) ? &ubx_messages[i] : nullptr;
+	}
+};
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
+constexpr UBXMessageTable ubx_message_table;
 
-		} else if (_use_nav_pvt) {
-			_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
-		}
+static_assert(UBX_MESSAGE_COUNT < UBX_MESSAGE_SLOTS, "UBX_MESSAGE_SLOTS too small");
+static_assert(ubx_message_table.multiplier != 0, "no collision free hash of the UBX messages");
+static_assert(ubx_message_table.find(UBX_MSG_NAV_PVT) == &ubx_messages[0], "UBX message table lookup");
+static_assert(ubx_message_table.find(UBX_MSG_RXM_RAWX) == nullptr, "UBX message table lookup");
 
-		break;
+} // namespace
 
-	case UBX_MSG_NAV_SAT:
-	case UBX_MSG_NAV_SVINFO:
-		if (_satellite_info == nullptr) {
-			_rx_state = UBX_RXMSG_DISABLE;        // disable if sat info not requested
+/**
+ * Start payload rx
+ */
+int	// -1 = abort, 0 = continue
+GPSDriverUBX::payloadRxInit()
+{
+	int ret = 0;
+
+	_rx_state = UBX_RXMSG_HANDLE;	// handle by default
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
+	if (rawMessageClass((uint8_t)_rx_msg)) {
+		// assembled to be passed on, if it fits
+		if (_raw_frame && _rx_payload_length + 8u <= sizeof(_raw_frame->data)) {
+			_rx_state = UBX_RXMSG_RAW;
+			const uint8_t header[6] = {UBX_SYNC1, UBX_SYNC2, (uint8_t)_rx_msg, (uint8_t)(_rx_msg >> 8),
+						   (uint8_t)_rx_payload_length, (uint8_t)(_rx_payload_length >> 8)
+						  };
+			memcpy(_raw_frame->data, header, sizeof(header));
 
 		} else {
-			memset(_satellite_info, 0, sizeof(*_satellite_info));        // initialize sat info
+			_rx_state = UBX_RXMSG_IGNORE;
 		}
 
-		break;
-
-	case UBX_MSG_NAV_SVIN:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_nav_svin_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+		return 0;
+	}
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
+	const UBXMessage *message = ubx_message_table.find(_rx_msg);
+	_rx_payload = message ? message->payload : UBX_RXPAYLOAD_PLAIN;
 
-		}
+	if (message == nullptr) {
+		_rx_state = UBX_RXMSG_DISABLE;	// disable all other messages
 
-		break;
+	} else if (_rx_payload_length < message->min_length || _rx_payload_length > message->max_length
+		   || (_rx_payload_length - message->min_length) % message->length_step != 0) {
+		_rx_state = UBX_RXMSG_ERROR_LENGTH;
 
-	case UBX_MSG_NAV_VELNED:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_nav_velned_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+	} else {
+		switch (message->accept) {
+		case UBXAccept::Always:
+			break;		// unconditionally handle this message
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
+		case UBXAccept::Text:
+			if (_rx_payload_length >= sizeof(ubx_buf_t)) {
+				_rx_payload_length = sizeof(ubx_buf_t) - 1; //avoid buffer overflow
+			}
 
-		} else if (_use_nav_pvt) {
-			_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
-		}
+			break;
 
-		break;
+		case UBXAccept::Configured:
+			if (!_configured) {
+				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
+			}
 
-	case UBX_MSG_MON_VER:
-		break;		// unconditionally handle this message
+			break;
 
-	case UBX_MSG_MON_HW:
-		if ((_rx_payload_length != sizeof(ubx_payload_rx_mon_hw_ubx6_t))	/* u-blox 6 msg format */
-		    && (_rx_payload_length != sizeof(ubx_payload_rx_mon_hw_ubx7_t))) {	/* u-blox 7+ msg format */
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+		case UBXAccept::NavPvt:
+			if (!_configured) {
+				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-		}
+			} else if (!_use_nav_pvt) {
+				_rx_state = UBX_RXMSG_DISABLE;        // disable if not using NAV-PVT
+			}
 
-		break;
+			break;
 
-	case UBX_MSG_MON_RF:
-		if (_rx_payload_length < sizeof(ubx_payload_rx_mon_rf_t) ||
-		    (_rx_payload_length - 4) % sizeof(ubx_payload_rx_mon_rf_t::ubx_payload_rx_mon_rf_block_t) != 0) {
+		case UBXAccept::NavLegacy:
+			if (!_configured) {
+				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
 
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+			} else if (_use_nav_pvt) {
+				_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
+			}
 
-		} else if (!_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-		}
+			break;
 
-		break;
+		case UBXAccept::SatInfo:
+			if (_satellite_info == nullptr) {
+				_rx_state = UBX_RXMSG_DISABLE;        // disable if sat info not requested
 
-	case UBX_MSG_ACK_ACK:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_ack_ack_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+			} else if (!_configured || !satelliteInfoEnabled()) {
+				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured or nobody consumes it
 
-		} else if (_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if _configured
-		}
+			} else {
+				memset(_satellite_info, 0, sizeof(*_satellite_info));        // initialize sat info
+			}
 
-		break;
+			break;
 
-	case UBX_MSG_ACK_NAK:
-		if (_rx_payload_length != sizeof(ubx_payload_rx_ack_nak_t)) {
-			_rx_state = UBX_RXMSG_ERROR_LENGTH;
+		case UBXAccept::Ack:
+			if (_configured) {
+				_rx_state = UBX_RXMSG_IGNORE;        // ignore if _configured
+			}
 
-		} else if (_configured) {
-			_rx_state = UBX_RXMSG_IGNORE;        // ignore if _configured
-		}
+			break;
 
-		break;
+		case UBXAccept::CfgValget:
+			if (_cfg_valget_pending == 0) {
+				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not polled by cfgBatchReadBack()
+			}
 
-	default:
-		_rx_state = UBX_RXMSG_DISABLE;	// disable all other messages
-		break;
+			break;
+		}
 	}
 
 	switch (_rx_state) {
@@ -1491,6 +2449,8 @@ GPSDriverUBX::payloadRxInit()
 				}
 			}
 
+#if UBX_SUPPORT_PRE_V27
+
 		} else {
 			gps_abstime t = gps_absolute_time();
 
@@ -1501,6 +2461,8 @@ GPSDriverUBX::payloadRxInit()
 
 				configureMessageRate(_rx_msg, 0);
 			}
+
+#endif
 		}
 
 		ret = -1;	// return error, abort handling this message
@@ -1556,105 +2518,107 @@ GPSDriverUBX::payloadRxAddNavSat(const uint8_t b)
 					 (unsigned)_buf.payload_rx_nav_sat_part1.numSvs);
 		}
 
-		if (_rx_payload_index < sizeof(ubx_payload_rx_nav_sat_part1_t) + _satellite_info->count * sizeof(
-			    ubx_payload_rx_nav_sat_part2_t)) {
-			// Still room in _satellite_info: fill Part 2 buffer
-			unsigned buf_index = (_rx_payload_index - sizeof(ubx_payload_rx_nav_sat_part1_t)) % sizeof(
-						     ubx_payload_rx_nav_sat_part2_t);
-			p_buf[buf_index] = b;
+		if (_rx_sat_index < _satellite_info->count) {
+			// Still room in _satellite_info: fill Part 2 buffer, decode it once complete
+			p_buf[_rx_sat_record_pos++] = b;
+
+			if (_rx_sat_record_pos == sizeof(ubx_payload_rx_nav_sat_part2_t)) {
+				_rx_sat_record_pos = 0;
+				decodeNavSatRecord(_buf.payload_rx_nav_sat_part2);
+			}
+		}
+	}
 
-			if (buf_index == sizeof(ubx_payload_rx_nav_sat_part2_t) - 1) {
-				// Part 2 complete: decode Part 2 buffer
-				unsigned sat_index = (_rx_payload_index - sizeof(ubx_payload_rx_nav_sat_part1_t)) /
-						     sizeof(ubx_payload_rx_nav_sat_part2_t);
+	if (++_rx_payload_index >= _rx_payload_length) {
+		ret = 1;	// payload received completely
+	}
 
-				// convert gnssId:svId to a 8 bit number (use svId numbering from NAV-SVINFO)
-				uint8_t ubx_sat_gnssId = static_cast<uint8_t>(_buf.payload_rx_nav_sat_part2.gnssId);
-				uint8_t ubx_sat_svId = static_cast<uint8_t>(_buf.payload_rx_nav_sat_part2.svId);
+	return ret;
+}
 
-				uint8_t svinfo_svid = 255;
+void
+GPSDriverUBX::decodeNavSatRecord(const ubx_payload_rx_nav_sat_part2_t &sat)
+{
+	const unsigned sat_index = _rx_sat_index++;
 
-				switch (ubx_sat_gnssId) {
-				case 0:  // GPS: G1-G23 -> 1-32
-					if (ubx_sat_svId >= 1 && ubx_sat_svId <= 32) {
-						svinfo_svid = ubx_sat_svId;
-					}
+	// convert gnssId:svId to a 8 bit number (use svId numbering from NAV-SVINFO)
+	uint8_t ubx_sat_gnssId = static_cast<uint8_t>(sat.gnssId);
+	uint8_t ubx_sat_svId = static_cast<uint8_t>(sat.svId);
 
-					break;
+	uint8_t svinfo_svid = 255;
 
-				case 1:  // SBAS: S120-S158 -> 120-158
-					if (ubx_sat_svId >= 120 && ubx_sat_svId <= 158) {
-						svinfo_svid = ubx_sat_svId;
-					}
+	switch (ubx_sat_gnssId) {
+	case 0:  // GPS: G1-G23 -> 1-32
+		if (ubx_sat_svId >= 1 && ubx_sat_svId <= 32) {
+			svinfo_svid = ubx_sat_svId;
+		}
 
-					break;
+		break;
 
-				case 2:  // Galileo: E1-E36 -> 211-246
-					if (ubx_sat_svId >= 1 && ubx_sat_svId <= 36) {
-						svinfo_svid = ubx_sat_svId + 210;
-					}
+	case 1:  // SBAS: S120-S158 -> 120-158
+		if (ubx_sat_svId >= 120 && ubx_sat_svId <= 158) {
+			svinfo_svid = ubx_sat_svId;
+		}
 
-					break;
+		break;
 
-				case 3:  // BeiDou: B1-B37 -> 159-163,33-64
-					if (ubx_sat_svId >= 1 && ubx_sat_svId <= 4) {
-						svinfo_svid = ubx_sat_svId + 158;
+	case 2:  // Galileo: E1-E36 -> 211-246
+		if (ubx_sat_svId >= 1 && ubx_sat_svId <= 36) {
+			svinfo_svid = ubx_sat_svId + 210;
+		}
 
-					} else if (ubx_sat_svId >= 5 && ubx_sat_svId <= 37) {
-						svinfo_svid = ubx_sat_svId + 28;
-					}
+		break;
 
-					break;
+	case 3:  // BeiDou: B1-B37 -> 159-163,33-64
+		if (ubx_sat_svId >= 1 && ubx_sat_svId <= 4) {
+			svinfo_svid = ubx_sat_svId + 158;
 
-				case 4:  // IMES: I1-I10 -> 173-182
-					if (ubx_sat_svId >= 1 && ubx_sat_svId <= 10) {
-						svinfo_svid = ubx_sat_svId + 172;
-					}
+		} else if (ubx_sat_svId >= 5 && ubx_sat_svId <= 37) {
+			svinfo_svid = ubx_sat_svId + 28;
+		}
 
-					break;
+		break;
 
-				case 5:  // QZSS: Q1-A10 -> 193-202
-					if (ubx_sat_svId >= 1 && ubx_sat_svId <= 10) {
-						svinfo_svid = ubx_sat_svId + 192;
-					}
+	case 4:  // IMES: I1-I10 -> 173-182
+		if (ubx_sat_svId >= 1 && ubx_sat_svId <= 10) {
+			svinfo_svid = ubx_sat_svId + 172;
+		}
 
-					break;
+		break;
 
-				case 6:  // GLONASS: R1-R32 -> 65-96, R? -> 255
-					if (ubx_sat_svId >= 1 && ubx_sat_svId <= 32) {
-						svinfo_svid = ubx_sat_svId + 64;
-					}
+	case 5:  // QZSS: Q1-A10 -> 193-202
+		if (ubx_sat_svId >= 1 && ubx_sat_svId <= 10) {
+			svinfo_svid = ubx_sat_svId + 192;
+		}
 
-					break;
-				}
+		break;
 
-				_satellite_info->svid[sat_index]	  = svinfo_svid;
-				_satellite_info->used[sat_index]	  = static_cast<uint8_t>(_buf.payload_rx_nav_sat_part2.flags & 0x01);
-				_satellite_info->elevation[sat_index] = static_cast<uint8_t>(_buf.payload_rx_nav_sat_part2.elev);
-				_satellite_info->azimuth[sat_index]	  = static_cast<uint8_t>(static_cast<float>(_buf.payload_rx_nav_sat_part2.azim) *
-						255.0f / 360.0f);
-				_satellite_info->snr[sat_index]		  = static_cast<uint8_t>(_buf.payload_rx_nav_sat_part2.cno);
-				_satellite_info->prn[sat_index]		  = svinfo_svid;
-				UBX_TRACE_SVINFO("SAT #%02u  svid %3u  used %u  elevation %3u  azimuth %3u  snr %3u  prn %3u",
-						 static_cast<unsigned>(sat_index + 1),
-						 static_cast<unsigned>(_satellite_info->svid[sat_index]),
-						 static_cast<unsigned>(_satellite_info->used[sat_index]),
-						 static_cast<unsigned>(_satellite_info->elevation[sat_index]),
-						 static_cast<unsigned>(_satellite_info->azimuth[sat_index]),
-						 static_cast<unsigned>(_satellite_info->snr[sat_index]),
-						 static_cast<unsigned>(_satellite_info->prn[sat_index])
-						);
-			}
+	case 6:  // GLONASS: R1-R32 -> 65-96, R? -> 255
+		if (ubx_sat_svId >= 1 && ubx_sat_svId <= 32) {
+			svinfo_svid = ubx_sat_svId + 64;
 		}
-	}
 
-	if (++_rx_payload_index >= _rx_payload_length) {
-		ret = 1;	// payload received completely
+		break;
 	}
 
-	return ret;
+	_satellite_info->svid[sat_index]	  = svinfo_svid;
+	_satellite_info->used[sat_index]	  = static_cast<uint8_t>(sat.flags & 0x01);
+	_satellite_info->elevation[sat_index] = static_cast<uint8_t>(sat.elev);
+	_satellite_info->azimuth[sat_index]	  = static_cast<uint8_t>(static_cast<float>(sat.azim) * 255.0f / 360.0f);
+	_satellite_info->snr[sat_index]		  = static_cast<uint8_t>(sat.cno);
+	_satellite_info->prn[sat_index]		  = svinfo_svid;
+	UBX_TRACE_SVINFO("SAT #%02u  svid %3u  used %u  elevation %3u  azimuth %3u  snr %3u  prn %3u",
+			 static_cast<unsigned>(sat_index + 1),
+			 static_cast<unsigned>(_satellite_info->svid[sat_index]),
+			 static_cast<unsigned>(_satellite_info->used[sat_index]),
+			 static_cast<unsigned>(_satellite_info->elevation[sat_index]),
+			 static_cast<unsigned>(_satellite_info->azimuth[sat_index]),
+			 static_cast<unsigned>(_satellite_info->snr[sat_index]),
+			 static_cast<unsigned>(_satellite_info->prn[sat_index])
+			);
 }
 
+#if UBX_SUPPORT_PRE_V27
 /**
  * Add NAV-SVINFO payload rx byte
  */
@@ -1676,34 +2640,13 @@ GPSDriverUBX::payloadRxAddNavSvinfo(const uint8_t b)
 					 (unsigned)_buf.payload_rx_nav_svinfo_part1.numCh);
 		}
 
-		if (_rx_payload_index < sizeof(ubx_payload_rx_nav_svinfo_part1_t) + _satellite_info->count * sizeof(
-			    ubx_payload_rx_nav_svinfo_part2_t)) {
-			// Still room in _satellite_info: fill Part 2 buffer
-			unsigned buf_index = (_rx_payload_index - sizeof(ubx_payload_rx_nav_svinfo_part1_t)) % sizeof(
-						     ubx_payload_rx_nav_svinfo_part2_t);
-			p_buf[buf_index] = b;
-
-			if (buf_index == sizeof(ubx_payload_rx_nav_svinfo_part2_t) - 1) {
-				// Part 2 complete: decode Part 2 buffer
-				unsigned sat_index = (_rx_payload_index - sizeof(ubx_payload_rx_nav_svinfo_part1_t)) /
-						     sizeof(ubx_payload_rx_nav_svinfo_part2_t);
-				_satellite_info->svid[sat_index]      = static_cast<uint8_t>(_buf.payload_rx_nav_svinfo_part2.svid);
-				_satellite_info->used[sat_index]      = static_cast<uint8_t>(_buf.payload_rx_nav_svinfo_part2.flags & 0x01);
-				_satellite_info->elevation[sat_index] = static_cast<uint8_t>(_buf.payload_rx_nav_svinfo_part2.elev);
-				_satellite_info->azimuth[sat_index]   = static_cast<uint8_t>(static_cast<float>(_buf.payload_rx_nav_svinfo_part2.azim) *
-									255.0f / 360.0f);
-				_satellite_info->snr[sat_index]       = static_cast<uint8_t>(_buf.payload_rx_nav_svinfo_part2.cno);
-				_satellite_info->prn[sat_index]       = static_cast<uint8_t>(_buf.payload_rx_nav_svinfo_part2.svid);
-
-				UBX_TRACE_SVINFO("SVINFO #%02u  svid %3u  used %u  elevation %3u  azimuth %3u  snr %3u  prn %3u",
-						 static_cast<unsigned>(sat_index + 1),
-						 static_cast<unsigned>(_satellite_info->svid[sat_index]),
-						 static_cast<unsigned>(_satellite_info->used[sat_index]),
-						 static_cast<unsigned>(_satellite_info->elevation[sat_index]),
-						 static_cast<unsigned>(_satellite_info->azimuth[sat_index]),
-						 static_cast<unsigned>(_satellite_info->snr[sat_index]),
-						 static_cast<unsigned>(_satellite_info->prn[sat_index])
-						);
+		if (_rx_sat_index < _satellite_info->count) {
+			// Still room in _satellite_info: fill Part 2 buffer, decode it once complete
+			p_buf[_rx_sat_record_pos++] = b;
+
+			if (_rx_sat_record_pos == sizeof(ubx_payload_rx_nav_svinfo_part2_t)) {
+				_rx_sat_record_pos = 0;
+				decodeNavSvinfoRecord(_buf.payload_rx_nav_svinfo_part2);
 			}
 		}
 	}
@@ -1715,6 +2658,116 @@ GPSDriverUBX::payloadRxAddNavSvinfo(const uint8_t b)
 	return ret;
 }
 
+void
+GPSDriverUBX::decodeNavSvinfoRecord(const ubx_payload_rx_nav_svinfo_part2_t &sat)
+{
+	const unsigned sat_index = _rx_sat_index++;
+
+	_satellite_info->svid[sat_index]      = static_cast<uint8_t>(sat.svid);
+	_satellite_info->used[sat_index]      = static_cast<uint8_t>(sat.flags & 0x01);
+	_satellite_info->elevation[sat_index] = static_cast<uint8_t>(sat.elev);
+	_satellite_info->azimuth[sat_index]   = static_cast<uint8_t>(static_cast<float>(sat.azim) * 255.0f / 360.0f);
+	_satellite_info->snr[sat_index]       = static_cast<uint8_t>(sat.cno);
+	_satellite_info->prn[sat_index]       = static_cast<uint8_t>(sat.svid);
+
+	UBX_TRACE_SVINFO("SVINFO #%02u  svid %3u  used %u  elevation %3u  azimuth %3u  snr %3u  prn %3u",
+			 static_cast<unsigned>(sat_index + 1),
+			 static_cast<unsigned>(_satellite_info->svid[sat_index]),
+			 static_cast<unsigned>(_satellite_info->used[sat_index]),
+			 static_cast<unsigned>(_satellite_info->elevation[sat_index]),
+			 static_cast<unsigned>(_satellite_info->azimuth[sat_index]),
+			 static_cast<unsigned>(_satellite_info->snr[sat_index]),
+			 static_cast<unsigned>(_satellite_info->prn[sat_index])
+			);
+}
+#endif
+
+size_t
+GPSDriverUBX::payloadRxAddSatRecords(const uint8_t *buf, size_t len)
+{
+	// both record types are 12 bytes, after an 8 byte part 1
+	static_assert(sizeof(ubx_payload_rx_nav_sat_part2_t) == sizeof(ubx_payload_rx_nav_svinfo_part2_t),
+		      "NAV-SAT and NAV-SVINFO records differ in size");
+	static_assert(sizeof(ubx_payload_rx_nav_sat_part1_t) == sizeof(ubx_payload_rx_nav_svinfo_part1_t),
+		      "NAV-SAT and NAV-SVINFO headers differ in size");
+	const size_t record_size = sizeof(ubx_payload_rx_nav_sat_part2_t);
+	uint8_t ck_a = _rx_ck_a;
+	uint8_t ck_b = _rx_ck_b;
+	size_t consumed = 0;
+
+	while (len - consumed >= record_size && (size_t)(_rx_payload_length - _rx_payload_index) >= record_size
+	       && _rx_sat_index < _satellite_info->count) {
+		const uint8_t *record = buf + consumed;
+
+		for (size_t j = 0; j < record_size; j++) {
+			ck_a = ck_a + record[j];
+			ck_b = ck_b + ck_a;
+		}
+
+		if (_rx_msg == UBX_MSG_NAV_SAT) {
+			ubx_payload_rx_nav_sat_part2_t sat;
+			memcpy(&sat, record, sizeof(sat));
+			decodeNavSatRecord(sat);
+
+#if UBX_SUPPORT_PRE_V27
+
+		} else {
+			ubx_payload_rx_nav_svinfo_part2_t sat;
+			memcpy(&sat, record, sizeof(sat));
+			decodeNavSvinfoRecord(sat);
+#endif
+		}
+
+		_rx_payload_index += (uint16_t)record_size;
+		consumed += record_size;
+	}
+
+	_rx_ck_a = ck_a;
+	_rx_ck_b = ck_b;
+	return consumed;
+}
+
+/**
+ * Add CFG-VALGET payload rx byte: the key and value pairs are matched with the configuration batch
+ * one at a time, the payload can be larger than _buf
+ */
+int	// -1 = error, 0 = ok, 1 = payload completed
+GPSDriverUBX::payloadRxAddCfgValget(const uint8_t b)
+{
+	uint8_t *p_buf = (uint8_t *)&_buf;
+
+	if (_rx_payload_index < UBX_CFG_HEADER_SIZE) {
+		// version, layer, position
+		p_buf[_rx_payload_index] = b;
+		_rx_cfg_pair_pos = 0;
+
+	} else if (_rx_state == UBX_RXMSG_HANDLE) {
+		uint8_t *pair = p_buf + UBX_CFG_HEADER_SIZE;
+		pair[_rx_cfg_pair_pos++] = b;
+
+		if (_rx_cfg_pair_pos >= sizeof(uint32_t)) {
+			uint32_t key_id;
+			memcpy(&key_id, pair, sizeof(key_id));
+			const size_t size = cfgValueSize(key_id);
+
+			if (size == 0) {
+				return -1;
+			}
+
+			if (_rx_cfg_pair_pos == sizeof(key_id) + size) {
+				cfgBatchMatch(p_buf[1], key_id, pair + sizeof(key_id), size);
+				_rx_cfg_pair_pos = 0;
+			}
+		}
+	}
+
+	if (++_rx_payload_index >= _rx_payload_length) {
+		return 1;	// payload received completely
+	}
+
+	return 0;
+}
+
 /**
  * Add MON-VER payload rx byte
  */
@@ -1824,6 +2877,13 @@ GPSDriverUBX::payloadRxDone()
 {
 	int ret = 0;
 
+	if (_rx_state == UBX_RXMSG_RAW) {
+		_raw_frame->data[6 + _rx_payload_length] = _rx_ck_a;
+		_raw_frame->data[7 + _rx_payload_length] = _rx_ck_b;
+		gotRawMessage(_raw_frame->data, _rx_payload_length + 8);
+		return ret;
+	}
+
 	// return if no message handled
 	if (_rx_state != UBX_RXMSG_HANDLE) {
 		return ret;
@@ -1918,14 +2978,14 @@ GPSDriverUBX::payloadRxDone()
 #endif
 		}
 
-		_gps_position->timestamp = gps_absolute_time();
+		_gps_position->timestamp = messageTimestamp(frameStartTime());
 		_last_timestamp_time = _gps_position->timestamp;
 
 		_rate_count_vel++;
 		_rate_count_lat_lon++;
 
-		_got_posllh = true;
-		_got_velned = true;
+		_epoch.add(_buf.payload_rx_nav_pvt.iTOW, GPSEpochAssembler::Position | GPSEpochAssembler::Velocity);
+		statsPositionFrame();
 
 		ret = 1;
 		break;
@@ -1946,6 +3006,8 @@ GPSDriverUBX::payloadRxDone()
 		}
 		break;
 
+#if UBX_SUPPORT_PRE_V27
+
 	case UBX_MSG_NAV_POSLLH:
 		UBX_TRACE_RXMSG("Rx NAV-POSLLH");
 
@@ -1956,10 +3018,11 @@ GPSDriverUBX::payloadRxDone()
 		_gps_position->epv	= static_cast<float>(_buf.payload_rx_nav_posllh.vAcc) * 1e-3f; // from mm to m
 		_gps_position->alt_ellipsoid = _buf.payload_rx_nav_posllh.height;
 
-		_gps_position->timestamp = gps_absolute_time();
+		_gps_position->timestamp = messageTimestamp(frameStartTime());
 
 		_rate_count_lat_lon++;
-		_got_posllh = true;
+		_epoch.add(_buf.payload_rx_nav_posllh.iTOW, GPSEpochAssembler::Position);
+		statsPositionFrame();
 
 		ret = 1;
 		break;
@@ -1974,6 +3037,8 @@ GPSDriverUBX::payloadRxDone()
 		ret = 1;
 		break;
 
+#endif
+
 	case UBX_MSG_NAV_STATUS:
 		UBX_TRACE_RXMSG("Rx NAV-STATUS");
 
@@ -1988,10 +3053,19 @@ GPSDriverUBX::payloadRxDone()
 
 		_gps_position->hdop		= _buf.payload_rx_nav_dop.hDOP * 0.01f;	// from cm to m
 		_gps_position->vdop		= _buf.payload_rx_nav_dop.vDOP * 0.01f;	// from cm to m
+		_epoch.add(_buf.payload_rx_nav_dop.iTOW, GPSEpochAssembler::DOP);
 
 		ret = 1;
 		break;
 
+	case UBX_MSG_NAV_EOE:
+		UBX_TRACE_RXMSG("Rx NAV-EOE");
+
+		_epoch.end(_buf.payload_rx_nav_eoe.iTOW);
+		break;
+
+#if UBX_SUPPORT_PRE_V27
+
 	case UBX_MSG_NAV_TIMEUTC:
 		UBX_TRACE_RXMSG("Rx NAV-TIMEUTC");
 
@@ -2033,13 +3107,17 @@ GPSDriverUBX::payloadRxDone()
 #endif
 		}
 
-		_last_timestamp_time = gps_absolute_time();
+		_last_timestamp_time = messageTimestamp(frameStartTime());
 
 		ret = 1;
 		break;
 
+#endif
+
 	case UBX_MSG_NAV_SAT:
+#if UBX_SUPPORT_PRE_V27
 	case UBX_MSG_NAV_SVINFO:
+#endif
 		UBX_TRACE_RXMSG("Rx NAV-SVINFO");
 
 		// _satellite_info already populated by payload_rx_add_svinfo(), just add a timestamp
@@ -2048,6 +3126,8 @@ GPSDriverUBX::payloadRxDone()
 		ret = 2;
 		break;
 
+#if UBX_SUPPORT_RTK
+
 	case UBX_MSG_NAV_SVIN:
 		UBX_TRACE_RXMSG("Rx NAV-SVIN");
 		{
@@ -2076,6 +3156,10 @@ GPSDriverUBX::payloadRxDone()
 		ret = 1;
 		break;
 
+#endif
+
+#if UBX_SUPPORT_PRE_V27
+
 	case UBX_MSG_NAV_VELNED:
 		UBX_TRACE_RXMSG("Rx NAV-VELNED");
 
@@ -2088,11 +3172,16 @@ GPSDriverUBX::payloadRxDone()
 		_gps_position->vel_ned_valid  = true;
 
 		_rate_count_vel++;
-		_got_velned = true;
+		_epoch.add(_buf.payload_rx_nav_velned.iTOW, GPSEpochAssembler::Velocity);
+		statsPositionFrame();
 
 		ret = 1;
 		break;
 
+#endif
+
+#if UBX_SUPPORT_RTK
+
 	case UBX_MSG_NAV_RELPOSNED:
 		UBX_TRACE_RXMSG("Rx NAV-RELPOSNED");
 
@@ -2114,11 +3203,10 @@ GPSDriverUBX::payloadRxDone()
 					heading -= 2.f * M_PI_F; // final range is [-pi, pi]
 				}
 
-				_gps_position->heading = heading;
-
 				heading_acc *= M_PI_F / 180.0f; // deg to rad, now in range [0, 2pi]
 
-				_gps_position->heading_accuracy = heading_acc;
+				// written into the position update of the same time
+				_heading_aligner.add(_buf.payload_rx_nav_relposned.iTOW, heading, heading_acc);
 
 				UBX_DEBUG("Heading: %.3f rad, acc: %.1f deg, relLen: %.1f cm, relAcc: %.1f cm, valid: %i %i", (double)heading,
 					  (double)heading_acc, (double)rel_length, (double)rel_length_acc, heading_valid, rel_pos_valid);
@@ -2170,6 +3258,8 @@ GPSDriverUBX::payloadRxDone()
 
 		break;
 
+#endif
+
 	case UBX_MSG_MON_VER:
 		UBX_TRACE_RXMSG("Rx MON-VER");
 
@@ -2181,6 +3271,25 @@ GPSDriverUBX::payloadRxDone()
 		ret = 1;
 		break;
 
+	case UBX_MSG_SEC_UNIQID:
+		UBX_TRACE_RXMSG("Rx SEC-UNIQID");
+		// the ID is 5 bytes (version 1) or 6 bytes (version 2) long
+		_unique_id = fnv1_32_buf(_buf.payload_rx_sec_uniqid.uniqueId, _rx_payload_length - 4u, FNV1_32_INIT);
+		ret = 1;
+		break;
+
+	case UBX_MSG_CFG_VALGET:
+		UBX_TRACE_RXMSG("Rx CFG-VALGET");
+
+		if (_cfg_valget_pending > 0) {
+			_cfg_valget_pending--;
+		}
+
+		ret = 1;
+		break;
+
+#if UBX_SUPPORT_PRE_V27
+
 	case UBX_MSG_MON_HW:
 		UBX_TRACE_RXMSG("Rx MON-HW");
 
@@ -2209,6 +3318,8 @@ GPSDriverUBX::payloadRxDone()
 
 		break;
 
+#endif
+
 	case UBX_MSG_MON_RF:
 		UBX_TRACE_RXMSG("Rx MON-RF");
 
@@ -2226,6 +3337,10 @@ GPSDriverUBX::payloadRxDone()
 			_ack_state = UBX_ACK_GOT_ACK;
 		}
 
+		if (_buf.payload_rx_ack_ack.msg == UBX_MSG_CFG_VALSET && _cfg_acks_received < _cfg_acks_expected) {
+			_cfg_acks_received++;
+		}
+
 		ret = 1;
 		break;
 
@@ -2236,6 +3351,15 @@ GPSDriverUBX::payloadRxDone()
 			_ack_state = UBX_ACK_GOT_NAK;
 		}
 
+		if (_buf.payload_rx_ack_nak.msg == UBX_MSG_CFG_VALSET && _cfg_acks_received < _cfg_acks_expected) {
+			_cfg_nak_mask |= 1u << _cfg_acks_received;
+			_cfg_acks_received++;
+
+		} else if (_buf.payload_rx_ack_nak.msg == UBX_MSG_CFG_VALGET && _cfg_valget_pending > 0) {
+			// none of the keys of the poll count as set
+			_cfg_valget_pending--;
+		}
+
 		ret = 1;
 		break;
 
@@ -2250,71 +3374,86 @@ GPSDriverUBX::payloadRxDone()
 	return ret;
 }
 
+#if UBX_SUPPORT_RTK
 int
 GPSDriverUBX::activateRTCMOutput(bool reduce_update_rate)
 {
 	/* For base stations we switch to 1 Hz update rate, which is enough for RTCM output.
 	 * For the survey-in, we still want 5/10 Hz, because this speeds up the process */
 
-	if (_proto_ver_27_or_higher) {
-		int cfg_valset_msg_size = initCfgValset();
+#if UBX_SUPPORT_PRE_V27
 
-		if (reduce_update_rate) {
-			cfgValset<uint16_t>(UBX_CFG_KEY_RATE_MEAS, 1000, cfg_valset_msg_size);
-		}
+	if (!_proto_ver_27_or_higher) {
+		return activateRTCMOutputPreV27(reduce_update_rate);
+	}
 
-		cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1005_I2C, 5, cfg_valset_msg_size);
-		cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1077_I2C, 1, cfg_valset_msg_size);
-		cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1087_I2C, 1, cfg_valset_msg_size);
-		cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1230_I2C, 1, cfg_valset_msg_size);
-		cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1097_I2C, 1, cfg_valset_msg_size);
-		cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1127_I2C, 1, cfg_valset_msg_size);
-		cfgValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_SVIN_I2C, 0, cfg_valset_msg_size);
+#endif
 
-		if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
-			return -1;
-		}
+	int cfg_valset_msg_size = initCfgValset();
 
-		if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, false) < 0) {
-			return -1;
-		}
+	if (reduce_update_rate) {
+		cfgValset<uint16_t>(UBX_CFG_KEY_RATE_MEAS, 1000, cfg_valset_msg_size);
+		_rate_planner.start(1000);
+	}
 
-	} else {
+	cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1005_I2C, 5, cfg_valset_msg_size);
+	cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1077_I2C, 1, cfg_valset_msg_size);
+	cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1087_I2C, 1, cfg_valset_msg_size);
+	cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1230_I2C, 1, cfg_valset_msg_size);
+	cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1097_I2C, 1, cfg_valset_msg_size);
+	cfgValsetPort(UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1127_I2C, 1, cfg_valset_msg_size);
+	cfgValsetPort(UBX_CFG_KEY_MSGOUT_UBX_NAV_SVIN_I2C, 0, cfg_valset_msg_size);
 
-		if (reduce_update_rate) {
-			memset(&_buf.payload_tx_cfg_rate, 0, sizeof(_buf.payload_tx_cfg_rate));
-			_buf.payload_tx_cfg_rate.measRate	= 1000;
-			_buf.payload_tx_cfg_rate.navRate	= UBX_TX_CFG_RATE_NAVRATE;
-			_buf.payload_tx_cfg_rate.timeRef	= UBX_TX_CFG_RATE_TIMEREF;
+	if (!sendMessage(UBX_MSG_CFG_VALSET, (uint8_t *)&_buf, cfg_valset_msg_size)) {
+		return -1;
+	}
 
-			if (!sendMessage(UBX_MSG_CFG_RATE, (uint8_t *)&_buf, sizeof(_buf.payload_tx_cfg_rate))) { return -1; }
+	if (waitForAck(UBX_MSG_CFG_VALSET, UBX_CONFIG_TIMEOUT, false) < 0) {
+		return -1;
+	}
 
-			// according to the spec we should receive an (N)ACK here, but we don't
-		}
+	return 0;
+}
+
+#if UBX_SUPPORT_PRE_V27
+int
+GPSDriverUBX::activateRTCMOutputPreV27(bool reduce_update_rate)
+{
+	if (reduce_update_rate) {
+		memset(&_buf.payload_tx_cfg_rate, 0, sizeof(_buf.payload_tx_cfg_rate));
+		_buf.payload_tx_cfg_rate.measRate	= 1000;
+		_buf.payload_tx_cfg_rate.navRate	= UBX_TX_CFG_RATE_NAVRATE;
+		_buf.payload_tx_cfg_rate.timeRef	= UBX_TX_CFG_RATE_TIMEREF;
 
-		configureMessageRate(UBX_MSG_NAV_SVIN, 0);
+		if (!sendMessage(UBX_MSG_CFG_RATE, (uint8_t *)&_buf, sizeof(_buf.payload_tx_cfg_rate))) { return -1; }
 
-		// stationary RTK reference station ARP (can be sent at lower rate)
-		if (!configureMessageRate(UBX_MSG_RTCM3_1005, 5)) { return -1; }
+		// according to the spec we should receive an (N)ACK here, but we don't
+	}
 
-		// GPS
-		if (!configureMessageRate(UBX_MSG_RTCM3_1077, 1)) { return -1; }
+	configureMessageRate(UBX_MSG_NAV_SVIN, 0);
 
-		// GLONASS
-		if (!configureMessageRate(UBX_MSG_RTCM3_1087, 1)) { return -1; }
+	// stationary RTK reference station ARP (can be sent at lower rate)
+	if (!configureMessageRate(UBX_MSG_RTCM3_1005, 5)) { return -1; }
 
-		// GLONASS code-phase biases
-		if (!configureMessageRate(UBX_MSG_RTCM3_1230, 1)) { return -1; }
+	// GPS
+	if (!configureMessageRate(UBX_MSG_RTCM3_1077, 1)) { return -1; }
 
-		// Galileo
-		if (!configureMessageRate(UBX_MSG_RTCM3_1097, 1)) { return -1; }
+	// GLONASS
+	if (!configureMessageRate(UBX_MSG_RTCM3_1087, 1)) { return -1; }
 
-		// BeiDou
-		if (!configureMessageRate(UBX_MSG_RTCM3_1127, 1)) { return -1; }
-	}
+	// GLONASS code-phase biases
+	if (!configureMessageRate(UBX_MSG_RTCM3_1230, 1)) { return -1; }
+
+	// Galileo
+	if (!configureMessageRate(UBX_MSG_RTCM3_1097, 1)) { return -1; }
+
+	// BeiDou
+	if (!configureMessageRate(UBX_MSG_RTCM3_1127, 1)) { return -1; }
 
 	return 0;
 }
+#endif
+#endif
 
 void
 GPSDriverUBX::decodeInit()
@@ -2324,10 +3463,12 @@ GPSDriverUBX::decodeInit()
 	_rx_ck_b = 0;
 	_rx_payload_length = 0;
 	_rx_payload_index = 0;
+	_rx_sat_index = 0;
+	_rx_sat_record_pos = 0;
 
 	if (_output_mode == OutputMode::GPSAndRTCM || _output_mode == OutputMode::RTCM || _mode == UBXMode::MovingBaseUART1) {
 		if (!_rtcm_parsing) {
-			_rtcm_parsing = new RTCMParsing();
+			_rtcm_parsing = createBuffer<RTCMParsing>();
 		}
 
 		if (_rtcm_parsing) {
@@ -2352,6 +3493,7 @@ GPSDriverUBX::calcChecksum(const uint8_t *buffer, const uint16_t length, ubx_che
 	}
 }
 
+#if UBX_SUPPORT_PRE_V27
 bool
 GPSDriverUBX::configureMessageRate(const uint16_t msg, const uint8_t rate)
 {
@@ -2379,6 +3521,7 @@ GPSDriverUBX::configureMessageRateAndAck(uint16_t msg, uint8_t rate, bool report
 
 	return waitForAck(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT, report_ack_error) >= 0;
 }
+#endif
 
 bool
 GPSDriverUBX::sendMessage(const uint16_t msg, const uint8_t *payload, const uint16_t length)
@@ -2438,6 +3581,23 @@ GPSDriverUBX::fnv1_32_str(uint8_t *str, uint32_t hval)
 	return hval;
 }
 
+uint32_t
+GPSDriverUBX::fnv1_32_buf(const void *buf, size_t length, uint32_t hval)
+{
+	const uint8_t *s = (const uint8_t *)buf;
+
+	for (size_t i = 0; i < length; i++) {
+#if defined(NO_FNV_GCC_OPTIMIZATION)
+		hval *= FNV1_32_PRIME;
+#else
+		hval += (hval << 1) + (hval << 4) + (hval << 7) + (hval << 8) + (hval << 24);
+#endif
+		hval ^= (uint32_t)s[i];
+	}
+
+	return hval;
+}
+
 int
 GPSDriverUBX::reset(GPSRestartType restart_type)
 {
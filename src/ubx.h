@@ -50,12 +50,16 @@
 #pragma once
 
 #include "base_station.h"
+#include "gps_epoch.h"
+#include "gps_heading.h"
 #include "gps_helper.h"
+#include "gps_rate_plan.h"
 #include "../../definitions.h"
 
 
 #define UBX_CONFIG_TIMEOUT    250 // ms, timeout for waiting ACK
 #define UBX_PACKET_TIMEOUT    8   // ms, if now data during this delay assume that full update received
+#define UBX_BAUDRATE_DETECT_TIME 120 // ms, listening time per baudrate of the baudrate detection
 
 #define DISABLE_MSG_INTERVAL  1000000    // us, try to disable message with this interval
 
@@ -67,6 +71,47 @@
 
 #define UART1_BAUDRATE_HEADING 921600
 
+/* Receiver support compiled into the driver. A target that knows its receiver can leave out what it
+ * doesn't need, e.g. an M10 uses neither: -DUBX_SUPPORT_PRE_V27=0 -DUBX_SUPPORT_RTK=0 */
+#ifndef UBX_SUPPORT_PRE_V27
+#define UBX_SUPPORT_PRE_V27   1 // u-blox 5 to 8 with protocol version < 27 (CFG-PRT/CFG-MSG, NAV-SOL, NAV-SVINFO, MON-HW, ...)
+#endif
+#ifndef UBX_SUPPORT_RTK
+#define UBX_SUPPORT_RTK       1 // RTCM base station (survey-in, fixed position) and moving base heading (NAV-RELPOSNED)
+#endif
+
+#ifndef UBX_RAW_FRAME_MAX_LENGTH
+#define UBX_RAW_FRAME_MAX_LENGTH 2048 // raw frames split over reads are assembled up to this length (RXM-RAWX with 63 measurements)
+#endif
+
+/* SPI transfers: a read always returns the requested length, 0xFF filled once the receiver has nothing to send */
+#ifndef UBX_SPI_READ_MAX_SIZE
+#define UBX_SPI_READ_MAX_SIZE 1024 // bytes, largest transfer, sized to the expected data of an update
+#endif
+#ifndef UBX_SPI_IDLE_SLEEP
+#define UBX_SPI_IDLE_SLEEP    2000 // us, wait before the next transfer after one with only fill
+#endif
+
+/* Output rate planning, the messages whose size depends on the tracked satellites are estimated with these */
+#ifndef UBX_RATE_PLAN_SATELLITES
+#define UBX_RATE_PLAN_SATELLITES 32 // satellites of NAV-SAT
+#endif
+#ifndef UBX_RATE_PLAN_SIGNALS
+#define UBX_RATE_PLAN_SIGNALS 64 // measurements of RXM-RAWX and RTCM MSM signals (dual band)
+#endif
+#ifndef UBX_RATE_PLAN_SFRBX
+#define UBX_RATE_PLAN_SFRBX   600 // bytes/s of RXM-SFRBX navigation data
+#endif
+#ifndef UBX_RATE_PLAN_RTCM_FRAME
+#define UBX_RATE_PLAN_RTCM_FRAME 36 // bytes of an RTCM MSM frame without its signals, or of a 1230 or 4072 frame
+#endif
+#ifndef UBX_RATE_PLAN_MSM4_SIGNAL
+#define UBX_RATE_PLAN_MSM4_SIGNAL 9 // bytes per MSM4 signal, with its share of the satellite data
+#endif
+#ifndef UBX_RATE_PLAN_MSM7_SIGNAL
+#define UBX_RATE_PLAN_MSM7_SIGNAL 15 // bytes per MSM7 signal, with its share of the satellite data
+#endif
+
 /* Message Classes */
 #define UBX_CLASS_NAV         0x01
 #define UBX_CLASS_RXM         0x02
@@ -74,6 +119,7 @@
 #define UBX_CLASS_ACK         0x05
 #define UBX_CLASS_CFG         0x06
 #define UBX_CLASS_MON         0x0A
+#define UBX_CLASS_SEC         0x27
 #define UBX_CLASS_RTCM3       0xF5
 
 /* Message IDs */
@@ -88,6 +134,7 @@
 #define UBX_ID_NAV_STATUS     0x03
 #define UBX_ID_NAV_SVIN       0x3B
 #define UBX_ID_NAV_RELPOSNED  0x3C
+#define UBX_ID_NAV_EOE        0x61
 #define UBX_ID_RXM_SFRBX      0x13
 #define UBX_ID_RXM_RAWX       0x15
 #define UBX_ID_INF_DEBUG      0x04
@@ -111,6 +158,7 @@
 #define UBX_ID_MON_VER        0x04
 #define UBX_ID_MON_HW         0x09 // deprecated in protocol version >= 27 -> use MON_RF
 #define UBX_ID_MON_RF         0x38
+#define UBX_ID_SEC_UNIQID     0x03
 
 /* UBX ID for RTCM3 output messages */
 /* Minimal messages for RTK: 1005, 1077 + (1087 or 1127) */
@@ -140,6 +188,7 @@
 #define UBX_MSG_NAV_STATUS    ((UBX_CLASS_NAV) | UBX_ID_NAV_STATUS << 8)
 #define UBX_MSG_NAV_SVIN      ((UBX_CLASS_NAV) | UBX_ID_NAV_SVIN << 8)
 #define UBX_MSG_NAV_RELPOSNED ((UBX_CLASS_NAV) | UBX_ID_NAV_RELPOSNED << 8)
+#define UBX_MSG_NAV_EOE       ((UBX_CLASS_NAV) | UBX_ID_NAV_EOE << 8)
 #define UBX_MSG_RXM_SFRBX     ((UBX_CLASS_RXM) | UBX_ID_RXM_SFRBX << 8)
 #define UBX_MSG_RXM_RAWX      ((UBX_CLASS_RXM) | UBX_ID_RXM_RAWX << 8)
 #define UBX_MSG_INF_DEBUG     ((UBX_CLASS_INF) | UBX_ID_INF_DEBUG << 8)
@@ -163,6 +212,7 @@
 #define UBX_MSG_MON_HW        ((UBX_CLASS_MON) | UBX_ID_MON_HW << 8)
 #define UBX_MSG_MON_VER       ((UBX_CLASS_MON) | UBX_ID_MON_VER << 8)
 #define UBX_MSG_MON_RF        ((UBX_CLASS_MON) | UBX_ID_MON_RF << 8)
+#define UBX_MSG_SEC_UNIQID    ((UBX_CLASS_SEC) | UBX_ID_SEC_UNIQID << 8)
 #define UBX_MSG_RTCM3_1005    ((UBX_CLASS_RTCM3) | UBX_ID_RTCM3_1005 << 8)
 #define UBX_MSG_RTCM3_1077    ((UBX_CLASS_RTCM3) | UBX_ID_RTCM3_1077 << 8)
 #define UBX_MSG_RTCM3_1087    ((UBX_CLASS_RTCM3) | UBX_ID_RTCM3_1087 << 8)
@@ -349,6 +399,7 @@
 #define UBX_CFG_KEY_MSGOUT_UBX_NAV_DOP_I2C       0x20910038
 #define UBX_CFG_KEY_MSGOUT_UBX_NAV_PVT_I2C       0x20910006
 #define UBX_CFG_KEY_MSGOUT_UBX_NAV_RELPOSNED_I2C 0x2091008d
+#define UBX_CFG_KEY_MSGOUT_UBX_NAV_EOE_I2C       0x2091015f
 #define UBX_CFG_KEY_MSGOUT_UBX_RXM_SFRBX_I2C     0x20910231
 #define UBX_CFG_KEY_MSGOUT_UBX_RXM_RAWX_I2C      0x209102a4
 #define UBX_CFG_KEY_MSGOUT_RTCM_3X_TYPE1005_I2C  0x209102bd
@@ -414,6 +465,10 @@
 #define UBX_CFG_LAYER_BBR                       (1 << 1)
 #define UBX_CFG_LAYER_FLASH                     (1 << 2)
 
+#define UBX_CFG_MAX_KEYS                        64   /**< key and value pairs per CFG-VALSET or CFG-VALGET message */
+#define UBX_CFG_BATCH_SIZE                      512  /**< bytes of CFG-VALSET payloads a configuration batch can hold */
+#define UBX_CFG_BATCH_MSGS                      16   /**< CFG-VALSET messages a configuration batch can hold */
+
 // Forward Declaration
 class RTCMParsing;
 
@@ -458,6 +513,11 @@ typedef struct {
 	uint16_t eDOP; /**< Easting DOP [0.01] */
 } ubx_payload_rx_nav_dop_t;
 
+/* Rx NAV-EOE */
+typedef struct {
+	uint32_t iTOW; /**< GPS Time of Week [ms] */
+} ubx_payload_rx_nav_eoe_t;
+
 /* Rx NAV-SOL */
 typedef struct {
 	uint32_t iTOW;     /**< GPS Time of Week [ms] */
@@ -691,6 +751,13 @@ typedef struct {
 	uint8_t extension[30];
 } ubx_payload_rx_mon_ver_part2_t;
 
+/* Rx SEC-UNIQID */
+typedef struct {
+	uint8_t version;
+	uint8_t reserved1[3];
+	uint8_t uniqueId[6];	/**< 5 bytes in version 1, 6 bytes in version 2 */
+} ubx_payload_rx_sec_uniqid_t;
+
 /* Rx ACK-ACK */
 typedef union {
 	uint16_t msg;
@@ -857,40 +924,72 @@ typedef struct {
 	uint32_t    flags;
 } ubx_payload_rx_nav_relposned_t;
 
-/* General message and payload buffer union */
+/* General message and payload buffer union, of the messages compiled in */
 typedef union {
 	ubx_payload_rx_nav_pvt_t          payload_rx_nav_pvt;
-	ubx_payload_rx_nav_posllh_t       payload_rx_nav_posllh;
-	ubx_payload_rx_nav_sol_t          payload_rx_nav_sol;
 	ubx_payload_rx_nav_dop_t          payload_rx_nav_dop;
-	ubx_payload_rx_nav_timeutc_t      payload_rx_nav_timeutc;
-	ubx_payload_rx_nav_svinfo_part1_t payload_rx_nav_svinfo_part1;
-	ubx_payload_rx_nav_svinfo_part2_t payload_rx_nav_svinfo_part2;
+	ubx_payload_rx_nav_eoe_t          payload_rx_nav_eoe;
 	ubx_payload_rx_nav_sat_part1_t    payload_rx_nav_sat_part1;
 	ubx_payload_rx_nav_sat_part2_t    payload_rx_nav_sat_part2;
 	ubx_payload_rx_nav_status_t       payload_rx_nav_status;
-	ubx_payload_rx_nav_svin_t         payload_rx_nav_svin;
-	ubx_payload_rx_nav_velned_t       payload_rx_nav_velned;
-	ubx_payload_rx_mon_hw_ubx6_t      payload_rx_mon_hw_ubx6;
-	ubx_payload_rx_mon_hw_ubx7_t      payload_rx_mon_hw_ubx7;
 	ubx_payload_rx_mon_rf_t           payload_rx_mon_rf;
 	ubx_payload_rx_mon_ver_part1_t    payload_rx_mon_ver_part1;
 	ubx_payload_rx_mon_ver_part2_t    payload_rx_mon_ver_part2;
+	ubx_payload_rx_sec_uniqid_t       payload_rx_sec_uniqid;
 	ubx_payload_rx_ack_ack_t          payload_rx_ack_ack;
 	ubx_payload_rx_ack_nak_t          payload_rx_ack_nak;
+	ubx_payload_tx_cfg_rst_t          payload_tx_cfg_rst;
+	ubx_payload_tx_cfg_valset_t       payload_tx_cfg_valset;
+#if UBX_SUPPORT_PRE_V27
+	ubx_payload_rx_nav_posllh_t       payload_rx_nav_posllh;
+	ubx_payload_rx_nav_sol_t          payload_rx_nav_sol;
+	ubx_payload_rx_nav_timeutc_t      payload_rx_nav_timeutc;
+	ubx_payload_rx_nav_svinfo_part1_t payload_rx_nav_svinfo_part1;
+	ubx_payload_rx_nav_svinfo_part2_t payload_rx_nav_svinfo_part2;
+	ubx_payload_rx_nav_velned_t       payload_rx_nav_velned;
+	ubx_payload_rx_mon_hw_ubx6_t      payload_rx_mon_hw_ubx6;
+	ubx_payload_rx_mon_hw_ubx7_t      payload_rx_mon_hw_ubx7;
 	ubx_payload_tx_cfg_prt_t          payload_tx_cfg_prt;
 	ubx_payload_tx_cfg_rate_t         payload_tx_cfg_rate;
 	ubx_payload_tx_cfg_nav5_t         payload_tx_cfg_nav5;
-	ubx_payload_tx_cfg_rst_t          payload_tx_cfg_rst;
 	ubx_payload_tx_cfg_sbas_t         payload_tx_cfg_sbas;
 	ubx_payload_tx_cfg_msg_t          payload_tx_cfg_msg;
-	ubx_payload_tx_cfg_tmode3_t       payload_tx_cfg_tmode3;
 	ubx_payload_tx_cfg_cfg_t          payload_tx_cfg_cfg;
-	ubx_payload_tx_cfg_valset_t       payload_tx_cfg_valset;
 	ubx_payload_tx_cfg_gnss_t         payload_tx_cfg_gnss;
+#endif
+#if UBX_SUPPORT_RTK
+	ubx_payload_rx_nav_svin_t         payload_rx_nav_svin;
 	ubx_payload_rx_nav_relposned_t    payload_rx_nav_relposned;
+	ubx_payload_tx_cfg_tmode3_t       payload_tx_cfg_tmode3;
+#endif
 } ubx_buf_t;
 
+/* Frame passed on without decoding it, see GPSDriverUBX::setRawMessageClass() */
+typedef struct {
+	uint8_t data[UBX_RAW_FRAME_MAX_LENGTH];
+} ubx_raw_frame_t;
+
+/* Configuration batch, see GPSDriverUBX::cfgBatchBegin() */
+typedef struct {
+	struct Message {
+		uint16_t offset;	///< of the CFG-VALSET payload in data
+		uint16_t length;	///< payload length
+		uint8_t keys;
+		bool required;
+	};
+
+	uint8_t data[UBX_CFG_BATCH_SIZE];	///< CFG-VALSET payloads
+	Message msgs[UBX_CFG_BATCH_MSGS];
+	uint16_t length;
+	uint8_t msg_count;
+	bool error;				///< a value didn't fit, the commit fails
+} ubx_cfg_batch_t;
+
+/* Transfer buffer of the SPI interface */
+typedef struct {
+	uint8_t data[UBX_SPI_READ_MAX_SIZE];
+} ubx_spi_buffer_t;
+
 #pragma pack(pop)
 /*** END OF u-blox protocol binary message and payload definitions ***/
 
@@ -914,9 +1013,19 @@ typedef enum {
 	UBX_RXMSG_IGNORE = 0,
 	UBX_RXMSG_HANDLE,
 	UBX_RXMSG_DISABLE,
-	UBX_RXMSG_ERROR_LENGTH
+	UBX_RXMSG_ERROR_LENGTH,
+	UBX_RXMSG_RAW
 } ubx_rxmsg_state_t;
 
+/* Rx payload decoding, of a handled message */
+typedef enum {
+	UBX_RXPAYLOAD_PLAIN = 0,	///< into _buf
+	UBX_RXPAYLOAD_NAV_SAT,
+	UBX_RXPAYLOAD_NAV_SVINFO,
+	UBX_RXPAYLOAD_MON_VER,
+	UBX_RXPAYLOAD_CFG_VALGET
+} ubx_rxpayload_t;
+
 /* ACK state */
 typedef enum {
 	UBX_ACK_IDLE = 0,
@@ -948,6 +1057,7 @@ public:
 
 	int configure(unsigned &baudrate, const GPSConfig &config) override;
 	int receive(unsigned timeout) override;
+	int feed(const uint8_t *buf, size_t buf_length) override;
 	int reset(GPSRestartType restart_type) override;
 
 	bool shouldInjectRTCM() override { return _mode != UBXMode::RoverWithMovingBase; }
@@ -965,12 +1075,51 @@ public:
 
 	const Board &board() const { return _board; }
 
+	/**
+	 * Select the layers configure() writes the configuration to (protocol version 27+).
+	 * With the BBR or flash layer the configuration is kept over a power cycle, and the keys are read
+	 * back (CFG-VALGET) before writing, so that only the ones that changed are sent.
+	 * The port and baudrate setup during the baudrate detection is always only written to RAM.
+	 * @param layers combination of UBX_CFG_LAYER_*, the RAM layer is always included
+	 */
+	void setConfigLayers(uint8_t layers) { _cfg_layers = UBX_CFG_LAYER_RAM | (layers & (UBX_CFG_LAYER_BBR | UBX_CFG_LAYER_FLASH)); }
+
+	/**
+	 * Fingerprint of the receiver (chip ID and firmware) and of the configuration the last configure()
+	 * wrote to its BBR or flash layer, 0 if it didn't write one (RAM only, or no chip ID).
+	 * The platform can store it and pass it to setConfigFingerprint() on the next start: configure()
+	 * then skips sending the configuration if neither the receiver nor the configuration changed, and
+	 * a CFG-VALGET of a few of its keys confirms that the receiver still has it.
+	 */
+	uint32_t configFingerprint() const { return _config_fingerprint; }
+
+	/**
+	 * @param fingerprint as returned by configFingerprint() before, 0 to always send the configuration
+	 */
+	void setConfigFingerprint(uint32_t fingerprint) { _config_fingerprint = fingerprint; }
+
+	/**
+	 * Pass the messages of a class on as complete frames (GPSCallbackType::gotRawMessage) instead of
+	 * ignoring them, e.g. UBX_CLASS_RXM to log the raw observations for post processing. A frame that
+	 * is complete in the read data is passed from there, one that is split over reads is assembled
+	 * first (up to UBX_RAW_FRAME_MAX_LENGTH). For UBX_CLASS_RXM, configure() also enables RXM-RAWX and
+	 * RXM-SFRBX at the navigation rate. Set before configure().
+	 * @return 0 on success, -1 for a class the driver decodes itself (NAV, INF, ACK, CFG, MON, SEC)
+	 *         or if there's no buffer memory for the frames
+	 */
+	int setRawMessageClass(uint8_t msg_class, bool enabled);
+
 private:
 
 private:
 
 	int activateRTCMOutput(bool reduce_update_rate);
 
+	/**
+	 * activateRTCMOutput for protocol version < 27 (_proto_ver_27_or_higher == false)
+	 */
+	int activateRTCMOutputPreV27(bool reduce_update_rate);
+
 	/**
 	 * While parsing add every byte (except the sync bytes) to the checksum
 	 */
@@ -1032,6 +1181,73 @@ private:
 	 */
 	bool cfgValsetPort(uint32_t key_id, uint8_t value, int &msg_size);
 
+protected:
+	// the configuration batch, accessible to the tests
+
+	/**
+	 * Configuration batch: collects the configuration values of several CFG-VALSET messages, so that
+	 * cfgBatchCommit() can send all of them before waiting for the ACKs. Messages are split at
+	 * UBX_CFG_MAX_KEYS keys. The batch takes a buffer of the memory pool until cfgBatchCommit().
+	 * Start a batch with the first message.
+	 */
+	void cfgBatchBegin();
+
+	/**
+	 * Start a new CFG-VALSET message in the batch
+	 * @param required if false, a NAK or missing ACK of the message doesn't fail the commit (e.g. for
+	 *                 keys that are not supported by all receivers)
+	 */
+	void cfgBatchMessage(bool required);
+
+	/**
+	 * Add a configuration value to the current message of the batch
+	 * @param key_id one of the UBX_CFG_KEY_* constants, its size must match the size of the value
+	 * @return true on success, false if the batch is full
+	 */
+	template<typename T>
+	bool cfgBatchValset(uint32_t key_id, T value) { return cfgBatchAdd(key_id, &value, sizeof(value)); }
+
+	/**
+	 * Add a port-specific configuration value to the current message of the batch, see cfgValsetPort()
+	 */
+	bool cfgBatchValsetPort(uint32_t key_id, uint8_t value);
+
+	bool cfgBatchAdd(uint32_t key_id, const void *value, size_t size);
+
+	/**
+	 * Send the messages of the batch and wait for their ACKs. With the BBR or flash layer selected the
+	 * keys are read back first, and keys with the same value in all selected layers are not sent.
+	 * @return 0 if all required messages were acknowledged, 1 if the configuration in BBR or flash
+	 *         matches the fingerprint, as confirmed by cfgBatchConfirm(), and nothing was sent, <0
+	 *         otherwise (also without a batch buffer)
+	 */
+	int cfgBatchCommit();
+	int cfgBatchSend();
+
+	/**
+	 * Poll the keys of the batch with CFG-VALGET from layers, and mark the ones that are already set
+	 * (see cfgBatchMatch())
+	 * @param layers combination of UBX_CFG_LAYER_*
+	 * @param only_keys if not nullptr, only poll the keys of the batch in this list
+	 */
+	void cfgBatchReadBack(uint8_t layers, const uint32_t *only_keys = nullptr, size_t only_count = 0);
+	void cfgBatchPoll(const uint8_t *poll, size_t keys);
+
+	/**
+	 * Read back a few keys of the batch that a configured receiver must have, before the configuration
+	 * is trusted to match the fingerprint
+	 * @return true if they are set in the BBR and flash layers selected
+	 */
+	bool cfgBatchConfirm();
+	static bool cfgKeyListed(uint32_t key_id, const uint32_t *keys, size_t count);
+
+	/**
+	 * Mark a key of the batch as set in a layer, if all its occurrences in the batch have that value
+	 * @param layer CFG-VALGET layer: 0 = RAM, 1 = BBR, 2 = flash
+	 */
+	void cfgBatchMatch(uint8_t layer, uint32_t key_id, const uint8_t *value, size_t size);
+
+private:
 	/**
 	 * Reset the parse state machine for a fresh start
 	 */
@@ -1041,6 +1257,7 @@ private:
 	 * Calculate FNV1 hash
 	 */
 	uint32_t fnv1_32_str(uint8_t *str, uint32_t hval);
+	uint32_t fnv1_32_buf(const void *buf, size_t length, uint32_t hval);
 
 	/**
 	 * Init _buf as CFG-VALSET
@@ -1060,11 +1277,61 @@ private:
 	 */
 	int restartSurveyInPreV27();
 
+	/**
+	 * Parse a chunk of the binary UBX stream. Equivalent to calling parseChar() for every byte,
+	 * but skips to the next sync byte and copies plain payloads with a single memcpy.
+	 * @return 0 = decoding, or the OR of all parseChar() results (1 = message handled, 2 = sat info message handled)
+	 */
+	int parseBuffer(const uint8_t *buf, const size_t len);
+
 	/**
 	 * Parse the binary UBX packet
 	 */
 	int parseChar(const uint8_t b);
 
+	bool rawMessageClass(uint8_t msg_class) const { return _raw_classes[msg_class / 32] & (1u << (msg_class % 32)); }
+
+	/**
+	 * Pass on a raw frame that is complete in the input
+	 * @param buf input, starting at the first sync byte
+	 * @return length of the frame passed on, 0 if it's not a complete raw frame
+	 */
+	size_t parseRawFrame(const uint8_t *buf, size_t len);
+
+	/**
+	 * receive() with an SPI buffer: transfers sized to the expected update, without parsing the fill
+	 */
+	int receiveSPI(unsigned timeout);
+
+	/**
+	 * Length of the next SPI transfer: the expected rest of the update in progress
+	 */
+	int spiTransferLength() const;
+
+	/**
+	 * @return length of the 0xFF fill at the end of an SPI transfer
+	 */
+	static size_t spiFillLength(const uint8_t *buf, size_t len);
+
+	/**
+	 * Expected output of the enabled messages on the interface, for the rate planning
+	 * @param epoch_bytes of each epoch
+	 * @param second_bytes per second, independent of the rate
+	 */
+	void ratePlanBytes(uint32_t &epoch_bytes, uint32_t &second_bytes) const;
+
+	/**
+	 * Adapt the measurement period to the achieved rate, after a position update
+	 */
+	void adaptRate();
+
+	/**
+	 * Set the measurement period in the RAM layer, with a message not built in _buf
+	 * @param wait_ack false while receiving: the ACK is left to the parser
+	 * @return 0 on success, <0 otherwise
+	 */
+	int setMeasurementRate(unsigned rate_meas, bool wait_ack);
+
 	/**
 	 * Start payload rx
 	 */
@@ -1075,9 +1342,23 @@ private:
 	 */
 	int payloadRxAdd(const uint8_t b);
 	int payloadRxAddMonVer(const uint8_t b);
+	int payloadRxAddCfgValget(const uint8_t b);
 	int payloadRxAddNavSat(const uint8_t b);
 	int payloadRxAddNavSvinfo(const uint8_t b);
 
+	/**
+	 * Decode one complete NAV-SAT / NAV-SVINFO satellite record into the next _satellite_info slot
+	 */
+	void decodeNavSatRecord(const ubx_payload_rx_nav_sat_part2_t &sat);
+	void decodeNavSvinfoRecord(const ubx_payload_rx_nav_svinfo_part2_t &sat);
+
+	/**
+	 * Decode as many whole satellite records as buf holds, for a NAV-SAT or NAV-SVINFO
+	 * payload that is at a record boundary
+	 * @return number of bytes consumed, a multiple of the record size
+	 */
+	size_t payloadRxAddSatRecords(const uint8_t *buf, size_t len);
+
 	/**
 	 * Finish payload rx
 	 */
@@ -1103,10 +1384,9 @@ private:
 	ubx_buf_t               _buf{};
 	ubx_decode_state_t      _decode_state{};
 	ubx_rxmsg_state_t       _rx_state{UBX_RXMSG_IGNORE};
+	ubx_rxpayload_t         _rx_payload{UBX_RXPAYLOAD_PLAIN};
 
 	bool _configured{false};
-	bool _got_posllh{false};
-	bool _got_velned{false};
 	bool _proto_ver_27_or_higher{false}; ///< true if protocol version 27 or higher detected
 	bool _use_nav_pvt{false};
 
@@ -1114,12 +1394,31 @@ private:
 	uint8_t _rx_ck_b{0};
 	uint8_t _dyn_model{7};  ///< ublox Dynamic platform model default 7: airborne with <2g acceleration
 
+	int _handled_pending{0}; ///< parse results of the update in progress, returned once it is complete
+	GPSEpochAssembler _epoch{GPSEpochAssembler::Position | GPSEpochAssembler::Velocity};	///< NAV messages of the update
+	GPSReportHold<sensor_gps_s> _report_hold;	///< the update while the rest of its read is decoded
+#if UBX_SUPPORT_RTK
+	GPSHeadingAligner _heading_aligner{7 * 24 * 3600 * 1000};	///< NAV-RELPOSNED headings, by time of week
+#endif
+
 	uint16_t _ack_waiting_msg{0};
 	uint16_t _rx_msg{};
 	uint16_t _rx_payload_index{0};
 	uint16_t _rx_payload_length{0};
+	uint8_t _rx_sat_index{0};	///< next _satellite_info slot of a NAV-SAT / NAV-SVINFO payload
+	uint8_t _rx_sat_record_pos{0};	///< bytes received of the current satellite record
+	uint8_t _rx_cfg_pair_pos{0};	///< bytes received of the current CFG-VALGET key and value pair
+
+	ubx_cfg_batch_t *_cfg_batch{nullptr};		///< configuration batch, only while configureDevice() runs
+	uint8_t _cfg_layers{UBX_CFG_LAYER_RAM};
+	uint8_t _cfg_acks_expected{0};			///< CFG-VALSET ACKs to count, 0 outside of cfgBatchCommit()
+	uint8_t _cfg_acks_received{0};
+	uint32_t _cfg_nak_mask{0};			///< bit n: the n-th acknowledged CFG-VALSET got a NAK
+	uint8_t _cfg_valget_pending{0};			///< CFG-VALGET polls without response
 
 	uint32_t _ubx_version{0};
+	uint32_t _unique_id{0};				///< hash of the SEC-UNIQID chip ID, 0 if unknown
+	uint32_t _config_fingerprint{0};
 
 	uint64_t _last_timestamp_time{0};
 
@@ -1129,6 +1428,19 @@ private:
 
 	RTCMParsing *_rtcm_parsing{nullptr};
 
+	uint32_t _raw_classes[256 / 32] {};		///< bit per message class passed on raw
+	ubx_raw_frame_t *_raw_frame{nullptr};		///< frame being assembled, while a class is passed on raw
+
+	ubx_spi_buffer_t *_spi_buffer{nullptr};		///< SPI transfers, nullptr on other interfaces
+	uint16_t _spi_update_size{GPS_READ_BUFFER_SIZE};	///< expected bytes of an update, follows the largest recent one
+	uint16_t _spi_update_bytes{0};			///< bytes received of the update in progress
+	uint16_t _spi_transfer_length{0};		///< of the last transfer
+	uint16_t _spi_data_length{0};			///< of the last transfer without the fill at its end
+	uint16_t _spi_pos{0};				///< bytes of the last transfer parsed
+
+	GPSRatePlanner _rate_planner;			///< measurement period, lowered if the updates fall behind it
+	unsigned _uart_baudrate{0};			///< of the UART the output is read from, 0 on other interfaces
+
 	const UBXMode _mode;
 	const float _heading_offset;
 	const int32_t _uart2_baudrate;
@@ -110,6 +110,20 @@ UnicoreParser::Result UnicoreParser::parseChar(char c)
 	return Result::None;
 }
 
+size_t UnicoreParser::parsePayload(const char *buf, size_t len)
+{
+	if (_state != State::GotHashtag) {
+		return 0;
+	}
+
+	// parseChar() handles a full buffer
+	const size_t space = sizeof(_buffer) - 1 - _buffer_pos;
+	len = len < space ? len : space;
+	memcpy(_buffer + _buffer_pos, buf, len);
+	_buffer_pos += (unsigned)len;
+	return len;
+}
+
 void UnicoreParser::reset()
 {
 	_state = State::Uninit;
@@ -138,8 +152,37 @@ bool UnicoreParser::isAgrica() const
 	return strncmp(header, _buffer, strlen(header)) == 0;
 }
 
+bool UnicoreParser::extractHeaderTime(uint32_t &time_of_week_ms, int &leap_seconds) const
+{
+	// #NAME,cpu idle,time reference,time status,week,milliseconds of week,reserved,version,leap seconds,output delay;
+	const char *ptr = _buffer;
+
+	for (unsigned i = 0; i < 8; ++i) {
+		ptr = strpbrk(ptr, ",;");
+
+		if (ptr == nullptr || *ptr == ';') {
+			return false;
+		}
+
+		++ptr;
+
+		if (i == 4) {
+			time_of_week_ms = (uint32_t)strtoul(ptr, nullptr, 10);
+
+		} else if (i == 7) {
+			leap_seconds = (int)strtol(ptr, nullptr, 10);
+		}
+	}
+
+	return true;
+}
+
 bool UnicoreParser::extractHeading()
 {
+	if (!extractHeaderTime(_heading.time_of_week_ms, _heading.leap_seconds)) {
+		return false;
+	}
+
 	// The basline starts after ;,, and then follows the heading.
 
 	// Skip to ;
@@ -179,6 +222,10 @@ bool UnicoreParser::extractHeading()
 
 bool UnicoreParser::extractAgrica()
 {
+	if (!extractHeaderTime(_agrica.time_of_week_ms, _agrica.leap_seconds)) {
+		return false;
+	}
+
 	// Skip to ;
 	char *ptr = strchr(_buffer, ';');
 
@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 
@@ -50,10 +51,24 @@ public:
 
 	Result parseChar(char c);
 
+	/**
+	 * Store bytes of a sentence at once instead of passing them to parseChar()
+	 * @param buf bytes before the '*' of the sentence
+	 * @return number of bytes stored, the next one is passed to parseChar(). 0 if not within a sentence.
+	 */
+	size_t parsePayload(const char *buf, size_t len);
+
+	/**
+	 * @return true if not within a sentence, all bytes but '#' are ignored
+	 */
+	bool idle() const { return _state == State::Uninit; }
+
 	struct Heading {
 		float heading_deg;
 		float heading_stddev_deg;
 		float baseline_m;
+		uint32_t time_of_week_ms;	///< GPS time of the measurement, from the message header
+		int leap_seconds;		///< GPS - UTC
 	};
 
 	struct Agrica {
@@ -64,6 +79,8 @@ public:
 		float stddev_velocity_north_m_s;
 		float stddev_velocity_east_m_s;
 		float stddev_velocity_up_m_s;
+		uint32_t time_of_week_ms;	///< GPS time of the solution, from the message header
+		int leap_seconds;		///< GPS - UTC
 	};
 
 	Heading heading() const
@@ -84,6 +101,7 @@ private:
 	bool isHeading() const;
 	bool isAgrica() const;
 	bool extractHeading();
+	bool extractHeaderTime(uint32_t &time_of_week_ms, int &leap_seconds) const;
 	bool extractAgrica();
 
 	// We have seen buffers with 540 bytes for AGRICA.
@@ -0,0 +1,528 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "captures.h"
+
+#include "crc.h"
+#include "femtomes.h"
+#include "rtcm.h"
+#include "sbf.h"
+#include "ubx.h"
+
+#include <cstdio>
+#include <cstring>
+
+#define FEMTO_MSG_ID_UAVGPS	8001
+#define FEMTO_HEADER_LENGTH	28
+
+namespace
+{
+
+/** deterministic filler for payloads the drivers don't interpret */
+uint32_t randomWord()
+{
+	static uint32_t state = 0x12345678;
+	state = state * 1664525u + 1013904223u;
+	return state;
+}
+
+void append(Capture &capture, const void *data, size_t length)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	capture.data.insert(capture.data.end(), bytes, bytes + length);
+}
+
+void appendUBX(Capture &capture, uint8_t msg_class, uint8_t msg_id, const void *payload, uint16_t length)
+{
+	const uint8_t header[6] = {UBX_SYNC1, UBX_SYNC2, msg_class, msg_id, (uint8_t)(length & 0xff), (uint8_t)(length >> 8)};
+	uint8_t ck_a = 0;
+	uint8_t ck_b = 0;
+
+	for (size_t i = 2; i < sizeof(header); i++) {
+		ck_a = (uint8_t)(ck_a + header[i]);
+		ck_b = (uint8_t)(ck_b + ck_a);
+	}
+
+	for (size_t i = 0; i < length; i++) {
+		ck_a = (uint8_t)(ck_a + ((const uint8_t *)payload)[i]);
+		ck_b = (uint8_t)(ck_b + ck_a);
+	}
+
+	const uint8_t checksum[2] = {ck_a, ck_b};
+	append(capture, header, sizeof(header));
+	append(capture, payload, length);
+	append(capture, checksum, sizeof(checksum));
+	capture.frames++;
+}
+
+void appendRTCM(Capture &capture, uint16_t message_type, uint16_t length)
+{
+	uint8_t frame[RTCM_BUFFER_LENGTH];
+	frame[0] = RTCM3_PREAMBLE;
+	frame[1] = (uint8_t)((length >> 8) & 0x03);
+	frame[2] = (uint8_t)(length & 0xff);
+
+	for (uint16_t i = 0; i < length; i++) {
+		frame[3 + i] = (uint8_t)randomWord();
+	}
+
+	frame[3] = (uint8_t)(message_type >> 4);
+	frame[4] = (uint8_t)((message_type << 4) | (frame[4] & 0x0f));
+
+	const uint32_t crc = calculateCRC24Q(3u + length, frame, 0);
+	frame[3 + length] = (uint8_t)(crc >> 16);
+	frame[4 + length] = (uint8_t)(crc >> 8);
+	frame[5 + length] = (uint8_t)crc;
+
+	append(capture, frame, 6u + length);
+	capture.frames++;
+}
+
+void appendSBF(Capture &capture, uint16_t msg_id, uint8_t revision, uint32_t tow, const void *payload, size_t length)
+{
+	uint8_t block[sizeof(sbf_buf_t)] {};
+	const uint16_t block_length = (uint16_t)((14 + length + 3) & ~3u);
+	const uint16_t id = (uint16_t)(msg_id | (revision << 13));
+	const uint16_t wnc = 2300;
+
+	block[0] = SBF_SYNC1;
+	block[1] = SBF_SYNC2;
+	memcpy(block + 4, &id, sizeof(id));
+	memcpy(block + 6, &block_length, sizeof(block_length));
+	memcpy(block + 8, &tow, sizeof(tow));
+	memcpy(block + 12, &wnc, sizeof(wnc));
+
+	if (length > 0) {
+		memcpy(block + 14, payload, length);
+	}
+
+	const uint16_t crc = calculateCRC16CCITT(block_length - 4u, block + 4, 0);
+	memcpy(block + 2, &crc, sizeof(crc));
+
+	append(capture, block, block_length);
+	capture.frames++;
+}
+
+/** append a Unicore message, adding the '#' framing, CRC and line ending */
+void appendUnicore(Capture &capture, const char *body)
+{
+	const size_t length = strlen(body);
+	const uint32_t crc = calculateCRC32((uint32_t)length, (uint8_t *)const_cast<char *>(body), 0);
+	char crc_field[16];
+	const int crc_length = snprintf(crc_field, sizeof(crc_field), "*%08x\r\n", (unsigned)crc);
+	append(capture, "#", 1);
+	append(capture, body, length);
+	append(capture, crc_field, (size_t)crc_length);
+	capture.frames++;
+}
+
+/** append a sentence, adding the '$' framing, checksum and line ending */
+void appendNMEA(Capture &capture, const char *body)
+{
+	uint8_t checksum = 0;
+
+	for (const char *c = body; *c; c++) {
+		checksum ^= (uint8_t) * c;
+	}
+
+	char sentence[128];
+	const int length = snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+	append(capture, sentence, (size_t)length);
+	capture.frames++;
+}
+
+void appendGSV(Capture &capture, const char *talker, unsigned first_prn, unsigned satellites)
+{
+	const unsigned pages = (satellites + 3) / 4;
+
+	for (unsigned page = 0; page < pages; page++) {
+		char body[128];
+		int length = snprintf(body, sizeof(body), "%sGSV,%u,%u,%02u", talker, pages, page + 1, satellites);
+
+		for (unsigned i = page * 4; i < satellites && i < page * 4 + 4; i++) {
+			length += snprintf(body + length, sizeof(body) - (size_t)length, ",%02u,%02u,%03u,%02u",
+					   first_prn + i, 10 + (i * 7) % 80, (i * 37) % 360, 30 + i % 20);
+		}
+
+		appendNMEA(capture, body);
+	}
+}
+
+/** hhmmss.ss UTC time of the given epoch */
+void utcTime(char *buf, size_t length, unsigned epoch)
+{
+	const unsigned hundredths = 4440000 + epoch * 10;
+	snprintf(buf, length, "%02u%02u%02u.%02u", (hundredths / 360000) % 24, (hundredths / 6000) % 60,
+		 (hundredths / 100) % 60, hundredths % 100);
+}
+
+} // namespace
+
+/**
+ * RXM-RAWX with 32 measurements and an RXM-SFRBX for 4 satellites
+ * RXM-RAWX: 16 byte header and 32 bytes per measurement, RXM-SFRBX: 8 byte header and 10 words
+ */
+static void appendRawMeasurements(Capture &capture, uint32_t itow, unsigned epoch)
+{
+	static constexpr uint8_t num_meas = 32;
+	uint8_t rawx[16 + num_meas * 32] {};
+	const double rcv_tow = itow * 1e-3;
+	memcpy(rawx, &rcv_tow, sizeof(rcv_tow));
+	rawx[11] = num_meas;
+	rawx[13] = 1;
+
+	for (unsigned i = 16; i < sizeof(rawx); i++) {
+		rawx[i] = (uint8_t)(i * 31 + epoch);
+	}
+
+	appendUBX(capture, UBX_CLASS_RXM, UBX_ID_RXM_RAWX, rawx, sizeof(rawx));
+
+	for (uint8_t sv = 0; sv < 4; sv++) {
+		uint8_t sfrbx[8 + 10 * 4] {};
+		sfrbx[1] = (uint8_t)(1 + sv * 5);
+		sfrbx[4] = 10;
+		sfrbx[6] = 2;
+
+		for (unsigned i = 8; i < sizeof(sfrbx); i++) {
+			sfrbx[i] = (uint8_t)(i * 17 + sv + epoch);
+		}
+
+		appendUBX(capture, UBX_CLASS_RXM, UBX_ID_RXM_SFRBX, sfrbx, sizeof(sfrbx));
+	}
+}
+
+Capture generateUBXCapture(unsigned seconds, bool raw_measurements)
+{
+	Capture capture;
+
+	for (unsigned epoch = 0; epoch < seconds * 10; epoch++) {
+		const uint32_t itow = 302400000 + epoch * 100;
+
+		ubx_payload_rx_nav_pvt_t pvt{};
+		pvt.iTOW = itow;
+		pvt.year = 2024;
+		pvt.month = 3;
+		pvt.day = 14;
+		pvt.hour = 12;
+		pvt.min = (uint8_t)((epoch / 600) % 60);
+		pvt.sec = (uint8_t)((epoch / 10) % 60);
+		pvt.valid = 0x07;
+		pvt.tAcc = 20;
+		pvt.nano = (int32_t)(epoch % 10) * 100000000;
+		pvt.fixType = 3;
+		pvt.flags = 0x01 | 0x02 | (2 << 6);
+		pvt.numSV = 24;
+		pvt.lon = 85455000 + (int32_t)epoch * 10;
+		pvt.lat = 473977000 + (int32_t)epoch * 5;
+		pvt.height = 488000;
+		pvt.hMSL = 440000;
+		pvt.hAcc = 14;
+		pvt.vAcc = 20;
+		pvt.velN = 500;
+		pvt.velE = 200;
+		pvt.velD = -10;
+		pvt.gSpeed = 540;
+		pvt.headMot = 2180000;
+		pvt.sAcc = 50;
+		pvt.headAcc = 400000;
+		pvt.pDOP = 110;
+		appendUBX(capture, UBX_CLASS_NAV, UBX_ID_NAV_PVT, &pvt, sizeof(pvt));
+
+		ubx_payload_rx_nav_dop_t dop{};
+		dop.iTOW = itow;
+		dop.gDOP = 130;
+		dop.pDOP = 110;
+		dop.tDOP = 70;
+		dop.vDOP = 90;
+		dop.hDOP = 60;
+		dop.nDOP = 40;
+		dop.eDOP = 45;
+		appendUBX(capture, UBX_CLASS_NAV, UBX_ID_NAV_DOP, &dop, sizeof(dop));
+
+		if (epoch % 10 == 0) {
+			static constexpr uint8_t num_svs = 32;
+			uint8_t sat[sizeof(ubx_payload_rx_nav_sat_part1_t) + num_svs * sizeof(ubx_payload_rx_nav_sat_part2_t)] {};
+			ubx_payload_rx_nav_sat_part1_t part1{};
+			part1.iTOW = itow;
+			part1.version = 1;
+			part1.numSvs = num_svs;
+			memcpy(sat, &part1, sizeof(part1));
+
+			for (uint8_t i = 0; i < num_svs; i++) {
+				ubx_payload_rx_nav_sat_part2_t part2{};
+				part2.gnssId = (uint8_t)(i / 8);
+				part2.svId = (uint8_t)(1 + i % 8 * 3);
+				part2.cno = (uint8_t)(30 + i % 18);
+				part2.elev = (int8_t)(10 + (i * 7) % 80);
+				part2.azim = (int16_t)((i * 37) % 360);
+				part2.flags = 0x0000081f;
+				memcpy(sat + sizeof(part1) + i * sizeof(part2), &part2, sizeof(part2));
+			}
+
+			appendUBX(capture, UBX_CLASS_NAV, UBX_ID_NAV_SAT, sat, sizeof(sat));
+		}
+
+		ubx_payload_rx_nav_eoe_t eoe{};
+		eoe.iTOW = itow;
+		appendUBX(capture, UBX_CLASS_NAV, UBX_ID_NAV_EOE, &eoe, sizeof(eoe));
+
+		if (epoch % 10 == 0) {
+			if (raw_measurements) {
+				appendRawMeasurements(capture, itow, epoch);
+			}
+
+			appendRTCM(capture, 1005, 19);
+			appendRTCM(capture, 1077, 420);
+			appendRTCM(capture, 1087, 310);
+		}
+	}
+
+	return capture;
+}
+
+Capture generateSBFCapture(unsigned seconds)
+{
+	Capture capture;
+
+	for (unsigned epoch = 0; epoch < seconds * 10; epoch++) {
+		const uint32_t tow = 302400000 + epoch * 100;
+
+		sbf_payload_pvt_geodetic_t pvt{};
+		pvt.mode_type = 4;
+		pvt.latitude = 0.8272454 + epoch * 1e-9;
+		pvt.longitude = 0.1491485 + epoch * 2e-9;
+		pvt.height = 488.0;
+		pvt.undulation = 48.0f;
+		pvt.vn = 5.0f;
+		pvt.ve = 2.0f;
+		pvt.vu = 0.1f;
+		pvt.cog = 21.8f;
+		pvt.nr_sv = 24;
+		pvt.h_accuracy = 3;
+		pvt.v_accuracy = 5;
+		appendSBF(capture, SBF_ID_PVTGeodetic, 2, tow, &pvt, sizeof(pvt));
+
+		sbf_payload_vel_cov_geodetic_t vel_cov{};
+		vel_cov.cov_vn_vn = 0.0004f;
+		vel_cov.cov_ve_ve = 0.0004f;
+		vel_cov.cov_vu_vu = 0.0009f;
+		appendSBF(capture, SBF_ID_VelCovGeodetic, 0, tow, &vel_cov, sizeof(vel_cov));
+
+		sbf_payload_dop_t dop{};
+		dop.nr_sv = 24;
+		dop.pDOP = 110;
+		dop.tDOP = 70;
+		dop.hDOP = 60;
+		dop.vDOP = 90;
+		appendSBF(capture, SBF_ID_DOP, 0, tow, &dop, sizeof(dop));
+		appendSBF(capture, SBF_ID_EndOfPVT, 0, tow, nullptr, 0);
+
+		sbf_payload_att_euler att{};
+		att.nr_sv = 20;
+		att.mode = 2;
+		att.heading = 123.4f;
+		att.pitch = 1.2f;
+		appendSBF(capture, SBF_ID_AttEuler, 0, tow, &att, sizeof(att));
+
+		sbf_payload_att_cov_euler att_cov{};
+		att_cov.cov_headhead = 0.04f;
+		att_cov.cov_pitchpitch = 0.09f;
+		appendSBF(capture, SBF_ID_AttCovEuler, 0, tow, &att_cov, sizeof(att_cov));
+	}
+
+	return capture;
+}
+
+Capture generateNMEACapture(unsigned seconds)
+{
+	Capture capture;
+
+	for (unsigned epoch = 0; epoch < seconds * 10; epoch++) {
+		char utc[16];
+		char body[128];
+		utcTime(utc, sizeof(utc), epoch);
+
+		snprintf(body, sizeof(body), "GNGGA,%s,4723.86200,N,00832.73000,E,4,24,0.6,440.0,M,48.0,M,1.0,0000", utc);
+		appendNMEA(capture, body);
+		snprintf(body, sizeof(body), "GNRMC,%s,A,4723.86200,N,00832.73000,E,10.50,21.8,140324,,,R,V", utc);
+		appendNMEA(capture, body);
+		appendNMEA(capture, "GNGSA,A,3,01,04,07,10,13,16,19,22,25,28,31,,1.1,0.6,0.9,1");
+		appendNMEA(capture, "GNVTG,21.8,T,,M,10.50,N,19.45,K,R");
+		snprintf(body, sizeof(body), "GNGST,%s,0.5,0.010,0.008,12.3,0.009,0.008,0.015", utc);
+		appendNMEA(capture, body);
+
+		if (epoch % 10 == 0) {
+			appendGSV(capture, "GP", 1, 12);
+			appendGSV(capture, "GL", 65, 12);
+			appendGSV(capture, "GA", 1, 12);
+			appendGSV(capture, "GB", 1, 12);
+		}
+	}
+
+	return capture;
+}
+
+Capture generateAshtechCapture(unsigned seconds)
+{
+	Capture capture;
+
+	for (unsigned epoch = 0; epoch < seconds * 10; epoch++) {
+		char utc[16];
+		char body[128];
+		utcTime(utc, sizeof(utc), epoch);
+
+		snprintf(body, sizeof(body), "GPZDA,%s,14,03,2024,00,00", utc);
+		appendNMEA(capture, body);
+		snprintf(body, sizeof(body),
+			 "PASHR,POS,3,24,%s,4723.8620000,N,00832.7300000,E,488.000,1.0,21.8,10.500,-0.100,1.1,0.6,0.9,0.7,", utc);
+		appendNMEA(capture, body);
+		snprintf(body, sizeof(body), "GPGST,%s,0.5,0.010,0.008,12.3,0.009,0.008,0.015", utc);
+		appendNMEA(capture, body);
+
+		if (epoch % 10 == 0) {
+			appendGSV(capture, "GP", 1, 12);
+		}
+	}
+
+	return capture;
+}
+
+Capture generateFemtoCapture(unsigned seconds)
+{
+	Capture capture;
+
+	for (unsigned epoch = 0; epoch < seconds * 10; epoch++) {
+		femto_uav_gps_t gps{};
+		gps.time_utc_usec = 1710417600000000ULL + epoch * 100000ULL;
+		gps.lat = 473977000 + (int32_t)epoch * 5;
+		gps.lon = 85455000 + (int32_t)epoch * 10;
+		gps.alt = 440000;
+		gps.alt_ellipsoid = 488000;
+		gps.s_variance_m_s = 0.05f;
+		gps.c_variance_rad = 0.01f;
+		gps.eph = 0.02f;
+		gps.epv = 0.03f;
+		gps.hdop = 0.6f;
+		gps.vdop = 0.9f;
+		gps.vel_m_s = 5.4f;
+		gps.vel_n_m_s = 5.0f;
+		gps.vel_e_m_s = 2.0f;
+		gps.vel_d_m_s = -0.1f;
+		gps.cog_rad = 0.38f;
+		gps.heading = 123.4f;
+		gps.fix_type = 6;
+		gps.vel_ned_valid = true;
+		gps.satellites_used = 24;
+		gps.heading_type = 6;
+
+		femto_msg_header_t header{};
+		header.preamble[0] = 0xaa;
+		header.preamble[1] = 0x44;
+		header.preamble[2] = 0x12;
+		header.headerlength = FEMTO_HEADER_LENGTH;
+		header.messageid = FEMTO_MSG_ID_UAVGPS;
+		header.messagelength = sizeof(gps);
+		header.sequence = (uint16_t)epoch;
+		header.week = 2300;
+		header.tow = 302400000 + epoch * 100;
+
+		uint32_t crc = calculateCRC32(sizeof(header), (uint8_t *)&header, 0);
+		crc = calculateCRC32(sizeof(gps), (uint8_t *)&gps, crc);
+
+		append(capture, &header, sizeof(header));
+		append(capture, &gps, sizeof(gps));
+		append(capture, &crc, sizeof(crc));
+		capture.frames++;
+	}
+
+	return capture;
+}
+
+Capture generateUnicoreCapture(unsigned seconds)
+{
+	Capture capture;
+
+	for (unsigned epoch = 0; epoch < seconds * 10; epoch++) {
+		// heading and velocity of the same epoch have the same header time
+		const unsigned time_of_week = 168052600 + epoch * 100;
+		char heading[256];
+		char agrica[640];
+		snprintf(heading, sizeof(heading),
+			 "UNIHEADINGA,89,GPS,FINE,2251,%u,0,0,18,11;SOL_COMPUTED,NARROW_INT,0.3718,67.0255,-0.7974,0.0000,"
+			 "0.8065,3.3818,\"999\",31,21,21,18,3,01,3,f3", time_of_week);
+		snprintf(agrica, sizeof(agrica),
+			 "AGRICA,68,GPS,FINE,2251,%u,0,0,18,38;GNSS,236,19,7,26,6,16,9,4,4,12,10,9,306.7191,10724.0176,-"
+			 "16.4796,0.0089,0.0070,0.0181,67.9651,29.3584,0.0000,0.003,0.003,0.001,-0.002,0.021,0.039,0.025,"
+			 "40.07896719907,116.23652055432,67.3108,-2160482.7849,4383625.2350,4084735.7632,0.0140,0.0125,0.0296,"
+			 "0.0107,0.0198,0.0128,40.07627310896,116.11079363322,65.3740,0.00000000000,0.00000000000,0.0000,"
+			 "%u,38.000,16.723207,-9.406086,0.000000,0.000000,8,0,0,0", time_of_week, time_of_week);
+		appendUnicore(capture, heading);
+		appendUnicore(capture, agrica);
+	}
+
+	return capture;
+}
+
+bool loadCapture(const char *path, Capture &capture)
+{
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		return false;
+	}
+
+	capture.data.clear();
+	capture.frames = 0;
+	uint8_t buf[4096];
+	size_t n;
+
+	while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+		append(capture, buf, n);
+	}
+
+	const bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+bool saveCapture(const char *path, const Capture &capture)
+{
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		return false;
+	}
+
+	const bool ok = fwrite(capture.data.data(), 1, capture.data.size(), file) == capture.data.size();
+	return fclose(file) == 0 && ok;
+}
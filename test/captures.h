@@ -0,0 +1,96 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file captures.h
+ *
+ * Synthetic receiver captures for the benchmark and replay tools, and loading of recorded
+ * captures from disk. The generated streams follow the message mix a receiver outputs in
+ * flight: 10 Hz navigation solutions, 1 Hz satellite information and RTCM corrections.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct Capture {
+	std::vector<uint8_t> data;
+	uint32_t frames{0};		///< number of complete messages in data
+};
+
+/**
+ * UBX NAV-PVT, NAV-DOP and NAV-EOE at 10 Hz, NAV-SAT with 32 satellites and RTCM 1005/1077/1087 at 1 Hz
+ * @param seconds capture duration
+ * @param raw_measurements add RXM-RAWX and RXM-SFRBX at 1 Hz
+ */
+Capture generateUBXCapture(unsigned seconds, bool raw_measurements = false);
+
+/**
+ * SBF PVTGeodetic, VelCovGeodetic, DOP, EndOfPVT and AttEuler at 10 Hz
+ */
+Capture generateSBFCapture(unsigned seconds);
+
+/**
+ * NMEA GGA, RMC, GSA, VTG and GST at 10 Hz, GSV for 4 constellations at 1 Hz
+ */
+Capture generateNMEACapture(unsigned seconds);
+
+/**
+ * Ashtech $PASHR,POS, ZDA and GST at 10 Hz, GPS GSV at 1 Hz
+ */
+Capture generateAshtechCapture(unsigned seconds);
+
+/**
+ * Femtomes UAVGPSB at 10 Hz
+ */
+Capture generateFemtoCapture(unsigned seconds);
+
+/**
+ * Unicore UNIHEADINGA and AGRICA at 10 Hz
+ */
+Capture generateUnicoreCapture(unsigned seconds);
+
+/**
+ * Load a recorded capture, i.e. the raw bytes read from the receiver
+ * @param path file to load
+ * @param capture output, frames is left at 0
+ * @return true on success
+ */
+bool loadCapture(const char *path, Capture &capture);
+
+/**
+ * Write a capture to disk, e.g. to replay a synthetic capture with gps-replay
+ * @return true on success
+ */
+bool saveCapture(const char *path, const Capture &capture);
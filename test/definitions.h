@@ -0,0 +1,140 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file definitions.h
+ *
+ * Host platform definitions for building the drivers outside of PX4 and QGroundControl,
+ * used by the benchmark and replay tools. Time is virtual (see mock_device.h), so driver
+ * timeouts never sleep.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#define GPS_INFO(...) {if (gps_host_verbose) {fprintf(stderr, __VA_ARGS__); fputc('\n', stderr);}}
+#define GPS_WARN(...) {if (gps_host_verbose) {fprintf(stderr, __VA_ARGS__); fputc('\n', stderr);}}
+#define GPS_ERR(...) {fprintf(stderr, __VA_ARGS__); fputc('\n', stderr);}
+
+#define M_DEG_TO_RAD_F		0.0174532925f
+#define M_RAD_TO_DEG		57.295779513082323
+#define M_PI_2_F		1.57079632679489661923f
+
+typedef uint64_t gps_abstime;
+
+/** print driver info and warnings (off by default to keep tool output readable) */
+extern bool gps_host_verbose;
+
+/** virtual time in us */
+gps_abstime gps_absolute_time();
+
+/** advance the virtual time */
+void gps_usleep(gps_abstime usec);
+
+struct sensor_gps_s {
+	uint64_t timestamp;
+	uint64_t timestamp_sample;
+	uint64_t time_utc_usec;
+	uint32_t device_id;
+	int32_t lat;
+	int32_t lon;
+	int32_t alt;
+	int32_t alt_ellipsoid;
+	float s_variance_m_s;
+	float c_variance_rad;
+	float eph;
+	float epv;
+	float hdop;
+	float vdop;
+	int32_t noise_per_ms;
+	int32_t jamming_indicator;
+	float vel_m_s;
+	float vel_n_m_s;
+	float vel_e_m_s;
+	float vel_d_m_s;
+	float cog_rad;
+	int32_t timestamp_time_relative;
+	float heading;
+	float heading_offset;
+	float heading_accuracy;
+	float rtcm_injection_rate;
+	uint16_t automatic_gain_control;
+	uint8_t fix_type;
+	uint8_t jamming_state;
+	uint8_t spoofing_state;
+	bool vel_ned_valid;
+	uint8_t satellites_used;
+	uint8_t selected_rtcm_instance;
+};
+
+struct satellite_info_s {
+	static constexpr uint8_t SAT_INFO_MAX_SATELLITES = 40;
+
+	uint64_t timestamp;
+	uint8_t count;
+	uint8_t svid[SAT_INFO_MAX_SATELLITES];
+	uint8_t used[SAT_INFO_MAX_SATELLITES];
+	uint8_t elevation[SAT_INFO_MAX_SATELLITES];
+	uint8_t azimuth[SAT_INFO_MAX_SATELLITES];
+	uint8_t snr[SAT_INFO_MAX_SATELLITES];
+	uint8_t prn[SAT_INFO_MAX_SATELLITES];
+};
+
+struct sensor_gnss_relative_s {
+	uint64_t timestamp;
+	uint64_t timestamp_sample;
+	uint64_t time_utc_usec;
+	uint32_t device_id;
+	float position[3];
+	float position_accuracy[3];
+	float heading;
+	float heading_accuracy;
+	float position_length;
+	float accuracy_length;
+	uint16_t reference_station_id;
+	bool gnss_fix_ok;
+	bool differential_solution;
+	bool relative_position_valid;
+	bool carrier_solution_floating;
+	bool carrier_solution_fixed;
+	bool moving_base_mode;
+	bool reference_position_miss;
+	bool reference_observations_miss;
+	bool heading_valid;
+	bool relative_position_normalized;
+};
@@ -0,0 +1,110 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "drivers.h"
+
+#include "ashtech.h"
+#include "femtomes.h"
+#include "nmea.h"
+#include "sbf.h"
+#include "ubx.h"
+
+#include <string.h>
+
+static const char *const protocol_names[] = {"ubx", "sbf", "nmea", "ashtech", "femto", "unicore"};
+
+static_assert(sizeof(protocol_names) / sizeof(protocol_names[0]) == (size_t)HostProtocol::Count,
+	      "protocol_names must match HostProtocol");
+
+const char *protocolName(HostProtocol protocol)
+{
+	return protocol < HostProtocol::Count ? protocol_names[(int)protocol] : "unknown";
+}
+
+bool parseProtocolName(const char *name, HostProtocol &protocol)
+{
+	for (int i = 0; i < (int)HostProtocol::Count; i++) {
+		if (strcmp(name, protocol_names[i]) == 0) {
+			protocol = (HostProtocol)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+MockDevice::Responder protocolResponder(HostProtocol protocol)
+{
+	switch (protocol) {
+	case HostProtocol::UBX: return MockDevice::Responder::UBX;
+
+	case HostProtocol::SBF: return MockDevice::Responder::SBF;
+
+	default: return MockDevice::Responder::None;
+	}
+}
+
+GPSHelper *createDriver(HostProtocol protocol, MockDevice &device, sensor_gps_s *gps_position,
+			satellite_info_s *satellite_info, GPSHelper::Interface interface)
+{
+	switch (protocol) {
+	case HostProtocol::UBX:
+		return new GPSDriverUBX(interface, MockDevice::callback, &device, gps_position, satellite_info);
+
+	case HostProtocol::SBF:
+		return new GPSDriverSBF(MockDevice::callback, &device, gps_position, satellite_info);
+
+	case HostProtocol::NMEA:
+		return new GPSDriverNMEA(MockDevice::callback, &device, gps_position, satellite_info);
+
+	case HostProtocol::Ashtech:
+		return new GPSDriverAshtech(MockDevice::callback, &device, gps_position, satellite_info);
+
+	case HostProtocol::Femto:
+		return new GPSDriverFemto(MockDevice::callback, &device, gps_position, satellite_info);
+
+	default:
+		return nullptr;
+	}
+}
+
+int configureDriver(HostProtocol protocol, GPSHelper &driver, GPSHelper::OutputMode output_mode, unsigned baudrate)
+{
+	if (protocolResponder(protocol) == MockDevice::Responder::None) {
+		return 0;
+	}
+
+	const GPSHelper::GPSConfig config{output_mode, GPSHelper::GNSSSystemsMask::RECEIVER_DEFAULTS,
+					  GPSHelper::InterfaceProtocolsMask::ALL_DISABLED};
+	return driver.configure(baudrate, config);
+}
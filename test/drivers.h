@@ -0,0 +1,84 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file drivers.h
+ *
+ * Creation and configuration of the drivers for the host tools, by protocol name.
+ */
+
+#pragma once
+
+#include "gps_helper.h"
+#include "mock_device.h"
+
+enum class HostProtocol {
+	UBX,
+	SBF,
+	NMEA,
+	Ashtech,
+	Femto,
+	Unicore,	///< UnicoreParser only, the NMEA driver handles Unicore receivers
+	Count
+};
+
+const char *protocolName(HostProtocol protocol);
+
+/**
+ * @param name protocol name as returned by protocolName()
+ * @param protocol output
+ * @return true if the name is known
+ */
+bool parseProtocolName(const char *name, HostProtocol &protocol);
+
+/**
+ * Configuration handshake the simulated device has to answer for the driver
+ */
+MockDevice::Responder protocolResponder(HostProtocol protocol);
+
+/**
+ * @param interface of the UBX driver, the others only have a UART
+ * @return new driver, or nullptr for HostProtocol::Unicore
+ */
+GPSHelper *createDriver(HostProtocol protocol, MockDevice &device, sensor_gps_s *gps_position,
+			satellite_info_s *satellite_info, GPSHelper::Interface interface = GPSHelper::Interface::UART);
+
+/**
+ * Run the configuration handshake if the driver needs one. The text and Femtomes drivers
+ * decode without it.
+ * @param output_mode requested output
+ * @param baudrate fixed baudrate, 0 to detect it
+ * @return 0 on success, <0 otherwise
+ */
+int configureDriver(HostProtocol protocol, GPSHelper &driver, GPSHelper::OutputMode output_mode = GPSHelper::OutputMode::GPS,
+		    unsigned baudrate = 115200);
@@ -0,0 +1,280 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "fuzz_decoders.h"
+
+#include "drivers.h"
+#include "emlid_reach.h"
+#include "mtk.h"
+
+#include <string.h>
+
+#define FUZZ_WIRE_BAUDRATE	115200		///< the virtual clock advances by the data's time on the wire
+
+#define FUZZ_TOKEN(s)	{s, sizeof(s) - 1}
+
+static const char *const decoder_names[] = {"ubx", "sbf", "nmea", "ashtech", "femto", "erb", "mtk", "unicore"};
+
+static_assert(sizeof(decoder_names) / sizeof(decoder_names[0]) == (size_t)FuzzDecoder::Count,
+	      "decoder_names must match FuzzDecoder");
+
+static const FuzzToken ubx_tokens[] = {
+	FUZZ_TOKEN("\xb5\x62\x01\x07"),	// NAV-PVT
+	FUZZ_TOKEN("\xb5\x62\x01\x04"),	// NAV-DOP
+	FUZZ_TOKEN("\xb5\x62\x01\x61"),	// NAV-EOE
+	FUZZ_TOKEN("\xb5\x62\x01\x35"),	// NAV-SAT
+	FUZZ_TOKEN("\xb5\x62\x01\x30"),	// NAV-SVINFO
+	FUZZ_TOKEN("\xb5\x62\x01\x02"),	// NAV-POSLLH
+	FUZZ_TOKEN("\xb5\x62\x01\x12"),	// NAV-VELNED
+	FUZZ_TOKEN("\xb5\x62\x01\x3c"),	// NAV-RELPOSNED
+	FUZZ_TOKEN("\xb5\x62\x01\x3b"),	// NAV-SVIN
+	FUZZ_TOKEN("\xb5\x62\x02\x15"),	// RXM-RAWX
+	FUZZ_TOKEN("\xb5\x62\x04\x02"),	// INF-NOTICE
+	FUZZ_TOKEN("\xb5\x62\x05\x01"),	// ACK-ACK
+	FUZZ_TOKEN("\xb5\x62\x06\x8b"),	// CFG-VALGET
+	FUZZ_TOKEN("\xb5\x62\x0a\x04"),	// MON-VER
+	FUZZ_TOKEN("\xb5\x62\x0a\x38"),	// MON-RF
+	FUZZ_TOKEN("\xb5\x62\x27\x03"),	// SEC-UNIQID
+	FUZZ_TOKEN("\xd3\x00"),		// RTCM3
+	FUZZ_TOKEN("\xff\xff"),
+	FUZZ_TOKEN("\x00\x00"),
+	FUZZ_TOKEN("\x5c\x00"),
+};
+
+static const FuzzToken sbf_tokens[] = {
+	FUZZ_TOKEN("$@"),
+	FUZZ_TOKEN("\xa7\x0f"),		// PVTGeodetic
+	FUZZ_TOKEN("\x14\x17"),		// VelCovGeodetic
+	FUZZ_TOKEN("\xa1\x0f"),		// DOP
+	FUZZ_TOKEN("\x21\x17"),		// EndOfPVT
+	FUZZ_TOKEN("\x32\x17"),		// AttEuler
+	FUZZ_TOKEN("\x33\x17"),		// AttCovEuler
+	FUZZ_TOKEN("\xad\x0f"),		// ChannelStatus
+	FUZZ_TOKEN("$R: "),
+	FUZZ_TOKEN("$R? "),
+	FUZZ_TOKEN("\xd3\x00"),
+	FUZZ_TOKEN("\xff\xff"),
+	FUZZ_TOKEN("\x08\x00"),
+	FUZZ_TOKEN("\x00\x00"),
+};
+
+static const FuzzToken nmea_tokens[] = {
+	FUZZ_TOKEN("$GPGGA,"),
+	FUZZ_TOKEN("$GNRMC,"),
+	FUZZ_TOKEN("$GNGNS,"),
+	FUZZ_TOKEN("$GPGSA,"),
+	FUZZ_TOKEN("$GPGSV,"),
+	FUZZ_TOKEN("$GPVTG,"),
+	FUZZ_TOKEN("$GPGST,"),
+	FUZZ_TOKEN("$GPHDT,"),
+	FUZZ_TOKEN("$GNTHS,"),
+	FUZZ_TOKEN("$GPZDA,"),
+	FUZZ_TOKEN("#UNIHEADINGA,"),
+	FUZZ_TOKEN("#AGRICA,"),
+	FUZZ_TOKEN(",,,,,,,,,,,,,,,,"),
+	FUZZ_TOKEN(";"),
+	FUZZ_TOKEN("*"),
+	FUZZ_TOKEN("\r\n"),
+	FUZZ_TOKEN("\xd3\x00"),
+};
+
+static const FuzzToken ashtech_tokens[] = {
+	FUZZ_TOKEN("$PASHR,POS,"),
+	FUZZ_TOKEN("$PASHR,RID,"),
+	FUZZ_TOKEN("$PASHR,PRT,"),
+	FUZZ_TOKEN("$PASHR,ACK"),
+	FUZZ_TOKEN("$PASHR,RECEIPT,"),
+	FUZZ_TOKEN("$GPZDA,"),
+	FUZZ_TOKEN("$GPGGA,"),
+	FUZZ_TOKEN("$GPGST,"),
+	FUZZ_TOKEN("$GPGSV,"),
+	FUZZ_TOKEN("$GPHDT,"),
+	FUZZ_TOKEN(",,,,,,,,,,,,,,,,"),
+	FUZZ_TOKEN("*"),
+	FUZZ_TOKEN("\r\n"),
+	FUZZ_TOKEN("\xd3\x00"),
+};
+
+static const FuzzToken femto_tokens[] = {
+	FUZZ_TOKEN("\xaa\x44\x12\x1c"),	// binary header, 28 bytes
+	FUZZ_TOKEN("\x41\x1f"),		// UAVGPSB
+	FUZZ_TOKEN("\x51\x1f"),		// UAVSTATUSB
+	FUZZ_TOKEN("\x10\x03"),		// RTCM3
+	FUZZ_TOKEN("$GPGGA,"),
+	FUZZ_TOKEN("*"),
+	FUZZ_TOKEN("\r\n"),
+	FUZZ_TOKEN("\xd3\x00"),
+	FUZZ_TOKEN("\xff\xff"),
+	FUZZ_TOKEN("\x00\x00"),
+};
+
+static const FuzzToken erb_tokens[] = {
+	FUZZ_TOKEN("ER\x01"),		// version
+	FUZZ_TOKEN("ER\x02"),		// geodetic position
+	FUZZ_TOKEN("ER\x03"),		// navigation status
+	FUZZ_TOKEN("ER\x04"),		// DOPs
+	FUZZ_TOKEN("ER\x05"),		// NED velocity
+	FUZZ_TOKEN("\xff\xff"),
+	FUZZ_TOKEN("\x00\x00"),
+	FUZZ_TOKEN("\x2a\x00"),
+};
+
+static const FuzzToken mtk_tokens[] = {
+	FUZZ_TOKEN("\xd0\xdd"),		// v16
+	FUZZ_TOKEN("\xd1\xdd"),		// v19
+	FUZZ_TOKEN("\x20"),		// payload length
+};
+
+static const FuzzToken unicore_tokens[] = {
+	FUZZ_TOKEN("#UNIHEADINGA,"),
+	FUZZ_TOKEN("#AGRICA,"),
+	FUZZ_TOKEN(",,,,,,,,,,,,,,,,"),
+	FUZZ_TOKEN(";"),
+	FUZZ_TOKEN("*"),
+	FUZZ_TOKEN("\r\n"),
+};
+
+const char *fuzzDecoderName(FuzzDecoder decoder)
+{
+	return decoder < FuzzDecoder::Count ? decoder_names[(int)decoder] : "unknown";
+}
+
+bool parseFuzzDecoderName(const char *name, FuzzDecoder &decoder)
+{
+	for (int i = 0; i < (int)FuzzDecoder::Count; i++) {
+		if (strcmp(name, decoder_names[i]) == 0) {
+			decoder = (FuzzDecoder)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template<size_t N>
+static const FuzzToken *tokenList(const FuzzToken (&tokens)[N], size_t &count)
+{
+	count = N;
+	return tokens;
+}
+
+const FuzzToken *fuzzTokens(FuzzDecoder decoder, size_t &count)
+{
+	switch (decoder) {
+	case FuzzDecoder::UBX: return tokenList(ubx_tokens, count);
+
+	case FuzzDecoder::SBF: return tokenList(sbf_tokens, count);
+
+	case FuzzDecoder::NMEA: return tokenList(nmea_tokens, count);
+
+	case FuzzDecoder::Ashtech: return tokenList(ashtech_tokens, count);
+
+	case FuzzDecoder::Femto: return tokenList(femto_tokens, count);
+
+	case FuzzDecoder::ERB: return tokenList(erb_tokens, count);
+
+	case FuzzDecoder::MTK: return tokenList(mtk_tokens, count);
+
+	default: return tokenList(unicore_tokens, count);
+	}
+}
+
+/**
+ * @return the host tools' protocol of a driver decoder, HostProtocol::Count for the other ones
+ */
+static HostProtocol hostProtocol(FuzzDecoder decoder)
+{
+	switch (decoder) {
+	case FuzzDecoder::UBX: return HostProtocol::UBX;
+
+	case FuzzDecoder::SBF: return HostProtocol::SBF;
+
+	case FuzzDecoder::NMEA: return HostProtocol::NMEA;
+
+	case FuzzDecoder::Ashtech: return HostProtocol::Ashtech;
+
+	case FuzzDecoder::Femto: return HostProtocol::Femto;
+
+	default: return HostProtocol::Count;
+	}
+}
+
+FuzzHarness::FuzzHarness(FuzzDecoder decoder) :
+	_decoder(decoder),
+	_device(nullptr, 0, GPS_READ_BUFFER_SIZE,
+		hostProtocol(decoder) < HostProtocol::Count ? protocolResponder(hostProtocol(decoder)) : MockDevice::Responder::None)
+{
+	const HostProtocol protocol = hostProtocol(decoder);
+
+	if (protocol < HostProtocol::Count) {
+		_driver = createDriver(protocol, _device, &_gps_position, &_satellite_info);
+
+		if (configureDriver(protocol, *_driver, GPSHelper::OutputMode::GPSAndRTCM) != 0) {
+			fprintf(stderr, "%s: configure failed\n", fuzzDecoderName(decoder));
+		}
+
+	} else if (decoder == FuzzDecoder::ERB) {
+		_driver = new GPSDriverEmlidReach(MockDevice::callback, &_device, &_gps_position, &_satellite_info);
+
+	} else if (decoder == FuzzDecoder::MTK) {
+		_driver = new GPSDriverMTK(MockDevice::callback, &_device, &_gps_position);
+	}
+}
+
+FuzzHarness::~FuzzHarness()
+{
+	delete _driver;
+}
+
+int FuzzHarness::feed(const uint8_t *data, size_t length)
+{
+	_wire_time_remainder += (uint64_t)length * 10 * 1000000;
+	MockDevice::advanceTime(_wire_time_remainder / FUZZ_WIRE_BAUDRATE);
+	_wire_time_remainder %= FUZZ_WIRE_BAUDRATE;
+
+	if (_driver) {
+		return _driver->feed(data, length);
+	}
+
+	int ret = 0;
+
+	for (size_t i = 0; i < length; i++) {
+		const UnicoreParser::Result result = _unicore.parseChar((char)data[i]);
+
+		if (result == UnicoreParser::Result::GotHeading || result == UnicoreParser::Result::GotAgrica) {
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
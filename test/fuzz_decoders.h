@@ -0,0 +1,114 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file fuzz_decoders.h
+ *
+ * The drivers' decoders as fuzz targets: a driver ready to decode, fed input without a device
+ * behind it, for the libFuzzer targets and the stress test.
+ */
+
+#pragma once
+
+#include "mock_device.h"
+#include "unicore.h"
+
+#include <cstddef>
+#include <cstdint>
+
+enum class FuzzDecoder {
+	UBX,
+	SBF,
+	NMEA,
+	Ashtech,
+	Femto,
+	ERB,		///< Emlid Reach
+	MTK,
+	Unicore,	///< UnicoreParser
+	Count
+};
+
+const char *fuzzDecoderName(FuzzDecoder decoder);
+
+/**
+ * @param name decoder name as returned by fuzzDecoderName()
+ * @param decoder output
+ * @return true if the name is known
+ */
+bool parseFuzzDecoderName(const char *name, FuzzDecoder &decoder);
+
+/**
+ * Byte sequences that lead a decoder out of its idle state: sync words, message headers,
+ * delimiters and extreme length fields
+ */
+struct FuzzToken {
+	const char *data;
+	size_t length;
+};
+
+/**
+ * @param count output, number of tokens
+ */
+const FuzzToken *fuzzTokens(FuzzDecoder decoder, size_t &count);
+
+/**
+ * A decoder in the state it runs in: the UBX and SBF drivers are configured against the
+ * simulated receiver (with RTCM output, so their RTCM parsers run as well), the others decode
+ * without configuration.
+ */
+class FuzzHarness
+{
+public:
+	explicit FuzzHarness(FuzzDecoder decoder);
+	~FuzzHarness();
+
+	FuzzHarness(const FuzzHarness &) = delete;
+	FuzzHarness &operator=(const FuzzHarness &) = delete;
+
+	/**
+	 * Decode one read of data, and advance the virtual clock by the time it takes on the wire
+	 * @return feed() result of the driver, for UnicoreParser 1 if a sentence was decoded
+	 */
+	int feed(const uint8_t *data, size_t length);
+
+	FuzzDecoder decoder() const { return _decoder; }
+
+private:
+	const FuzzDecoder _decoder;
+	MockDevice _device;
+	sensor_gps_s _gps_position{};
+	satellite_info_s _satellite_info{};
+	GPSHelper *_driver{nullptr};
+	UnicoreParser _unicore;
+	uint64_t _wire_time_remainder{0};	///< us * FUZZ_WIRE_BAUDRATE / 10 not yet added to the clock
+};
@@ -0,0 +1,520 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "mock_device.h"
+
+#include <string.h>
+
+#define MIN(X,Y)	((X) < (Y) ? (X) : (Y))
+
+bool gps_host_verbose = false;
+
+static gps_abstime virtual_time = 1;
+
+gps_abstime gps_absolute_time()
+{
+	return virtual_time;
+}
+
+void gps_usleep(gps_abstime usec)
+{
+	virtual_time += usec;
+}
+
+void MockDevice::advanceTime(gps_abstime usec)
+{
+	virtual_time += usec;
+}
+
+MockDevice::MockDevice(const uint8_t *data, size_t length, size_t chunk_size, Responder responder) :
+	_data(data),
+	_length(length),
+	_chunk_size(chunk_size > 0 ? chunk_size : 1),
+	_responder(responder),
+	_command_parser(handleUBXCommand, this, ProtocolDemux::protocolMask(ProtocolDemux::Protocol::UBX))
+{
+}
+
+int MockDevice::callback(GPSCallbackType type, void *data1, int data2, void *user)
+{
+	MockDevice *device = (MockDevice *)user;
+
+	switch (type) {
+	case GPSCallbackType::readDeviceData: {
+			int timeout;
+			memcpy(&timeout, data1, sizeof(timeout));
+			return device->read((uint8_t *)data1, (size_t)data2, timeout);
+		}
+
+	case GPSCallbackType::readDeviceDataTimestamped: {
+			GPSTimestampedRead *request = (GPSTimestampedRead *)data1;
+			const int ret = device->read(request->buf, (size_t)data2, request->timeout);
+			request->timestamp = ret > 0 ? device->_chunk_timestamp : 0;
+			return ret;
+		}
+
+	case GPSCallbackType::writeDeviceData:
+		return device->write((const uint8_t *)data1, (size_t)data2);
+
+	case GPSCallbackType::gotRTCMMessage:
+		device->_rtcm_messages++;
+		return 0;
+
+	case GPSCallbackType::gotRelativePositionMessage:
+		device->_relative_position_messages++;
+		return 0;
+
+	case GPSCallbackType::gotRawMessage:
+		device->_raw_messages++;
+		device->_raw_bytes += (size_t)data2;
+
+		if (device->_raw_sink) {
+			fwrite(data1, 1, (size_t)data2, device->_raw_sink);
+		}
+
+		return 0;
+
+	case GPSCallbackType::setBaudrate:
+		device->_host_baudrate = (unsigned)data2;
+		return 0;
+
+	case GPSCallbackType::surveyInStatus:
+	case GPSCallbackType::setClock:
+		return 0;
+	}
+
+	return 0;
+}
+
+void MockDevice::startStream(unsigned repeat)
+{
+	_pos = 0;
+	_repeat = _length > 0 ? repeat : 0;
+	_stream_start = virtual_time;
+	_stream_start_bytes = _bytes_served;
+	_spi_frame_left = 0;
+}
+
+int MockDevice::read(uint8_t *buf, size_t buf_length, int timeout)
+{
+	if (_spi_clock > 0) {
+		return (int)readSPI(buf, buf_length);
+	}
+
+	const size_t max_length = MIN(buf_length, _chunk_size);
+
+	if (_reply_pos < _reply_length && virtual_time < _reply_time) {
+		// the receiver is still processing the command
+		const gps_abstime timeout_us = (gps_abstime)(timeout > 0 ? timeout : 1) * 1000;
+
+		if (_reply_time - virtual_time > timeout_us) {
+			virtual_time += timeout_us;
+			return 0;
+		}
+
+		virtual_time = _reply_time;
+	}
+
+	size_t n;
+
+	if (_reply_pos < _reply_length) {
+		n = MIN(max_length, _reply_length - _reply_pos);
+		memcpy(buf, _reply + _reply_pos, n);
+		_reply_pos += n;
+		_chunk_timestamp = virtual_time;
+
+	} else if (_repeat == 0) {
+		n = readBeforeStream(buf, max_length);
+
+		if (n == 0) {
+			// nothing to read: the poll times out
+			virtual_time += (gps_abstime)(timeout > 0 ? timeout : 1) * 1000;
+			return 0;
+		}
+
+	} else {
+		const uint8_t *chunk;
+		n = nextChunk(chunk, max_length);
+		memcpy(buf, chunk, n);
+	}
+
+	if (baudrateMismatch()) {
+		addNoise(buf, n);
+	}
+
+	return (int)n;
+}
+
+size_t MockDevice::readBeforeStream(uint8_t *buf, size_t max_length)
+{
+	if (!_sending_before_stream || _length == 0) {
+		return 0;
+	}
+
+	const size_t n = MIN(max_length, _length - _pre_stream_pos);
+	memcpy(buf, _data + _pre_stream_pos, n);
+	_pre_stream_pos = (_pre_stream_pos + n) % _length;
+	_chunk_timestamp = virtual_time;
+
+	// the bytes arrive at the receiver's baudrate
+	const unsigned baudrate = _line_baudrate > 0 ? _line_baudrate : _wire_baudrate;
+
+	if (baudrate > 0) {
+		virtual_time += n * 10 * 1000000ULL / baudrate;
+	}
+
+	return n;
+}
+
+size_t MockDevice::readSPI(uint8_t *buf, size_t length)
+{
+	size_t n = 0;
+	_chunk_timestamp = virtual_time;
+
+	if (_reply_pos < _reply_length && virtual_time >= _reply_time) {
+		n = MIN(length, _reply_length - _reply_pos);
+		memcpy(buf, _reply + _reply_pos, n);
+		_reply_pos += n;
+
+	} else if (_repeat > 0) {
+		const size_t queued = _wire_baudrate > 0 ?
+				      (size_t)((virtual_time - _stream_start) * _wire_baudrate / 10000000ULL) : SIZE_MAX;
+		const size_t sent = _bytes_served - _stream_start_bytes;
+
+		// the receiver writes a frame into its queue at once, it sends fill only between frames
+		while (n < length && _repeat > 0) {
+			if (_spi_frame_left == 0) {
+				if (sent + n >= queued) {
+					break;
+				}
+
+				_spi_frame_left = frameLength(_pos);
+			}
+
+			const size_t chunk = MIN(length - n, _spi_frame_left);
+			memcpy(buf + n, _data + _pos, chunk);
+			n += chunk;
+			_pos += chunk;
+			_spi_frame_left -= chunk;
+
+			if (_pos == _length) {
+				_pos = 0;
+				_repeat--;
+				_spi_frame_left = 0;
+			}
+		}
+
+		_bytes_served += n;
+	}
+
+	memset(buf + n, 0xff, length - n);
+	_spi_transfers++;
+	_spi_fill_bytes += length - n;
+	virtual_time += (length * 8 * 1000000ULL + _spi_clock - 1) / _spi_clock;
+	return length;
+}
+
+size_t MockDevice::frameLength(size_t pos) const
+{
+	const uint8_t *frame = _data + pos;
+	const size_t available = _length - pos;
+	size_t length = 1;	// any other byte, e.g. of an NMEA sentence
+
+	if (available >= 6 && frame[0] == 0xb5 && frame[1] == 0x62) {
+		length = 8 + (frame[4] | (size_t)frame[5] << 8);
+
+	} else if (available >= 3 && frame[0] == 0xd3) {
+		length = 6 + ((frame[1] & 0x03u) << 8 | frame[2]);
+	}
+
+	return MIN(length, available);
+}
+
+void MockDevice::addNoise(uint8_t *buf, size_t length)
+{
+	// bytes sampled at the wrong baudrate have nothing in common with the ones sent
+	for (size_t i = 0; i < length; i++) {
+		_noise ^= _noise << 13;
+		_noise ^= _noise >> 17;
+		_noise ^= _noise << 5;
+		buf[i] = (uint8_t)_noise;
+	}
+}
+
+size_t MockDevice::nextChunk(const uint8_t *&chunk, size_t max_length)
+{
+	if (_repeat == 0) {
+		return 0;
+	}
+
+	const size_t n = MIN(MIN(max_length, _chunk_size), _length - _pos);
+	chunk = _data + _pos;
+	_pos += n;
+	_bytes_served += n;
+
+	// the first byte is complete after its own wire time
+	_chunk_timestamp = virtual_time + (_wire_baudrate > 0 ? 10 * 1000000ULL / _wire_baudrate : 0);
+
+	if (_wire_baudrate > 0) {
+		_wire_time_remainder += n * 10 * 1000000ULL;
+		virtual_time += _wire_time_remainder / _wire_baudrate;
+		_wire_time_remainder %= _wire_baudrate;
+	}
+
+	if (_pos == _length) {
+		_pos = 0;
+		_repeat--;
+	}
+
+	return n;
+}
+
+int MockDevice::write(const uint8_t *buf, size_t length)
+{
+	if (baudrateMismatch()) {
+		return (int)length;
+	}
+
+	switch (_responder) {
+	case Responder::UBX:
+		_command_parser.addBytes(buf, length);
+		break;
+
+	case Responder::SBF:
+		if (length >= 2 && buf[0] == '\n' && buf[1] == '\r') {
+			queueReply("COM1>", 5);
+
+		} else if (length > 3 && buf[0] >= 'a' && buf[0] <= 'z') {
+			// valid commands are echoed on the first reply line
+			queueReply("$R: ", 4);
+			queueReply(buf, length);
+			queueReply("\r\nCOM1>", 7);
+		}
+
+		break;
+
+	case Responder::None:
+		break;
+	}
+
+	return (int)length;
+}
+
+void MockDevice::queueReply(const void *data, size_t length)
+{
+	if (_reply_pos == _reply_length) {
+		_reply_pos = _reply_length = 0;
+		_reply_time = virtual_time + _reply_delay;
+	}
+
+	length = MIN(length, sizeof(_reply) - _reply_length);
+	memcpy(_reply + _reply_length, data, length);
+	_reply_length += length;
+}
+
+void MockDevice::queueUBX(uint8_t msg_class, uint8_t msg_id, const void *payload, uint16_t length)
+{
+	uint8_t header[6] = {0xb5, 0x62, msg_class, msg_id, (uint8_t)(length & 0xff), (uint8_t)(length >> 8)};
+	uint8_t ck_a = 0;
+	uint8_t ck_b = 0;
+
+	for (size_t i = 2; i < sizeof(header); i++) {
+		ck_a = (uint8_t)(ck_a + header[i]);
+		ck_b = (uint8_t)(ck_b + ck_a);
+	}
+
+	for (size_t i = 0; i < length; i++) {
+		ck_a = (uint8_t)(ck_a + ((const uint8_t *)payload)[i]);
+		ck_b = (uint8_t)(ck_b + ck_a);
+	}
+
+	const uint8_t checksum[2] = {ck_a, ck_b};
+	queueReply(header, sizeof(header));
+	queueReply(payload, length);
+	queueReply(checksum, sizeof(checksum));
+}
+
+void MockDevice::handleUBXCommand(ProtocolDemux::Protocol, const uint8_t *frame, size_t length, void *user)
+{
+	MockDevice *device = (MockDevice *)user;
+	const uint8_t msg_class = frame[2];
+	const uint8_t msg_id = frame[3];
+
+	if (msg_class == 0x0a && msg_id == 0x04 && length == 8) {
+		// MON-VER poll
+		uint8_t mon_ver[30 + 10 + 3 * 30] {};
+		strcpy((char *)mon_ver, "EXT CORE 1.00 (fake)");
+		strcpy((char *)mon_ver + 30, "00190000");
+		strcpy((char *)mon_ver + 40, "FWVER=HPG 1.32");
+		strcpy((char *)mon_ver + 70, "PROTVER=27.31");
+		strcpy((char *)mon_ver + 100, "MOD=ZED-F9P");
+		device->queueUBX(0x0a, 0x04, mon_ver, sizeof(mon_ver));
+
+	} else if (msg_class == 0x27 && msg_id == 0x03 && length == 8) {
+		// SEC-UNIQID poll
+		const uint8_t uniqid[10] = {2, 0, 0, 0, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc};
+		device->queueUBX(0x27, 0x03, uniqid, sizeof(uniqid));
+
+	} else if (msg_class == 0x06 && msg_id == 0x8b) {
+		device->handleCfgValget(frame + 6, length - 8);
+
+	} else if (msg_class == 0x06) {
+		// ACK-ACK for every CFG message, ACK-NAK for a rejected CFG-VALSET
+		const bool accepted = msg_id != 0x8a || device->handleCfgValset(frame + 6, length - 8);
+		const uint8_t ack[2] = {msg_class, msg_id};
+		device->queueUBX(0x05, accepted ? 0x01 : 0x00, ack, sizeof(ack));
+	}
+}
+
+static size_t cfgValueSize(uint32_t key_id)
+{
+	switch ((key_id >> 28) & 0x7) {
+	case 1:
+	case 2: return 1;
+
+	case 3: return 2;
+
+	case 4: return 4;
+
+	case 5: return 8;
+
+	default: return 0;
+	}
+}
+
+void MockDevice::setCfgValue(uint32_t key_id, uint8_t layers, const void *value)
+{
+	size_t i = 0;
+
+	while (i < _cfg_value_count && _cfg_values[i].key_id != key_id) {
+		i++;
+	}
+
+	if (i == _cfg_value_count) {
+		if (_cfg_value_count == sizeof(_cfg_values) / sizeof(_cfg_values[0])) {
+			return;
+		}
+
+		_cfg_value_count++;
+	}
+
+	_cfg_values[i].key_id = key_id;
+	_cfg_values[i].layers |= layers;
+
+	for (unsigned layer = 0; layer < 3; layer++) {
+		if (layers & (1 << layer)) {
+			memcpy(_cfg_values[i].value[layer], value, cfgValueSize(key_id));
+		}
+	}
+}
+
+bool MockDevice::handleCfgValset(const uint8_t *payload, size_t length)
+{
+	if (_cfg_valsets < sizeof(_cfg_valset_keys) / sizeof(_cfg_valset_keys[0])) {
+		_cfg_valset_keys[_cfg_valsets] = 0;
+	}
+
+	// version, layers, reserved, then key and value pairs
+	for (int apply = 0; apply < 2; apply++) {
+		size_t pos = 4;
+
+		while (pos + 4 <= length) {
+			uint32_t key_id;
+			memcpy(&key_id, payload + pos, sizeof(key_id));
+			const size_t size = cfgValueSize(key_id);
+
+			if (size == 0 || pos + 4 + size > length) {
+				break;
+			}
+
+			if (!apply) {
+				if (key_id == _cfg_nak_key) {
+					_cfg_valsets++;
+					return false;
+				}
+
+			} else {
+				if (key_id == 0x40520001 && _line_baudrate != 0) {
+					// CFG-UART1-BAUDRATE
+					memcpy(&_line_baudrate, payload + pos + 4, sizeof(_line_baudrate));
+				}
+
+				setCfgValue(key_id, payload[1], payload + pos + 4);
+
+				if (_cfg_valsets < sizeof(_cfg_valset_keys) / sizeof(_cfg_valset_keys[0])) {
+					_cfg_valset_keys[_cfg_valsets]++;
+				}
+
+				_cfg_keys_set++;
+			}
+
+			pos += 4 + size;
+		}
+	}
+
+	_cfg_valsets++;
+	return true;
+}
+
+void MockDevice::handleCfgValget(const uint8_t *payload, size_t length)
+{
+	if (length < 4) {
+		return;
+	}
+
+	_cfg_valgets++;
+
+	// the response has the poll's header, followed by the keys that are set in the polled layer
+	const uint8_t layer = payload[1];
+	const uint8_t layer_mask = layer < 3 ? (uint8_t)(1 << layer) : 0;
+	uint8_t response[4 + 64 * 12] {};
+	size_t response_length = 4;
+	response[0] = 1;
+	response[1] = payload[1];
+
+	for (size_t pos = 4; pos + 4 <= length; pos += 4) {
+		uint32_t key_id;
+		memcpy(&key_id, payload + pos, sizeof(key_id));
+
+		for (size_t i = 0; i < _cfg_value_count; i++) {
+			if (_cfg_values[i].key_id == key_id && (_cfg_values[i].layers & layer_mask)
+			    && response_length + 4 + 8 <= sizeof(response)) {
+				memcpy(response + response_length, &key_id, sizeof(key_id));
+				memcpy(response + response_length + 4, _cfg_values[i].value[layer], cfgValueSize(key_id));
+				response_length += 4 + cfgValueSize(key_id);
+			}
+		}
+	}
+
+	queueUBX(0x06, 0x8b, response, (uint16_t)response_length);
+}
@@ -0,0 +1,254 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2023 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mock_device.h
+ *
+ * Simulated receiver for running the drivers on a host: serves a byte capture through the
+ * readDeviceData callback, answers the configuration handshake of the drivers that need one
+ * and keeps the virtual clock.
+ */
+
+#pragma once
+
+#include "gps_helper.h"
+#include "protocol_demux.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+
+class MockDevice
+{
+public:
+	/** configuration handshake to emulate */
+	enum class Responder {
+		None,
+		UBX,	///< ACK every CFG message, answer MON-VER and SEC-UNIQID as a ZED-F9P and CFG-VALGET with the values set
+		SBF,	///< answer the COM port prompt and echo commands with "$R: "
+	};
+
+	/**
+	 * @param data capture to serve, must stay valid while the device is used
+	 * @param length capture length in bytes
+	 * @param chunk_size largest number of bytes returned by a single read
+	 * @param responder configuration handshake to emulate
+	 */
+	MockDevice(const uint8_t *data, size_t length, size_t chunk_size = GPS_READ_BUFFER_SIZE,
+		   Responder responder = Responder::None);
+
+	/**
+	 * GPSCallbackPtr implementation, pass the MockDevice as callback user
+	 */
+	static int callback(GPSCallbackType type, void *data1, int data2, void *user);
+
+	/**
+	 * Start serving the capture. Before this, reads only return configuration replies.
+	 * @param repeat number of times to serve the capture
+	 */
+	void startStream(unsigned repeat = 1);
+
+	bool streamDone() const { return _repeat == 0; }
+
+	/**
+	 * Advance the virtual clock on every read by the time the bytes take on a UART, at 10 bits per
+	 * byte, so timestamps and rate measurements of the drivers see the recorded data rate.
+	 * @param baudrate line rate, 0 (default) to only advance the clock when nothing is read
+	 */
+	void setWireBaudrate(unsigned baudrate) { _wire_baudrate = baudrate; }
+
+	/**
+	 * Model an SPI port instead of a UART: a read is a transfer of the requested length (not limited
+	 * by the chunk size) and takes its time at the clock rate. The receiver queues the capture at the
+	 * wire baudrate from startStream() on, whole UBX and RTCM frames at once, and a transfer returns
+	 * what is queued and 0xFF fill after it.
+	 * @param clock SPI clock in Hz, 0 (default) for a UART
+	 */
+	void setSPIClock(unsigned clock) { _spi_clock = clock; }
+
+	/**
+	 * SPI transfers and the fill bytes returned by them
+	 */
+	uint32_t spiTransfers() const { return _spi_transfers; }
+	size_t spiFillBytes() const { return _spi_fill_bytes; }
+
+	/**
+	 * Delay the configuration replies, the way a receiver takes time to process a command.
+	 * Replies queued while earlier ones are pending become readable together with them.
+	 * @param usec delay on the virtual clock, 0 (default) to reply immediately
+	 */
+	void setReplyDelay(gps_abstime usec) { _reply_delay = usec; }
+
+	/**
+	 * Model the receiver's UART: at any other baudrate of the host, reads return noise and commands
+	 * are lost. A UBX CFG-VALSET of the UART1 baudrate changes it.
+	 * @param baudrate receiver baudrate, 0 (default) to work at any baudrate
+	 * @param sending the receiver already sends the capture before startStream(), e.g. after a restart
+	 *                of the driver. These bytes are not counted in bytesServed().
+	 */
+	void setLineBaudrate(unsigned baudrate, bool sending)
+	{
+		_line_baudrate = baudrate;
+		_sending_before_stream = sending;
+	}
+
+	/**
+	 * @return number of CFG-VALSET keys received
+	 */
+	uint32_t cfgKeysSet() const { return _cfg_keys_set; }
+
+	/**
+	 * CFG-VALSET and CFG-VALGET messages received, and the keys of the n-th CFG-VALSET
+	 */
+	uint32_t cfgValsets() const { return _cfg_valsets; }
+	uint32_t cfgValgets() const { return _cfg_valgets; }
+	uint32_t cfgValsetKeys(uint32_t n) const { return n < sizeof(_cfg_valset_keys) / sizeof(_cfg_valset_keys[0]) ? _cfg_valset_keys[n] : 0; }
+
+	/**
+	 * Store a configuration value, as if the receiver had it from an earlier configuration
+	 * @param layers CFG-VALSET layer mask: 1 = RAM, 2 = BBR, 4 = flash
+	 */
+	void setCfgValue(uint32_t key_id, uint8_t layers, const void *value);
+
+	/**
+	 * Reject a CFG-VALSET with this key with an ACK-NAK and keep none of its values, the way a
+	 * receiver handles a key it doesn't know
+	 * @param key_id 0 (default) to accept every key
+	 */
+	void setCfgNakKey(uint32_t key_id) { _cfg_nak_key = key_id; }
+
+	/**
+	 * Take the next chunk of the capture without copying it, the way an event driven I/O loop gets
+	 * data to pass to GPSHelper::feed(). Advances the clock like readDeviceData.
+	 * @param chunk output, valid while the device is
+	 * @param max_length largest chunk to return, limited by the chunk size as well
+	 * @return chunk length, 0 once the stream is done
+	 */
+	size_t nextChunk(const uint8_t *&chunk, size_t max_length = SIZE_MAX);
+
+	/**
+	 * Reception time of the first byte of the last chunk on the virtual clock, as returned by
+	 * readDeviceDataTimestamped
+	 */
+	gps_abstime chunkTimestamp() const { return _chunk_timestamp; }
+
+	size_t bytesServed() const { return _bytes_served; }
+	uint32_t rtcmMessages() const { return _rtcm_messages; }
+	uint32_t relativePositionMessages() const { return _relative_position_messages; }
+
+	/**
+	 * Raw messages (gotRawMessage) received and their total length
+	 */
+	uint32_t rawMessages() const { return _raw_messages; }
+	size_t rawBytes() const { return _raw_bytes; }
+
+	/**
+	 * @param sink file the raw messages are written to, nullptr for none
+	 */
+	void setRawSink(FILE *sink) { _raw_sink = sink; }
+
+	/**
+	 * Advance the virtual clock. Reads that return nothing advance it by their timeout.
+	 */
+	static void advanceTime(gps_abstime usec);
+
+private:
+	int read(uint8_t *buf, size_t buf_length, int timeout);
+	size_t readBeforeStream(uint8_t *buf, size_t max_length);
+	size_t readSPI(uint8_t *buf, size_t length);
+	size_t frameLength(size_t pos) const;
+	bool baudrateMismatch() const { return _line_baudrate != 0 && _host_baudrate != _line_baudrate; }
+	void addNoise(uint8_t *buf, size_t length);
+	int write(const uint8_t *buf, size_t length);
+
+	void queueReply(const void *data, size_t length);
+	void queueUBX(uint8_t msg_class, uint8_t msg_id, const void *payload, uint16_t length);
+
+	static void handleUBXCommand(ProtocolDemux::Protocol protocol, const uint8_t *frame, size_t length, void *user);
+	bool handleCfgValset(const uint8_t *payload, size_t length);
+	void handleCfgValget(const uint8_t *payload, size_t length);
+
+	const uint8_t	*_data;
+	const size_t	_length;
+	const size_t	_chunk_size;
+	const Responder	_responder;
+
+	size_t		_pos{0};
+	unsigned	_repeat{0};
+	size_t		_bytes_served{0};
+	unsigned	_wire_baudrate{0};
+	uint64_t	_wire_time_remainder{0};		///< wire time not yet added to the clock, in us * _wire_baudrate
+	gps_abstime	_chunk_timestamp{0};
+
+	unsigned	_spi_clock{0};
+	gps_abstime	_stream_start{0};
+	size_t		_stream_start_bytes{0};
+	size_t		_spi_frame_left{0};		///< bytes of the capture frame being sent
+	uint32_t	_spi_transfers{0};
+	size_t		_spi_fill_bytes{0};
+
+	unsigned	_line_baudrate{0};
+	unsigned	_host_baudrate{0};
+	bool		_sending_before_stream{false};
+	size_t		_pre_stream_pos{0};
+	uint32_t	_noise{0x12345678};
+
+	uint8_t		_reply[1024] {};		///< pending configuration replies, served before capture data
+	size_t		_reply_length{0};
+	size_t		_reply_pos{0};
+	gps_abstime	_reply_delay{0};
+	gps_abstime	_reply_time{0};			///< virtual time the pending replies become readable
+
+	struct CfgValue {
+		uint32_t key_id;
+		uint8_t layers;				///< CFG-VALSET layer mask the value was written to
+		uint8_t value[3][8];			///< by CFG-VALGET layer: RAM, BBR, flash
+	};
+
+	CfgValue	_cfg_values[256] {};		///< configuration set with CFG-VALSET
+	size_t		_cfg_value_count{0};
+	uint32_t	_cfg_keys_set{0};
+	uint32_t	_cfg_valsets{0};
+	uint32_t	_cfg_valgets{0};
+	uint32_t	_cfg_valset_keys[32] {};	///< keys of the first CFG-VALSET messages
+	uint32_t	_cfg_nak_key{0};
+
+	ProtocolDemux	_command_parser;
+
+	uint32_t	_rtcm_messages{0};
+	uint32_t	_relative_position_messages{0};
+
+	uint32_t	_raw_messages{0};
+	size_t		_raw_bytes{0};
+	FILE		*_raw_sink{nullptr};
+};